@@ -26,8 +26,7 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <glib.h>
-#include <dbus/dbus-glib.h>
-#include <dbus/dbus.h>
+#include <gio/gio.h>
 
 #include "egg-console-kit.h"
 
@@ -42,14 +41,31 @@ static void     egg_console_kit_finalize	(GObject		*object);
 #define CONSOLEKIT_SEAT_INTERFACE       "org.freedesktop.ConsoleKit.Seat"
 #define CONSOLEKIT_SESSION_INTERFACE    "org.freedesktop.ConsoleKit.Session"
 
+#define EGG_CONSOLE_KIT_PROXY_FLAGS	(G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES | \
+					 G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START_AT_CONSTRUCTION)
+
 struct EggConsoleKitPrivate
 {
-	DBusGConnection		*connection;
-	DBusGProxy		*proxy_manager;
-	DBusGProxy		*proxy_session;
+	GDBusProxy		*proxy_manager;
+	GDBusProxy		*proxy_session;
+	GCancellable		*cancellable;
+	gboolean		 connecting;
+	GError			*manager_error;
+	GQueue			 waiting;	/* of GTask, until the manager proxy is made */
 	gchar			*session_id;
+	gboolean		 session_failed;
+	gboolean		 session_warned;
+	gboolean		 is_active;
+	gboolean		 is_local;
 };
 
+typedef struct {
+	const gchar		*method;
+	GVariant		*parameters;
+	const GVariantType	*reply_type;
+	gint			 timeout;
+} EggConsoleKitCall;
+
 enum {
 	EGG_CONSOLE_KIT_ACTIVE_CHANGED,
 	EGG_CONSOLE_KIT_LAST_SIGNAL
@@ -60,291 +76,483 @@ static guint signals [EGG_CONSOLE_KIT_LAST_SIGNAL] = { 0 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (EggConsoleKit, egg_console_kit, G_TYPE_OBJECT)
 
+static void	egg_console_kit_manager_proxy_cb	(GObject	*source,
+							 GAsyncResult	*res,
+							 gpointer	 user_data);
+
 /**
- * egg_console_kit_restart:
+ * egg_console_kit_logind_running:
+ *
+ * Return value: if logind looks after the seats, so ConsoleKit is not used
  **/
-gboolean
-egg_console_kit_restart (EggConsoleKit *console, GError **error)
+static gboolean
+egg_console_kit_logind_running (void)
 {
-	gboolean ret;
-	GError *error_local = NULL;
-
-	g_return_val_if_fail (EGG_IS_CONSOLE_KIT (console), FALSE);
-	g_return_val_if_fail (console->priv->proxy_manager != NULL, FALSE);
-
-	ret = dbus_g_proxy_call (console->priv->proxy_manager, "Restart", &error_local,
-				 G_TYPE_INVALID, G_TYPE_INVALID);
-	if (!ret) {
-		g_warning ("Couldn't restart: %s", error_local->message);
-		if (error != NULL)
-			*error = g_error_new (1, 0, "%s", error_local->message);
-		g_error_free (error_local);
-	}
-	return ret;
+	return access ("/run/systemd/seats/", F_OK) >= 0;
 }
 
 /**
- * egg_console_kit_stop:
+ * egg_console_kit_connect:
+ *
+ * Makes the manager proxy in the background, if it is not made already.
  **/
-gboolean
-egg_console_kit_stop (EggConsoleKit *console, GError **error)
+static void
+egg_console_kit_connect (EggConsoleKit *console)
 {
-	gboolean ret;
-	GError *error_local = NULL;
+	if (console->priv->proxy_manager != NULL || console->priv->connecting)
+		return;
+	console->priv->connecting = TRUE;
+	g_dbus_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
+				  EGG_CONSOLE_KIT_PROXY_FLAGS |
+				  G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS,
+				  NULL, CONSOLEKIT_NAME, CONSOLEKIT_MANAGER_PATH,
+				  CONSOLEKIT_MANAGER_INTERFACE, console->priv->cancellable,
+				  egg_console_kit_manager_proxy_cb, console);
+}
 
-	g_return_val_if_fail (EGG_IS_CONSOLE_KIT (console), FALSE);
-	g_return_val_if_fail (console->priv->proxy_manager != NULL, FALSE);
-
-	ret = dbus_g_proxy_call (console->priv->proxy_manager, "Stop", &error_local,
-				 G_TYPE_INVALID, G_TYPE_INVALID);
-	if (!ret) {
-		g_warning ("Couldn't stop: %s", error_local->message);
-		if (error != NULL)
-			*error = g_error_new (1, 0, "%s", error_local->message);
-		g_error_free (error_local);
-	}
-	return ret;
+/**
+ * egg_console_kit_call_free:
+ **/
+static void
+egg_console_kit_call_free (EggConsoleKitCall *call)
+{
+	if (call->parameters != NULL)
+		g_variant_unref (call->parameters);
+	g_free (call);
 }
 
 /**
- * egg_console_kit_suspend:
+ * egg_console_kit_call_cb:
  **/
-gboolean
-egg_console_kit_suspend (EggConsoleKit *console, GError **error)
+static void
+egg_console_kit_call_cb (GObject *source, GAsyncResult *res, gpointer user_data)
 {
-	gboolean ret;
-	GError *error_local = NULL;
+	GTask *task = G_TASK (user_data);
+	EggConsoleKitCall *call = g_task_get_task_data (task);
+	GVariant *result;
+	GError *error = NULL;
 
-	g_return_val_if_fail (EGG_IS_CONSOLE_KIT (console), FALSE);
-	g_return_val_if_fail (console->priv->proxy_manager != NULL, FALSE);
-
-	ret = dbus_g_proxy_call (console->priv->proxy_manager, "Suspend", &error_local,
-				 G_TYPE_BOOLEAN, TRUE,
-				 G_TYPE_INVALID, G_TYPE_INVALID);
-	if (!ret) {
-		g_warning ("Couldn't suspend: %s", error_local->message);
-		if (error != NULL)
-			*error = g_error_new (1, 0, "%s", error_local->message);
-		g_error_free (error_local);
+	result = g_dbus_proxy_call_finish (G_DBUS_PROXY (source), res, &error);
+	if (result == NULL) {
+		g_dbus_error_strip_remote_error (error);
+		g_warning ("Couldn't %s: %s", call->method, error->message);
+		g_task_return_error (task, error);
+	} else if (call->reply_type != NULL && !g_variant_is_of_type (result, call->reply_type)) {
+		g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+					 "%s returned %s, expected %s", call->method,
+					 g_variant_get_type_string (result),
+					 g_variant_type_peek_string (call->reply_type));
+		g_variant_unref (result);
+	} else {
+		g_task_return_pointer (task, result, (GDestroyNotify) g_variant_unref);
 	}
-	return ret;
+	g_object_unref (task);
 }
 
 /**
- * egg_console_kit_hibernate:
+ * egg_console_kit_call_start:
  **/
-gboolean
-egg_console_kit_hibernate (EggConsoleKit *console, GError **error)
+static void
+egg_console_kit_call_start (EggConsoleKit *console, GTask *task)
 {
-	gboolean ret;
-	GError *error_local = NULL;
+	EggConsoleKitCall *call = g_task_get_task_data (task);
 
-	g_return_val_if_fail (EGG_IS_CONSOLE_KIT (console), FALSE);
-	g_return_val_if_fail (console->priv->proxy_manager != NULL, FALSE);
-
-	ret = dbus_g_proxy_call (console->priv->proxy_manager, "Hibernate", &error_local,
-				 G_TYPE_BOOLEAN, TRUE,
-				 G_TYPE_INVALID, G_TYPE_INVALID);
-	if (!ret) {
-		g_warning ("Couldn't hibernate: %s", error_local->message);
-		if (error != NULL)
-			*error = g_error_new (1, 0, "%s", error_local->message);
-		g_error_free (error_local);
+	g_dbus_proxy_call (console->priv->proxy_manager, call->method, call->parameters,
+			   G_DBUS_CALL_FLAGS_NONE, call->timeout, NULL,
+			   egg_console_kit_call_cb, task);
+}
+
+/**
+ * egg_console_kit_call_async:
+ *
+ * Calls @method on the manager once the proxy is made, without ever
+ * waiting for either.
+ **/
+static void
+egg_console_kit_call_async (EggConsoleKit *console, const gchar *method,
+			    GVariant *parameters, const GVariantType *reply_type,
+			    gint timeout, GAsyncReadyCallback callback, gpointer user_data)
+{
+	EggConsoleKitCall *call;
+	GTask *task;
+
+	call = g_new0 (EggConsoleKitCall, 1);
+	call->method = method;
+	call->parameters = parameters != NULL ? g_variant_ref_sink (parameters) : NULL;
+	call->reply_type = reply_type;
+	call->timeout = timeout;
+	task = g_task_new (console, NULL, callback, user_data);
+	g_task_set_task_data (task, call, (GDestroyNotify) egg_console_kit_call_free);
+
+	if (console->priv->proxy_manager != NULL) {
+		egg_console_kit_call_start (console, task);
+		return;
+	}
+	if (console->priv->manager_error != NULL) {
+		g_task_return_error (task, g_error_copy (console->priv->manager_error));
+		g_object_unref (task);
+		return;
 	}
-	return ret;
+	g_queue_push_tail (&console->priv->waiting, task);
+	egg_console_kit_connect (console);
 }
 
 /**
- * egg_console_kit_can_stop:
+ * egg_console_kit_call_finish:
+ *
+ * Return value: the reply, or %NULL with @error set
  **/
-gboolean
-egg_console_kit_can_stop (EggConsoleKit *console, gboolean *can_stop, GError **error)
+static GVariant *
+egg_console_kit_call_finish (EggConsoleKit *console, GAsyncResult *res, GError **error)
 {
-	gboolean ret;
-	GError *error_local = NULL;
+	g_return_val_if_fail (g_task_is_valid (res, console), NULL);
+	return g_task_propagate_pointer (G_TASK (res), error);
+}
 
-	g_return_val_if_fail (EGG_IS_CONSOLE_KIT (console), FALSE);
-	g_return_val_if_fail (console->priv->proxy_manager != NULL, FALSE);
-
-	ret = dbus_g_proxy_call (console->priv->proxy_manager, "CanStop", &error_local,
-				 G_TYPE_INVALID,
-				 G_TYPE_BOOLEAN, can_stop, G_TYPE_INVALID);
-	if (!ret) {
-		g_warning ("Couldn't do CanStop: %s", error_local->message);
-		if (error != NULL)
-			*error = g_error_new (1, 0, "%s", error_local->message);
-		g_error_free (error_local);
-		/* CanStop was only added in new versions of ConsoleKit,
-		 * so assume true if this failed */
-		*can_stop = TRUE;
-	}
-	return ret;
+/**
+ * egg_console_kit_restart_async:
+ **/
+void
+egg_console_kit_restart_async (EggConsoleKit *console, GAsyncReadyCallback callback, gpointer user_data)
+{
+	g_return_if_fail (EGG_IS_CONSOLE_KIT (console));
+	egg_console_kit_call_async (console, "Restart", NULL, NULL, -1, callback, user_data);
 }
 
 /**
- * egg_console_kit_can_restart:
+ * egg_console_kit_stop_async:
  **/
-gboolean
-egg_console_kit_can_restart (EggConsoleKit *console, gboolean *can_restart, GError **error)
+void
+egg_console_kit_stop_async (EggConsoleKit *console, GAsyncReadyCallback callback, gpointer user_data)
 {
-	gboolean ret;
-	GError *error_local = NULL;
+	g_return_if_fail (EGG_IS_CONSOLE_KIT (console));
+	egg_console_kit_call_async (console, "Stop", NULL, NULL, -1, callback, user_data);
+}
 
-	g_return_val_if_fail (EGG_IS_CONSOLE_KIT (console), FALSE);
-	g_return_val_if_fail (console->priv->proxy_manager != NULL, FALSE);
-
-	ret = dbus_g_proxy_call (console->priv->proxy_manager, "CanRestart", &error_local,
-				 G_TYPE_INVALID,
-				 G_TYPE_BOOLEAN, can_restart, G_TYPE_INVALID);
-	if (!ret) {
-		g_warning ("Couldn't do CanRestart: %s", error_local->message);
-		if (error != NULL)
-			*error = g_error_new (1, 0, "%s", error_local->message);
-		g_error_free (error_local);
-		/* CanRestart was only added in new versions of ConsoleKit,
-		 * so assume true if this failed */
-		*can_restart = TRUE;
-	}
-	return ret;
+/**
+ * egg_console_kit_suspend_async:
+ *
+ * ConsoleKit only replies once we have resumed, so never wait for it.
+ **/
+void
+egg_console_kit_suspend_async (EggConsoleKit *console, GAsyncReadyCallback callback, gpointer user_data)
+{
+	g_return_if_fail (EGG_IS_CONSOLE_KIT (console));
+	egg_console_kit_call_async (console, "Suspend", g_variant_new ("(b)", TRUE), NULL,
+				    G_MAXINT, callback, user_data);
 }
 
 /**
- * egg_console_kit_can_suspend:
+ * egg_console_kit_hibernate_async:
  **/
-gboolean
-egg_console_kit_can_suspend (EggConsoleKit *console, gboolean *can_suspend, GError **error)
+void
+egg_console_kit_hibernate_async (EggConsoleKit *console, GAsyncReadyCallback callback, gpointer user_data)
 {
-	GError *error_local = NULL;
-	gboolean ret;
-	gchar  *retval;
+	g_return_if_fail (EGG_IS_CONSOLE_KIT (console));
+	egg_console_kit_call_async (console, "Hibernate", g_variant_new ("(b)", TRUE), NULL,
+				    G_MAXINT, callback, user_data);
+}
 
-	g_return_val_if_fail (EGG_IS_CONSOLE_KIT (console), FALSE);
-	g_return_val_if_fail (console->priv->proxy_manager != NULL, FALSE);
-
-	ret = dbus_g_proxy_call (console->priv->proxy_manager, "CanSuspend", &error_local,
-				 G_TYPE_INVALID,
-				 G_TYPE_STRING, &retval, G_TYPE_INVALID);
-	if (!ret) {
-		g_warning ("Couldn't do CanSuspend: %s", error_local->message);
-		if (error != NULL)
-			*error = g_error_new (1, 0, "%s", error_local->message);
-		g_error_free (error_local);
-	}
+/**
+ * egg_console_kit_action_finish:
+ *
+ * Finishes egg_console_kit_stop_async(), egg_console_kit_restart_async(),
+ * egg_console_kit_suspend_async() or egg_console_kit_hibernate_async().
+ **/
+gboolean
+egg_console_kit_action_finish (EggConsoleKit *console, GAsyncResult *res, GError **error)
+{
+	GVariant *result;
 
-	*can_suspend = g_strcmp0 (retval, "yes") == 0 ||
-		       g_strcmp0 (retval, "challenge") == 0;
+	result = egg_console_kit_call_finish (console, res, error);
+	if (result == NULL)
+		return FALSE;
+	g_variant_unref (result);
+	return TRUE;
+}
 
-	g_free (retval);
-	return ret;
+/**
+ * egg_console_kit_can_suspend_async:
+ **/
+void
+egg_console_kit_can_suspend_async (EggConsoleKit *console, GAsyncReadyCallback callback, gpointer user_data)
+{
+	g_return_if_fail (EGG_IS_CONSOLE_KIT (console));
+	egg_console_kit_call_async (console, "CanSuspend", NULL, G_VARIANT_TYPE ("(s)"),
+				    -1, callback, user_data);
 }
 
 /**
- * egg_console_kit_can_hibernate:
+ * egg_console_kit_can_hibernate_async:
  **/
+void
+egg_console_kit_can_hibernate_async (EggConsoleKit *console, GAsyncReadyCallback callback, gpointer user_data)
+{
+	g_return_if_fail (EGG_IS_CONSOLE_KIT (console));
+	egg_console_kit_call_async (console, "CanHibernate", NULL, G_VARIANT_TYPE ("(s)"),
+				    -1, callback, user_data);
+}
 
+/**
+ * egg_console_kit_can_finish:
+ * @value: Set to whether it is allowed, and %FALSE on error
+ *
+ * Finishes egg_console_kit_can_suspend_async() or
+ * egg_console_kit_can_hibernate_async().
+ **/
 gboolean
-egg_console_kit_can_hibernate (EggConsoleKit *console, gboolean *can_hibernate, GError **error)
+egg_console_kit_can_finish (EggConsoleKit *console, GAsyncResult *res, gboolean *value, GError **error)
 {
-	GError *error_local = NULL;
-	gboolean ret;
-	gchar  *retval;
+	GVariant *result;
+	const gchar *retval;
+
+	*value = FALSE;
+	result = egg_console_kit_call_finish (console, res, error);
+	if (result == NULL)
+		return FALSE;
+	g_variant_get (result, "(&s)", &retval);
+	*value = g_strcmp0 (retval, "yes") == 0 ||
+		 g_strcmp0 (retval, "challenge") == 0;
+	g_variant_unref (result);
+	return TRUE;
+}
 
-	g_return_val_if_fail (EGG_IS_CONSOLE_KIT (console), FALSE);
-	g_return_val_if_fail (console->priv->proxy_manager != NULL, FALSE);
-
-	ret = dbus_g_proxy_call (console->priv->proxy_manager, "CanHibernate", &error_local,
-				 G_TYPE_INVALID,
-				 G_TYPE_STRING, &retval, G_TYPE_INVALID);
-	if (!ret) {
-		g_warning ("Couldn't do CanHibernate: %s", error_local->message);
-		if (error != NULL)
-			*error = g_error_new (1, 0, "%s", error_local->message);
-		g_error_free (error_local);
+/**
+ * egg_console_kit_session_missing:
+ *
+ * Return value: if ConsoleKit does not know about our session, said
+ * only the first time
+ **/
+static gboolean
+egg_console_kit_session_missing (EggConsoleKit *console)
+{
+	if (!console->priv->session_failed)
+		return FALSE;
+	if (!console->priv->session_warned) {
+		g_debug ("no ConsoleKit session, so not local or active");
+		console->priv->session_warned = TRUE;
 	}
-
-	*can_hibernate = g_strcmp0 (retval, "yes") == 0 ||
-	                 g_strcmp0 (retval, "challenge") == 0;
-	return ret;
+	return TRUE;
 }
 
 /**
  * egg_console_kit_is_local:
  *
+ * Only reads the cached value, so never blocks.
+ *
  * Return value: Returns whether the session is local
  **/
 gboolean
 egg_console_kit_is_local (EggConsoleKit *console)
 {
-	gboolean ret = FALSE;
-	gboolean value = FALSE;
-	GError *error = NULL;
-
 	g_return_val_if_fail (EGG_IS_CONSOLE_KIT (console), FALSE);
 
 	/* maybe console kit does not know about our session */
-	if (console->priv->proxy_session == NULL) {
-		g_warning ("no ConsoleKit session");
-		goto out;
-	}
-
-	/* is our session local */
-	ret = dbus_g_proxy_call (console->priv->proxy_session, "IsLocal", &error, G_TYPE_INVALID,
-				 G_TYPE_BOOLEAN, &value, G_TYPE_INVALID);
-	if (!ret) {
-		g_warning ("IsLocal failed: %s", error->message);
-		g_error_free (error);
-		goto out;
-	}
-
-	/* return value only if we successed */
-	ret = value;
-out:
-	return ret;
+	if (egg_console_kit_session_missing (console))
+		return FALSE;
+	return console->priv->is_local;
 }
 
 /**
  * egg_console_kit_is_active:
  *
+ * Only reads the cached value, which is kept up to date from the
+ * ActiveChanged signal, so never blocks.
+ *
  * Return value: Returns whether the session is active on the Seat that it is attached to.
  **/
 gboolean
 egg_console_kit_is_active (EggConsoleKit *console)
 {
-	gboolean ret = FALSE;
-	gboolean value = FALSE;
-	GError *error = NULL;
-
 	g_return_val_if_fail (EGG_IS_CONSOLE_KIT (console), FALSE);
 
 	/* maybe console kit does not know about our session */
-	if (console->priv->proxy_session == NULL) {
-		g_warning ("no ConsoleKit session");
-		goto out;
+	if (egg_console_kit_session_missing (console))
+		return FALSE;
+	return console->priv->is_active;
+}
+
+/**
+ * egg_console_kit_set_active:
+ **/
+static void
+egg_console_kit_set_active (EggConsoleKit *console, gboolean active)
+{
+	if (console->priv->is_active == active)
+		return;
+	console->priv->is_active = active;
+	g_debug ("emitting active: %i", active);
+	g_signal_emit (console, signals [EGG_CONSOLE_KIT_ACTIVE_CHANGED], 0, active);
+}
+
+/**
+ * egg_console_kit_session_signal_cb:
+ **/
+static void
+egg_console_kit_session_signal_cb (GDBusProxy *proxy, const gchar *sender_name,
+				   const gchar *signal_name, GVariant *parameters,
+				   EggConsoleKit *console)
+{
+	gboolean active;
+
+	if (g_strcmp0 (signal_name, "ActiveChanged") != 0)
+		return;
+	if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(b)")))
+		return;
+	g_variant_get (parameters, "(b)", &active);
+	egg_console_kit_set_active (console, active);
+}
+
+/**
+ * egg_console_kit_is_active_cb:
+ **/
+static void
+egg_console_kit_is_active_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GVariant *result;
+	GError *error = NULL;
+	gboolean value;
+
+	result = g_dbus_proxy_call_finish (G_DBUS_PROXY (source), res, &error);
+	if (result == NULL) {
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			g_warning ("IsActive failed: %s", error->message);
+		g_error_free (error);
+		return;
 	}
+	g_variant_get (result, "(b)", &value);
+	g_variant_unref (result);
+	egg_console_kit_set_active (EGG_CONSOLE_KIT (user_data), value);
+}
+
+/**
+ * egg_console_kit_is_local_cb:
+ **/
+static void
+egg_console_kit_is_local_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GVariant *result;
+	GError *error = NULL;
 
-	/* is our session active */
-	ret = dbus_g_proxy_call (console->priv->proxy_session, "IsActive", &error, G_TYPE_INVALID,
-				 G_TYPE_BOOLEAN, &value, G_TYPE_INVALID);
-	if (!ret) {
-		g_warning ("IsActive failed: %s", error->message);
+	result = g_dbus_proxy_call_finish (G_DBUS_PROXY (source), res, &error);
+	if (result == NULL) {
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			g_warning ("IsLocal failed: %s", error->message);
 		g_error_free (error);
-		goto out;
+		return;
 	}
+	g_variant_get (result, "(b)", &EGG_CONSOLE_KIT (user_data)->priv->is_local);
+	g_variant_unref (result);
+}
+
+/**
+ * egg_console_kit_session_proxy_cb:
+ **/
+static void
+egg_console_kit_session_proxy_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	EggConsoleKit *console;
+	GDBusProxy *proxy;
+	GError *error = NULL;
 
-	/* return value only if we successed */
-	ret = value;
-out:
-	return ret;
+	proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
+	if (proxy == NULL) {
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			g_warning ("cannot connect to session: %s", error->message);
+			EGG_CONSOLE_KIT (user_data)->priv->session_failed = TRUE;
+		}
+		g_error_free (error);
+		return;
+	}
+	console = EGG_CONSOLE_KIT (user_data);
+	console->priv->proxy_session = proxy;
+	g_signal_connect (proxy, "g-signal",
+			  G_CALLBACK (egg_console_kit_session_signal_cb), console);
+
+	/* prime the cache, the signal keeps it current from now on */
+	g_dbus_proxy_call (proxy, "IsActive", NULL, G_DBUS_CALL_FLAGS_NONE, -1,
+			   console->priv->cancellable, egg_console_kit_is_active_cb, console);
+	g_dbus_proxy_call (proxy, "IsLocal", NULL, G_DBUS_CALL_FLAGS_NONE, -1,
+			   console->priv->cancellable, egg_console_kit_is_local_cb, console);
 }
 
 /**
- * egg_console_kit_active_changed_cb:
+ * egg_console_kit_get_session_cb:
  **/
 static void
-egg_console_kit_active_changed_cb (DBusGProxy *proxy, gboolean active, EggConsoleKit *console)
+egg_console_kit_get_session_cb (GObject *source, GAsyncResult *res, gpointer user_data)
 {
-	g_debug ("emitting active: %i", active);
-	g_signal_emit (console, signals [EGG_CONSOLE_KIT_ACTIVE_CHANGED], 0, active);
+	EggConsoleKit *console;
+	GVariant *result;
+	GError *error = NULL;
+
+	result = g_dbus_proxy_call_finish (G_DBUS_PROXY (source), res, &error);
+	if (result == NULL) {
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			g_warning ("Failed to get session for pid %u: %s",
+				   (guint) getpid (), error->message);
+			EGG_CONSOLE_KIT (user_data)->priv->session_failed = TRUE;
+		}
+		g_error_free (error);
+		return;
+	}
+	console = EGG_CONSOLE_KIT (user_data);
+	g_variant_get (result, "(o)", &console->priv->session_id);
+	g_variant_unref (result);
+	g_debug ("ConsoleKit session ID: %s", console->priv->session_id);
+
+	/* connect to session */
+	g_dbus_proxy_new_for_bus (G_BUS_TYPE_SYSTEM, EGG_CONSOLE_KIT_PROXY_FLAGS, NULL,
+				  CONSOLEKIT_NAME, console->priv->session_id,
+				  CONSOLEKIT_SESSION_INTERFACE, console->priv->cancellable,
+				  egg_console_kit_session_proxy_cb, console);
+}
+
+/**
+ * egg_console_kit_manager_proxy_cb:
+ **/
+static void
+egg_console_kit_manager_proxy_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	EggConsoleKit *console;
+	GDBusProxy *proxy;
+	GError *error = NULL;
+	GTask *task;
+
+	proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
+	if (proxy == NULL) {
+		if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			g_error_free (error);
+			return;
+		}
+		console = EGG_CONSOLE_KIT (user_data);
+		console->priv->connecting = FALSE;
+		g_warning ("cannot connect to ConsoleKit: %s", error->message);
+		console->priv->session_failed = TRUE;
+		console->priv->manager_error = error;
+		while ((task = g_queue_pop_head (&console->priv->waiting)) != NULL) {
+			g_task_return_error (task, g_error_copy (error));
+			g_object_unref (task);
+		}
+		return;
+	}
+	console = EGG_CONSOLE_KIT (user_data);
+	console->priv->connecting = FALSE;
+	console->priv->proxy_manager = proxy;
+
+	/* anything asked for before now */
+	while ((task = g_queue_pop_head (&console->priv->waiting)) != NULL)
+		egg_console_kit_call_start (console, task);
+
+	/* logind looks after the session instead */
+	if (egg_console_kit_logind_running ())
+		return;
+
+	/* get the session we are running in */
+	g_dbus_proxy_call (console->priv->proxy_manager, "GetSessionForUnixProcess",
+			   g_variant_new ("(u)", (guint32) getpid ()),
+			   G_DBUS_CALL_FLAGS_NONE, -1, console->priv->cancellable,
+			   egg_console_kit_get_session_cb, console);
 }
 
 /**
@@ -367,63 +575,27 @@ egg_console_kit_class_init (EggConsoleKitClass *klass)
 
 /**
  * egg_console_kit_init:
+ *
+ * Finding our session takes a few round trips, so do them in the
+ * background and assume we are active and local until told otherwise.
+ * Nothing here ever waits for ConsoleKit.
  **/
 static void
 egg_console_kit_init (EggConsoleKit *console)
 {
-	gboolean ret;
-	GError *error = NULL;
-	guint32 pid;
-
 	console->priv = egg_console_kit_get_instance_private (console);
 	console->priv->proxy_manager = NULL;
 	console->priv->session_id = NULL;
-
-	/* connect to D-Bus */
-	console->priv->connection = dbus_g_bus_get (DBUS_BUS_SYSTEM, &error);
-	if (console->priv->connection == NULL) {
-		g_warning ("Failed to connect to the D-Bus daemon: %s", error->message);
-		g_error_free (error);
-		goto out;
-	}
-
-	/* connect to ConsoleKit */
-	console->priv->proxy_manager =
-		dbus_g_proxy_new_for_name (console->priv->connection, CONSOLEKIT_NAME,
-					   CONSOLEKIT_MANAGER_PATH, CONSOLEKIT_MANAGER_INTERFACE);
-	if (console->priv->proxy_manager == NULL) {
-		g_warning ("cannot connect to ConsoleKit");
-		goto out;
-	}
-
-	/* get the session we are running in */
-	pid = getpid ();
-	ret = dbus_g_proxy_call (console->priv->proxy_manager, "GetSessionForUnixProcess", &error,
-				 G_TYPE_UINT, pid,
-				 G_TYPE_INVALID,
-				 DBUS_TYPE_G_OBJECT_PATH, &console->priv->session_id,
-				 G_TYPE_INVALID);
-	if (!ret) {
-		g_warning ("Failed to get session for pid %u: %s", pid, error->message);
-		g_error_free (error);
-		goto out;
-	}
-	g_debug ("ConsoleKit session ID: %s", console->priv->session_id);
-
-	/* connect to session */
-	console->priv->proxy_session =
-		dbus_g_proxy_new_for_name (console->priv->connection, CONSOLEKIT_NAME,
-					   console->priv->session_id, CONSOLEKIT_SESSION_INTERFACE);
-	if (console->priv->proxy_session == NULL) {
-		g_warning ("cannot connect to: %s", console->priv->session_id);
-		goto out;
-	}
-	dbus_g_proxy_add_signal (console->priv->proxy_session, "ActiveChanged", G_TYPE_BOOLEAN, G_TYPE_INVALID);
-	dbus_g_proxy_connect_signal (console->priv->proxy_session, "ActiveChanged",
-				     G_CALLBACK (egg_console_kit_active_changed_cb), console, NULL);
-
-out:
-	return;
+	console->priv->is_active = TRUE;
+	console->priv->is_local = TRUE;
+	console->priv->cancellable = g_cancellable_new ();
+	g_queue_init (&console->priv->waiting);
+
+	/* nothing to find out when logind looks after the session, the
+	 * manager is only connected to if something is asked of it */
+	if (egg_console_kit_logind_running ())
+		return;
+	egg_console_kit_connect (console);
 }
 
 /**
@@ -440,10 +612,16 @@ egg_console_kit_finalize (GObject *object)
 	console = EGG_CONSOLE_KIT (object);
 
 	g_return_if_fail (console->priv != NULL);
+	g_cancellable_cancel (console->priv->cancellable);
+	g_object_unref (console->priv->cancellable);
+	if (console->priv->manager_error != NULL)
+		g_error_free (console->priv->manager_error);
 	if (console->priv->proxy_manager != NULL)
 		g_object_unref (console->priv->proxy_manager);
-	if (console->priv->proxy_session != NULL)
+	if (console->priv->proxy_session != NULL) {
+		g_signal_handlers_disconnect_by_data (console->priv->proxy_session, console);
 		g_object_unref (console->priv->proxy_session);
+	}
 	g_free (console->priv->session_id);
 
 	G_OBJECT_CLASS (egg_console_kit_parent_class)->finalize (object);
@@ -24,6 +24,7 @@
 #define __EGG_CONSOLE_KIT_H
 
 #include <glib-object.h>
+#include <gio/gio.h>
 
 G_BEGIN_DECLS
 
@@ -55,25 +56,30 @@ GType		 egg_console_kit_get_type	  	(void);
 EggConsoleKit	*egg_console_kit_new			(void);
 gboolean	 egg_console_kit_is_local		(EggConsoleKit	*console);
 gboolean	 egg_console_kit_is_active		(EggConsoleKit	*console);
-gboolean	 egg_console_kit_stop			(EggConsoleKit	*console,
+void		 egg_console_kit_stop_async		(EggConsoleKit	*console,
+							 GAsyncReadyCallback callback,
+							 gpointer	 user_data);
+void		 egg_console_kit_restart_async		(EggConsoleKit	*console,
+							 GAsyncReadyCallback callback,
+							 gpointer	 user_data);
+void		 egg_console_kit_suspend_async		(EggConsoleKit	*console,
+							 GAsyncReadyCallback callback,
+							 gpointer	 user_data);
+void		 egg_console_kit_hibernate_async	(EggConsoleKit	*console,
+							 GAsyncReadyCallback callback,
+							 gpointer	 user_data);
+gboolean	 egg_console_kit_action_finish		(EggConsoleKit	*console,
+							 GAsyncResult	*res,
 							 GError		**error);
-gboolean	 egg_console_kit_restart		(EggConsoleKit	*console,
-							 GError		**error);
-gboolean	 egg_console_kit_suspend		(EggConsoleKit	*console,
-							 GError		**error);
-gboolean	 egg_console_kit_hibernate		(EggConsoleKit	*console,
-							 GError		**error);
-gboolean	 egg_console_kit_can_stop		(EggConsoleKit	*console,
-							 gboolean	*can_stop,
-							 GError		**error);
-gboolean	 egg_console_kit_can_restart		(EggConsoleKit	*console,
-							 gboolean	*can_restart,
-							 GError		**error);
-gboolean	 egg_console_kit_can_suspend		(EggConsoleKit	*console,
-							 gboolean	*can_restart,
-							 GError		**error);
-gboolean	 egg_console_kit_can_hibernate		(EggConsoleKit	*console,
-							 gboolean	*can_restart,
+void		 egg_console_kit_can_suspend_async	(EggConsoleKit	*console,
+							 GAsyncReadyCallback callback,
+							 gpointer	 user_data);
+void		 egg_console_kit_can_hibernate_async	(EggConsoleKit	*console,
+							 GAsyncReadyCallback callback,
+							 gpointer	 user_data);
+gboolean	 egg_console_kit_can_finish		(EggConsoleKit	*console,
+							 GAsyncResult	*res,
+							 gboolean	*value,
 							 GError		**error);
 
 G_END_DECLS
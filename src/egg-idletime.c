@@ -25,6 +25,7 @@
 #endif
 
 #include <glib.h>
+#include <gio/gio.h>
 #include <X11/Xlib.h>
 #include <X11/extensions/sync.h>
 #include <gdk/gdkx.h>
@@ -33,243 +34,1024 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "egg-idletime.h"
 
 static void     egg_idletime_finalize   (GObject       *object);
 
-struct EggIdletimePrivate
-{
-	gint			 sync_event;
-	gboolean		 reset_set;
-	XSyncCounter		 idle_counter;
-	GPtrArray		*array;
-	Display			*dpy;
-};
-
 typedef struct
 {
 	guint			 id;
-	XSyncValue		 timeout;
-	XSyncAlarm		 xalarm;
+	guint			 timeout;	/* ms */
+	gboolean		 armed;
+	gulong			 handle;	/* owned by the backend */
+	guint			 late_id;
 	EggIdletime		*idletime;
 } EggIdletimeAlarm;
 
+/*
+ * Where the idle time comes from. Each backend fires an alarm by calling
+ * egg_idletime_backend_expired() once the idle time has reached it, and
+ * reports activity by calling egg_idletime_alarm_reset_all() once asked
+ * to with reset_arm. Backends without timeout_add and get_clock use the
+ * real clock.
+ */
+typedef struct
+{
+	const gchar		*name;
+	gboolean		 (* open)		(EggIdletime		*idletime);
+	void			 (* close)		(EggIdletime		*idletime);
+	gint64			 (* get_time)		(EggIdletime		*idletime);
+	void			 (* alarm_arm)		(EggIdletime		*idletime,
+							 EggIdletimeAlarm	*alarm);
+	void			 (* alarm_disarm)	(EggIdletime		*idletime,
+							 EggIdletimeAlarm	*alarm);
+	void			 (* reset_arm)		(EggIdletime		*idletime,
+							 gint64			 idle_time);
+	void			 (* reset_disarm)	(EggIdletime		*idletime);
+	guint			 (* timeout_add)	(EggIdletime		*idletime,
+							 guint			 interval,
+							 const gchar		*name,
+							 GSourceFunc		 func,
+							 gpointer		 user_data);
+	void			 (* timeout_remove)	(EggIdletime		*idletime,
+							 guint			 id);
+	void			 (* flush)		(EggIdletime		*idletime);
+	gint64			 (* get_clock)		(EggIdletime		*idletime);
+} EggIdletimeBackend;
+
+struct EggIdletimePrivate
+{
+	const EggIdletimeBackend *backend;
+	gpointer		 backend_data;
+	gboolean		 reset_set;
+	GHashTable		*alarms;	/* id to EggIdletimeAlarm */
+	EggIdletimeTimeoutAddFunc timeout_add;
+	EggIdletimeTimeoutRemoveFunc timeout_remove;
+	gpointer		 timeout_data;
+};
+
 enum {
 	SIGNAL_ALARM_EXPIRED,
 	SIGNAL_RESET,
 	LAST_SIGNAL
 };
 
+static guint signals [LAST_SIGNAL] = { 0 };
+static gpointer egg_idletime_object = NULL;
+
+G_DEFINE_TYPE_WITH_PRIVATE (EggIdletime, egg_idletime, G_TYPE_OBJECT)
+
+/**
+ * egg_idletime_get_time:
+ *
+ * Return value: how long the user has been idle, in ms
+ */
+gint64
+egg_idletime_get_time (EggIdletime *idletime)
+{
+	g_return_val_if_fail (EGG_IS_IDLETIME (idletime), 0);
+	return idletime->priv->backend->get_time (idletime);
+}
+
+/**
+ * egg_idletime_get_clock:
+ *
+ * Return value: a monotonic time in ms, on the clock the idle time is
+ * counted on, so how long an idle period lasted can be measured
+ */
+gint64
+egg_idletime_get_clock (EggIdletime *idletime)
+{
+	g_return_val_if_fail (EGG_IS_IDLETIME (idletime), 0);
+	if (idletime->priv->backend->get_clock != NULL)
+		return idletime->priv->backend->get_clock (idletime);
+	return g_get_monotonic_time () / 1000;
+}
+
+/**
+ * egg_idletime_get_backend_name:
+ */
+const gchar *
+egg_idletime_get_backend_name (EggIdletime *idletime)
+{
+	g_return_val_if_fail (EGG_IS_IDLETIME (idletime), NULL);
+	return idletime->priv->backend->name;
+}
+
+/**
+ * egg_idletime_alarm_arm:
+ */
+static void
+egg_idletime_alarm_arm (EggIdletime *idletime, EggIdletimeAlarm *alarm)
+{
+	alarm->armed = TRUE;
+	if (idletime->priv->backend->alarm_arm != NULL)
+		idletime->priv->backend->alarm_arm (idletime, alarm);
+}
+
+/**
+ * egg_idletime_flush:
+ *
+ * Sends whatever the backend has batched up.
+ */
+static void
+egg_idletime_flush (EggIdletime *idletime)
+{
+	if (idletime->priv->backend->flush != NULL)
+		idletime->priv->backend->flush (idletime);
+}
+
+/**
+ * egg_idletime_alarm_reset_all:
+ */
+void
+egg_idletime_alarm_reset_all (EggIdletime *idletime)
+{
+	GHashTableIter iter;
+	EggIdletimeAlarm *alarm;
+
+	g_return_if_fail (EGG_IS_IDLETIME (idletime));
+
+	if (!idletime->priv->reset_set)
+		return;
+
+	/* reset the alarms that went off to their timeouts, the others are
+	 * still waiting for the idle time to pass them */
+	g_hash_table_iter_init (&iter, idletime->priv->alarms);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &alarm)) {
+		if (!alarm->armed)
+			egg_idletime_alarm_arm (idletime, alarm);
+	}
+
+	/* stop watching for activity, and send it all at once */
+	if (idletime->priv->backend->reset_disarm != NULL)
+		idletime->priv->backend->reset_disarm (idletime);
+	egg_idletime_flush (idletime);
+
+	/* emit signal so say we've reset all timers */
+	g_signal_emit (idletime, signals [SIGNAL_RESET], 0);
+
+	/* we need to be reset again on the next event */
+	idletime->priv->reset_set = FALSE;
+}
+
+/**
+ * egg_idletime_backend_expired:
+ * @idle_time: The idle time the alarm went off at, in ms
+ */
+static void
+egg_idletime_backend_expired (EggIdletime *idletime, EggIdletimeAlarm *alarm, gint64 idle_time)
+{
+	/* only goes off again after a reset */
+	alarm->armed = FALSE;
+
+	/* emit */
+	g_signal_emit (idletime, signals [SIGNAL_ALARM_EXPIRED], 0, alarm->id);
+
+	/* we need the first alarm to go off to watch for activity, and
+	 * don't try to set this again if multiple timers are going off in
+	 * sequence */
+	if (idletime->priv->reset_set)
+		return;
+	idletime->priv->reset_set = TRUE;
+	if (idletime->priv->backend->reset_arm != NULL)
+		idletime->priv->backend->reset_arm (idletime, idle_time);
+	egg_idletime_flush (idletime);
+}
+
+/**
+ * egg_idletime_alarm_find_id:
+ */
+static EggIdletimeAlarm *
+egg_idletime_alarm_find_id (EggIdletime *idletime, guint id)
+{
+	return g_hash_table_lookup (idletime->priv->alarms, GUINT_TO_POINTER (id));
+}
+
+/**
+ * egg_idletime_real_timeout_add:
+ */
+static guint
+egg_idletime_real_timeout_add (EggIdletime *idletime, guint interval, const gchar *name,
+			       GSourceFunc func, gpointer user_data)
+{
+	guint id;
+
+	if (idletime->priv->timeout_add != NULL)
+		return idletime->priv->timeout_add (interval, name, func, user_data,
+						    idletime->priv->timeout_data);
+
+	/* whole seconds can be coalesced with other wakeups */
+	if (interval > 0 && interval % 1000 == 0)
+		id = g_timeout_add_seconds (interval / 1000, func, user_data);
+	else
+		id = g_timeout_add (interval, func, user_data);
+	g_source_set_name_by_id (id, name);
+	return id;
+}
+
+/**
+ * egg_idletime_real_timeout_remove:
+ */
+static void
+egg_idletime_real_timeout_remove (EggIdletime *idletime, guint id)
+{
+	if (idletime->priv->timeout_remove != NULL)
+		idletime->priv->timeout_remove (id, idletime->priv->timeout_data);
+	else
+		g_source_remove (id);
+}
+
+/**
+ * egg_idletime_set_timeout_funcs:
+ *
+ * Makes the real clock use some other timer service, so that the idle
+ * timers can share wakeups with the rest of the program. Backends with a
+ * clock of their own do not use it.
+ */
+void
+egg_idletime_set_timeout_funcs (EggIdletime *idletime,
+				EggIdletimeTimeoutAddFunc add_func,
+				EggIdletimeTimeoutRemoveFunc remove_func,
+				gpointer data)
+{
+	g_return_if_fail (EGG_IS_IDLETIME (idletime));
+	g_return_if_fail ((add_func == NULL) == (remove_func == NULL));
+
+	idletime->priv->timeout_add = add_func;
+	idletime->priv->timeout_remove = remove_func;
+	idletime->priv->timeout_data = data;
+}
+
+/**
+ * egg_idletime_timeout_add:
+ * @interval: In ms
+ * @name: The name of the source, e.g. "[GpmIdle] blank"
+ *
+ * Like g_timeout_add(), but on the clock of the backend, so that it can
+ * be faked along with the idle time.
+ *
+ * Return value: the id to pass to egg_idletime_timeout_remove()
+ */
+guint
+egg_idletime_timeout_add (EggIdletime *idletime, guint interval, const gchar *name,
+			  GSourceFunc func, gpointer user_data)
+{
+	g_return_val_if_fail (EGG_IS_IDLETIME (idletime), 0);
+	g_return_val_if_fail (func != NULL, 0);
+
+	if (idletime->priv->backend->timeout_add != NULL)
+		return idletime->priv->backend->timeout_add (idletime, interval, name, func, user_data);
+	return egg_idletime_real_timeout_add (idletime, interval, name, func, user_data);
+}
+
+/**
+ * egg_idletime_timeout_remove:
+ */
+void
+egg_idletime_timeout_remove (EggIdletime *idletime, guint id)
+{
+	g_return_if_fail (EGG_IS_IDLETIME (idletime));
+	g_return_if_fail (id != 0);
+
+	if (idletime->priv->backend->timeout_remove != NULL)
+		idletime->priv->backend->timeout_remove (idletime, id);
+	else
+		egg_idletime_real_timeout_remove (idletime, id);
+}
+
+/***************************************************************************
+ ***                             XSync backend                           ***
+ ***************************************************************************/
+
+typedef struct
+{
+	Display			*dpy;
+	gint			 sync_event;
+	XSyncCounter		 idle_counter;
+	XSyncAlarm		 reset_xalarm;
+	GHashTable		*xalarms;	/* XSyncAlarm to EggIdletimeAlarm */
+} EggIdletimeXSync;
+
 typedef enum {
 	EGG_IDLETIME_ALARM_TYPE_POSITIVE,
 	EGG_IDLETIME_ALARM_TYPE_NEGATIVE,
 	EGG_IDLETIME_ALARM_TYPE_DISABLED
 } EggIdletimeAlarmType;
 
-static guint signals [LAST_SIGNAL] = { 0 };
-static gpointer egg_idletime_object = NULL;
+/**
+ * egg_idletime_xsyncvalue_to_int64:
+ */
+static gint64
+egg_idletime_xsyncvalue_to_int64 (XSyncValue value)
+{
+	return ((guint64) XSyncValueHigh32 (value)) << 32 | (guint64) XSyncValueLow32 (value);
+}
+
+/**
+ * egg_idletime_xsync_get_time:
+ */
+static gint64
+egg_idletime_xsync_get_time (EggIdletime *idletime)
+{
+	EggIdletimeXSync *xsync = idletime->priv->backend_data;
+	XSyncValue value;
+	XSyncQueryCounter (xsync->dpy, xsync->idle_counter, &value);
+	return egg_idletime_xsyncvalue_to_int64 (value);
+}
+
+/**
+ * egg_idletime_xsync_alarm_set:
+ */
+static void
+egg_idletime_xsync_alarm_set (EggIdletime *idletime, XSyncAlarm *xalarm, gint64 timeout, EggIdletimeAlarmType alarm_type)
+{
+	EggIdletimeXSync *xsync = idletime->priv->backend_data;
+	XSyncAlarmAttributes attr;
+	XSyncValue delta;
+	unsigned int flags;
+	XSyncTestType test;
+
+	/* just remove it */
+	if (alarm_type == EGG_IDLETIME_ALARM_TYPE_DISABLED) {
+		if (*xalarm) {
+			XSyncDestroyAlarm (xsync->dpy, *xalarm);
+			*xalarm = None;
+		}
+		return;
+	}
+
+	/* which way do we do the test? */
+	if (alarm_type == EGG_IDLETIME_ALARM_TYPE_POSITIVE)
+		test = XSyncPositiveTransition;
+	else
+		test = XSyncNegativeTransition;
+
+	XSyncIntToValue (&delta, 0);
+
+	attr.trigger.counter = xsync->idle_counter;
+	attr.trigger.value_type = XSyncAbsolute;
+	attr.trigger.test_type = test;
+	XSyncIntsToValue (&attr.trigger.wait_value, (guint) (timeout & 0xffffffff), (gint) (timeout >> 32));
+	attr.delta = delta;
+
+	flags = XSyncCACounter | XSyncCAValueType | XSyncCATestType | XSyncCAValue | XSyncCADelta;
+
+	if (*xalarm)
+		XSyncChangeAlarm (xsync->dpy, *xalarm, flags, &attr);
+	else
+		*xalarm = XSyncCreateAlarm (xsync->dpy, flags, &attr);
+}
+
+/**
+ * egg_idletime_xsync_alarm_arm:
+ */
+static void
+egg_idletime_xsync_alarm_arm (EggIdletime *idletime, EggIdletimeAlarm *alarm)
+{
+	EggIdletimeXSync *xsync = idletime->priv->backend_data;
+	XSyncAlarm xalarm = alarm->handle;
+
+	egg_idletime_xsync_alarm_set (idletime, &xalarm, alarm->timeout, EGG_IDLETIME_ALARM_TYPE_POSITIVE);
+	if (alarm->handle == None)
+		g_hash_table_insert (xsync->xalarms, GSIZE_TO_POINTER (xalarm), alarm);
+	alarm->handle = xalarm;
+}
+
+/**
+ * egg_idletime_xsync_alarm_disarm:
+ */
+static void
+egg_idletime_xsync_alarm_disarm (EggIdletime *idletime, EggIdletimeAlarm *alarm)
+{
+	EggIdletimeXSync *xsync = idletime->priv->backend_data;
+	XSyncAlarm xalarm = alarm->handle;
+
+	if (xalarm == None)
+		return;
+	g_hash_table_remove (xsync->xalarms, GSIZE_TO_POINTER (xalarm));
+	egg_idletime_xsync_alarm_set (idletime, &xalarm, 0, EGG_IDLETIME_ALARM_TYPE_DISABLED);
+	alarm->handle = xalarm;
+}
+
+/**
+ * egg_idletime_xsync_reset_arm:
+ */
+static void
+egg_idletime_xsync_reset_arm (EggIdletime *idletime, gint64 idle_time)
+{
+	EggIdletimeXSync *xsync = idletime->priv->backend_data;
+	gint64 reset_threshold;
+
+	/* don't match on the current value because
+	 * XSyncNegativeComparison means less or equal. */
+	reset_threshold = idle_time - 1;
+
+	/* set the reset alarm to fire the next time
+	 * the idle counter < the current counter value */
+	egg_idletime_xsync_alarm_set (idletime, &xsync->reset_xalarm, reset_threshold,
+				      EGG_IDLETIME_ALARM_TYPE_NEGATIVE);
+
+	/* We've missed the alarm already */
+	if (egg_idletime_xsync_get_time (idletime) < reset_threshold)
+		egg_idletime_alarm_reset_all (idletime);
+}
+
+/**
+ * egg_idletime_xsync_reset_disarm:
+ */
+static void
+egg_idletime_xsync_reset_disarm (EggIdletime *idletime)
+{
+	EggIdletimeXSync *xsync = idletime->priv->backend_data;
+	egg_idletime_xsync_alarm_set (idletime, &xsync->reset_xalarm, 0, EGG_IDLETIME_ALARM_TYPE_DISABLED);
+}
+
+/**
+ * egg_idletime_xsync_flush:
+ */
+static void
+egg_idletime_xsync_flush (EggIdletime *idletime)
+{
+	EggIdletimeXSync *xsync = idletime->priv->backend_data;
+	XFlush (xsync->dpy);
+}
+
+/**
+ * egg_idletime_xsync_event_filter_cb:
+ */
+static GdkFilterReturn
+egg_idletime_xsync_event_filter_cb (GdkXEvent *gdkxevent, GdkEvent *event, gpointer data)
+{
+	EggIdletimeAlarm *alarm;
+	XEvent *xevent = (XEvent *) gdkxevent;
+	EggIdletime *idletime = (EggIdletime *) data;
+	EggIdletimeXSync *xsync = idletime->priv->backend_data;
+	XSyncAlarmNotifyEvent *alarm_event;
+
+	/* no point continuing */
+	if (xevent->type != xsync->sync_event + XSyncAlarmNotify)
+		return GDK_FILTER_CONTINUE;
+
+	alarm_event = (XSyncAlarmNotifyEvent *) xevent;
+
+	/* are we the reset alarm? */
+	if (xsync->reset_xalarm != None && alarm_event->alarm == xsync->reset_xalarm) {
+		egg_idletime_alarm_reset_all (idletime);
+		goto out;
+	}
+
+	/* did we match one of our alarms? */
+	alarm = g_hash_table_lookup (xsync->xalarms, GSIZE_TO_POINTER (alarm_event->alarm));
+	if (alarm == NULL)
+		return GDK_FILTER_CONTINUE;
+
+	egg_idletime_backend_expired (idletime, alarm,
+				      egg_idletime_xsyncvalue_to_int64 (alarm_event->counter_value));
+out:
+	/* don't propagate */
+	return GDK_FILTER_REMOVE;
+}
+
+/**
+ * egg_idletime_xsync_open:
+ */
+static gboolean
+egg_idletime_xsync_open (EggIdletime *idletime)
+{
+	EggIdletimeXSync *xsync;
+	GdkDisplay *display;
+	int sync_error;
+	int ncounters;
+	XSyncSystemCounter *counters;
+	gint i;
+
+	display = gdk_display_get_default ();
+	if (display == NULL || !GDK_IS_X11_DISPLAY (display))
+		return FALSE;
+
+	xsync = g_new0 (EggIdletimeXSync, 1);
+	xsync->idle_counter = None;
+	xsync->reset_xalarm = None;
+	xsync->dpy = GDK_DISPLAY_XDISPLAY (display);
+
+	/* get the sync event */
+	if (!XSyncQueryExtension (xsync->dpy, &xsync->sync_event, &sync_error)) {
+		g_warning ("No Sync extension.");
+		g_free (xsync);
+		return FALSE;
+	}
+
+	/* gtk_init should do XSyncInitialize for us */
+	counters = XSyncListSystemCounters (xsync->dpy, &ncounters);
+	for (i=0; i < ncounters && !xsync->idle_counter; i++) {
+		if (strcmp(counters[i].name, "IDLETIME") == 0)
+			xsync->idle_counter = counters[i].counter;
+	}
+	XSyncFreeSystemCounterList (counters);
+
+	/* arh. we don't have IDLETIME support */
+	if (!xsync->idle_counter) {
+		g_warning ("No idle counter.");
+		g_free (xsync);
+		return FALSE;
+	}
+
+	xsync->xalarms = g_hash_table_new (g_direct_hash, g_direct_equal);
+	idletime->priv->backend_data = xsync;
+
+	/* catch the timer alarm */
+	gdk_window_add_filter (NULL, egg_idletime_xsync_event_filter_cb, idletime);
+	return TRUE;
+}
+
+/**
+ * egg_idletime_xsync_close:
+ */
+static void
+egg_idletime_xsync_close (EggIdletime *idletime)
+{
+	EggIdletimeXSync *xsync = idletime->priv->backend_data;
+
+	gdk_window_remove_filter (NULL, egg_idletime_xsync_event_filter_cb, idletime);
+	egg_idletime_xsync_reset_disarm (idletime);
+	XFlush (xsync->dpy);
+	g_hash_table_unref (xsync->xalarms);
+	g_free (xsync);
+}
+
+static const EggIdletimeBackend egg_idletime_backend_xsync = {
+	"xsync",
+	egg_idletime_xsync_open,
+	egg_idletime_xsync_close,
+	egg_idletime_xsync_get_time,
+	egg_idletime_xsync_alarm_arm,
+	egg_idletime_xsync_alarm_disarm,
+	egg_idletime_xsync_reset_arm,
+	egg_idletime_xsync_reset_disarm,
+	NULL,
+	NULL,
+	egg_idletime_xsync_flush,
+	NULL
+};
+
+/***************************************************************************
+ ***                            logind backend                           ***
+ ***************************************************************************/
+
+/*
+ * The IdleHint of our logind session, as set by whatever in the session
+ * tracks input. The idle time only starts counting once the hint is set,
+ * from IdleSinceHintMonotonic, so it is coarser than the XSync counter
+ * but also works without an X server.
+ */
+
+typedef struct
+{
+	GDBusProxy		*proxy;
+	GCancellable		*cancellable;
+	gboolean		 idle_hint;
+	gint64			 idle_since;	/* monotonic, us */
+} EggIdletimeLogind;
+
+/**
+ * egg_idletime_logind_get_time:
+ */
+static gint64
+egg_idletime_logind_get_time (EggIdletime *idletime)
+{
+	EggIdletimeLogind *logind = idletime->priv->backend_data;
+	if (!logind->idle_hint)
+		return 0;
+	return MAX (g_get_monotonic_time () - logind->idle_since, 0) / 1000;
+}
+
+/**
+ * egg_idletime_logind_alarm_cb:
+ */
+static gboolean
+egg_idletime_logind_alarm_cb (EggIdletimeAlarm *alarm)
+{
+	alarm->handle = 0;
+	egg_idletime_backend_expired (alarm->idletime, alarm,
+				      egg_idletime_logind_get_time (alarm->idletime));
+	return FALSE;
+}
+
+/**
+ * egg_idletime_logind_alarm_disarm:
+ */
+static void
+egg_idletime_logind_alarm_disarm (EggIdletime *idletime, EggIdletimeAlarm *alarm)
+{
+	if (alarm->handle == 0)
+		return;
+	egg_idletime_real_timeout_remove (idletime, alarm->handle);
+	alarm->handle = 0;
+}
+
+/**
+ * egg_idletime_logind_alarm_arm:
+ *
+ * Only counts down while the session is idle, the rest happens when the
+ * hint changes.
+ */
+static void
+egg_idletime_logind_alarm_arm (EggIdletime *idletime, EggIdletimeAlarm *alarm)
+{
+	EggIdletimeLogind *logind = idletime->priv->backend_data;
+	gint64 remaining;
 
-G_DEFINE_TYPE_WITH_PRIVATE (EggIdletime, egg_idletime, G_TYPE_OBJECT)
+	egg_idletime_logind_alarm_disarm (idletime, alarm);
+	if (!logind->idle_hint)
+		return;
+	remaining = MAX (alarm->timeout - egg_idletime_logind_get_time (idletime), 0);
+	alarm->handle = egg_idletime_real_timeout_add (idletime, remaining, "[EggIdletime] logind alarm",
+						       (GSourceFunc) egg_idletime_logind_alarm_cb, alarm);
+}
 
 /**
- * egg_idletime_xsyncvalue_to_int64:
+ * egg_idletime_logind_refresh:
  */
-static gint64
-egg_idletime_xsyncvalue_to_int64 (XSyncValue value)
+static void
+egg_idletime_logind_refresh (EggIdletime *idletime)
 {
-	return ((guint64) XSyncValueHigh32 (value)) << 32 | (guint64) XSyncValueLow32 (value);
+	EggIdletimeLogind *logind = idletime->priv->backend_data;
+	EggIdletimeAlarm *alarm;
+	GVariant *variant;
+	gboolean idle_hint = FALSE;
+	gint64 idle_since = 0;
+	GHashTableIter iter;
+
+	variant = g_dbus_proxy_get_cached_property (logind->proxy, "IdleHint");
+	if (variant != NULL) {
+		idle_hint = g_variant_get_boolean (variant);
+		g_variant_unref (variant);
+	}
+	variant = g_dbus_proxy_get_cached_property (logind->proxy, "IdleSinceHintMonotonic");
+	if (variant != NULL) {
+		idle_since = g_variant_get_uint64 (variant);
+		g_variant_unref (variant);
+	}
+	if (idle_since == 0)
+		idle_since = g_get_monotonic_time ();
+	if (idle_hint == logind->idle_hint && idle_since == logind->idle_since)
+		return;
+	logind->idle_hint = idle_hint;
+	logind->idle_since = idle_since;
+	g_debug ("logind idle hint %i since %" G_GINT64_FORMAT, idle_hint, idle_since);
+
+	/* the user came back */
+	g_hash_table_iter_init (&iter, idletime->priv->alarms);
+	if (!idle_hint) {
+		while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &alarm))
+			egg_idletime_logind_alarm_disarm (idletime, alarm);
+		egg_idletime_alarm_reset_all (idletime);
+		return;
+	}
+
+	/* start counting down what has not gone off yet */
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &alarm)) {
+		if (alarm->armed)
+			egg_idletime_logind_alarm_arm (idletime, alarm);
+	}
 }
 
 /**
- * egg_idletime_get_time:
+ * egg_idletime_logind_properties_changed_cb:
  */
-gint64
-egg_idletime_get_time (EggIdletime *idletime)
+static void
+egg_idletime_logind_properties_changed_cb (GDBusProxy *proxy, GVariant *changed, GStrv invalidated, EggIdletime *idletime)
 {
-	XSyncValue value;
-	XSyncQueryCounter (idletime->priv->dpy, idletime->priv->idle_counter, &value);
-	return egg_idletime_xsyncvalue_to_int64 (value);
+	egg_idletime_logind_refresh (idletime);
 }
 
 /**
- * egg_idletime_xsync_alarm_set:
+ * egg_idletime_logind_proxy_cb:
  */
 static void
-egg_idletime_xsync_alarm_set (EggIdletime *idletime, EggIdletimeAlarm *alarm, EggIdletimeAlarmType alarm_type)
+egg_idletime_logind_proxy_cb (GObject *source, GAsyncResult *res, gpointer user_data)
 {
-	XSyncAlarmAttributes attr;
-	XSyncValue delta;
-	unsigned int flags;
-	XSyncTestType test;
-
-	/* just remove it */
-	if (alarm_type == EGG_IDLETIME_ALARM_TYPE_DISABLED) {
-		if (alarm->xalarm) {
-			XSyncDestroyAlarm (idletime->priv->dpy, alarm->xalarm);
-			alarm->xalarm = None;
-		}
+	EggIdletime *idletime;
+	EggIdletimeLogind *logind;
+	GDBusProxy *proxy;
+	GError *error = NULL;
+
+	proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
+	if (proxy == NULL) {
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			g_warning ("failed to get logind session: %s", error->message);
+		g_error_free (error);
 		return;
 	}
+	idletime = EGG_IDLETIME (user_data);
+	logind = idletime->priv->backend_data;
+	logind->proxy = proxy;
+	g_signal_connect (proxy, "g-properties-changed",
+			  G_CALLBACK (egg_idletime_logind_properties_changed_cb), idletime);
+	egg_idletime_logind_refresh (idletime);
+}
 
-	/* which way do we do the test? */
-	if (alarm_type == EGG_IDLETIME_ALARM_TYPE_POSITIVE)
-		test = XSyncPositiveTransition;
-	else
-		test = XSyncNegativeTransition;
-
-	XSyncIntToValue (&delta, 0);
-
-	attr.trigger.counter = idletime->priv->idle_counter;
-	attr.trigger.value_type = XSyncAbsolute;
-	attr.trigger.test_type = test;
-	attr.trigger.wait_value = alarm->timeout;
-	attr.delta = delta;
+/**
+ * egg_idletime_logind_open:
+ */
+static gboolean
+egg_idletime_logind_open (EggIdletime *idletime)
+{
+	EggIdletimeLogind *logind;
 
-	flags = XSyncCACounter | XSyncCAValueType | XSyncCATestType | XSyncCAValue | XSyncCADelta;
+	/* not booted with systemd */
+	if (access ("/run/systemd/seats/", F_OK) < 0)
+		return FALSE;
 
-	if (alarm->xalarm)
-		XSyncChangeAlarm (idletime->priv->dpy, alarm->xalarm, flags, &attr);
-	else
-		alarm->xalarm = XSyncCreateAlarm (idletime->priv->dpy, flags, &attr);
+	logind = g_new0 (EggIdletimeLogind, 1);
+	logind->cancellable = g_cancellable_new ();
+	idletime->priv->backend_data = logind;
+
+	/* not idle until we know otherwise */
+	g_dbus_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
+				  G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START,
+				  NULL,
+				  "org.freedesktop.login1",
+				  "/org/freedesktop/login1/session/self",
+				  "org.freedesktop.login1.Session",
+				  logind->cancellable,
+				  egg_idletime_logind_proxy_cb,
+				  idletime);
+	return TRUE;
 }
 
 /**
- * egg_idletime_alarm_reset_all:
+ * egg_idletime_logind_close:
  */
-void
-egg_idletime_alarm_reset_all (EggIdletime *idletime)
+static void
+egg_idletime_logind_close (EggIdletime *idletime)
 {
-	guint i;
-	EggIdletimeAlarm *alarm;
+	EggIdletimeLogind *logind = idletime->priv->backend_data;
 
-	g_return_if_fail (EGG_IS_IDLETIME (idletime));
+	g_cancellable_cancel (logind->cancellable);
+	g_object_unref (logind->cancellable);
+	if (logind->proxy != NULL) {
+		g_signal_handlers_disconnect_by_data (logind->proxy, idletime);
+		g_object_unref (logind->proxy);
+	}
+	g_free (logind);
+}
 
-	if (!idletime->priv->reset_set)
-		return;
+static const EggIdletimeBackend egg_idletime_backend_logind = {
+	"logind",
+	egg_idletime_logind_open,
+	egg_idletime_logind_close,
+	egg_idletime_logind_get_time,
+	egg_idletime_logind_alarm_arm,
+	egg_idletime_logind_alarm_disarm,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL
+};
 
-	/* reset all the alarms (except the reset alarm) to their timeouts */
-	for (i=1; i<idletime->priv->array->len; i++) {
-		alarm = g_ptr_array_index (idletime->priv->array, i);
-		egg_idletime_xsync_alarm_set (idletime, alarm, EGG_IDLETIME_ALARM_TYPE_POSITIVE);
-	}
+/***************************************************************************
+ ***                             fake backend                            ***
+ ***************************************************************************/
+
+/*
+ * A virtual clock that only moves in egg_idletime_fake_advance(), with
+ * the user only active in egg_idletime_fake_activity(). Alarms and the
+ * timeouts added with egg_idletime_timeout_add() go off in order as the
+ * clock passes them, so hours of idle policy run in microseconds.
+ */
 
-	/* set the reset alarm to be disabled */
-	alarm = g_ptr_array_index (idletime->priv->array, 0);
-	egg_idletime_xsync_alarm_set (idletime, alarm, EGG_IDLETIME_ALARM_TYPE_DISABLED);
+static const EggIdletimeBackend egg_idletime_backend_fake;
 
-	/* emit signal so say we've reset all timers */
-	g_signal_emit (idletime, signals [SIGNAL_RESET], 0);
+typedef struct
+{
+	guint			 id;
+	gint64			 deadline;
+	guint			 interval;
+	GSourceFunc		 func;
+	gpointer		 user_data;
+} EggIdletimeFakeTimeout;
 
-	/* we need to be reset again on the next event */
-	idletime->priv->reset_set = FALSE;
+typedef struct
+{
+	gint64			 clock;		/* ms */
+	gint64			 activity;	/* ms */
+	GPtrArray		*timeouts;
+	guint			 next_id;
+} EggIdletimeFake;
+
+/**
+ * egg_idletime_fake_get_time:
+ */
+static gint64
+egg_idletime_fake_get_time (EggIdletime *idletime)
+{
+	EggIdletimeFake *fake = idletime->priv->backend_data;
+	return fake->clock - fake->activity;
 }
 
 /**
- * egg_idletime_alarm_find_id:
+ * egg_idletime_fake_get_clock:
  */
-static EggIdletimeAlarm *
-egg_idletime_alarm_find_id (EggIdletime *idletime, guint id)
+static gint64
+egg_idletime_fake_get_clock (EggIdletime *idletime)
+{
+	EggIdletimeFake *fake = idletime->priv->backend_data;
+	return fake->clock;
+}
+
+/**
+ * egg_idletime_fake_timeout_add:
+ */
+static guint
+egg_idletime_fake_timeout_add (EggIdletime *idletime, guint interval, const gchar *name,
+			       GSourceFunc func, gpointer user_data)
 {
+	EggIdletimeFake *fake = idletime->priv->backend_data;
+	EggIdletimeFakeTimeout *timeout;
+
+	timeout = g_new0 (EggIdletimeFakeTimeout, 1);
+	timeout->id = fake->next_id++;
+	timeout->deadline = fake->clock + interval;
+	timeout->interval = interval;
+	timeout->func = func;
+	timeout->user_data = user_data;
+	g_ptr_array_add (fake->timeouts, timeout);
+	return timeout->id;
+}
+
+/**
+ * egg_idletime_fake_timeout_find:
+ */
+static EggIdletimeFakeTimeout *
+egg_idletime_fake_timeout_find (EggIdletimeFake *fake, guint id)
+{
+	EggIdletimeFakeTimeout *timeout;
 	guint i;
-	EggIdletimeAlarm *alarm;
-	for (i=0; i<idletime->priv->array->len; i++) {
-		alarm = g_ptr_array_index (idletime->priv->array, i);
-		if (alarm->id == id)
-			return alarm;
+	for (i=0; i<fake->timeouts->len; i++) {
+		timeout = g_ptr_array_index (fake->timeouts, i);
+		if (timeout->id == id)
+			return timeout;
 	}
 	return NULL;
 }
 
 /**
- * egg_idletime_set_reset_alarm:
+ * egg_idletime_fake_timeout_remove:
  */
 static void
-egg_idletime_set_reset_alarm (EggIdletime *idletime, XSyncAlarmNotifyEvent *alarm_event)
+egg_idletime_fake_timeout_remove (EggIdletime *idletime, guint id)
 {
-	EggIdletimeAlarm *alarm;
-	int overflow;
-	XSyncValue add;
-	gint64 current, reset_threshold;
-
-	alarm = egg_idletime_alarm_find_id (idletime, 0);
-
-	if (!idletime->priv->reset_set) {
-		/* don't match on the current value because
-		 * XSyncNegativeComparison means less or equal. */
-		XSyncIntToValue (&add, -1);
-		XSyncValueAdd (&alarm->timeout, alarm_event->counter_value, add, &overflow);
-
-		/* set the reset alarm to fire the next time
-		 * idletime->priv->idle_counter < the current counter value */
-		egg_idletime_xsync_alarm_set (idletime, alarm, EGG_IDLETIME_ALARM_TYPE_NEGATIVE);
-
-		/* don't try to set this again if multiple timers are going off in sequence */
-		idletime->priv->reset_set = TRUE;
-
-		current = egg_idletime_get_time (idletime);
-		reset_threshold = egg_idletime_xsyncvalue_to_int64 (alarm->timeout);
-		if (current < reset_threshold) {
-			/* We've missed the alarm already */
-			egg_idletime_alarm_reset_all (idletime);
-		}
-	}
+	EggIdletimeFake *fake = idletime->priv->backend_data;
+	EggIdletimeFakeTimeout *timeout;
+
+	timeout = egg_idletime_fake_timeout_find (fake, id);
+	if (timeout != NULL)
+		g_ptr_array_remove_fast (fake->timeouts, timeout);
 }
 
 /**
- * egg_idletime_alarm_find_event:
+ * egg_idletime_fake_advance:
+ * @ms: How far to move the virtual clock
+ *
+ * Moves the clock of the fake backend forward, firing alarms and
+ * timeouts in the order they fall due.
  */
-static EggIdletimeAlarm *
-egg_idletime_alarm_find_event (EggIdletime *idletime, XSyncAlarmNotifyEvent *alarm_event)
+void
+egg_idletime_fake_advance (EggIdletime *idletime, guint ms)
 {
-	guint i;
+	EggIdletimeFake *fake;
+	EggIdletimeFakeTimeout *timeout;
+	EggIdletimeFakeTimeout *next_timeout;
 	EggIdletimeAlarm *alarm;
-	for (i=0; i<idletime->priv->array->len; i++) {
-		alarm = g_ptr_array_index (idletime->priv->array, i);
-		if (alarm_event->alarm == alarm->xalarm)
-			return alarm;
+	EggIdletimeAlarm *next_alarm;
+	gint64 target;
+	gint64 next;
+	gint64 due;
+	gboolean found;
+	GHashTableIter iter;
+	guint id;
+	guint i;
+
+	g_return_if_fail (EGG_IS_IDLETIME (idletime));
+	g_return_if_fail (idletime->priv->backend == &egg_idletime_backend_fake);
+
+	fake = idletime->priv->backend_data;
+	target = fake->clock + ms;
+	while (TRUE) {
+		next = target;
+		next_alarm = NULL;
+		next_timeout = NULL;
+		found = FALSE;
+
+		/* alarms go off as the idle time passes them, and win ties */
+		g_hash_table_iter_init (&iter, idletime->priv->alarms);
+		while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &alarm)) {
+			due = fake->activity + alarm->timeout;
+			if (!alarm->armed || due < fake->clock)
+				continue;
+			if (due > next || (found && due == next))
+				continue;
+			next = due;
+			next_alarm = alarm;
+			found = TRUE;
+		}
+		for (i=0; i<fake->timeouts->len; i++) {
+			timeout = g_ptr_array_index (fake->timeouts, i);
+			if (timeout->deadline > next || (found && timeout->deadline == next))
+				continue;
+			next = timeout->deadline;
+			next_alarm = NULL;
+			next_timeout = timeout;
+			found = TRUE;
+		}
+		fake->clock = next;
+
+		if (next_alarm != NULL) {
+			egg_idletime_backend_expired (idletime, next_alarm, egg_idletime_fake_get_time (idletime));
+			continue;
+		}
+		if (next_timeout == NULL)
+			break;
+
+		/* the callback can add and remove timeouts */
+		id = next_timeout->id;
+		if (next_timeout->func (next_timeout->user_data)) {
+			timeout = egg_idletime_fake_timeout_find (fake, id);
+			if (timeout != NULL)
+				timeout->deadline = fake->clock + timeout->interval;
+		} else {
+			egg_idletime_fake_timeout_remove (idletime, id);
+		}
 	}
-	return NULL;
 }
 
 /**
- * egg_idletime_event_filter_cb:
+ * egg_idletime_fake_activity:
+ *
+ * The user moved the mouse, for the fake backend.
  */
-static GdkFilterReturn
-egg_idletime_event_filter_cb (GdkXEvent *gdkxevent, GdkEvent *event, gpointer data)
+void
+egg_idletime_fake_activity (EggIdletime *idletime)
 {
-	EggIdletimeAlarm *alarm;
-	XEvent *xevent = (XEvent *) gdkxevent;
-	EggIdletime *idletime = (EggIdletime *) data;
-	XSyncAlarmNotifyEvent *alarm_event;
-
-	/* no point continuing */
-	if (xevent->type != idletime->priv->sync_event + XSyncAlarmNotify)
-		return GDK_FILTER_CONTINUE;
+	EggIdletimeFake *fake;
 
-	alarm_event = (XSyncAlarmNotifyEvent *) xevent;
+	g_return_if_fail (EGG_IS_IDLETIME (idletime));
+	g_return_if_fail (idletime->priv->backend == &egg_idletime_backend_fake);
 
-	/* did we match one of our alarms? */
-	alarm = egg_idletime_alarm_find_event (idletime, alarm_event);
-	if (alarm == NULL)
-		return GDK_FILTER_CONTINUE;
+	fake = idletime->priv->backend_data;
+	fake->activity = fake->clock;
+	egg_idletime_alarm_reset_all (idletime);
+}
 
-	/* are we the reset alarm? */
-	if (alarm->id == 0) {
-		egg_idletime_alarm_reset_all (idletime);
-		goto out;
-	}
+/**
+ * egg_idletime_fake_open:
+ */
+static gboolean
+egg_idletime_fake_open (EggIdletime *idletime)
+{
+	EggIdletimeFake *fake;
 
-	/* emit */
-	g_signal_emit (alarm->idletime, signals [SIGNAL_ALARM_EXPIRED], 0, alarm->id);
+	fake = g_new0 (EggIdletimeFake, 1);
+	fake->timeouts = g_ptr_array_new_with_free_func (g_free);
+	fake->next_id = 1;
+	idletime->priv->backend_data = fake;
+	return TRUE;
+}
 
-	/* we need the first alarm to go off to set the reset alarm */
-	egg_idletime_set_reset_alarm (idletime, alarm_event);
-out:
-	/* don't propagate */
-	return GDK_FILTER_REMOVE;
+/**
+ * egg_idletime_fake_close:
+ */
+static void
+egg_idletime_fake_close (EggIdletime *idletime)
+{
+	EggIdletimeFake *fake = idletime->priv->backend_data;
+	g_ptr_array_unref (fake->timeouts);
+	g_free (fake);
 }
 
+static const EggIdletimeBackend egg_idletime_backend_fake = {
+	"fake",
+	egg_idletime_fake_open,
+	egg_idletime_fake_close,
+	egg_idletime_fake_get_time,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	egg_idletime_fake_timeout_add,
+	egg_idletime_fake_timeout_remove,
+	NULL,
+	egg_idletime_fake_get_clock
+};
+
+/***************************************************************************/
+
 /**
  * egg_idletime_alarm_new:
  */
@@ -283,14 +1065,38 @@ egg_idletime_alarm_new (EggIdletime *idletime, guint id)
 
 	/* set the default values */
 	alarm->id = id;
-	alarm->xalarm = None;
+	alarm->handle = 0;
 	alarm->idletime = g_object_ref (idletime);
 
 	return alarm;
 }
 
+/**
+ * egg_idletime_alarm_late_cb:
+ *
+ * The idle time was already past the alarm when it was set.
+ */
+static gboolean
+egg_idletime_alarm_late_cb (EggIdletimeAlarm *alarm)
+{
+	EggIdletime *idletime = alarm->idletime;
+
+	alarm->late_id = 0;
+	if (!alarm->armed)
+		return FALSE;
+	if (idletime->priv->backend->alarm_disarm != NULL)
+		idletime->priv->backend->alarm_disarm (idletime, alarm);
+	egg_idletime_backend_expired (idletime, alarm, egg_idletime_get_time (idletime));
+	return FALSE;
+}
+
 /**
  * egg_idletime_alarm_set:
+ * @timeout: In ms
+ *
+ * If the user has already been idle for longer than @timeout the alarm
+ * goes off on the next main loop iteration, rather than waiting for an
+ * idle time it has missed.
  */
 gboolean
 egg_idletime_alarm_set (EggIdletime *idletime, guint id, guint timeout)
@@ -307,15 +1113,20 @@ egg_idletime_alarm_set (EggIdletime *idletime, guint id, guint timeout)
 		/* create a new alarm */
 		alarm = egg_idletime_alarm_new (idletime, id);
 
-		/* add to array */
-		g_ptr_array_add (idletime->priv->array, alarm);
+		/* add to table */
+		g_hash_table_insert (idletime->priv->alarms, GUINT_TO_POINTER (id), alarm);
 	}
 
-	/* set the timeout */
-	XSyncIntToValue (&alarm->timeout, (gint)timeout);
-
 	/* set, and start the timer */
-	egg_idletime_xsync_alarm_set (idletime, alarm, EGG_IDLETIME_ALARM_TYPE_POSITIVE);
+	alarm->timeout = timeout;
+	egg_idletime_alarm_arm (idletime, alarm);
+	egg_idletime_flush (idletime);
+
+	/* the idle time will never pass it again before some activity */
+	if (alarm->late_id == 0 && egg_idletime_get_time (idletime) >= timeout) {
+		alarm->late_id = egg_idletime_timeout_add (idletime, 0, "[EggIdletime] late alarm",
+							   (GSourceFunc) egg_idletime_alarm_late_cb, alarm);
+	}
 	return TRUE;
 }
 
@@ -328,10 +1139,12 @@ egg_idletime_alarm_free (EggIdletime *idletime, EggIdletimeAlarm *alarm)
 	g_return_val_if_fail (EGG_IS_IDLETIME (idletime), FALSE);
 	g_return_val_if_fail (alarm != NULL, FALSE);
 
-	if (alarm->xalarm)
-		XSyncDestroyAlarm (idletime->priv->dpy, alarm->xalarm);
+	if (idletime->priv->backend->alarm_disarm != NULL)
+		idletime->priv->backend->alarm_disarm (idletime, alarm);
+	if (alarm->late_id != 0)
+		egg_idletime_timeout_remove (idletime, alarm->late_id);
 	g_object_unref (alarm->idletime);
-	g_ptr_array_remove (idletime->priv->array, alarm);
+	g_hash_table_remove (idletime->priv->alarms, GUINT_TO_POINTER (alarm->id));
 	g_free (alarm);
 	return TRUE;
 }
@@ -384,47 +1197,42 @@ egg_idletime_class_init (EggIdletimeClass *klass)
 static void
 egg_idletime_init (EggIdletime *idletime)
 {
-	int sync_error;
-	int ncounters;
-	XSyncSystemCounter *counters;
-	EggIdletimeAlarm *alarm;
-	gint i;
-
 	idletime->priv = egg_idletime_get_instance_private (idletime);
-
-	idletime->priv->array = g_ptr_array_new ();
-
+	idletime->priv->alarms = g_hash_table_new (g_direct_hash, g_direct_equal);
 	idletime->priv->reset_set = FALSE;
-	idletime->priv->idle_counter = None;
-	idletime->priv->sync_event = 0;
-	idletime->priv->dpy = GDK_DISPLAY_XDISPLAY (gdk_display_get_default());
-
-	/* get the sync event */
-	if (!XSyncQueryExtension (idletime->priv->dpy, &idletime->priv->sync_event, &sync_error)) {
-		g_warning ("No Sync extension.");
-		return;
-	}
+}
 
-	/* gtk_init should do XSyncInitialize for us */
-	counters = XSyncListSystemCounters (idletime->priv->dpy, &ncounters);
-	for (i=0; i < ncounters && !idletime->priv->idle_counter; i++) {
-		if (strcmp(counters[i].name, "IDLETIME") == 0)
-			idletime->priv->idle_counter = counters[i].counter;
-	}
-	XSyncFreeSystemCounterList (counters);
+/**
+ * egg_idletime_open:
+ **/
+static void
+egg_idletime_open (EggIdletime *idletime, EggIdletimeBackendKind kind)
+{
+	const EggIdletimeBackend *backends[] = { &egg_idletime_backend_xsync,
+						 &egg_idletime_backend_logind,
+						 &egg_idletime_backend_fake };
+	guint i;
 
-	/* arh. we don't have IDLETIME support */
-	if (!idletime->priv->idle_counter) {
-		g_warning ("No idle counter.");
-		return;
+	if (kind != EGG_IDLETIME_BACKEND_AUTO) {
+		idletime->priv->backend = backends[kind - 1];
+		if (idletime->priv->backend->open (idletime))
+			goto out;
+		g_warning ("failed to open %s idletime backend", idletime->priv->backend->name);
+	} else {
+		/* the first that works, but never fake */
+		for (i = 0; i < G_N_ELEMENTS (backends) - 1; i++) {
+			idletime->priv->backend = backends[i];
+			if (idletime->priv->backend->open (idletime))
+				goto out;
+		}
+		g_warning ("no idletime backend, the user will never be idle");
 	}
 
-	/* catch the timer alarm */
-	gdk_window_add_filter (NULL, egg_idletime_event_filter_cb, idletime);
-
-	/* create a reset alarm */
-	alarm = egg_idletime_alarm_new (idletime, 0);
-	g_ptr_array_add (idletime->priv->array, alarm);
+	/* a clock that never moves */
+	idletime->priv->backend = &egg_idletime_backend_fake;
+	idletime->priv->backend->open (idletime);
+out:
+	g_debug ("using %s idletime backend", idletime->priv->backend->name);
 }
 
 /**
@@ -433,9 +1241,9 @@ egg_idletime_init (EggIdletime *idletime)
 static void
 egg_idletime_finalize (GObject *object)
 {
-	guint i;
 	EggIdletime *idletime;
-	EggIdletimeAlarm *alarm;
+	GList *alarms;
+	GList *l;
 
 	g_return_if_fail (object != NULL);
 	g_return_if_fail (EGG_IS_IDLETIME (object));
@@ -443,81 +1251,77 @@ egg_idletime_finalize (GObject *object)
 	idletime = EGG_IDLETIME (object);
 	idletime->priv = egg_idletime_get_instance_private (idletime);
 
-	/* free all counters, including reset counter */
-	for (i=0; i<idletime->priv->array->len; i++) {
-		alarm = g_ptr_array_index (idletime->priv->array, i);
-		egg_idletime_alarm_free (idletime, alarm);
-	}
-	g_ptr_array_free (idletime->priv->array, TRUE);
+	/* free all alarms */
+	alarms = g_hash_table_get_values (idletime->priv->alarms);
+	for (l = alarms; l != NULL; l = l->next)
+		egg_idletime_alarm_free (idletime, l->data);
+	g_list_free (alarms);
+	g_hash_table_unref (idletime->priv->alarms);
+	idletime->priv->backend->close (idletime);
 
 	G_OBJECT_CLASS (egg_idletime_parent_class)->finalize (object);
 }
 
 /**
- * egg_idletime_new:
+ * egg_idletime_new_for_backend:
+ * @kind: Where the idle time comes from
+ *
+ * The first caller decides the backend, later ones share it.
  **/
 EggIdletime *
-egg_idletime_new (void)
+egg_idletime_new_for_backend (EggIdletimeBackendKind kind)
 {
 	if (egg_idletime_object != NULL) {
 		g_object_ref (egg_idletime_object);
 	} else {
 		egg_idletime_object = g_object_new (EGG_IDLETIME_TYPE, NULL);
 		g_object_add_weak_pointer (egg_idletime_object, &egg_idletime_object);
+		egg_idletime_open (EGG_IDLETIME (egg_idletime_object), kind);
 	}
 	return EGG_IDLETIME (egg_idletime_object);
 }
 
+/**
+ * egg_idletime_new:
+ **/
+EggIdletime *
+egg_idletime_new (void)
+{
+	return egg_idletime_new_for_backend (EGG_IDLETIME_BACKEND_AUTO);
+}
+
 /***************************************************************************
  ***                          MAKE CHECK TESTS                           ***
  ***************************************************************************/
 #ifdef EGG_TEST
 #include "egg-test.h"
 
-static void
-egg_test_egg_idletime_wait (guint time_ms)
-{
-	GTimer *ltimer = g_timer_new ();
-	gfloat goal = time_ms / (gfloat) 1000.0f;
-	do {
-		g_main_context_iteration (NULL, FALSE);
-	} while (g_timer_elapsed (ltimer, NULL) < goal);
-	g_timer_destroy (ltimer);
-}
-
 static guint last_alarm = 0;
-static guint event_time;
-GTimer *timer;
+static guint reset_count = 0;
+static gint64 event_time;
+
+static guint expired_count = 0;
 
 static void
 gpm_alarm_expired_cb (EggIdletime *idletime, guint alarm, gpointer data)
 {
+	expired_count++;
 	last_alarm = alarm;
-	event_time = g_timer_elapsed (timer, NULL) * (gfloat) 1000.0f;
-//	g_print ("[evt %i in %ims]\n", alarm, event_time);
+	event_time = egg_idletime_get_time (idletime);
 }
 
 static void
-wait_until_alarm (void)
+gpm_reset_cb (EggIdletime *idletime, gpointer data)
 {
-	g_print ("*****************************\n");
-	g_print ("*** DO NOT MOVE THE MOUSE ***\n");
-	g_print ("*****************************\n");
-	while (last_alarm == 0)
-		g_main_context_iteration (NULL, FALSE);
+	last_alarm = 0;
+	reset_count++;
 }
 
-static void
-wait_until_reset (void)
+static gboolean
+egg_idletime_test_timeout_cb (guint *count)
 {
-	if (last_alarm == 0)
-		return;
-	g_print ("*****************************\n");
-	g_print ("***     MOVE THE MOUSE    ***\n");
-	g_print ("*****************************\n");
-	while (last_alarm != 0)
-		g_main_context_iteration (NULL, FALSE);
-	egg_test_egg_idletime_wait (1000);
+	(*count)++;
+	return *count < 3;
 }
 
 void
@@ -526,30 +1330,15 @@ egg_idletime_test (gpointer data)
 	EggIdletime *idletime;
 	gboolean ret;
 	guint i;
+	guint count = 0;
 	EggTest *test = (EggTest *) data;
 
 	if (egg_test_start (test, "EggIdletime") == FALSE)
 		return;
 
-	timer = g_timer_new ();
-	gdk_init (NULL, NULL);
-
-	/* warn */
-
-	g_timer_start (timer);
-	/************************************************************/
-	egg_test_title (test, "check to see if delay works as expected");
-	egg_test_egg_idletime_wait (2000);
-	event_time = g_timer_elapsed (timer, NULL) * (gfloat) 1000.0f;
-	if (event_time > 1800 && event_time < 2200) {
-		egg_test_success (test, "time %i~=%i", 2000, event_time);
-	} else {
-		egg_test_failed (test, "time not the same! %i != %i", event_time, 2000);
-	}
-
 	/************************************************************/
 	egg_test_title (test, "make sure we get a non null device");
-	idletime = egg_idletime_new ();
+	idletime = egg_idletime_new_for_backend (EGG_IDLETIME_BACKEND_FAKE);
 	if (idletime != NULL) {
 		egg_test_success (test, "got EggIdletime");
 	} else {
@@ -557,6 +1346,12 @@ egg_idletime_test (gpointer data)
 	}
 	g_signal_connect (idletime, "alarm-expired",
 			  G_CALLBACK (gpm_alarm_expired_cb), NULL);
+	g_signal_connect (idletime, "reset",
+			  G_CALLBACK (gpm_reset_cb), NULL);
+
+	/************************************************************/
+	egg_test_title (test, "check we got the fake backend");
+	egg_test_assert (test, g_strcmp0 (egg_idletime_get_backend_name (idletime), "fake") == 0);
 
 	/************************************************************/
 	egg_test_title (test, "check if we are alarm zero with no alarms");
@@ -585,7 +1380,6 @@ egg_idletime_test (gpointer data)
 	}
 
 	/************************************************************/
-	g_timer_start (timer);
 	egg_test_title (test, "check if we can set an alarm");
 	ret = egg_idletime_alarm_set (idletime, 101, 5000);
 	if (ret) {
@@ -594,31 +1388,16 @@ egg_idletime_test (gpointer data)
 		egg_test_failed (test, "could not set alarm");
 	}
 
-	egg_idletime_alarm_set (idletime, 101, 5000);
-	wait_until_alarm ();
+	/************************************************************/
+	egg_test_title (test, "check the alarm does not go off early");
+	egg_idletime_fake_advance (idletime, 4999);
+	egg_test_assert (test, (last_alarm == 0));
 
 	/* loop this two times */
 	for (i=0; i<2; i++) {
-		/* just let it time out, and wait for human input */
-		wait_until_reset ();
-		g_timer_start (timer);
-
-		/************************************************************/
-		g_timer_start (timer);
-		egg_test_title (test, "check if we can set an alarm");
-		ret = egg_idletime_alarm_set (idletime, 101, 5000);
-		if (ret) {
-			egg_test_success (test, "set alarm 5000ms okay");
-		} else {
-			egg_test_failed (test, "could not set alarm 5000ms");
-		}
-
-		/* wait for alarm to go off */
-		wait_until_alarm ();
-		g_timer_start (timer);
-
 		/************************************************************/
 		egg_test_title (test, "check if correct alarm has gone off");
+		egg_idletime_fake_advance (idletime, 1);
 		if (last_alarm == 101) {
 			egg_test_success (test, "correct alarm");
 		} else {
@@ -627,42 +1406,82 @@ egg_idletime_test (gpointer data)
 
 		/************************************************************/
 		egg_test_title (test, "check if alarm has gone off in correct time");
-		if (event_time > 3000 && event_time < 6000) {
-			egg_test_success (test, "correct, timeout ideally %ims (we did after %ims)", 5000, event_time);
+		if (event_time == 5000) {
+			egg_test_success (test, NULL);
 		} else {
-			egg_test_failed (test, "alarm %i did not timeout correctly !", last_alarm);
+			egg_test_failed (test, "alarm went off after %" G_GINT64_FORMAT "ms", event_time);
 		}
-	}
 
-	/* just let it time out, and wait for human input */
-	wait_until_reset ();
-	g_timer_start (timer);
+		/************************************************************/
+		egg_test_title (test, "check the alarm only goes off once");
+		last_alarm = 0;
+		egg_idletime_fake_advance (idletime, 20000);
+		egg_test_assert (test, (last_alarm == 0));
+
+		/************************************************************/
+		egg_test_title (test, "check activity resets");
+		egg_idletime_fake_activity (idletime);
+		egg_test_assert (test, (reset_count == i + 1 && egg_idletime_get_time (idletime) == 0));
+		egg_idletime_fake_advance (idletime, 4999);
+	}
 
 	/************************************************************/
-	g_timer_start (timer);
 	egg_test_title (test, "check if we can set an existing alarm");
+	egg_idletime_fake_activity (idletime);
 	ret = egg_idletime_alarm_set (idletime, 101, 10000);
-	if (ret) {
-		egg_test_success (test, "set alarm 10000ms okay");
+	egg_idletime_fake_advance (idletime, 9999);
+	egg_test_assert (test, (ret && last_alarm == 0));
+
+	/************************************************************/
+	egg_test_title (test, "check if alarm has gone off in the new time");
+	egg_idletime_fake_advance (idletime, 1);
+	if (last_alarm == 101 && event_time == 10000) {
+		egg_test_success (test, NULL);
 	} else {
-		egg_test_failed (test, "could not set alarm 10000ms");
+		egg_test_failed (test, "incorrect timeout used %" G_GINT64_FORMAT "ms", event_time);
 	}
 
-	/* wait for alarm to go off */
-	wait_until_alarm ();
-	g_timer_start (timer);
+	/************************************************************/
+	egg_test_title (test, "check timeouts run on the fake clock");
+	egg_idletime_timeout_add (idletime, 1000, "[EggIdletime] test",
+				  (GSourceFunc) egg_idletime_test_timeout_cb, &count);
+	egg_idletime_fake_advance (idletime, 2500);
+	egg_test_assert (test, (count == 2));
 
 	/************************************************************/
-	egg_test_title (test, "check if alarm has gone off in the old time");
-	if (event_time > 5000) {
-		egg_test_success (test, "last timeout value used");
-	} else {
-		egg_test_failed (test, "incorrect timeout used %ims", event_time);
-	}
+	egg_test_title (test, "check timeouts stop when they return FALSE");
+	egg_idletime_fake_advance (idletime, 5000);
+	egg_test_assert (test, (count == 3));
+
+	/************************************************************/
+	egg_test_title (test, "check many alarms go off in order");
+	egg_idletime_fake_activity (idletime);
+	for (i=0; i<100; i++)
+		egg_idletime_alarm_set (idletime, 1000 + i, 20000 + 100 * i);
+	expired_count = 0;
+	egg_idletime_fake_advance (idletime, 20000 + 100 * 49);
+	egg_test_assert (test, (expired_count == 50 + 1 && last_alarm == 1049));
+
+	/************************************************************/
+	egg_test_title (test, "check all alarms go off again after activity");
+	egg_idletime_fake_activity (idletime);
+	expired_count = 0;
+	egg_idletime_fake_advance (idletime, 20000 + 100 * 99);
+	egg_test_assert (test, (expired_count == 100 + 1 && last_alarm == 1099));
+	for (i=0; i<100; i++)
+		egg_idletime_alarm_remove (idletime, 1000 + i);
+
+	/************************************************************/
+	egg_test_title (test, "check an alarm set after its time goes off straight away");
+	last_alarm = 0;
+	egg_idletime_alarm_set (idletime, 202, 1000);
+	egg_idletime_fake_advance (idletime, 0);
+	egg_test_assert (test, (last_alarm == 202));
+	egg_idletime_alarm_remove (idletime, 202);
 
 	/************************************************************/
 	egg_test_title (test, "check if we can remove an invalid alarm");
-	ret = egg_idletime_alarm_remove (idletime, 202);
+	ret = egg_idletime_alarm_remove (idletime, 303);
 	if (!ret) {
 		egg_test_success (test, "ignored invalid alarm");
 	} else {
@@ -678,11 +1497,9 @@ egg_idletime_test (gpointer data)
 		egg_test_failed (test, "failed to remove valid alarm");
 	}
 
-	g_timer_destroy (timer);
 	g_object_unref (idletime);
 
 	egg_test_end (test);
 }
 
 #endif
-
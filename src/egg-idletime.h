@@ -50,8 +50,26 @@ typedef struct
 	void		(* reset)			(EggIdletime	*idletime);
 } EggIdletimeClass;
 
+typedef enum {
+	EGG_IDLETIME_BACKEND_AUTO,
+	EGG_IDLETIME_BACKEND_XSYNC,
+	EGG_IDLETIME_BACKEND_LOGIND,
+	EGG_IDLETIME_BACKEND_FAKE
+} EggIdletimeBackendKind;
+
+/* lets the real clock be some other timer service */
+typedef guint	(* EggIdletimeTimeoutAddFunc)		(guint		 interval,
+							 const gchar	*name,
+							 GSourceFunc	 func,
+							 gpointer	 user_data,
+							 gpointer	 data);
+typedef void	(* EggIdletimeTimeoutRemoveFunc)	(guint		 id,
+							 gpointer	 data);
+
 GType		 egg_idletime_get_type			(void);
 EggIdletime	*egg_idletime_new			(void);
+EggIdletime	*egg_idletime_new_for_backend		(EggIdletimeBackendKind kind);
+const gchar	*egg_idletime_get_backend_name		(EggIdletime	*idletime);
 
 void		 egg_idletime_alarm_reset_all		(EggIdletime	*idletime);
 gboolean	 egg_idletime_alarm_set			(EggIdletime	*idletime,
@@ -60,6 +78,21 @@ gboolean	 egg_idletime_alarm_set			(EggIdletime	*idletime,
 gboolean	 egg_idletime_alarm_remove		(EggIdletime	*idletime,
 							 guint		 alarm_id);
 gint64		 egg_idletime_get_time			(EggIdletime	*idletime);
+gint64		 egg_idletime_get_clock			(EggIdletime	*idletime);
+guint		 egg_idletime_timeout_add		(EggIdletime	*idletime,
+							 guint		 interval,
+							 const gchar	*name,
+							 GSourceFunc	 func,
+							 gpointer	 user_data);
+void		 egg_idletime_set_timeout_funcs		(EggIdletime	*idletime,
+							 EggIdletimeTimeoutAddFunc add_func,
+							 EggIdletimeTimeoutRemoveFunc remove_func,
+							 gpointer	 data);
+void		 egg_idletime_timeout_remove		(EggIdletime	*idletime,
+							 guint		 id);
+void		 egg_idletime_fake_advance		(EggIdletime	*idletime,
+							 guint		 ms);
+void		 egg_idletime_fake_activity		(EggIdletime	*idletime);
 #ifdef EGG_TEST
 void		 egg_idletime_test			(gpointer	 data);
 #endif
@@ -0,0 +1,755 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Notifications and sounds, kept off the policy path. Asking for either
+ * only queues it: notifications are sent from an idle once the handler
+ * that asked for them has returned, with async calls straight to the
+ * notification daemon, and sounds are played by a worker thread, so a
+ * slow notification daemon or sound server can never hold up the action
+ * taken on a critical battery. A newer notification of a kind replaces
+ * one still queued, an identical one still on screen is not shown again,
+ * and a sound already queued is not queued twice.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <glib.h>
+#include <glib/gi18n.h>
+#include <canberra-gtk.h>
+
+#include "gpm-alert.h"
+#include "gpm-common.h"
+#include "gpm-proxy-pool.h"
+#include "gpm-timer.h"
+
+static void     gpm_alert_finalize   (GObject	  *object);
+
+typedef struct {
+	gchar			*title;
+	gchar			*message;
+	gchar			*icon;
+	guint			 timeout;
+	NotifyUrgency		 urgency;
+} GpmAlertMessage;
+
+typedef struct {
+	gchar			*id;
+	gchar			*desc;
+} GpmAlertSound;
+
+typedef struct {
+	GpmAlert		*alert;
+	GpmAlertNotify		 kind;
+	GpmAlertMessage		*message;
+} GpmAlertCall;
+
+struct GpmAlertPrivate
+{
+	GtkStatusIcon		*status_icon;
+	GpmProxyPool		*pool;
+	GDBusProxy		*proxy;
+	GCancellable		*cancellable;
+	gboolean		 connecting;
+	guint32			 ids[GPM_ALERT_NOTIFY_LAST];	/* from the daemon, or 0 */
+	GpmAlertMessage		*showing[GPM_ALERT_NOTIFY_LAST];
+	GpmAlertMessage		*pending[GPM_ALERT_NOTIFY_LAST];
+	gboolean		 close[GPM_ALERT_NOTIFY_LAST];
+	gboolean		 busy[GPM_ALERT_NOTIFY_LAST];	/* a call is in flight */
+	guint			 dispatch_id;
+	ca_context		*context;
+	GThread			*thread;
+	GAsyncQueue		*sounds;
+	GHashTable		*sounds_queued;
+	GMutex			 sounds_lock;
+	GpmAlertSound		*loop;
+	GpmTimer		*timer;
+	guint			 loop_id;
+};
+
+/* pushed to the front of the queue to stop the thread */
+static GpmAlertSound gpm_alert_sound_quit = { NULL, NULL };
+
+static gpointer gpm_alert_object = NULL;
+
+static void	gpm_alert_schedule	(GpmAlert	*alert);
+
+G_DEFINE_TYPE_WITH_PRIVATE (GpmAlert, gpm_alert, G_TYPE_OBJECT)
+
+/**
+ * gpm_alert_message_free:
+ **/
+static void
+gpm_alert_message_free (GpmAlertMessage *message)
+{
+	if (message == NULL)
+		return;
+	g_free (message->title);
+	g_free (message->message);
+	g_free (message->icon);
+	g_free (message);
+}
+
+/**
+ * gpm_alert_message_equal:
+ **/
+static gboolean
+gpm_alert_message_equal (const GpmAlertMessage *a, const GpmAlertMessage *b)
+{
+	if (a == NULL || b == NULL)
+		return FALSE;
+	return g_strcmp0 (a->title, b->title) == 0 &&
+	       g_strcmp0 (a->message, b->message) == 0 &&
+	       g_strcmp0 (a->icon, b->icon) == 0 &&
+	       a->timeout == b->timeout &&
+	       a->urgency == b->urgency;
+}
+
+/**
+ * gpm_alert_sound_free:
+ **/
+static void
+gpm_alert_sound_free (GpmAlertSound *sound)
+{
+	if (sound == &gpm_alert_sound_quit)
+		return;
+	g_free (sound->id);
+	g_free (sound->desc);
+	g_free (sound);
+}
+
+/**
+ * gpm_alert_fallback_cb:
+ *
+ * Shows a dialog when the notification daemon could not, at a low
+ * priority so that building it never gets in the way of a policy action.
+ **/
+static gboolean
+gpm_alert_fallback_cb (GpmAlertMessage *message)
+{
+	GtkWidget *dialog;
+
+	dialog = gtk_message_dialog_new_with_markup (NULL, GTK_DIALOG_DESTROY_WITH_PARENT,
+						     GTK_MESSAGE_INFO, GTK_BUTTONS_CLOSE,
+						     "<span size='larger'><b>%s</b></span>", message->title);
+	gtk_message_dialog_format_secondary_markup (GTK_MESSAGE_DIALOG (dialog), "%s", message->message);
+
+	/* wait async for close */
+	gtk_widget_show (dialog);
+	g_signal_connect_swapped (dialog, "response", G_CALLBACK (gtk_widget_destroy), dialog);
+	return FALSE;
+}
+
+/**
+ * gpm_alert_fallback:
+ *
+ * Takes @message.
+ **/
+static void
+gpm_alert_fallback (GpmAlertMessage *message)
+{
+	guint id;
+
+	id = g_idle_add_full (G_PRIORITY_LOW, (GSourceFunc) gpm_alert_fallback_cb,
+			      message, (GDestroyNotify) gpm_alert_message_free);
+	g_source_set_name_by_id (id, "[GpmAlert] fallback");
+}
+
+/**
+ * gpm_alert_call_free:
+ **/
+static void
+gpm_alert_call_free (GpmAlertCall *call)
+{
+	gpm_alert_message_free (call->message);
+	g_free (call);
+}
+
+/**
+ * gpm_alert_signal_cb:
+ **/
+static void
+gpm_alert_signal_cb (GDBusProxy *proxy, const gchar *sender_name, const gchar *signal_name,
+		     GVariant *parameters, GpmAlert *alert)
+{
+	guint32 id;
+	guint32 reason;
+	guint i;
+
+	if (g_strcmp0 (signal_name, "NotificationClosed") != 0)
+		return;
+	g_variant_get (parameters, "(uu)", &id, &reason);
+	g_debug ("caught notification closed signal %u", id);
+	for (i = 0; i < GPM_ALERT_NOTIFY_LAST; i++) {
+		if (alert->priv->ids[i] != id)
+			continue;
+		alert->priv->ids[i] = 0;
+		gpm_alert_message_free (alert->priv->showing[i]);
+		alert->priv->showing[i] = NULL;
+	}
+}
+
+/**
+ * gpm_alert_close_cb:
+ **/
+static void
+gpm_alert_close_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GpmAlertCall *call = (GpmAlertCall *) user_data;
+	GVariant *result;
+	GError *error = NULL;
+
+	result = g_dbus_proxy_call_finish (G_DBUS_PROXY (source), res, &error);
+	if (result == NULL) {
+		/* the alert has gone away */
+		if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			g_error_free (error);
+			gpm_alert_call_free (call);
+			return;
+		}
+		g_warning ("failed to close notification: %s", error->message);
+		g_error_free (error);
+	} else {
+		g_variant_unref (result);
+	}
+
+	call->alert->priv->busy[call->kind] = FALSE;
+	gpm_alert_schedule (call->alert);
+	gpm_alert_call_free (call);
+}
+
+/**
+ * gpm_alert_close_now:
+ **/
+static void
+gpm_alert_close_now (GpmAlert *alert, GpmAlertNotify kind)
+{
+	GpmAlertCall *call;
+
+	if (alert->priv->ids[kind] == 0)
+		return;
+
+	call = g_new0 (GpmAlertCall, 1);
+	call->alert = alert;
+	call->kind = kind;
+	alert->priv->busy[kind] = TRUE;
+	g_dbus_proxy_call (alert->priv->proxy, "CloseNotification",
+			   g_variant_new ("(u)", alert->priv->ids[kind]),
+			   G_DBUS_CALL_FLAGS_NONE, -1, alert->priv->cancellable,
+			   gpm_alert_close_cb, call);
+
+	/* forget it first, it may already be gone */
+	alert->priv->ids[kind] = 0;
+	gpm_alert_message_free (alert->priv->showing[kind]);
+	alert->priv->showing[kind] = NULL;
+}
+
+/**
+ * gpm_alert_show_cb:
+ **/
+static void
+gpm_alert_show_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GpmAlertCall *call = (GpmAlertCall *) user_data;
+	GpmAlert *alert = call->alert;
+	GVariant *result;
+	GError *error = NULL;
+
+	result = g_dbus_proxy_call_finish (G_DBUS_PROXY (source), res, &error);
+	if (result == NULL) {
+		if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			g_error_free (error);
+			gpm_alert_call_free (call);
+			return;
+		}
+		g_warning ("failed to show notification: %s", error->message);
+		g_error_free (error);
+
+		/* show modal dialog as the notification daemon failed */
+		alert->priv->ids[call->kind] = 0;
+		gpm_alert_message_free (alert->priv->showing[call->kind]);
+		alert->priv->showing[call->kind] = NULL;
+		gpm_alert_fallback (call->message);
+		call->message = NULL;
+	} else {
+		g_variant_get (result, "(u)", &alert->priv->ids[call->kind]);
+		g_variant_unref (result);
+		gpm_alert_message_free (alert->priv->showing[call->kind]);
+		alert->priv->showing[call->kind] = call->message;
+		call->message = NULL;
+	}
+
+	alert->priv->busy[call->kind] = FALSE;
+	gpm_alert_schedule (alert);
+	gpm_alert_call_free (call);
+}
+
+/**
+ * gpm_alert_show_now:
+ *
+ * Takes @message.
+ **/
+static void
+gpm_alert_show_now (GpmAlert *alert, GpmAlertNotify kind, GpmAlertMessage *message)
+{
+	GpmAlertCall *call;
+	GVariantBuilder hints;
+	const gchar *icon = message->icon;
+
+	/* still on screen, nothing would change */
+	if (alert->priv->ids[kind] != 0 &&
+	    gpm_alert_message_equal (alert->priv->showing[kind], message)) {
+		g_debug ("notification %s already shown", message->title);
+		gpm_alert_message_free (message);
+		return;
+	}
+
+	/* if the status icon is hidden, don't point at it */
+	if (alert->priv->status_icon != NULL &&
+	    gtk_status_icon_is_embedded (alert->priv->status_icon))
+		icon = gtk_status_icon_get_icon_name (alert->priv->status_icon);
+
+	g_debug ("notification %u: %s : %s", alert->priv->ids[kind], message->title, message->message);
+
+	g_variant_builder_init (&hints, G_VARIANT_TYPE ("a{sv}"));
+	g_variant_builder_add (&hints, "{sv}", "urgency", g_variant_new_byte (message->urgency));
+
+	/* replace the one shown in place rather than closing it first */
+	call = g_new0 (GpmAlertCall, 1);
+	call->alert = alert;
+	call->kind = kind;
+	call->message = message;
+	alert->priv->busy[kind] = TRUE;
+	g_dbus_proxy_call (alert->priv->proxy, "Notify",
+			   g_variant_new ("(susss@asa{sv}i)",
+					  GPM_NAME,
+					  alert->priv->ids[kind],
+					  icon != NULL ? icon : "",
+					  message->title,
+					  message->message != NULL ? message->message : "",
+					  g_variant_new_strv (NULL, 0),
+					  &hints,
+					  (gint32) message->timeout),
+			   G_DBUS_CALL_FLAGS_NONE, -1, alert->priv->cancellable,
+			   gpm_alert_show_cb, call);
+}
+
+/**
+ * gpm_alert_proxy_cb:
+ **/
+static void
+gpm_alert_proxy_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GpmAlert *alert;
+	GDBusProxy *proxy;
+	GError *error = NULL;
+	guint i;
+
+	proxy = gpm_proxy_pool_get_finish (GPM_PROXY_POOL (source), res, &error);
+	if (proxy == NULL) {
+		if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			g_error_free (error);
+			return;
+		}
+		alert = GPM_ALERT (user_data);
+		alert->priv->connecting = FALSE;
+		g_warning ("no notification daemon: %s", error->message);
+		g_error_free (error);
+
+		/* nothing can be shown, so tell the user some other way */
+		for (i = 0; i < GPM_ALERT_NOTIFY_LAST; i++) {
+			alert->priv->close[i] = FALSE;
+			if (alert->priv->pending[i] == NULL)
+				continue;
+			gpm_alert_fallback (alert->priv->pending[i]);
+			alert->priv->pending[i] = NULL;
+		}
+		return;
+	}
+
+	alert = GPM_ALERT (user_data);
+	alert->priv->connecting = FALSE;
+	alert->priv->proxy = proxy;
+	g_signal_connect (proxy, "g-signal", G_CALLBACK (gpm_alert_signal_cb), alert);
+	gpm_alert_schedule (alert);
+}
+
+/**
+ * gpm_alert_connect:
+ *
+ * Starts connecting to the notification daemon, so the first notification
+ * does not have to wait for it. Nothing is shown before this is done.
+ **/
+void
+gpm_alert_connect (GpmAlert *alert)
+{
+	g_return_if_fail (GPM_IS_ALERT (alert));
+
+	if (alert->priv->proxy != NULL || alert->priv->connecting)
+		return;
+	alert->priv->connecting = TRUE;
+	gpm_proxy_pool_get_async (alert->priv->pool, GPM_PROXY_POOL_NOTIFICATIONS,
+				  alert->priv->cancellable, gpm_alert_proxy_cb, alert);
+}
+
+/**
+ * gpm_alert_dispatch_cb:
+ *
+ * Sends everything queued to the notification daemon without waiting for
+ * any of it; a kind with a call still in flight is sent when it returns.
+ **/
+static gboolean
+gpm_alert_dispatch_cb (GpmAlert *alert)
+{
+	GpmAlertMessage *message;
+	guint i;
+
+	alert->priv->dispatch_id = 0;
+
+	if (alert->priv->proxy == NULL) {
+		gpm_alert_connect (alert);
+		return FALSE;
+	}
+
+	for (i = 0; i < GPM_ALERT_NOTIFY_LAST; i++) {
+		if (alert->priv->busy[i])
+			continue;
+		if (alert->priv->close[i]) {
+			alert->priv->close[i] = FALSE;
+			gpm_alert_close_now (alert, i);
+		} else if (alert->priv->pending[i] != NULL) {
+			message = alert->priv->pending[i];
+			alert->priv->pending[i] = NULL;
+			gpm_alert_show_now (alert, i, message);
+		}
+	}
+	return FALSE;
+}
+
+/**
+ * gpm_alert_schedule:
+ **/
+static void
+gpm_alert_schedule (GpmAlert *alert)
+{
+	if (alert->priv->dispatch_id != 0)
+		return;
+	alert->priv->dispatch_id = g_idle_add ((GSourceFunc) gpm_alert_dispatch_cb, alert);
+	g_source_set_name_by_id (alert->priv->dispatch_id, "[GpmAlert] dispatch");
+}
+
+/**
+ * gpm_alert_set_status_icon:
+ **/
+void
+gpm_alert_set_status_icon (GpmAlert *alert, GtkStatusIcon *status_icon)
+{
+	g_return_if_fail (GPM_IS_ALERT (alert));
+
+	if (alert->priv->status_icon != NULL)
+		g_object_unref (alert->priv->status_icon);
+	alert->priv->status_icon = status_icon != NULL ? g_object_ref (status_icon) : NULL;
+}
+
+/**
+ * gpm_alert_notify:
+ * @alert: This class instance
+ * @kind: The kind of notification, which replaces any other of this kind
+ * @timeout: In ms, or 0 for never
+ *
+ * Queues a notification; it is shown once the main loop is idle.
+ **/
+void
+gpm_alert_notify (GpmAlert *alert, GpmAlertNotify kind,
+		  const gchar *title, const gchar *message,
+		  guint timeout, const gchar *icon, NotifyUrgency urgency)
+{
+	GpmAlertMessage *pending;
+
+	g_return_if_fail (GPM_IS_ALERT (alert));
+	g_return_if_fail (kind < GPM_ALERT_NOTIFY_LAST);
+
+	pending = g_new0 (GpmAlertMessage, 1);
+	pending->title = g_strdup (title);
+	pending->message = g_strdup (message);
+	pending->icon = g_strdup (icon);
+	pending->timeout = timeout;
+	pending->urgency = urgency;
+
+	/* the newest wins */
+	gpm_alert_message_free (alert->priv->pending[kind]);
+	alert->priv->pending[kind] = pending;
+	alert->priv->close[kind] = FALSE;
+	gpm_alert_schedule (alert);
+}
+
+/**
+ * gpm_alert_close:
+ *
+ * Drops a queued notification of @kind, and closes the one shown.
+ **/
+void
+gpm_alert_close (GpmAlert *alert, GpmAlertNotify kind)
+{
+	g_return_if_fail (GPM_IS_ALERT (alert));
+	g_return_if_fail (kind < GPM_ALERT_NOTIFY_LAST);
+
+	gpm_alert_message_free (alert->priv->pending[kind]);
+	alert->priv->pending[kind] = NULL;
+	if (alert->priv->ids[kind] == 0 && !alert->priv->busy[kind])
+		return;
+	alert->priv->close[kind] = TRUE;
+	gpm_alert_schedule (alert);
+}
+
+/**
+ * gpm_alert_close_all:
+ **/
+void
+gpm_alert_close_all (GpmAlert *alert)
+{
+	guint i;
+
+	g_return_if_fail (GPM_IS_ALERT (alert));
+
+	for (i = 0; i < GPM_ALERT_NOTIFY_LAST; i++)
+		gpm_alert_close (alert, i);
+}
+
+/**
+ * gpm_alert_thread_func:
+ *
+ * Connecting to the sound server happens on the first play, and any of
+ * them may block, so they all happen here.
+ **/
+static gpointer
+gpm_alert_thread_func (GpmAlert *alert)
+{
+	GpmAlertSound *sound;
+	gint retval;
+
+	while (TRUE) {
+		sound = g_async_queue_pop (alert->priv->sounds);
+		if (sound == &gpm_alert_sound_quit)
+			break;
+
+		/* a new request for this one can be queued from now */
+		g_mutex_lock (&alert->priv->sounds_lock);
+		g_hash_table_remove (alert->priv->sounds_queued, sound->id);
+		g_mutex_unlock (&alert->priv->sounds_lock);
+
+		/* play the sound, using sounds from the naming spec */
+		retval = ca_context_play (alert->priv->context, 0,
+					  CA_PROP_EVENT_ID, sound->id,
+					  CA_PROP_EVENT_DESCRIPTION, sound->desc, NULL);
+		if (retval < 0)
+			g_warning ("failed to play %s: %s", sound->id, ca_strerror (retval));
+		gpm_alert_sound_free (sound);
+	}
+	return NULL;
+}
+
+/**
+ * gpm_alert_play:
+ * @alert: This class instance
+ * @id: The sound from the naming spec, e.g. "battery-low"
+ * @desc: The translated description
+ **/
+void
+gpm_alert_play (GpmAlert *alert, const gchar *id, const gchar *desc)
+{
+	GpmAlertSound *sound;
+	gboolean queued;
+
+	g_return_if_fail (GPM_IS_ALERT (alert));
+	g_return_if_fail (id != NULL);
+
+	g_mutex_lock (&alert->priv->sounds_lock);
+	queued = g_hash_table_contains (alert->priv->sounds_queued, id);
+	if (!queued)
+		g_hash_table_add (alert->priv->sounds_queued, g_strdup (id));
+	g_mutex_unlock (&alert->priv->sounds_lock);
+	if (queued) {
+		g_debug ("%s is already queued", id);
+		return;
+	}
+
+	sound = g_new0 (GpmAlertSound, 1);
+	sound->id = g_strdup (id);
+	sound->desc = g_strdup (desc);
+	g_async_queue_push (alert->priv->sounds, sound);
+}
+
+/**
+ * gpm_alert_play_loop_timeout_cb:
+ **/
+static gboolean
+gpm_alert_play_loop_timeout_cb (GpmAlert *alert)
+{
+	gpm_alert_play (alert, alert->priv->loop->id, alert->priv->loop->desc);
+	return TRUE;
+}
+
+/**
+ * gpm_alert_play_loop_stop:
+ *
+ * Return value: %TRUE if a loop was playing
+ **/
+gboolean
+gpm_alert_play_loop_stop (GpmAlert *alert)
+{
+	g_return_val_if_fail (GPM_IS_ALERT (alert), FALSE);
+
+	if (alert->priv->loop_id == 0)
+		return FALSE;
+
+	gpm_timer_remove (alert->priv->timer, alert->priv->loop_id);
+	alert->priv->loop_id = 0;
+	gpm_alert_sound_free (alert->priv->loop);
+	alert->priv->loop = NULL;
+	return TRUE;
+}
+
+/**
+ * gpm_alert_play_loop_start:
+ * @timeout: How often to play it, in seconds
+ *
+ * Plays the sound now and then every @timeout until stopped, replacing
+ * any loop already playing.
+ **/
+void
+gpm_alert_play_loop_start (GpmAlert *alert, const gchar *id, const gchar *desc, guint timeout)
+{
+	g_return_if_fail (GPM_IS_ALERT (alert));
+	g_return_if_fail (id != NULL);
+	g_return_if_fail (timeout > 0);
+
+	/* if a sound loop is already running, stop the existing loop */
+	if (gpm_alert_play_loop_stop (alert))
+		g_warning ("was instructed to play a sound loop with one already playing");
+
+	alert->priv->loop = g_new0 (GpmAlertSound, 1);
+	alert->priv->loop->id = g_strdup (id);
+	alert->priv->loop->desc = g_strdup (desc);
+	alert->priv->loop_id = gpm_timer_add_seconds (alert->priv->timer, timeout, "[GpmAlert] play-loop",
+						      (GSourceFunc) gpm_alert_play_loop_timeout_cb,
+						      alert);
+
+	gpm_alert_play (alert, id, desc);
+}
+
+/**
+ * gpm_alert_class_init:
+ * @klass: This class instance
+ **/
+static void
+gpm_alert_class_init (GpmAlertClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = gpm_alert_finalize;
+}
+
+/**
+ * gpm_alert_init:
+ * @alert: This class instance
+ **/
+static void
+gpm_alert_init (GpmAlert *alert)
+{
+	alert->priv = gpm_alert_get_instance_private (alert);
+
+	/* owned by the screen, and this does not connect to anything yet */
+	alert->priv->context = ca_gtk_context_get_for_screen (gdk_screen_get_default ());
+	alert->priv->timer = gpm_timer_new ();
+	alert->priv->pool = gpm_proxy_pool_new ();
+	alert->priv->cancellable = g_cancellable_new ();
+
+	g_mutex_init (&alert->priv->sounds_lock);
+	alert->priv->sounds_queued = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	alert->priv->sounds = g_async_queue_new_full ((GDestroyNotify) gpm_alert_sound_free);
+	alert->priv->thread = g_thread_new ("gpm-alert", (GThreadFunc) gpm_alert_thread_func, alert);
+}
+
+/**
+ * gpm_alert_finalize:
+ * @object: This class instance
+ **/
+static void
+gpm_alert_finalize (GObject *object)
+{
+	GpmAlert *alert;
+	guint i;
+
+	g_return_if_fail (object != NULL);
+	g_return_if_fail (GPM_IS_ALERT (object));
+
+	alert = GPM_ALERT (object);
+
+	/* anything not played yet is dropped */
+	g_async_queue_push_front (alert->priv->sounds, &gpm_alert_sound_quit);
+	g_thread_join (alert->priv->thread);
+	g_async_queue_unref (alert->priv->sounds);
+	g_hash_table_unref (alert->priv->sounds_queued);
+	g_mutex_clear (&alert->priv->sounds_lock);
+	gpm_alert_play_loop_stop (alert);
+	g_object_unref (alert->priv->timer);
+
+	if (alert->priv->dispatch_id != 0)
+		g_source_remove (alert->priv->dispatch_id);
+	g_cancellable_cancel (alert->priv->cancellable);
+	for (i = 0; i < GPM_ALERT_NOTIFY_LAST; i++) {
+		gpm_alert_message_free (alert->priv->pending[i]);
+		gpm_alert_message_free (alert->priv->showing[i]);
+
+		/* nobody is left to hear the answer */
+		if (alert->priv->ids[i] != 0)
+			g_dbus_proxy_call (alert->priv->proxy, "CloseNotification",
+					   g_variant_new ("(u)", alert->priv->ids[i]),
+					   G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+	}
+	if (alert->priv->proxy != NULL) {
+		g_signal_handlers_disconnect_by_data (alert->priv->proxy, alert);
+		g_object_unref (alert->priv->proxy);
+	}
+	g_object_unref (alert->priv->cancellable);
+	g_object_unref (alert->priv->pool);
+	if (alert->priv->status_icon != NULL)
+		g_object_unref (alert->priv->status_icon);
+
+	G_OBJECT_CLASS (gpm_alert_parent_class)->finalize (object);
+}
+
+/**
+ * gpm_alert_new:
+ * Return value: new GpmAlert instance.
+ **/
+GpmAlert *
+gpm_alert_new (void)
+{
+	if (gpm_alert_object != NULL) {
+		g_object_ref (gpm_alert_object);
+	} else {
+		gpm_alert_object = g_object_new (GPM_TYPE_ALERT, NULL);
+		g_object_add_weak_pointer (gpm_alert_object, &gpm_alert_object);
+	}
+	return GPM_ALERT (gpm_alert_object);
+}
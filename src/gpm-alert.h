@@ -0,0 +1,87 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __GPM_ALERT_H
+#define __GPM_ALERT_H
+
+#include <glib-object.h>
+#include <gtk/gtk.h>
+#include <libnotify/notify.h>
+
+G_BEGIN_DECLS
+
+#define GPM_TYPE_ALERT		(gpm_alert_get_type ())
+#define GPM_ALERT(o)		(G_TYPE_CHECK_INSTANCE_CAST ((o), GPM_TYPE_ALERT, GpmAlert))
+#define GPM_ALERT_CLASS(k)	(G_TYPE_CHECK_CLASS_CAST((k), GPM_TYPE_ALERT, GpmAlertClass))
+#define GPM_IS_ALERT(o)		(G_TYPE_CHECK_INSTANCE_TYPE ((o), GPM_TYPE_ALERT))
+#define GPM_IS_ALERT_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), GPM_TYPE_ALERT))
+#define GPM_ALERT_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), GPM_TYPE_ALERT, GpmAlertClass))
+
+typedef struct GpmAlertPrivate GpmAlertPrivate;
+
+typedef struct
+{
+	GObject		 parent;
+	GpmAlertPrivate	*priv;
+} GpmAlert;
+
+typedef struct
+{
+	GObjectClass	parent_class;
+} GpmAlertClass;
+
+/* each kind replaces the previous notification of the same kind */
+typedef enum {
+	GPM_ALERT_NOTIFY_GENERAL,
+	GPM_ALERT_NOTIFY_WARNING_LOW,
+	GPM_ALERT_NOTIFY_DISCHARGING,
+	GPM_ALERT_NOTIFY_FULLY_CHARGED,
+	GPM_ALERT_NOTIFY_LAST
+} GpmAlertNotify;
+
+GType		 gpm_alert_get_type			(void);
+GpmAlert	*gpm_alert_new				(void);
+
+void		 gpm_alert_set_status_icon		(GpmAlert	*alert,
+							 GtkStatusIcon	*status_icon);
+void		 gpm_alert_connect			(GpmAlert	*alert);
+void		 gpm_alert_notify			(GpmAlert	*alert,
+							 GpmAlertNotify	 kind,
+							 const gchar	*title,
+							 const gchar	*message,
+							 guint		 timeout,
+							 const gchar	*icon,
+							 NotifyUrgency	 urgency);
+void		 gpm_alert_close			(GpmAlert	*alert,
+							 GpmAlertNotify	 kind);
+void		 gpm_alert_close_all			(GpmAlert	*alert);
+void		 gpm_alert_play				(GpmAlert	*alert,
+							 const gchar	*id,
+							 const gchar	*desc);
+void		 gpm_alert_play_loop_start		(GpmAlert	*alert,
+							 const gchar	*id,
+							 const gchar	*desc,
+							 guint		 timeout);
+gboolean	 gpm_alert_play_loop_stop		(GpmAlert	*alert);
+
+G_END_DECLS
+
+#endif /* __GPM_ALERT_H */
@@ -0,0 +1,726 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Turns the ambient light level into a screen brightness. The level comes
+ * from iio-sensor-proxy when it has a light sensor, else straight from the
+ * first IIO illuminance channel in sysfs, which cannot be polled so is
+ * read on a slack timer and only while the brightness is being followed.
+ * Light is judged on a log scale, and the brightness curve is bent towards
+ * what the user picks by hand in a handful of bands of that scale.
+ */
+
+#include "config.h"
+
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "gpm-ambient.h"
+#include "gpm-timer.h"
+
+#define GPM_AMBIENT_SYSFS_LOCATION	"/sys/bus/iio/devices"
+#define GPM_AMBIENT_POLL_INTERVAL	2	/* s */
+#define GPM_AMBIENT_BANDS		5	/* one per decade of lux */
+#define GPM_AMBIENT_HYSTERESIS		0.15	/* decades, smaller changes are sensor noise */
+#define GPM_AMBIENT_MIN_STEP		3	/* %, smaller changes are not worth a fade */
+#define GPM_AMBIENT_MAX_OFFSET		100	/* % */
+
+/* brightness in percent at 1, 10, 100, 1000 and 10000 lux */
+static const gdouble gpm_ambient_curve[GPM_AMBIENT_BANDS] = { 10.0, 25.0, 45.0, 75.0, 100.0 };
+
+struct GpmAmbientPrivate
+{
+	gboolean		 active;
+	GCancellable		*cancellable;
+	/* iio-sensor-proxy */
+	GDBusProxy		*proxy;
+	gboolean		 claimed;
+	/* sysfs */
+	gchar			*path;
+	gint			 fd;
+	gdouble			 scale;
+	gdouble			 offset;
+	GpmTimer		*timer;
+	guint			 poll_id;
+	/* model */
+	gboolean		 has_level;
+	gdouble			 level;		/* log10 (lux + 1) */
+	guint			 percentage;
+	guint			 emitted;	/* or 0 for none */
+	gint			 offsets[GPM_AMBIENT_BANDS];
+};
+
+enum {
+	BRIGHTNESS_CHANGED,
+	LAST_SIGNAL
+};
+
+static guint signals [LAST_SIGNAL] = { 0 };
+
+G_DEFINE_TYPE_WITH_PRIVATE (GpmAmbient, gpm_ambient, G_TYPE_OBJECT)
+
+/**
+ * gpm_ambient_get_band:
+ **/
+static guint
+gpm_ambient_get_band (gdouble level)
+{
+	return (guint) CLAMP (floor (level), 0, GPM_AMBIENT_BANDS - 1);
+}
+
+/**
+ * gpm_ambient_get_curve:
+ *
+ * Return value: the brightness for @level before the user's offsets
+ **/
+static gdouble
+gpm_ambient_get_curve (gdouble level)
+{
+	guint band;
+
+	if (level <= 0.0)
+		return gpm_ambient_curve[0];
+	if (level >= GPM_AMBIENT_BANDS - 1)
+		return gpm_ambient_curve[GPM_AMBIENT_BANDS - 1];
+	band = gpm_ambient_get_band (level);
+	return gpm_ambient_curve[band] +
+	       (level - band) * (gpm_ambient_curve[band + 1] - gpm_ambient_curve[band]);
+}
+
+/**
+ * gpm_ambient_update_percentage:
+ **/
+static void
+gpm_ambient_update_percentage (GpmAmbient *ambient)
+{
+	gdouble value;
+
+	value = gpm_ambient_get_curve (ambient->priv->level) +
+		ambient->priv->offsets[gpm_ambient_get_band (ambient->priv->level)];
+	ambient->priv->percentage = (guint) CLAMP (value + 0.5, 1, 100);
+}
+
+/**
+ * gpm_ambient_add_lux:
+ * @lux: The ambient light level
+ *
+ * Emits ::brightness-changed if the light changed enough to need a new
+ * brightness.
+ **/
+static void
+gpm_ambient_add_lux (GpmAmbient *ambient, gdouble lux)
+{
+	gdouble level;
+
+	level = log10 (MAX (lux, 0.0) + 1.0);
+	if (ambient->priv->has_level &&
+	    fabs (level - ambient->priv->level) < GPM_AMBIENT_HYSTERESIS)
+		return;
+	ambient->priv->has_level = TRUE;
+	ambient->priv->level = level;
+	gpm_ambient_update_percentage (ambient);
+
+	if (ambient->priv->emitted != 0 &&
+	    ABS ((gint) ambient->priv->percentage - (gint) ambient->priv->emitted) < GPM_AMBIENT_MIN_STEP)
+		return;
+	g_debug ("ambient light %.1f lux, brightness now %u%%", lux, ambient->priv->percentage);
+	ambient->priv->emitted = ambient->priv->percentage;
+	g_signal_emit (ambient, signals [BRIGHTNESS_CHANGED], 0, ambient->priv->percentage);
+}
+
+/**
+ * gpm_ambient_sysfs_read:
+ *
+ * Reads the sensor through the descriptor kept open for it, as sysfs
+ * hands back the current value on every read from the start of the file.
+ **/
+static gboolean
+gpm_ambient_sysfs_read (GpmAmbient *ambient)
+{
+	gchar buffer[32];
+	gchar *endptr = NULL;
+	gdouble value;
+	gssize len;
+
+	len = pread (ambient->priv->fd, buffer, sizeof (buffer) - 1, 0);
+	if (len <= 0) {
+		g_debug ("failed to read %s: %s", ambient->priv->path,
+			 len < 0 ? g_strerror (errno) : "empty");
+		return FALSE;
+	}
+	buffer[len] = '\0';
+	value = g_ascii_strtod (buffer, &endptr);
+	if (endptr == buffer) {
+		g_debug ("invalid ambient light value '%s'", buffer);
+		return FALSE;
+	}
+	gpm_ambient_add_lux (ambient, (value + ambient->priv->offset) * ambient->priv->scale);
+	return TRUE;
+}
+
+/**
+ * gpm_ambient_sysfs_poll_cb:
+ **/
+static gboolean
+gpm_ambient_sysfs_poll_cb (GpmAmbient *ambient)
+{
+	gpm_ambient_sysfs_read (ambient);
+	return TRUE;
+}
+
+/**
+ * gpm_ambient_sysfs_get_double:
+ **/
+static gdouble
+gpm_ambient_sysfs_get_double (const gchar *dirname, const gchar *filename, gdouble fallback)
+{
+	gchar *path;
+	gchar *contents = NULL;
+	gdouble value = fallback;
+
+	path = g_build_filename (dirname, filename, NULL);
+	if (g_file_get_contents (path, &contents, NULL, NULL))
+		value = g_ascii_strtod (contents, NULL);
+	g_free (contents);
+	g_free (path);
+	return value;
+}
+
+/**
+ * gpm_ambient_sysfs_open:
+ * @path: An in_illuminance_input or in_illuminance_raw sysfs file
+ **/
+static gboolean
+gpm_ambient_sysfs_open (GpmAmbient *ambient, const gchar *path)
+{
+	gchar *dirname;
+
+	ambient->priv->fd = g_open (path, O_RDONLY | O_CLOEXEC, 0);
+	if (ambient->priv->fd < 0) {
+		g_debug ("failed to open %s: %s", path, g_strerror (errno));
+		return FALSE;
+	}
+	ambient->priv->path = g_strdup (path);
+
+	/* raw values need scaling to lux, which never changes for a channel */
+	if (g_str_has_suffix (path, "_raw")) {
+		dirname = g_path_get_dirname (path);
+		ambient->priv->scale = gpm_ambient_sysfs_get_double (dirname, "in_illuminance_scale", 1.0);
+		ambient->priv->offset = gpm_ambient_sysfs_get_double (dirname, "in_illuminance_offset", 0.0);
+		g_free (dirname);
+	}
+	g_debug ("using ambient light sensor %s", path);
+	return TRUE;
+}
+
+/**
+ * gpm_ambient_sysfs_find:
+ *
+ * Return value: the first IIO illuminance channel, or %NULL
+ **/
+static gchar *
+gpm_ambient_sysfs_find (void)
+{
+	GDir *dir;
+	const gchar *name;
+	gchar *path = NULL;
+	guint i;
+	const gchar *channels[] = { "in_illuminance_input", "in_illuminance_raw", NULL };
+
+	dir = g_dir_open (GPM_AMBIENT_SYSFS_LOCATION, 0, NULL);
+	if (dir == NULL)
+		return NULL;
+	while (path == NULL && (name = g_dir_read_name (dir)) != NULL) {
+		for (i=0; channels[i] != NULL; i++) {
+			path = g_build_filename (GPM_AMBIENT_SYSFS_LOCATION, name, channels[i], NULL);
+			if (g_file_test (path, G_FILE_TEST_EXISTS))
+				break;
+			g_free (path);
+			path = NULL;
+		}
+	}
+	g_dir_close (dir);
+	return path;
+}
+
+/**
+ * gpm_ambient_update_source:
+ *
+ * Claims the sensor or polls it, but only while brightness follows it.
+ **/
+static void
+gpm_ambient_update_source (GpmAmbient *ambient)
+{
+	GpmAmbientPrivate *priv = ambient->priv;
+
+	if (priv->proxy != NULL && priv->active != priv->claimed) {
+		priv->claimed = priv->active;
+		g_dbus_proxy_call (priv->proxy, priv->active ? "ClaimLight" : "ReleaseLight",
+				   NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+	}
+
+	if (priv->fd >= 0 && priv->active && priv->poll_id == 0) {
+		gpm_ambient_sysfs_read (ambient);
+		priv->poll_id = gpm_timer_add_seconds (priv->timer, GPM_AMBIENT_POLL_INTERVAL, "[GpmAmbient] poll",
+						       (GSourceFunc) gpm_ambient_sysfs_poll_cb, ambient);
+	} else if (!priv->active && priv->poll_id != 0) {
+		gpm_timer_remove (priv->timer, priv->poll_id);
+		priv->poll_id = 0;
+	}
+}
+
+/**
+ * gpm_ambient_proxy_read:
+ **/
+static void
+gpm_ambient_proxy_read (GpmAmbient *ambient)
+{
+	GVariant *variant;
+
+	variant = g_dbus_proxy_get_cached_property (ambient->priv->proxy, "LightLevel");
+	if (variant == NULL)
+		return;
+	gpm_ambient_add_lux (ambient, g_variant_get_double (variant));
+	g_variant_unref (variant);
+}
+
+/**
+ * gpm_ambient_proxy_properties_changed_cb:
+ **/
+static void
+gpm_ambient_proxy_properties_changed_cb (GDBusProxy *proxy, GVariant *changed,
+					 GStrv invalidated, GpmAmbient *ambient)
+{
+	GVariant *variant;
+
+	if (!ambient->priv->claimed)
+		return;
+	variant = g_variant_lookup_value (changed, "LightLevel", NULL);
+	if (variant == NULL)
+		return;
+	g_variant_unref (variant);
+	gpm_ambient_proxy_read (ambient);
+}
+
+/**
+ * gpm_ambient_use_sysfs:
+ **/
+static void
+gpm_ambient_use_sysfs (GpmAmbient *ambient)
+{
+	gchar *path;
+
+	path = gpm_ambient_sysfs_find ();
+	if (path == NULL) {
+		g_debug ("no ambient light sensor");
+		return;
+	}
+	if (gpm_ambient_sysfs_open (ambient, path))
+		gpm_ambient_update_source (ambient);
+	g_free (path);
+}
+
+/**
+ * gpm_ambient_proxy_cb:
+ **/
+static void
+gpm_ambient_proxy_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GpmAmbient *ambient;
+	GDBusProxy *proxy;
+	GVariant *variant;
+	gchar *owner;
+	gboolean has_light = FALSE;
+	GError *error = NULL;
+
+	proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
+	if (proxy == NULL) {
+		if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			g_error_free (error);
+			return;
+		}
+		g_debug ("no iio-sensor-proxy: %s", error->message);
+		g_error_free (error);
+		gpm_ambient_use_sysfs (GPM_AMBIENT (user_data));
+		return;
+	}
+	ambient = GPM_AMBIENT (user_data);
+
+	/* not activatable, so only useful when it is already running */
+	owner = g_dbus_proxy_get_name_owner (proxy);
+	variant = g_dbus_proxy_get_cached_property (proxy, "HasAmbientLight");
+	if (variant != NULL) {
+		has_light = g_variant_get_boolean (variant);
+		g_variant_unref (variant);
+	}
+	if (owner == NULL || !has_light) {
+		g_debug ("iio-sensor-proxy has no ambient light sensor");
+		g_object_unref (proxy);
+		g_free (owner);
+		gpm_ambient_use_sysfs (ambient);
+		return;
+	}
+	g_free (owner);
+
+	g_debug ("using iio-sensor-proxy for ambient light");
+	ambient->priv->proxy = proxy;
+	g_signal_connect (proxy, "g-properties-changed",
+			  G_CALLBACK (gpm_ambient_proxy_properties_changed_cb), ambient);
+	gpm_ambient_update_source (ambient);
+}
+
+/**
+ * gpm_ambient_set_active:
+ * @active: If the brightness should follow the ambient light
+ *
+ * The sensor is only read while active, so it can power down otherwise.
+ **/
+void
+gpm_ambient_set_active (GpmAmbient *ambient, gboolean active)
+{
+	g_return_if_fail (GPM_IS_AMBIENT (ambient));
+
+	if (ambient->priv->active == active)
+		return;
+	ambient->priv->active = active;
+
+	/* a stale level would snap the brightness back when reactivated */
+	ambient->priv->has_level = FALSE;
+	ambient->priv->emitted = 0;
+	gpm_ambient_update_source (ambient);
+}
+
+/**
+ * gpm_ambient_get_brightness:
+ * @percentage: Return location for the brightness for the current light
+ *
+ * Return value: %TRUE if there is a sensor reading to follow
+ **/
+gboolean
+gpm_ambient_get_brightness (GpmAmbient *ambient, guint *percentage)
+{
+	g_return_val_if_fail (GPM_IS_AMBIENT (ambient), FALSE);
+	g_return_val_if_fail (percentage != NULL, FALSE);
+
+	if (!ambient->priv->active || !ambient->priv->has_level)
+		return FALSE;
+	*percentage = ambient->priv->percentage;
+	return TRUE;
+}
+
+/**
+ * gpm_ambient_learn:
+ * @percentage: The brightness the user picked in the current light
+ *
+ * Bends the curve to go through @percentage here, and half as far in the
+ * neighbouring bands so the brightness does not jump when crossing them.
+ **/
+void
+gpm_ambient_learn (GpmAmbient *ambient, guint percentage)
+{
+	gint delta;
+	guint band;
+	guint i;
+
+	g_return_if_fail (GPM_IS_AMBIENT (ambient));
+
+	if (!ambient->priv->active || !ambient->priv->has_level)
+		return;
+
+	band = gpm_ambient_get_band (ambient->priv->level);
+	delta = (gint) percentage - (gint) ambient->priv->percentage;
+	for (i=0; i<GPM_AMBIENT_BANDS; i++) {
+		if (i == band)
+			ambient->priv->offsets[i] += delta;
+		else if (i + 1 == band || i == band + 1)
+			ambient->priv->offsets[i] += delta / 2;
+		ambient->priv->offsets[i] = CLAMP (ambient->priv->offsets[i],
+						   -GPM_AMBIENT_MAX_OFFSET, GPM_AMBIENT_MAX_OFFSET);
+	}
+	gpm_ambient_update_percentage (ambient);
+	ambient->priv->emitted = ambient->priv->percentage;
+	g_debug ("learned %u%% at ambient band %u", percentage, band);
+}
+
+/**
+ * gpm_ambient_to_variant:
+ *
+ * Return value: the learned offsets, suitable for saving in GSettings
+ **/
+GVariant *
+gpm_ambient_to_variant (GpmAmbient *ambient)
+{
+	GVariantBuilder builder;
+	guint i;
+
+	g_return_val_if_fail (GPM_IS_AMBIENT (ambient), NULL);
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("an"));
+	for (i=0; i<GPM_AMBIENT_BANDS; i++)
+		g_variant_builder_add (&builder, "n", (gint16) ambient->priv->offsets[i]);
+	return g_variant_builder_end (&builder);
+}
+
+/**
+ * gpm_ambient_from_variant:
+ *
+ * Return value: %TRUE if @variant was saved by gpm_ambient_to_variant()
+ **/
+gboolean
+gpm_ambient_from_variant (GpmAmbient *ambient, GVariant *variant)
+{
+	const gint16 *values;
+	gsize len;
+	guint i;
+
+	g_return_val_if_fail (GPM_IS_AMBIENT (ambient), FALSE);
+	g_return_val_if_fail (variant != NULL, FALSE);
+
+	if (!g_variant_is_of_type (variant, G_VARIANT_TYPE ("an")))
+		return FALSE;
+	values = g_variant_get_fixed_array (variant, &len, sizeof (gint16));
+	if (len != GPM_AMBIENT_BANDS) {
+		g_debug ("ignoring %" G_GSIZE_FORMAT " ambient offsets", len);
+		return FALSE;
+	}
+	for (i=0; i<GPM_AMBIENT_BANDS; i++)
+		ambient->priv->offsets[i] = CLAMP (values[i], -GPM_AMBIENT_MAX_OFFSET, GPM_AMBIENT_MAX_OFFSET);
+	if (ambient->priv->has_level)
+		gpm_ambient_update_percentage (ambient);
+	return TRUE;
+}
+
+/**
+ * gpm_ambient_finalize:
+ **/
+static void
+gpm_ambient_finalize (GObject *object)
+{
+	GpmAmbient *ambient;
+
+	g_return_if_fail (object != NULL);
+	g_return_if_fail (GPM_IS_AMBIENT (object));
+	ambient = GPM_AMBIENT (object);
+
+	g_cancellable_cancel (ambient->priv->cancellable);
+	g_object_unref (ambient->priv->cancellable);
+	if (ambient->priv->proxy != NULL) {
+		g_signal_handlers_disconnect_by_data (ambient->priv->proxy, ambient);
+		if (ambient->priv->claimed)
+			g_dbus_proxy_call (ambient->priv->proxy, "ReleaseLight", NULL,
+					   G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+		g_object_unref (ambient->priv->proxy);
+	}
+	if (ambient->priv->poll_id != 0)
+		gpm_timer_remove (ambient->priv->timer, ambient->priv->poll_id);
+	g_object_unref (ambient->priv->timer);
+	if (ambient->priv->fd >= 0)
+		close (ambient->priv->fd);
+	g_free (ambient->priv->path);
+
+	G_OBJECT_CLASS (gpm_ambient_parent_class)->finalize (object);
+}
+
+/**
+ * gpm_ambient_class_init:
+ * @klass: This class instance
+ **/
+static void
+gpm_ambient_class_init (GpmAmbientClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = gpm_ambient_finalize;
+
+	signals [BRIGHTNESS_CHANGED] =
+		g_signal_new ("brightness-changed",
+			      G_TYPE_FROM_CLASS (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (GpmAmbientClass, brightness_changed),
+			      NULL, NULL, g_cclosure_marshal_VOID__UINT,
+			      G_TYPE_NONE, 1, G_TYPE_UINT);
+}
+
+/**
+ * gpm_ambient_init:
+ **/
+static void
+gpm_ambient_init (GpmAmbient *ambient)
+{
+	ambient->priv = gpm_ambient_get_instance_private (ambient);
+	ambient->priv->fd = -1;
+	ambient->priv->scale = 1.0;
+	ambient->priv->offset = 0.0;
+	ambient->priv->cancellable = g_cancellable_new ();
+	ambient->priv->timer = gpm_timer_new ();
+}
+
+/**
+ * gpm_ambient_new:
+ * Return value: A new GpmAmbient instance, which finds its own sensor.
+ **/
+GpmAmbient *
+gpm_ambient_new (void)
+{
+	GpmAmbient *ambient;
+
+	ambient = g_object_new (GPM_TYPE_AMBIENT, NULL);
+	g_dbus_proxy_new_for_bus (G_BUS_TYPE_SYSTEM,
+				  G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START,
+				  NULL,
+				  "net.hadess.SensorProxy",
+				  "/net/hadess/SensorProxy",
+				  "net.hadess.SensorProxy",
+				  ambient->priv->cancellable,
+				  gpm_ambient_proxy_cb,
+				  ambient);
+	return ambient;
+}
+
+/**
+ * gpm_ambient_new_for_path:
+ * @path: An IIO illuminance sysfs file
+ * Return value: A new GpmAmbient instance reading @path.
+ **/
+GpmAmbient *
+gpm_ambient_new_for_path (const gchar *path)
+{
+	GpmAmbient *ambient;
+
+	ambient = g_object_new (GPM_TYPE_AMBIENT, NULL);
+	gpm_ambient_sysfs_open (ambient, path);
+	return ambient;
+}
+
+/***************************************************************************
+ ***                          MAKE CHECK TESTS                           ***
+ ***************************************************************************/
+#ifdef EGG_TEST
+#include <string.h>
+#include "egg-test.h"
+
+/* in place, like sysfs, as the sensor file is kept open */
+static void
+gpm_ambient_test_write (const gchar *path, const gchar *value)
+{
+	gint fd;
+
+	fd = g_open (path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return;
+	if (write (fd, value, strlen (value)) < 0)
+		g_warning ("failed to write %s", path);
+	close (fd);
+}
+
+void
+gpm_ambient_test (gpointer data)
+{
+	GpmAmbient *ambient;
+	GpmAmbient *ambient_copy;
+	GVariant *variant;
+	EggTest *test = (EggTest *) data;
+	gchar *dirname;
+	gchar *path;
+	guint percentage = 0;
+	gboolean ret;
+
+	if (!egg_test_start (test, "GpmAmbient"))
+		return;
+
+	dirname = g_dir_make_tmp ("gpm-ambient-XXXXXX", NULL);
+	path = g_build_filename (dirname, "in_illuminance_input", NULL);
+	gpm_ambient_test_write (path, "0\n");
+
+	/************************************************************/
+	egg_test_title (test, "get object");
+	ambient = gpm_ambient_new_for_path (path);
+	egg_test_assert (test, (ambient != NULL && ambient->priv->fd >= 0));
+
+	/************************************************************/
+	egg_test_title (test, "check there is no brightness until active");
+	egg_test_assert (test, !gpm_ambient_get_brightness (ambient, &percentage));
+
+	/************************************************************/
+	egg_test_title (test, "check darkness gives the lowest brightness");
+	gpm_ambient_set_active (ambient, TRUE);
+	ret = gpm_ambient_get_brightness (ambient, &percentage);
+	egg_test_assert (test, (ret && percentage == 10));
+
+	/************************************************************/
+	egg_test_title (test, "check the sensor is read again in place");
+	gpm_ambient_test_write (path, "9\n");
+	gpm_ambient_sysfs_read (ambient);
+	gpm_ambient_get_brightness (ambient, &percentage);
+	egg_test_assert (test, (percentage == 25));
+
+	/************************************************************/
+	egg_test_title (test, "check small changes in light are ignored");
+	gpm_ambient_test_write (path, "10\n");
+	gpm_ambient_sysfs_read (ambient);
+	gpm_ambient_get_brightness (ambient, &percentage);
+	egg_test_assert (test, (percentage == 25));
+
+	/************************************************************/
+	egg_test_title (test, "check the user's brightness is learned");
+	gpm_ambient_learn (ambient, 40);
+	gpm_ambient_get_brightness (ambient, &percentage);
+	egg_test_assert (test, (percentage == 40));
+
+	/************************************************************/
+	egg_test_title (test, "check the neighbouring band is nudged");
+	gpm_ambient_test_write (path, "99\n");
+	gpm_ambient_sysfs_read (ambient);
+	gpm_ambient_get_brightness (ambient, &percentage);
+	egg_test_assert (test, (percentage == 52));
+
+	/************************************************************/
+	egg_test_title (test, "check the offsets can be saved and loaded");
+	variant = g_variant_ref_sink (gpm_ambient_to_variant (ambient));
+	ambient_copy = gpm_ambient_new_for_path (path);
+	ret = gpm_ambient_from_variant (ambient_copy, variant);
+	g_variant_unref (variant);
+	gpm_ambient_set_active (ambient_copy, TRUE);
+	gpm_ambient_get_brightness (ambient_copy, &percentage);
+	egg_test_assert (test, (ret && percentage == 52));
+	g_object_unref (ambient_copy);
+
+	/************************************************************/
+	egg_test_title (test, "check unknown offsets are not loaded");
+	variant = g_variant_ref_sink (g_variant_new_fixed_array (G_VARIANT_TYPE_INT16, NULL, 0, sizeof (gint16)));
+	ret = gpm_ambient_from_variant (ambient, variant);
+	g_variant_unref (variant);
+	egg_test_assert (test, !ret);
+
+	g_object_unref (ambient);
+	g_unlink (path);
+	g_rmdir (dirname);
+	g_free (path);
+	g_free (dirname);
+
+	egg_test_end (test);
+}
+
+#endif
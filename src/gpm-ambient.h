@@ -0,0 +1,68 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __GPM_AMBIENT_H
+#define __GPM_AMBIENT_H
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define GPM_TYPE_AMBIENT		(gpm_ambient_get_type ())
+#define GPM_AMBIENT(o)			(G_TYPE_CHECK_INSTANCE_CAST ((o), GPM_TYPE_AMBIENT, GpmAmbient))
+#define GPM_AMBIENT_CLASS(k)		(G_TYPE_CHECK_CLASS_CAST((k), GPM_TYPE_AMBIENT, GpmAmbientClass))
+#define GPM_IS_AMBIENT(o)		(G_TYPE_CHECK_INSTANCE_TYPE ((o), GPM_TYPE_AMBIENT))
+#define GPM_IS_AMBIENT_CLASS(k)		(G_TYPE_CHECK_CLASS_TYPE ((k), GPM_TYPE_AMBIENT))
+#define GPM_AMBIENT_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), GPM_TYPE_AMBIENT, GpmAmbientClass))
+
+typedef struct GpmAmbientPrivate GpmAmbientPrivate;
+
+typedef struct
+{
+	GObject			 parent;
+	GpmAmbientPrivate	*priv;
+} GpmAmbient;
+
+typedef struct
+{
+	GObjectClass	parent_class;
+	void		(* brightness_changed)		(GpmAmbient	*ambient,
+							 guint		 percentage);
+} GpmAmbientClass;
+
+GType		 gpm_ambient_get_type			(void);
+GpmAmbient	*gpm_ambient_new			(void);
+GpmAmbient	*gpm_ambient_new_for_path		(const gchar	*path);
+void		 gpm_ambient_test			(gpointer	 data);
+
+void		 gpm_ambient_set_active			(GpmAmbient	*ambient,
+							 gboolean	 active);
+gboolean	 gpm_ambient_get_brightness		(GpmAmbient	*ambient,
+							 guint		*percentage);
+void		 gpm_ambient_learn			(GpmAmbient	*ambient,
+							 guint		 percentage);
+GVariant	*gpm_ambient_to_variant			(GpmAmbient	*ambient);
+gboolean	 gpm_ambient_from_variant		(GpmAmbient	*ambient,
+							 GVariant	*variant);
+
+G_END_DECLS
+
+#endif /* __GPM_AMBIENT_H */
@@ -42,33 +42,48 @@
 #include <gtk/gtk.h>
 #include <libupower-glib/upower.h>
 
+#include "gpm-ambient.h"
 #include "gpm-button.h"
 #include "gpm-backlight.h"
 #include "gpm-brightness.h"
 #include "gpm-control.h"
 #include "gpm-common.h"
 #include "gsd-media-keys-window.h"
+#include "gpm-display.h"
 #include "gpm-dpms.h"
+#include "gpm-dim-model.h"
 #include "gpm-idle.h"
 #include "gpm-marshal.h"
+#include "gpm-policy.h"
+#include "gpm-timer.h"
 #include "gpm-icon-names.h"
 #include "egg-console-kit.h"
 
+/* what the dim model learned is written out lazily, it changes a little
+ * every time the user comes back */
+#define GPM_BACKLIGHT_DIM_MODEL_SAVE_DELAY	600	/* s */
+#define GPM_BACKLIGHT_DIM_MODEL_SAVE_SLACK	300	/* s */
+
 struct GpmBacklightPrivate
 {
 	UpClient		*client;
 	GpmBrightness		*brightness;
 	GpmButton		*button;
 	GSettings		*settings;
+	GpmPolicy		*policy;
 	GtkWidget		*popup;
 	GpmControl		*control;
-	GpmDpms			*dpms;
+	GpmDisplay		*display;
 	GpmIdle			*idle;
+	GpmTimer		*timer;
+	GpmDimModel		*dim_model;
+	GpmAmbient		*ambient;
 	EggConsoleKit		*console;
 	gboolean		 can_dim;
 	gboolean		 system_is_idle;
-	GTimer			*idle_timer;
+	gboolean		 is_blanked;
 	guint			 idle_dim_timeout;
+	guint			 dim_model_save_id;
 	guint			 master_percentage;
 };
 
@@ -126,6 +141,22 @@ gpm_backlight_get_brightness (GpmBacklight *backlight, guint *brightness, GError
 	return ret;
 }
 
+/**
+ * gpm_backlight_ambient_learn:
+ * @percentage: The brightness the user picked
+ *
+ * Teaches the ambient light curve, and keeps it for next time.
+ **/
+static void
+gpm_backlight_ambient_learn (GpmBacklight *backlight, guint percentage)
+{
+	if (!gpm_policy_get (backlight->priv->policy)->ambient_enable)
+		return;
+	gpm_ambient_learn (backlight->priv->ambient, percentage);
+	g_settings_set_value (backlight->priv->settings, GPM_SETTINGS_AMBIENT_OFFSETS,
+			      gpm_ambient_to_variant (backlight->priv->ambient));
+}
+
 /**
  * gpm_backlight_set_brightness:
  **/
@@ -148,6 +179,7 @@ gpm_backlight_set_brightness (GpmBacklight *backlight, guint percentage, GError
 
 	/* just set the master percentage for now, don't try to be clever */
 	backlight->priv->master_percentage = percentage;
+	gpm_backlight_ambient_learn (backlight, percentage);
 
 	/* sets the current policy brightness */
 	ret = gpm_brightness_set (backlight->priv->brightness, percentage, &hw_changed);
@@ -255,35 +287,42 @@ gpm_backlight_dialog_show (GpmBacklight *backlight)
 }
 
 /**
- * gpm_backlight_brightness_evaluate_and_set:
+ * gpm_backlight_brightness_evaluate:
+ * @percentage: Return location for the brightness the policy wants
+ *
+ * Return value: %FALSE if the brightness should not be touched
  **/
 static gboolean
-gpm_backlight_brightness_evaluate_and_set (GpmBacklight *backlight, gboolean interactive, gboolean use_initial)
+gpm_backlight_brightness_evaluate (GpmBacklight *backlight, gboolean use_initial, guint *percentage)
 {
+	const GpmPolicySnapshot *policy = gpm_policy_get (backlight->priv->policy);
 	gfloat brightness;
 	gfloat scale;
-	gboolean ret;
 	gboolean on_battery;
 	gboolean do_laptop_lcd;
 	gboolean enable_action;
 	gboolean battery_reduce;
-	gboolean hw_changed;
 	guint value;
-	guint old_value;
 
 	if (backlight->priv->can_dim == FALSE) {
 		g_debug ("no dimming hardware");
 		return FALSE;
 	}
 
-	do_laptop_lcd = g_settings_get_boolean (backlight->priv->settings, GPM_SETTINGS_BACKLIGHT_ENABLE);
+	do_laptop_lcd = policy->backlight_enable;
 	if (do_laptop_lcd == FALSE) {
 		g_warning ("policy is no dimming");
 		return FALSE;
 	}
 
-	/* get the last set brightness */
+	/* get the last set brightness, or what suits the ambient light */
 	brightness = backlight->priv->master_percentage / 100.0f;
+	if (policy->ambient_enable &&
+	    gpm_ambient_get_brightness (backlight->priv->ambient, &value)) {
+		brightness = value / 100.0f;
+		/* the learned curve already has what the user wants on battery */
+		use_initial = FALSE;
+	}
 	g_debug ("1. main brightness %f", brightness);
 
 	/* get battery status */
@@ -294,9 +333,9 @@ gpm_backlight_brightness_evaluate_and_set (GpmBacklight *backlight, gboolean int
 	/* reduce if on battery power if we should */
 	if (use_initial) {
 		g_debug ("Setting initial brightness level");
-		battery_reduce = g_settings_get_boolean (backlight->priv->settings, GPM_SETTINGS_BACKLIGHT_BATTERY_REDUCE);
+		battery_reduce = policy->backlight_battery_reduce;
 		if (on_battery && battery_reduce) {
-			value = g_settings_get_int (backlight->priv->settings, GPM_SETTINGS_BRIGHTNESS_DIM_BATT);
+			value = policy->brightness_dim_battery;
 			if (value > 100) {
 				g_warning ("cannot use battery brightness value %u, correcting to 50", value);
 				value = 50;
@@ -311,11 +350,11 @@ gpm_backlight_brightness_evaluate_and_set (GpmBacklight *backlight, gboolean int
 
 	/* reduce if system is momentarily idle */
 	if (!on_battery)
-		enable_action = g_settings_get_boolean (backlight->priv->settings, GPM_SETTINGS_IDLE_DIM_AC);
+		enable_action = policy->idle_dim_ac;
 	else
-		enable_action = g_settings_get_boolean (backlight->priv->settings, GPM_SETTINGS_IDLE_DIM_BATT);
+		enable_action = policy->idle_dim_battery;
 	if (enable_action && backlight->priv->system_is_idle) {
-		value = g_settings_get_int (backlight->priv->settings, GPM_SETTINGS_IDLE_BRIGHTNESS);
+		value = policy->idle_brightness;
 		if (value > 100) {
 			g_warning ("cannot use idle brightness value %u, correcting to 50", value);
 			value = 50;
@@ -328,7 +367,21 @@ gpm_backlight_brightness_evaluate_and_set (GpmBacklight *backlight, gboolean int
 	g_debug ("3. idle scale %f, brightness %f", scale, brightness);
 
 	/* convert to percentage */
-	value = (guint) ((brightness * 100.0f) + 0.5);
+	*percentage = (guint) ((brightness * 100.0f) + 0.5);
+	return TRUE;
+}
+
+/**
+ * gpm_backlight_brightness_apply:
+ *
+ * Return value: %TRUE if the brightness had to be changed
+ **/
+static gboolean
+gpm_backlight_brightness_apply (GpmBacklight *backlight, guint value)
+{
+	gboolean ret;
+	gboolean hw_changed;
+	guint old_value;
 
 	/* only do stuff if the brightness is different */
 	gpm_brightness_get (backlight->priv->brightness, &old_value);
@@ -337,14 +390,6 @@ gpm_backlight_brightness_evaluate_and_set (GpmBacklight *backlight, gboolean int
 		return FALSE;
 	}
 
-	/* only show dialog if interactive */
-	if (interactive) {
-		gpm_backlight_dialog_init (backlight);
-		msd_media_keys_window_set_volume_level (MSD_MEDIA_KEYS_WINDOW (backlight->priv->popup),
-							round (brightness));
-		gpm_backlight_dialog_show (backlight);
-	}
-
 	ret = gpm_brightness_set (backlight->priv->brightness, value, &hw_changed);
 	/* we emit a signal for the brightness applet */
 	if (ret && hw_changed) {
@@ -355,12 +400,137 @@ gpm_backlight_brightness_evaluate_and_set (GpmBacklight *backlight, gboolean int
 }
 
 /**
- * gpm_settings_key_changed_cb:
+ * gpm_backlight_display_panel_cb:
+ *
+ * Called by the display coordinator when a transition is applied. This
+ * is on the way to the screen changing, so the value is set without
+ * reading the hardware first; GpmBrightness skips it if its cache says
+ * it is already set.
+ **/
+static void
+gpm_backlight_display_panel_cb (guint percentage, gpointer user_data)
+{
+	GpmBacklight *backlight = GPM_BACKLIGHT (user_data);
+	gboolean hw_changed = FALSE;
+
+	if (!gpm_brightness_set (backlight->priv->brightness, percentage, &hw_changed))
+		return;
+	if (hw_changed) {
+		g_debug ("emitting brightness-changed : %u", percentage);
+		g_signal_emit (backlight, signals [BRIGHTNESS_CHANGED], 0, percentage);
+	}
+}
+
+/**
+ * gpm_backlight_brightness_queue:
+ *
+ * Asks for the policy brightness in the next display transition.
+ **/
+static void
+gpm_backlight_brightness_queue (GpmBacklight *backlight)
+{
+	guint value;
+
+	if (gpm_backlight_brightness_evaluate (backlight, TRUE, &value))
+		gpm_display_set_brightness (backlight->priv->display, value);
+}
+
+/**
+ * gpm_backlight_brightness_evaluate_and_set:
+ **/
+static gboolean
+gpm_backlight_brightness_evaluate_and_set (GpmBacklight *backlight, gboolean interactive, gboolean use_initial)
+{
+	guint value;
+
+	if (!gpm_backlight_brightness_evaluate (backlight, use_initial, &value))
+		return FALSE;
+	if (!gpm_backlight_brightness_apply (backlight, value))
+		return FALSE;
+
+	/* only show dialog if interactive */
+	if (interactive) {
+		gpm_backlight_dialog_init (backlight);
+		msd_media_keys_window_set_volume_level (MSD_MEDIA_KEYS_WINDOW (backlight->priv->popup),
+							value);
+		gpm_backlight_dialog_show (backlight);
+	}
+	return TRUE;
+}
+
+/**
+ * gpm_backlight_get_hour:
+ * @ago: How far back, in seconds
+ **/
+static guint
+gpm_backlight_get_hour (guint ago)
+{
+	GDateTime *now;
+	GDateTime *then;
+	guint hour;
+
+	now = g_date_time_new_now_local ();
+	then = g_date_time_add_seconds (now, -(gdouble) ago);
+	hour = g_date_time_get_hour (then);
+	g_date_time_unref (then);
+	g_date_time_unref (now);
+	return hour;
+}
+
+/**
+ * gpm_backlight_sync_idle_dim:
+ *
+ * Sets the idle dim timeout the model picks for the power source and the
+ * time of day.
+ **/
+static void
+gpm_backlight_sync_idle_dim (GpmBacklight *backlight)
+{
+	gboolean on_battery;
+	guint timeout;
+
+	g_object_get (backlight->priv->client,
+		      "on-battery", &on_battery,
+		      NULL);
+	timeout = gpm_dim_model_get_timeout (backlight->priv->dim_model, on_battery,
+					     gpm_backlight_get_hour (0));
+	if (timeout == backlight->priv->idle_dim_timeout)
+		return;
+	g_debug ("idle dim time now %us", timeout);
+	backlight->priv->idle_dim_timeout = timeout;
+	gpm_idle_set_timeout_dim (backlight->priv->idle, timeout);
+}
+
+/**
+ * gpm_backlight_sync_ambient:
+ *
+ * Only reads the light sensor while the brightness follows it.
+ **/
+static void
+gpm_backlight_sync_ambient (GpmBacklight *backlight)
+{
+	gpm_ambient_set_active (backlight->priv->ambient,
+				backlight->priv->can_dim &&
+				gpm_policy_get (backlight->priv->policy)->ambient_enable &&
+				!backlight->priv->is_blanked);
+}
+
+/**
+ * gpm_backlight_ambient_changed_cb:
+ **/
+static void
+gpm_backlight_ambient_changed_cb (GpmAmbient *ambient, guint percentage, GpmBacklight *backlight)
+{
+	gpm_backlight_brightness_evaluate_and_set (backlight, FALSE, TRUE);
+}
+
+/**
+ * gpm_backlight_policy_changed_cb:
  *
  * We might have to do things when the keys change; do them here.
  **/
 static void
-gpm_settings_key_changed_cb (GSettings *settings, const gchar *key, GpmBacklight *backlight)
+gpm_backlight_policy_changed_cb (GpmPolicy *policy, const gchar *key, GpmBacklight *backlight)
 {
 	gboolean on_battery;
 
@@ -370,7 +540,7 @@ gpm_settings_key_changed_cb (GSettings *settings, const gchar *key, GpmBacklight
 		      NULL);
 
 	if (g_strcmp0 (key, GPM_SETTINGS_BRIGHTNESS_AC) == 0) {
-		backlight->priv->master_percentage = g_settings_get_double (settings, key);
+		backlight->priv->master_percentage = gpm_policy_get (policy)->brightness_ac;
 		gpm_backlight_brightness_evaluate_and_set (backlight, FALSE, TRUE);
 
 	} else if (on_battery && g_strcmp0 (key, GPM_SETTINGS_BRIGHTNESS_DIM_BATT) == 0) {
@@ -384,8 +554,16 @@ gpm_settings_key_changed_cb (GSettings *settings, const gchar *key, GpmBacklight
 		gpm_backlight_brightness_evaluate_and_set (backlight, FALSE, TRUE);
 
 	} else if (g_strcmp0 (key, GPM_SETTINGS_IDLE_DIM_TIME) == 0) {
-		backlight->priv->idle_dim_timeout = g_settings_get_int (settings, key);
-		gpm_idle_set_timeout_dim (backlight->priv->idle, backlight->priv->idle_dim_timeout);
+		gpm_dim_model_set_timeout (backlight->priv->dim_model, gpm_policy_get (policy)->idle_dim_time);
+		gpm_idle_set_timeout_activity (backlight->priv->idle, gpm_policy_get (policy)->idle_dim_time);
+		gpm_backlight_sync_idle_dim (backlight);
+	} else if (g_strcmp0 (key, GPM_SETTINGS_IDLE_DIM_MODEL) == 0) {
+		/* we saved it */
+	} else if (g_strcmp0 (key, GPM_SETTINGS_AMBIENT_ENABLE) == 0) {
+		gpm_backlight_sync_ambient (backlight);
+		gpm_backlight_brightness_evaluate_and_set (backlight, FALSE, TRUE);
+	} else if (g_strcmp0 (key, GPM_SETTINGS_AMBIENT_OFFSETS) == 0) {
+		/* we saved it */
 	} else {
 		g_debug ("unknown key %s", key);
 	}
@@ -402,6 +580,7 @@ static void
 gpm_backlight_client_changed_cb (UpClient *client, GParamSpec *pspec, GpmBacklight *backlight)
 {
 	gpm_backlight_brightness_evaluate_and_set (backlight, FALSE, TRUE);
+	gpm_backlight_sync_idle_dim (backlight);
 }
 
 /**
@@ -417,6 +596,7 @@ gpm_backlight_save_settings (GpmBacklight *backlight, guint percentage)
 	gboolean on_battery;
 
 	backlight->priv->master_percentage = percentage;
+	gpm_backlight_ambient_learn (backlight, percentage);
 	g_object_get (backlight->priv->client, "on-battery", &on_battery, NULL);
 	if (on_battery) {
 		/* If using battery, saving settings needs a bit of trickery.
@@ -425,7 +605,7 @@ gpm_backlight_save_settings (GpmBacklight *backlight, guint percentage)
 		 * this is still less random than only saving changes when
 		 * running on AC.
 		 */
-		brightness_ac = g_settings_get_double (backlight->priv->settings, GPM_SETTINGS_BRIGHTNESS_AC);
+		brightness_ac = gpm_policy_get (backlight->priv->policy)->brightness_ac;
 		if (brightness_ac) {
 			battery_reduce = 100 - (gint) (percentage * 100.0f / brightness_ac);
 		} else {
@@ -461,7 +641,6 @@ static void
 gpm_backlight_button_pressed_cb (GpmButton *button, const gchar *type, GpmBacklight *backlight)
 {
 	gboolean ret;
-	GError *error = NULL;
 	guint percentage;
 	gboolean hw_changed;
 	g_debug ("Button press event type=%s", type);
@@ -504,16 +683,31 @@ gpm_backlight_button_pressed_cb (GpmButton *button, const gchar *type, GpmBackli
 			g_debug ("emitting brightness-changed : %u", percentage);
 			g_signal_emit (backlight, signals [BRIGHTNESS_CHANGED], 0, percentage);
 		}
-	} else if (g_strcmp0 (type, GPM_BUTTON_LID_OPEN) == 0) {
-		/* make sure we undim when we lift the lid */
-		gpm_backlight_brightness_evaluate_and_set (backlight, FALSE, TRUE);
+	}
+}
 
-		/* ensure backlight is on */
-		ret = gpm_dpms_set_mode (backlight->priv->dpms, GPM_DPMS_MODE_ON, &error);
-		if (!ret) {
-			g_warning ("failed to turn on DPMS: %s", error->message);
-			g_error_free (error);
-		}
+/**
+ * gpm_backlight_lid_changed_cb:
+ * @button: The button class instance
+ * @is_closed: TRUE if the lid has been closed
+ * @backlight: This class instance
+ **/
+static void
+gpm_backlight_lid_changed_cb (GpmButton *button, gboolean is_closed, GpmBacklight *backlight)
+{
+	gboolean ret;
+	GError *error = NULL;
+
+	if (is_closed)
+		return;
+
+	/* make sure the backlight is on, and undimmed, when we lift the lid */
+	gpm_backlight_brightness_queue (backlight);
+	gpm_display_set_dpms_mode (backlight->priv->display, GPM_DPMS_MODE_ON);
+	ret = gpm_display_commit_now (backlight->priv->display, &error);
+	if (!ret) {
+		g_warning ("failed to turn on DPMS: %s", error->message);
+		g_error_free (error);
 	}
 }
 
@@ -523,47 +717,65 @@ gpm_backlight_button_pressed_cb (GpmButton *button, const gchar *type, GpmBackli
 static gboolean
 gpm_backlight_notify_system_idle_changed (GpmBacklight *backlight, gboolean is_idle)
 {
-	gdouble elapsed;
-
 	/* no point continuing */
 	if (backlight->priv->system_is_idle == is_idle) {
 		g_debug ("state not changed");
 		return FALSE;
 	}
 
-	/* get elapsed time and reset timer */
-	elapsed = g_timer_elapsed (backlight->priv->idle_timer, NULL);
-	g_timer_reset (backlight->priv->idle_timer);
+	g_debug ("changing powersave idle status to %i", is_idle);
+	backlight->priv->system_is_idle = is_idle;
+	return TRUE;
+}
 
-	if (is_idle == FALSE) {
-		g_debug ("we have just been idle for %lfs", elapsed);
+/**
+ * gpm_backlight_dim_model_save:
+ **/
+static void
+gpm_backlight_dim_model_save (GpmBacklight *backlight)
+{
+	g_settings_set_value (backlight->priv->settings, GPM_SETTINGS_IDLE_DIM_MODEL,
+			      gpm_dim_model_to_variant (backlight->priv->dim_model));
+}
 
-		/* The user immediatly undimmed the screen!
-		 * We should double the timeout to avoid this happening again */
-		if (elapsed < 10) {
-			/* double the event time */
-			backlight->priv->idle_dim_timeout *= 2.0;
-			g_debug ("increasing idle dim time to %us", backlight->priv->idle_dim_timeout);
-			gpm_idle_set_timeout_dim (backlight->priv->idle, backlight->priv->idle_dim_timeout);
-		}
+/**
+ * gpm_backlight_dim_model_save_cb:
+ **/
+static gboolean
+gpm_backlight_dim_model_save_cb (GpmBacklight *backlight)
+{
+	backlight->priv->dim_model_save_id = 0;
+	gpm_backlight_dim_model_save (backlight);
+	return FALSE;
+}
 
-		/* We reset the dimming after 2 minutes of idle,
-		 * as the user will have changed tasks */
-		if (elapsed > 2*60) {
-			/* reset back to our default dimming */
-			backlight->priv->idle_dim_timeout =
-				g_settings_get_int (backlight->priv->settings,
-					   GPM_SETTINGS_IDLE_DIM_TIME);
-			g_debug ("resetting idle dim time to %us", backlight->priv->idle_dim_timeout);
-			gpm_idle_set_timeout_dim (backlight->priv->idle, backlight->priv->idle_dim_timeout);
-		}
-	} else {
-		g_debug ("we were active for %lfs", elapsed);
-	}
+/**
+ * gpm_backlight_idle_activity_cb:
+ * @idle_time: How long the user was idle for, in seconds
+ *
+ * Learns from every idle period long enough to have dimmed at the
+ * configured timeout, whether or not the screen did dim.
+ **/
+static void
+gpm_backlight_idle_activity_cb (GpmIdle *idle, guint idle_time, GpmBacklight *backlight)
+{
+	gboolean on_battery;
 
-	g_debug ("changing powersave idle status to %i", is_idle);
-	backlight->priv->system_is_idle = is_idle;
-	return TRUE;
+	g_debug ("we have just been idle for %us", idle_time);
+	g_object_get (backlight->priv->client,
+		      "on-battery", &on_battery,
+		      NULL);
+	gpm_dim_model_add_idle (backlight->priv->dim_model, on_battery,
+				gpm_backlight_get_hour (idle_time), idle_time);
+	gpm_backlight_sync_idle_dim (backlight);
+
+	if (backlight->priv->dim_model_save_id == 0)
+		backlight->priv->dim_model_save_id =
+			gpm_timer_add (backlight->priv->timer,
+				       GPM_BACKLIGHT_DIM_MODEL_SAVE_DELAY * 1000,
+				       GPM_BACKLIGHT_DIM_MODEL_SAVE_SLACK * 1000,
+				       "[GpmBacklight] save-dim-model",
+				       (GSourceFunc) gpm_backlight_dim_model_save_cb, backlight);
 }
 
 /**
@@ -580,8 +792,6 @@ gpm_backlight_notify_system_idle_changed (GpmBacklight *backlight, gboolean is_i
 static void
 idle_changed_cb (GpmIdle *idle, GpmIdleMode mode, GpmBacklight *backlight)
 {
-	gboolean ret;
-	GError *error = NULL;
 	gboolean on_battery;
 	GpmDpmsMode dpms_mode;
 
@@ -595,45 +805,40 @@ idle_changed_cb (GpmIdle *idle, GpmIdleMode mode, GpmBacklight *backlight)
 		return;
 	}
 
+	/* nobody can see the screen, so stop reading the light sensor */
+	backlight->priv->is_blanked = (mode == GPM_IDLE_MODE_BLANK ||
+				       mode == GPM_IDLE_MODE_DPMS_OFF);
+	gpm_backlight_sync_ambient (backlight);
+
 	if (mode == GPM_IDLE_MODE_NORMAL) {
-		/* sync lcd brightness */
+		/* sync lcd brightness, and ensure backlight is on */
 		gpm_backlight_notify_system_idle_changed (backlight, FALSE);
-		gpm_backlight_brightness_evaluate_and_set (backlight, FALSE, TRUE);
+		gpm_backlight_brightness_queue (backlight);
+		gpm_display_set_dpms_mode (backlight->priv->display, GPM_DPMS_MODE_ON);
+		gpm_display_commit (backlight->priv->display);
 
-		/* ensure backlight is on */
-		ret = gpm_dpms_set_mode (backlight->priv->dpms, GPM_DPMS_MODE_ON, &error);
-		if (!ret) {
-			g_warning ("failed to turn on DPMS: %s", error->message);
-			g_error_free (error);
-		}
-
-	} else if (mode == GPM_IDLE_MODE_DIM) {
+	} else if (mode == GPM_IDLE_MODE_DIM || mode == GPM_IDLE_MODE_KBD_OFF) {
 
-		/* sync lcd brightness */
+		/* sync lcd brightness, and ensure backlight is on */
 		gpm_backlight_notify_system_idle_changed (backlight, TRUE);
-		gpm_backlight_brightness_evaluate_and_set (backlight, FALSE, TRUE);
-
-		/* ensure backlight is on */
-		ret = gpm_dpms_set_mode (backlight->priv->dpms, GPM_DPMS_MODE_ON, &error);
-		if (!ret) {
-			g_warning ("failed to turn on DPMS: %s", error->message);
-			g_error_free (error);
-		}
+		gpm_backlight_brightness_queue (backlight);
+		gpm_display_set_dpms_mode (backlight->priv->display, GPM_DPMS_MODE_ON);
+		gpm_display_commit (backlight->priv->display);
 
 	} else if (mode == GPM_IDLE_MODE_BLANK) {
 
-		/* sync lcd brightness */
+		/* sync lcd brightness, in case the screen cannot be turned off */
 		gpm_backlight_notify_system_idle_changed (backlight, TRUE);
-		gpm_backlight_brightness_evaluate_and_set (backlight, FALSE, TRUE);
+		gpm_backlight_brightness_queue (backlight);
 
 		/* get the DPMS state we're supposed to use on the power state */
 		g_object_get (backlight->priv->client,
 			      "on-battery", &on_battery,
 			      NULL);
 		if (!on_battery)
-			dpms_mode = g_settings_get_enum (backlight->priv->settings, GPM_SETTINGS_DPMS_METHOD_AC);
+			dpms_mode = gpm_policy_get (backlight->priv->policy)->dpms_method_ac;
 		else
-			dpms_mode = g_settings_get_enum (backlight->priv->settings, GPM_SETTINGS_DPMS_METHOD_BATT);
+			dpms_mode = gpm_policy_get (backlight->priv->policy)->dpms_method_battery;
 
 		/* check if method is valid */
 		if (dpms_mode == GPM_DPMS_MODE_UNKNOWN || dpms_mode == GPM_DPMS_MODE_ON) {
@@ -642,12 +847,15 @@ idle_changed_cb (GpmIdle *idle, GpmIdleMode mode, GpmBacklight *backlight)
 		}
 
 		/* turn backlight off */
-		ret = gpm_dpms_set_mode (backlight->priv->dpms, dpms_mode, &error);
-		if (!ret) {
-			g_warning ("failed to change DPMS: %s", error->message);
-			g_error_free (error);
-		}
+		gpm_display_set_dpms_mode (backlight->priv->display, dpms_mode);
+		gpm_display_commit (backlight->priv->display);
+
+	} else if (mode == GPM_IDLE_MODE_DPMS_OFF) {
 
+		/* whatever the policy mode was, the screen is now fully off */
+		gpm_backlight_notify_system_idle_changed (backlight, TRUE);
+		gpm_display_set_dpms_mode (backlight->priv->display, GPM_DPMS_MODE_OFF);
+		gpm_display_commit (backlight->priv->display);
 	}
 }
 
@@ -675,20 +883,16 @@ brightness_changed_cb (GpmBrightness *brightness, guint percentage, GpmBacklight
  * @control: The control class instance
  * @power: This power class instance
  *
- * We have to update the caches on resume
+ * Only queues the screen coming back on at the policy brightness, so the
+ * other resume handlers can start their work in the meantime.
  **/
 static void
 control_resume_cb (GpmControl *control, GpmControlAction action, GpmBacklight *backlight)
 {
-	gboolean ret;
-	GError *error = NULL;
-
 	/* ensure backlight is on */
-	ret = gpm_dpms_set_mode (backlight->priv->dpms, GPM_DPMS_MODE_ON, &error);
-	if (!ret) {
-		g_warning ("failed to turn on DPMS: %s", error->message);
-		g_error_free (error);
-	}
+	gpm_backlight_brightness_queue (backlight);
+	gpm_display_set_dpms_mode (backlight->priv->display, GPM_DPMS_MODE_ON);
+	gpm_display_commit (backlight->priv->display);
 }
 
 /**
@@ -702,15 +906,26 @@ gpm_backlight_finalize (GObject *object)
 	g_return_if_fail (GPM_IS_BACKLIGHT (object));
 	backlight = GPM_BACKLIGHT (object);
 
-	g_timer_destroy (backlight->priv->idle_timer);
-	gtk_widget_destroy (backlight->priv->popup);
+	/* keep what was learned since the last save */
+	if (backlight->priv->dim_model_save_id != 0) {
+		gpm_timer_remove (backlight->priv->timer, backlight->priv->dim_model_save_id);
+		gpm_backlight_dim_model_save (backlight);
+	}
+	g_object_unref (backlight->priv->timer);
 
-	g_object_unref (backlight->priv->dpms);
+	if (backlight->priv->popup != NULL)
+		gtk_widget_destroy (backlight->priv->popup);
+
+	gpm_display_set_panel_func (backlight->priv->display, NULL, NULL);
+	g_object_unref (backlight->priv->display);
 	g_object_unref (backlight->priv->control);
 	g_object_unref (backlight->priv->settings);
+	g_object_unref (backlight->priv->policy);
 	g_object_unref (backlight->priv->client);
 	g_object_unref (backlight->priv->button);
 	g_object_unref (backlight->priv->idle);
+	g_object_unref (backlight->priv->dim_model);
+	g_object_unref (backlight->priv->ambient);
 	g_object_unref (backlight->priv->brightness);
 	g_object_unref (backlight->priv->console);
 
@@ -748,10 +963,9 @@ gpm_backlight_class_init (GpmBacklightClass *klass)
 static void
 gpm_backlight_init (GpmBacklight *backlight)
 {
-	backlight->priv = gpm_backlight_get_instance_private (backlight);
+	GVariant *variant;
 
-	/* record our idle time */
-	backlight->priv->idle_timer = g_timer_new ();
+	backlight->priv = gpm_backlight_get_instance_private (backlight);
 
 	/* watch for manual brightness changes (for the popup widget) */
 	backlight->priv->brightness = gpm_brightness_new ();
@@ -768,36 +982,56 @@ gpm_backlight_init (GpmBacklight *backlight)
 
 	/* watch for dim value changes */
 	backlight->priv->settings = g_settings_new (GPM_SETTINGS_SCHEMA);
-	g_signal_connect (backlight->priv->settings, "changed", G_CALLBACK (gpm_settings_key_changed_cb), backlight);
+	backlight->priv->policy = gpm_policy_new ();
+	g_signal_connect (backlight->priv->policy, "changed", G_CALLBACK (gpm_backlight_policy_changed_cb), backlight);
 
 	/* set the main brightness, this is designed to be updated if the user changes the
 	 * brightness so we can undim to the 'correct' value */
-	backlight->priv->master_percentage = g_settings_get_double (backlight->priv->settings, GPM_SETTINGS_BRIGHTNESS_AC);
+	backlight->priv->master_percentage = gpm_policy_get (backlight->priv->policy)->brightness_ac;
 
 	/* watch for brightness up and down buttons and also check lid state */
 	backlight->priv->button = gpm_button_new ();
 	g_signal_connect (backlight->priv->button, "button-pressed",
 			  G_CALLBACK (gpm_backlight_button_pressed_cb), backlight);
+	g_signal_connect (backlight->priv->button, "lid-changed",
+			  G_CALLBACK (gpm_backlight_lid_changed_cb), backlight);
 
 	/* watch for idle mode changes */
 	backlight->priv->idle = gpm_idle_new ();
 	g_signal_connect (backlight->priv->idle, "idle-changed",
 			  G_CALLBACK (idle_changed_cb), backlight);
+	g_signal_connect (backlight->priv->idle, "activity",
+			  G_CALLBACK (gpm_backlight_idle_activity_cb), backlight);
+	backlight->priv->timer = gpm_timer_new ();
 
 	/* assumption */
 	backlight->priv->system_is_idle = FALSE;
-	backlight->priv->idle_dim_timeout = g_settings_get_int (backlight->priv->settings, GPM_SETTINGS_IDLE_DIM_TIME);
-	gpm_idle_set_timeout_dim (backlight->priv->idle, backlight->priv->idle_dim_timeout);
-
-	/* use a visual widget */
-	backlight->priv->popup = msd_media_keys_window_new ();
-	msd_media_keys_window_set_action_custom (MSD_MEDIA_KEYS_WINDOW (backlight->priv->popup),
-						 "gpm-brightness-lcd",
-						 TRUE);
-        gtk_window_set_position (GTK_WINDOW (backlight->priv->popup), GTK_WIN_POS_NONE);
-
-	/* DPMS mode poll class */
-	backlight->priv->dpms = gpm_dpms_new ();
+
+	/* pick up what we learned last time about when to dim */
+	backlight->priv->dim_model = gpm_dim_model_new ();
+	variant = g_settings_get_value (backlight->priv->settings, GPM_SETTINGS_IDLE_DIM_MODEL);
+	gpm_dim_model_from_variant (backlight->priv->dim_model, variant);
+	g_variant_unref (variant);
+	gpm_dim_model_set_timeout (backlight->priv->dim_model,
+				   gpm_policy_get (backlight->priv->policy)->idle_dim_time);
+	backlight->priv->idle_dim_timeout = 0;
+	gpm_backlight_sync_idle_dim (backlight);
+	gpm_idle_set_timeout_activity (backlight->priv->idle,
+				       gpm_policy_get (backlight->priv->policy)->idle_dim_time);
+
+	/* follow the ambient light, bent towards what the user picked before */
+	backlight->priv->is_blanked = FALSE;
+	backlight->priv->ambient = gpm_ambient_new ();
+	variant = g_settings_get_value (backlight->priv->settings, GPM_SETTINGS_AMBIENT_OFFSETS);
+	gpm_ambient_from_variant (backlight->priv->ambient, variant);
+	g_variant_unref (variant);
+	g_signal_connect (backlight->priv->ambient, "brightness-changed",
+			  G_CALLBACK (gpm_backlight_ambient_changed_cb), backlight);
+	gpm_backlight_sync_ambient (backlight);
+
+	/* DPMS and brightness are changed together on idle transitions */
+	backlight->priv->display = gpm_display_new ();
+	gpm_display_set_panel_func (backlight->priv->display, gpm_backlight_display_panel_cb, backlight);
 
 	/* we refresh DPMS on resume */
 	backlight->priv->control = gpm_control_new ();
@@ -34,6 +34,7 @@
 
 #include "gpm-common.h"
 #include "gpm-button.h"
+#include "gpm-timer.h"
 
 static void     gpm_button_finalize   (GObject	      *object);
 
@@ -45,11 +46,15 @@ struct GpmButtonPrivate
 	gchar			*last_button;
 	GTimer			*timer;
 	gboolean		 lid_is_closed;
+	gboolean		 lid_emitted;
+	GpmTimer		*lid_timer;
+	guint			 lid_debounce_id;
 	UpClient		*client;
 };
 
 enum {
 	BUTTON_PRESSED,
+	LID_CHANGED,
 	LAST_SIGNAL
 };
 
@@ -59,6 +64,7 @@ static gpointer gpm_button_object = NULL;
 G_DEFINE_TYPE_WITH_PRIVATE (GpmButton, gpm_button, G_TYPE_OBJECT)
 
 #define GPM_BUTTON_DUPLICATE_TIMEOUT	0.125f
+#define GPM_BUTTON_LID_DEBOUNCE		200 /* ms */
 
 /**
  * gpm_button_emit_type:
@@ -245,62 +251,27 @@ gpm_button_class_init (GpmButtonClass *klass)
 			      NULL, NULL,
 			      g_cclosure_marshal_VOID__STRING,
 			      G_TYPE_NONE, 1, G_TYPE_STRING);
+	signals [LID_CHANGED] =
+		g_signal_new ("lid-changed",
+			      G_TYPE_FROM_CLASS (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (GpmButtonClass, lid_changed),
+			      NULL, NULL,
+			      g_cclosure_marshal_VOID__BOOLEAN,
+			      G_TYPE_NONE, 1, G_TYPE_BOOLEAN);
 }
 
 /**
  * gpm_button_is_lid_closed:
+ *
+ * Return value: the last lid state UPower told us about, without
+ * waiting for the debounce.
  **/
 gboolean
 gpm_button_is_lid_closed (GpmButton *button)
 {
-	GDBusProxy *proxy;
-	GVariant *res, *inner;
-	gboolean lid;
-	GError *error = NULL;
-
 	g_return_val_if_fail (GPM_IS_BUTTON (button), FALSE);
-
-	if (LOGIND_RUNNING()) {
-		proxy = g_dbus_proxy_new_for_bus_sync (G_BUS_TYPE_SYSTEM,
-						       G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
-						       NULL,
-						       "org.freedesktop.UPower",
-						       "/org/freedesktop/UPower",
-						       "org.freedesktop.DBus.Properties",
-						       NULL,
-						       &error );
-		if (proxy == NULL) {
-			g_error("Error connecting to dbus - %s", error->message);
-			g_error_free (error);
-			return -1;
-		}
-
-		res = g_dbus_proxy_call_sync (proxy, "Get",
-					      g_variant_new( "(ss)",
-							     "org.freedesktop.UPower",
-							     "LidIsClosed"),
-					      G_DBUS_CALL_FLAGS_NONE,
-					      -1,
-					      NULL,
-					      &error
-					      );
-		if (error == NULL && res != NULL) {
-			g_variant_get(res, "(v)", &inner );
-			lid = g_variant_get_boolean(inner);
-			g_variant_unref (inner);
-			g_variant_unref (res);
-			return lid;
-		} else if (error != NULL ) {
-			g_error ("Error in dbus - %s", error->message);
-			g_error_free (error);
-		}
-		g_object_unref(proxy);
-
-		return FALSE;
-	}
-	else {
-		return up_client_get_lid_is_closed (button->priv->client);
-	}
+	return button->priv->lid_is_closed;
 }
 
 /**
@@ -318,15 +289,36 @@ gpm_button_reset_time (GpmButton *button)
 }
 
 /**
- * gpm_button_client_changed_cb
+ * gpm_button_lid_debounce_cb:
+ *
+ * Some lid switches bounce, so only act on a state that has been stable
+ * for GPM_BUTTON_LID_DEBOUNCE ms.
+ **/
+static gboolean
+gpm_button_lid_debounce_cb (GpmButton *button)
+{
+	button->priv->lid_debounce_id = 0;
+
+	/* it went back to where it was */
+	if (button->priv->lid_emitted == button->priv->lid_is_closed)
+		return FALSE;
+	button->priv->lid_emitted = button->priv->lid_is_closed;
+
+	g_debug ("lid is now %s", button->priv->lid_is_closed ? "closed" : "open");
+	g_signal_emit (button, signals [LID_CHANGED], 0, button->priv->lid_is_closed);
+	return FALSE;
+}
+
+/**
+ * gpm_button_client_lid_changed_cb
  **/
 static void
-gpm_button_client_changed_cb (UpClient *client, GParamSpec *pspec, GpmButton *button)
+gpm_button_client_lid_changed_cb (UpClient *client, GParamSpec *pspec, GpmButton *button)
 {
 	gboolean lid_is_closed;
 
-	/* get new state */
-	lid_is_closed = gpm_button_is_lid_closed(button);
+	/* UpClient keeps the property up to date for us */
+	lid_is_closed = up_client_get_lid_is_closed (client);
 
 	/* same state */
 	if (button->priv->lid_is_closed == lid_is_closed)
@@ -335,11 +327,13 @@ gpm_button_client_changed_cb (UpClient *client, GParamSpec *pspec, GpmButton *bu
 	/* save state */
 	button->priv->lid_is_closed = lid_is_closed;
 
-	/* sent correct event */
-	if (lid_is_closed)
-		gpm_button_emit_type (button, GPM_BUTTON_LID_CLOSED);
-	else
-		gpm_button_emit_type (button, GPM_BUTTON_LID_OPEN);
+	/* restart the wait on every change */
+	if (button->priv->lid_debounce_id != 0)
+		gpm_timer_remove (button->priv->lid_timer, button->priv->lid_debounce_id);
+	button->priv->lid_debounce_id =
+		gpm_timer_add (button->priv->lid_timer, GPM_BUTTON_LID_DEBOUNCE, 0,
+			       "[GpmButton] lid-debounce",
+			       (GSourceFunc) gpm_button_lid_debounce_cb, button);
 }
 
 /**
@@ -357,11 +351,13 @@ gpm_button_init (GpmButton *button)
 	button->priv->keysym_to_name_hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
 	button->priv->last_button = NULL;
 	button->priv->timer = g_timer_new ();
+	button->priv->lid_timer = gpm_timer_new ();
 
 	button->priv->client = up_client_new ();
 	button->priv->lid_is_closed = up_client_get_lid_is_closed (button->priv->client);
-	g_signal_connect (button->priv->client, "notify",
-			  G_CALLBACK (gpm_button_client_changed_cb), button);
+	button->priv->lid_emitted = button->priv->lid_is_closed;
+	g_signal_connect (button->priv->client, "notify::lid-is-closed",
+			  G_CALLBACK (gpm_button_client_lid_changed_cb), button);
 	/* register the brightness keys */
 	gpm_button_xevent_key (button, XF86XK_PowerOff, GPM_BUTTON_POWER);
 
@@ -399,6 +395,9 @@ gpm_button_finalize (GObject *object)
 	button = GPM_BUTTON (object);
 	button->priv = gpm_button_get_instance_private (button);
 
+	if (button->priv->lid_debounce_id != 0)
+		gpm_timer_remove (button->priv->lid_timer, button->priv->lid_debounce_id);
+	g_object_unref (button->priv->lid_timer);
 	g_object_unref (button->priv->client);
 	g_free (button->priv->last_button);
 	g_timer_destroy (button->priv->timer);
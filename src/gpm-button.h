@@ -62,6 +62,8 @@ typedef struct
 	GObjectClass	parent_class;
 	void		(* button_pressed)	(GpmButton	*button,
 						 const gchar	*type);
+	void		(* lid_changed)		(GpmButton	*button,
+						 gboolean	 is_closed);
 } GpmButtonClass;
 
 GType		 gpm_button_get_type		(void);
@@ -64,8 +64,11 @@ G_BEGIN_DECLS
 #define GPM_SETTINGS_IDLE_DIM_AC			"idle-dim-ac"
 #define GPM_SETTINGS_IDLE_DIM_BATT			"idle-dim-battery"
 #define GPM_SETTINGS_IDLE_DIM_TIME			"idle-dim-time"
+#define GPM_SETTINGS_IDLE_DIM_MODEL			"idle-dim-model"
 #define GPM_SETTINGS_BRIGHTNESS_AC			"brightness-ac"
 #define GPM_SETTINGS_BRIGHTNESS_DIM_BATT		"brightness-dim-battery"
+#define GPM_SETTINGS_AMBIENT_ENABLE			"ambient-enable"
+#define GPM_SETTINGS_AMBIENT_OFFSETS			"ambient-offsets"
 
 /* keyboard backlight */
 #define GPM_SETTINGS_KBD_BACKLIGHT_ENABLE		"kbd-backlight-enable"
@@ -123,6 +126,9 @@ G_BEGIN_DECLS
 #define GPM_SETTINGS_ICON_POLICY			"icon-policy"
 #define GPM_SETTINGS_ENABLE_SOUND			"enable-sound"
 #define GPM_SETTINGS_SHOW_ACTIONS			"show-actions"
+#define GPM_SETTINGS_TOOLTIP_INTERVAL			"tooltip-interval"
+#define GPM_SETTINGS_TOOLTIP_PERCENTAGE_THRESHOLD	"tooltip-percentage-threshold"
+#define GPM_SETTINGS_TOOLTIP_TIME_THRESHOLD		"tooltip-time-threshold"
 
 /* statistics */
 #define GPM_SETTINGS_INFO_HISTORY_TIME			"info-history-time"
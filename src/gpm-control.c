@@ -38,6 +38,7 @@
 #endif /* HAVE_UNISTD_H */
 
 #include <gio/gio.h>
+#include <gio/gunixfdlist.h>
 #include <glib/gi18n.h>
 
 #ifdef WITH_LIBSECRET
@@ -53,12 +54,62 @@
 #include "gpm-common.h"
 #include "gpm-control.h"
 #include "gpm-networkmanager.h"
+#include "gpm-proxy-pool.h"
+#include "gpm-timer.h"
+
+#define GPM_CONTROL_PREPARE_TIMEOUT	5 /* seconds */
+#define GPM_CONTROL_RESUME_TIMEOUT	60 /* seconds awake, the clock stops while asleep */
 
 struct GpmControlPrivate
 {
 	GSettings		*settings;
+	GpmProxyPool		*pool;
+	GDBusProxy		*logind_proxy;
+	gboolean		 sleeping;
+	GTask			*sleep_task;
+	gint			 inhibit_fd;
+	gboolean		 inhibit_pending;
+	EggConsoleKit		*console;
+	gint			 can_suspend;	/* -1 until ConsoleKit has told us */
+	gint			 can_hibernate;
+};
+
+typedef enum {
+	GPM_CONTROL_STAGE_KEYRING,
+	GPM_CONTROL_STAGE_LOGIND,
+	GPM_CONTROL_STAGE_SCREENSAVER,
+	GPM_CONTROL_STAGE_NETWORK,
+	GPM_CONTROL_STAGE_LAST
+} GpmControlStage;
+
+static const gchar *gpm_control_stage_names[] = {
+	"keyring",
+	"logind",
+	"screensaver",
+	"network"
 };
 
+typedef struct {
+	GpmControlAction	 action;
+	GpmScreensaver		*screensaver;
+	GCancellable		*cancellable;
+	GpmTimer		*timer;
+	guint			 timeout_id;
+	guint			 resume_timeout_id;
+	gboolean		 do_lock;
+	gboolean		 nm_sleep;
+	guint32			 throttle_cookie;
+	guint			 pending;
+	gint64			 start;
+	gint64			 request;
+	gboolean		 external;
+	gboolean		 replied;
+	gboolean		 resumed;
+	gboolean		 woken;
+	gint64			 started[GPM_CONTROL_STAGE_LAST];
+	gint64			 finished[GPM_CONTROL_STAGE_LAST];
+} GpmControlSleep;
+
 enum {
 	RESUME,
 	SLEEP,
@@ -68,6 +119,9 @@ enum {
 static guint signals [LAST_SIGNAL] = { 0 };
 static gpointer gpm_control_object = NULL;
 
+static void	gpm_control_set_logind_proxy	(GpmControl	*control,
+						 GDBusProxy	*proxy);
+
 G_DEFINE_TYPE_WITH_PRIVATE (GpmControl, gpm_control, G_TYPE_OBJECT)
 
 /**
@@ -84,28 +138,88 @@ gpm_control_error_quark (void)
 }
 
 /**
- * gpm_manager_systemd_shutdown:
+ * gpm_control_action_get_method:
+ **/
+static const gchar *
+gpm_control_action_get_method (GpmControlAction action)
+{
+	if (action == GPM_CONTROL_ACTION_SUSPEND)
+		return "Suspend";
+	if (action == GPM_CONTROL_ACTION_HIBERNATE)
+		return "Hibernate";
+	return "Sleep";
+}
+
+/**
+ * gpm_control_sleep_free:
+ **/
+static void
+gpm_control_sleep_free (GpmControlSleep *state)
+{
+	if (state->timeout_id != 0)
+		gpm_timer_remove (state->timer, state->timeout_id);
+	if (state->resume_timeout_id != 0)
+		gpm_timer_remove (state->timer, state->resume_timeout_id);
+	g_object_unref (state->timer);
+	g_object_unref (state->cancellable);
+	g_object_unref (state->screensaver);
+	g_free (state);
+}
+
+/**
+ * gpm_control_sleep_start:
+ **/
+static void
+gpm_control_sleep_start (GpmControlSleep *state, GpmControlStage stage)
+{
+	state->started[stage] = g_get_monotonic_time ();
+	state->pending++;
+}
+
+static void gpm_control_sleep_do (GTask *task);
+
+/**
+ * gpm_control_sleep_release:
+ *
+ * Drops one pending step, and goes to sleep after the last.
+ **/
+static void
+gpm_control_sleep_release (GTask *task)
+{
+	GpmControlSleep *state = g_task_get_task_data (task);
+
+	if (--state->pending == 0)
+		gpm_control_sleep_do (task);
+}
+
+/**
+ * gpm_control_sleep_done:
+ **/
+static void
+gpm_control_sleep_done (GTask *task, GpmControlStage stage)
+{
+	GpmControlSleep *state = g_task_get_task_data (task);
+
+	state->finished[stage] = g_get_monotonic_time ();
+	gpm_control_sleep_release (task);
+}
+
+/**
+ * gpm_control_systemd_shutdown:
  *
  * Shutdown the system using systemd-logind.
  *
- * Return value: fd, -1 on error
+ * Return value: Success value
  **/
 static gboolean
-gpm_control_systemd_shutdown (void) {
+gpm_control_systemd_shutdown (GpmControl *control)
+{
 	GError *error = NULL;
 	GDBusProxy *proxy;
 	GVariant *res = NULL;
 
 	g_debug ("Requesting systemd to shutdown");
-	proxy = g_dbus_proxy_new_for_bus_sync (G_BUS_TYPE_SYSTEM,
-					       G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
-					       NULL,
-					       "org.freedesktop.login1",
-					       "/org/freedesktop/login1",
-					       "org.freedesktop.login1.Manager",
-					       NULL,
-					       &error );
-	//append all our arguments
+	proxy = gpm_proxy_pool_get_sync (control->priv->pool, GPM_PROXY_POOL_LOGIND, &error);
 	if (proxy == NULL) {
 		g_warning ("Error connecting to dbus - %s", error->message);
 		g_error_free (error);
@@ -129,23 +243,34 @@ gpm_control_systemd_shutdown (void) {
 	return TRUE;
 }
 
+/**
+ * gpm_control_console_kit_stop_cb:
+ **/
+static void
+gpm_control_console_kit_stop_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	/* already warned about */
+	egg_console_kit_action_finish (EGG_CONSOLE_KIT (source), res, NULL);
+}
+
 /**
  * gpm_control_shutdown:
  * @control: This class instance
  *
- * Shuts down the computer
+ * Shuts down the computer. ConsoleKit is asked without waiting for the
+ * answer, so a failure there is only logged.
  **/
 gboolean
 gpm_control_shutdown (GpmControl *control, GError **error)
 {
-	gboolean ret;
+	gboolean ret = TRUE;
 	EggConsoleKit *console;
 
 	if (LOGIND_RUNNING()) {
-		ret = gpm_control_systemd_shutdown ();
+		ret = gpm_control_systemd_shutdown (control);
 	} else {
 		console = egg_console_kit_new ();
-		ret = egg_console_kit_stop (console, error);
+		egg_console_kit_stop_async (console, gpm_control_console_kit_stop_cb, NULL);
 		g_object_unref (console);
 	}
 	return ret;
@@ -201,313 +326,809 @@ gpm_control_get_lock_policy (GpmControl *control, const gchar *policy)
 	return do_lock;
 }
 
+#ifdef WITH_LIBSECRET
 /**
- * gpm_control_suspend:
+ * gpm_control_secret_lock_cb:
  **/
-gboolean
-gpm_control_suspend (GpmControl *control, GError **error)
+static void
+gpm_control_secret_lock_cb (GObject *source, GAsyncResult *res, gpointer user_data)
 {
-	gboolean allowed = FALSE;
-	gboolean ret = FALSE;
-	gboolean do_lock;
-	gboolean nm_sleep;
-	EggConsoleKit *console;
-	GpmScreensaver *screensaver;
-	guint32 throttle_cookie = 0;
-#ifdef WITH_LIBSECRET
-	gboolean lock_libsecret;
-	GCancellable *libsecret_cancellable = NULL;
-	SecretService *secretservice_proxy = NULL;
+	GTask *task = G_TASK (user_data);
+	GError *error = NULL;
 	gint num_secrets_locked;
-	GList *libsecret_collections = NULL;
+
+	num_secrets_locked = secret_service_lock_finish (SECRET_SERVICE (source), res, NULL, &error);
+	if (error != NULL) {
+		g_warning ("could not lock keyring: %s", error->message);
+		g_error_free (error);
+	} else if (num_secrets_locked <= 0) {
+		g_warning ("could not lock keyring");
+	}
+	gpm_control_sleep_done (task, GPM_CONTROL_STAGE_KEYRING);
+	g_object_unref (task);
+}
+
+/**
+ * gpm_control_secret_service_cb:
+ **/
+static void
+gpm_control_secret_service_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GTask *task = G_TASK (user_data);
+	GpmControlSleep *state = g_task_get_task_data (task);
+	SecretService *secretservice_proxy;
+	GList *libsecret_collections;
+	GError *error = NULL;
+
+	secretservice_proxy = secret_service_get_finish (res, &error);
+	if (secretservice_proxy == NULL) {
+		g_warning ("failed to connect to secret service: %s", error->message);
+		g_error_free (error);
+		gpm_control_sleep_done (task, GPM_CONTROL_STAGE_KEYRING);
+		g_object_unref (task);
+		return;
+	}
+	libsecret_collections = secret_service_get_collections (secretservice_proxy);
+	if (libsecret_collections == NULL) {
+		g_warning ("failed to get secret collections");
+		gpm_control_sleep_done (task, GPM_CONTROL_STAGE_KEYRING);
+		g_object_unref (task);
+	} else {
+		/* the stage is finished when the lock is */
+		secret_service_lock (secretservice_proxy, libsecret_collections,
+				     state->cancellable,
+				     gpm_control_secret_lock_cb, task);
+		g_list_free_full (libsecret_collections, g_object_unref);
+	}
+	g_object_unref (secretservice_proxy);
+}
 #endif /* WITH_LIBSECRET */
+
 #ifdef WITH_KEYRING
-	gboolean lock_gnome_keyring;
-	GnomeKeyringResult keyres;
+/**
+ * gpm_control_gnome_keyring_thread:
+ *
+ * There is no async version that works on another main context.
+ **/
+static void
+gpm_control_gnome_keyring_thread (GTask *task, gpointer source_object,
+				  gpointer task_data, GCancellable *cancellable)
+{
+	g_task_return_int (task, gnome_keyring_lock_all_sync ());
+}
+
+/**
+ * gpm_control_gnome_keyring_cb:
+ **/
+static void
+gpm_control_gnome_keyring_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GTask *task = G_TASK (user_data);
+	GError *error = NULL;
+	gssize keyres;
+
+	keyres = g_task_propagate_int (G_TASK (res), &error);
+	if (error != NULL) {
+		g_warning ("could not lock keyring: %s", error->message);
+		g_error_free (error);
+	} else if (keyres != GNOME_KEYRING_RESULT_OK) {
+		g_warning ("could not lock keyring");
+	}
+	gpm_control_sleep_done (task, GPM_CONTROL_STAGE_KEYRING);
+	g_object_unref (task);
+}
 #endif /* WITH_KEYRING */
 
-	GError *dbus_error = NULL;
+/**
+ * gpm_control_logind_proxy_cb:
+ **/
+static void
+gpm_control_logind_proxy_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GTask *task = G_TASK (user_data);
+	GpmControl *control = g_task_get_source_object (task);
 	GDBusProxy *proxy;
-	GVariant *res = NULL;
+	GError *error = NULL;
 
-	screensaver = gpm_screensaver_new ();
+	proxy = gpm_proxy_pool_get_finish (GPM_PROXY_POOL (source), res, &error);
+	if (proxy == NULL) {
+		g_warning ("Error connecting to dbus - %s", error->message);
+		g_error_free (error);
+	} else {
+		gpm_control_set_logind_proxy (control, proxy);
+		g_object_unref (proxy);
+	}
+	gpm_control_sleep_done (task, GPM_CONTROL_STAGE_LOGIND);
+	g_object_unref (task);
+}
 
-	if (!LOGIND_RUNNING()) {
-		console = egg_console_kit_new ();
-		egg_console_kit_can_suspend (console, &allowed, NULL);
-		g_object_unref (console);
+/**
+ * gpm_control_screensaver_lock_cb:
+ **/
+static void
+gpm_control_screensaver_lock_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GTask *task = G_TASK (user_data);
+	GError *error = NULL;
 
-		if (!allowed) {
-			g_debug ("cannot suspend as not allowed from policy");
-			g_set_error_literal (error, GPM_CONTROL_ERROR, GPM_CONTROL_ERROR_GENERAL, "Cannot suspend");
-			goto out;
-		}
+	if (!gpm_screensaver_lock_finish (GPM_SCREENSAVER (source), res, &error)) {
+		g_warning ("could not lock the screen: %s", error->message);
+		g_error_free (error);
 	}
+	gpm_control_sleep_done (task, GPM_CONTROL_STAGE_SCREENSAVER);
+	g_object_unref (task);
+}
 
-#ifdef WITH_LIBSECRET
-	/* we should perhaps lock keyrings when sleeping #375681 */
-	lock_libsecret = g_settings_get_boolean (control->priv->settings,
-						 GPM_SETTINGS_LOCK_KEYRING_SUSPEND);
-	if (lock_libsecret) {
-		libsecret_cancellable = g_cancellable_new ();
-		secretservice_proxy = secret_service_get_sync (SECRET_SERVICE_LOAD_COLLECTIONS,
-							       libsecret_cancellable,
-							       error);
-		if (secretservice_proxy == NULL) {
-			g_warning ("failed to connect to secret service");
-		} else {
-			libsecret_collections = secret_service_get_collections (secretservice_proxy);
-			if ( libsecret_collections == NULL) {
-				g_warning ("failed to get secret collections");
-			} else {
-				num_secrets_locked = secret_service_lock_sync (secretservice_proxy,
-									       libsecret_collections,
-									       libsecret_cancellable,
-									       NULL,
-									       error);
-				if (num_secrets_locked <= 0)
-					g_warning ("could not lock keyring");
-				g_list_free (libsecret_collections);
-			}
-			g_object_unref (secretservice_proxy);
-		}
-		g_object_unref (libsecret_cancellable);
+/**
+ * gpm_control_sleep_timeout_cb:
+ **/
+static gboolean
+gpm_control_sleep_timeout_cb (gpointer user_data)
+{
+	GpmControlSleep *state = (GpmControlSleep *) user_data;
+	state->timeout_id = 0;
+	g_warning ("giving up on the sleep preparation steps still running after %is",
+		   GPM_CONTROL_PREPARE_TIMEOUT);
+	g_cancellable_cancel (state->cancellable);
+	return FALSE;
+}
+
+/**
+ * gpm_control_inhibit_cb:
+ **/
+static void
+gpm_control_inhibit_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GpmControl *control = GPM_CONTROL (user_data);
+	GUnixFDList *fd_list = NULL;
+	GVariant *result;
+	GError *error = NULL;
+	gint32 idx;
+
+	control->priv->inhibit_pending = FALSE;
+	result = g_dbus_proxy_call_with_unix_fd_list_finish (G_DBUS_PROXY (source), &fd_list, res, &error);
+	if (result == NULL) {
+		g_warning ("failed to take the logind delay inhibitor: %s", error->message);
+		g_error_free (error);
+		goto out;
 	}
-#endif /* WITH_LIBSECRET */
-#ifdef WITH_KEYRING
-	/* we should perhaps lock keyrings when sleeping #375681 */
-	lock_gnome_keyring = g_settings_get_boolean (control->priv->settings, GPM_SETTINGS_LOCK_KEYRING_SUSPEND);
-	if (lock_gnome_keyring) {
-		keyres = gnome_keyring_lock_all_sync ();
-		if (keyres != GNOME_KEYRING_RESULT_OK)
-			g_warning ("could not lock keyring");
+	g_variant_get (result, "(h)", &idx);
+	control->priv->inhibit_fd = g_unix_fd_list_get (fd_list, idx, &error);
+	if (control->priv->inhibit_fd == -1) {
+		g_warning ("failed to get the logind delay inhibitor: %s", error->message);
+		g_error_free (error);
+	} else {
+		g_debug ("holding logind delay inhibitor fd %i", control->priv->inhibit_fd);
 	}
-#endif /* WITH_KEYRING */
+	g_object_unref (fd_list);
+	g_variant_unref (result);
+out:
+	g_object_unref (control);
+}
 
-	do_lock = gpm_control_get_lock_policy (control, GPM_SETTINGS_LOCK_ON_SUSPEND);
-	if (do_lock) {
-		throttle_cookie = gpm_screensaver_add_throttle (screensaver, "suspend");
-		gpm_screensaver_lock (screensaver);
-	}
+/**
+ * gpm_control_inhibit:
+ *
+ * Takes a delay inhibitor, so logind waits for us to lock the screen
+ * before sleeping however the sleep was started.
+ **/
+static void
+gpm_control_inhibit (GpmControl *control)
+{
+	if (control->priv->logind_proxy == NULL)
+		return;
+	if (control->priv->inhibit_fd >= 0 || control->priv->inhibit_pending)
+		return;
 
-	nm_sleep = g_settings_get_boolean (control->priv->settings, GPM_SETTINGS_NETWORKMANAGER_SLEEP);
-	if (nm_sleep)
-		gpm_networkmanager_sleep ();
+	control->priv->inhibit_pending = TRUE;
+	g_dbus_proxy_call_with_unix_fd_list (control->priv->logind_proxy, "Inhibit",
+					     g_variant_new ("(ssss)",
+							    "sleep",
+							    "MATE Power Manager",
+							    "Lock the screen before sleeping",
+							    "delay"),
+					     G_DBUS_CALL_FLAGS_NONE,
+					     -1,
+					     NULL,
+					     NULL,
+					     gpm_control_inhibit_cb, g_object_ref (control));
+}
 
-	/* Do the suspend */
-	g_debug ("emitting sleep");
-	g_signal_emit (control, signals [SLEEP], 0, GPM_CONTROL_ACTION_SUSPEND);
+/**
+ * gpm_control_uninhibit:
+ **/
+static void
+gpm_control_uninhibit (GpmControl *control)
+{
+	if (control->priv->inhibit_fd < 0)
+		return;
+	g_debug ("releasing logind delay inhibitor");
+	close (control->priv->inhibit_fd);
+	control->priv->inhibit_fd = -1;
+}
 
-	if (LOGIND_RUNNING()) {
-		/* sleep via logind */
-		proxy = g_dbus_proxy_new_for_bus_sync (G_BUS_TYPE_SYSTEM,
-						       G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
-						       NULL,
-						       "org.freedesktop.login1",
-						       "/org/freedesktop/login1",
-						       "org.freedesktop.login1.Manager",
-						       NULL,
-						       &dbus_error );
-		if (proxy == NULL) {
-			g_warning ("Error connecting to dbus - %s", dbus_error->message);
-			g_error_free (dbus_error);
-			ret = FALSE;
-			goto out;
-		}
-		res = g_dbus_proxy_call_sync (proxy, "Suspend",
-					      g_variant_new( "(b)",FALSE),
-					      G_DBUS_CALL_FLAGS_NONE,
-					      -1,
-					      NULL,
-					      &dbus_error
-					      );
-		if (dbus_error != NULL ) {
-			g_warning ("Error in dbus - %s", dbus_error->message);
-			g_error_free (dbus_error);
-			ret = TRUE;
-		}
-		else {
-			g_variant_unref(res);
-			ret = TRUE;
-		}
-		g_object_unref(proxy);
-	}
-	else {
-		console = egg_console_kit_new ();
-		ret = egg_console_kit_suspend (console, error);
-		g_object_unref (console);
+/**
+ * gpm_control_sleep_resume:
+ *
+ * Undoes the preparation, only the first time it is called.
+ *
+ * The resume work is all started here and left to finish on its own: the
+ * D-Bus calls go out first, and the ::resume handlers only queue their
+ * work, so restoring the brightness does not wait for the keyboard, the
+ * screensaver or the network to answer, nor they for it.
+ **/
+static void
+gpm_control_sleep_resume (GTask *task)
+{
+	GpmControl *control = g_task_get_source_object (task);
+	GpmControlSleep *state = g_task_get_task_data (task);
+
+	if (state->resumed)
+		return;
+	state->resumed = TRUE;
+
+	g_debug ("%s request took %" G_GINT64_FORMAT "ms",
+		 gpm_control_action_get_method (state->action),
+		 (g_get_monotonic_time () - state->request) / 1000);
+
+	if (state->do_lock) {
+		gpm_screensaver_poke (state->screensaver);
+		if (state->throttle_cookie)
+			gpm_screensaver_remove_throttle (state->screensaver, state->throttle_cookie);
 	}
 
+	if (g_settings_get_boolean (control->priv->settings, GPM_SETTINGS_NETWORKMANAGER_SLEEP))
+		gpm_networkmanager_wake ();
+
+	/* ready for the next time */
+	gpm_control_inhibit (control);
+
 	g_debug ("emitting resume");
-	g_signal_emit (control, signals [RESUME], 0, GPM_CONTROL_ACTION_SUSPEND);
+	g_signal_emit (control, signals [RESUME], 0, state->action);
+}
+
+/**
+ * gpm_control_sleep_complete:
+ **/
+static void
+gpm_control_sleep_complete (GTask *task, GError *error)
+{
+	GpmControl *control = g_task_get_source_object (task);
+
+	gpm_control_sleep_resume (task);
+
+	control->priv->sleeping = FALSE;
+	control->priv->sleep_task = NULL;
+	if (error != NULL)
+		g_task_return_error (task, error);
+	else
+		g_task_return_boolean (task, TRUE);
+	g_object_unref (task);
+}
+
+/**
+ * gpm_control_sleep_resume_timeout_cb:
+ **/
+static gboolean
+gpm_control_sleep_resume_timeout_cb (gpointer user_data)
+{
+	GTask *task = G_TASK (user_data);
+	GpmControlSleep *state = g_task_get_task_data (task);
+
+	state->resume_timeout_id = 0;
+	g_warning ("logind did not say we resumed within %is, assuming the sleep failed",
+		   GPM_CONTROL_RESUME_TIMEOUT);
+	gpm_control_sleep_complete (task, NULL);
+	return FALSE;
+}
+
+/**
+ * gpm_control_sleep_wait_resume:
+ *
+ * Stops waiting for PrepareForSleep(false) if it never comes, e.g. when
+ * the sleep failed or logind was restarted, so we can sleep again.
+ **/
+static void
+gpm_control_sleep_wait_resume (GTask *task)
+{
+	GpmControlSleep *state = g_task_get_task_data (task);
+
+	if (state->resume_timeout_id != 0)
+		return;
+	state->resume_timeout_id = gpm_timer_add_seconds (state->timer, GPM_CONTROL_RESUME_TIMEOUT,
+							  "[GpmControl] resume-timeout",
+							  gpm_control_sleep_resume_timeout_cb, task);
+}
+
+/**
+ * gpm_control_sleep_logind_cb:
+ **/
+static void
+gpm_control_sleep_logind_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GTask *task = G_TASK (user_data);
+	GpmControlSleep *state = g_task_get_task_data (task);
+	GError *error = NULL;
+	GVariant *result;
 
-	if (do_lock) {
-		gpm_screensaver_poke (screensaver);
-		if (throttle_cookie)
-			gpm_screensaver_remove_throttle (screensaver, throttle_cookie);
+	result = g_dbus_proxy_call_finish (G_DBUS_PROXY (source), res, &error);
+	if (result == NULL) {
+		g_warning ("Error in dbus - %s", error->message);
+		g_error_free (error);
+		gpm_control_sleep_complete (task, NULL);
+		return;
 	}
+	g_variant_unref (result);
 
-	nm_sleep = g_settings_get_boolean (control->priv->settings, GPM_SETTINGS_NETWORKMANAGER_SLEEP);
-	if (nm_sleep)
-		gpm_networkmanager_wake ();
+	/* logind replies once the sleep is queued, so wait for PrepareForSleep */
+	state->replied = TRUE;
+	if (state->resumed)
+		gpm_control_sleep_complete (task, NULL);
+	else
+		gpm_control_sleep_wait_resume (task);
+}
 
-out:
-	g_object_unref (screensaver);
-	return ret;
+/**
+ * gpm_control_sleep_console_kit_cb:
+ **/
+static void
+gpm_control_sleep_console_kit_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GTask *task = G_TASK (user_data);
+	GError *error = NULL;
+
+	/* ConsoleKit replies once we have resumed */
+	egg_console_kit_action_finish (EGG_CONSOLE_KIT (source), res, &error);
+	gpm_control_sleep_complete (task, error);
 }
 
 /**
- * gpm_control_hibernate:
+ * gpm_control_sleep_do:
+ *
+ * Called when all the preparation steps are done or given up on.
  **/
-gboolean
-gpm_control_hibernate (GpmControl *control, GError **error)
+static void
+gpm_control_sleep_do (GTask *task)
 {
-	gboolean allowed = FALSE;
-	gboolean ret = FALSE;
-	gboolean do_lock;
-	gboolean nm_sleep;
+	GpmControl *control = g_task_get_source_object (task);
+	GpmControlSleep *state = g_task_get_task_data (task);
 	EggConsoleKit *console;
-	GpmScreensaver *screensaver;
-	guint32 throttle_cookie = 0;
-#ifdef WITH_LIBSECRET
-	gboolean lock_libsecret;
-	GCancellable *libsecret_cancellable = NULL;
-	SecretService *secretservice_proxy = NULL;
-	gint num_secrets_locked;
-	GList *libsecret_collections = NULL;
-#endif /* WITH_LIBSECRET */
-#ifdef WITH_KEYRING
-	gboolean lock_gnome_keyring;
-	GnomeKeyringResult keyres;
-#endif /* WITH_KEYRING */
+	GError *error = NULL;
+	const gchar *method;
+	guint i;
 
-	GError *dbus_error = NULL;
-	GDBusProxy *proxy;
-	GVariant *res = NULL;
+	if (state->timeout_id != 0) {
+		gpm_timer_remove (state->timer, state->timeout_id);
+		state->timeout_id = 0;
+	}
 
-	screensaver = gpm_screensaver_new ();
+	for (i = 0; i < GPM_CONTROL_STAGE_LAST; i++) {
+		if (state->started[i] == 0)
+			continue;
+		g_debug ("prepare %s took %" G_GINT64_FORMAT "ms",
+			 gpm_control_stage_names[i],
+			 (state->finished[i] - state->started[i]) / 1000);
+	}
+	g_debug ("prepare took %" G_GINT64_FORMAT "ms%s",
+		 (g_get_monotonic_time () - state->start) / 1000,
+		 g_cancellable_is_cancelled (state->cancellable) ? " (timed out)" : "");
 
-	if (!LOGIND_RUNNING()) {
-		console = egg_console_kit_new ();
-		egg_console_kit_can_hibernate (console, &allowed, NULL);
-		g_object_unref (console);
+	/* Do the suspend */
+	g_debug ("emitting sleep");
+	g_signal_emit (control, signals [SLEEP], 0, state->action);
 
-		if (!allowed) {
-			g_debug ("cannot hibernate as not allowed from policy");
-			g_set_error_literal (error, GPM_CONTROL_ERROR, GPM_CONTROL_ERROR_GENERAL, "Cannot hibernate");
-			goto out;
+	method = gpm_control_action_get_method (state->action);
+	state->request = g_get_monotonic_time ();
+	if (state->external) {
+		/* logind is already on its way to sleep, let it go */
+		gpm_control_uninhibit (control);
+		if (state->woken)
+			gpm_control_sleep_complete (task, NULL);
+		else
+			gpm_control_sleep_wait_resume (task);
+		return;
+	}
+	if (LOGIND_RUNNING()) {
+		/* sleep via logind */
+		if (control->priv->logind_proxy == NULL) {
+			error = g_error_new (GPM_CONTROL_ERROR, GPM_CONTROL_ERROR_GENERAL,
+					     "Cannot %s: not connected to logind", method);
+			gpm_control_sleep_complete (task, error);
+			return;
 		}
+		g_dbus_proxy_call (control->priv->logind_proxy, method,
+				   g_variant_new ("(b)", FALSE),
+				   G_DBUS_CALL_FLAGS_NONE,
+				   G_MAXINT,
+				   NULL,
+				   gpm_control_sleep_logind_cb, task);
+		return;
 	}
 
-#ifdef WITH_LIBSECRET
+	console = egg_console_kit_new ();
+	if (state->action == GPM_CONTROL_ACTION_SUSPEND)
+		egg_console_kit_suspend_async (console, gpm_control_sleep_console_kit_cb, task);
+	else
+		egg_console_kit_hibernate_async (console, gpm_control_sleep_console_kit_cb, task);
+	g_object_unref (console);
+}
+
+/**
+ * gpm_control_sleep_prepare:
+ *
+ * Starts all the preparation steps at once.
+ **/
+static void
+gpm_control_sleep_prepare (GTask *task)
+{
+	GpmControl *control = g_task_get_source_object (task);
+	GpmControlSleep *state = g_task_get_task_data (task);
+	gboolean lock_keyring;
+
+	state->timeout_id = gpm_timer_add_seconds (state->timer, GPM_CONTROL_PREPARE_TIMEOUT,
+						   "[GpmControl] prepare-timeout",
+						   gpm_control_sleep_timeout_cb, state);
+
+	/* held until every step has been started */
+	state->pending = 1;
+
 	/* we should perhaps lock keyrings when sleeping #375681 */
-	lock_libsecret = g_settings_get_boolean (control->priv->settings,
-						 GPM_SETTINGS_LOCK_KEYRING_SUSPEND);
-	if (lock_libsecret) {
-		libsecret_cancellable = g_cancellable_new ();
-		secretservice_proxy = secret_service_get_sync (SECRET_SERVICE_LOAD_COLLECTIONS,
-							       libsecret_cancellable,
-							       error);
-		if (secretservice_proxy == NULL) {
-			g_warning ("failed to connect to secret service");
-		} else {
-			libsecret_collections = secret_service_get_collections (secretservice_proxy);
-			if ( libsecret_collections == NULL) {
-				g_warning ("failed to get secret collections");
-			} else {
-				num_secrets_locked = secret_service_lock_sync (secretservice_proxy,
-									       libsecret_collections,
-									       libsecret_cancellable,
-									       NULL,
-									       error);
-				if (num_secrets_locked <= 0)
-					g_warning ("could not lock keyring");
-				g_list_free (libsecret_collections);
-			}
-			g_object_unref (secretservice_proxy);
-		}
-		g_object_unref (libsecret_cancellable);
+	if (state->action == GPM_CONTROL_ACTION_SUSPEND)
+		lock_keyring = g_settings_get_boolean (control->priv->settings, GPM_SETTINGS_LOCK_KEYRING_SUSPEND);
+	else if (state->action == GPM_CONTROL_ACTION_HIBERNATE)
+		lock_keyring = g_settings_get_boolean (control->priv->settings, GPM_SETTINGS_LOCK_KEYRING_HIBERNATE);
+	else
+		lock_keyring = g_settings_get_boolean (control->priv->settings, GPM_SETTINGS_LOCK_KEYRING_SUSPEND) ||
+			       g_settings_get_boolean (control->priv->settings, GPM_SETTINGS_LOCK_KEYRING_HIBERNATE);
+#ifdef WITH_LIBSECRET
+	if (lock_keyring) {
+		gpm_control_sleep_start (state, GPM_CONTROL_STAGE_KEYRING);
+		secret_service_get (SECRET_SERVICE_LOAD_COLLECTIONS, state->cancellable,
+				    gpm_control_secret_service_cb, g_object_ref (task));
 	}
 #endif /* WITH_LIBSECRET */
 #ifdef WITH_KEYRING
-	/* we should perhaps lock keyrings when sleeping #375681 */
-	lock_gnome_keyring = g_settings_get_boolean (control->priv->settings, GPM_SETTINGS_LOCK_KEYRING_HIBERNATE);
-	if (lock_gnome_keyring) {
-		keyres = gnome_keyring_lock_all_sync ();
-		if (keyres != GNOME_KEYRING_RESULT_OK) {
-			g_warning ("could not lock keyring");
-		}
+	if (lock_keyring) {
+		GTask *keyring_task;
+
+		gpm_control_sleep_start (state, GPM_CONTROL_STAGE_KEYRING);
+		keyring_task = g_task_new (control, state->cancellable,
+					   gpm_control_gnome_keyring_cb, g_object_ref (task));
+		g_task_set_return_on_cancel (keyring_task, TRUE);
+		g_task_run_in_thread (keyring_task, gpm_control_gnome_keyring_thread);
+		g_object_unref (keyring_task);
 	}
 #endif /* WITH_KEYRING */
 
-	do_lock = gpm_control_get_lock_policy (control, GPM_SETTINGS_LOCK_ON_HIBERNATE);
-	if (do_lock) {
-		throttle_cookie = gpm_screensaver_add_throttle (screensaver, "hibernate");
-		gpm_screensaver_lock (screensaver);
+	/* only when asked to sleep very early on */
+	if (LOGIND_RUNNING() && control->priv->logind_proxy == NULL) {
+		gpm_control_sleep_start (state, GPM_CONTROL_STAGE_LOGIND);
+		gpm_proxy_pool_get_async (control->priv->pool, GPM_PROXY_POOL_LOGIND,
+					  state->cancellable,
+					  gpm_control_logind_proxy_cb, g_object_ref (task));
 	}
 
-	nm_sleep = g_settings_get_boolean (control->priv->settings, GPM_SETTINGS_NETWORKMANAGER_SLEEP);
-	if (nm_sleep)
+	/* the stage is finished when mate-screensaver has faded out */
+	if (state->do_lock) {
+		gpm_control_sleep_start (state, GPM_CONTROL_STAGE_SCREENSAVER);
+		if (state->action == GPM_CONTROL_ACTION_SUSPEND)
+			state->throttle_cookie = gpm_screensaver_add_throttle (state->screensaver, "suspend");
+		else if (state->action == GPM_CONTROL_ACTION_HIBERNATE)
+			state->throttle_cookie = gpm_screensaver_add_throttle (state->screensaver, "hibernate");
+		else
+			state->throttle_cookie = gpm_screensaver_add_throttle (state->screensaver, "sleep");
+		gpm_screensaver_lock_async (state->screensaver, state->cancellable,
+					    gpm_control_screensaver_lock_cb, g_object_ref (task));
+	}
+	if (state->nm_sleep) {
+		gpm_control_sleep_start (state, GPM_CONTROL_STAGE_NETWORK);
 		gpm_networkmanager_sleep ();
+		gpm_control_sleep_done (task, GPM_CONTROL_STAGE_NETWORK);
+	}
 
-	g_debug ("emitting sleep");
-	g_signal_emit (control, signals [SLEEP], 0, GPM_CONTROL_ACTION_HIBERNATE);
+	/* the task ref is passed on to whatever finishes last */
+	gpm_control_sleep_release (task);
+}
 
-	if (LOGIND_RUNNING()) {
-		/* sleep via logind */
-		proxy = g_dbus_proxy_new_for_bus_sync (G_BUS_TYPE_SYSTEM,
-						       G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
-						       NULL,
-						       "org.freedesktop.login1",
-						       "/org/freedesktop/login1",
-						       "org.freedesktop.login1.Manager",
-						       NULL,
-						       &dbus_error );
-		if (proxy == NULL) {
-			g_warning ("Error connecting to dbus - %s", dbus_error->message);
-			g_error_free (dbus_error);
-			ret = FALSE;
-			goto out;
-		}
-		res = g_dbus_proxy_call_sync (proxy, "Hibernate",
-					      g_variant_new( "(b)",FALSE),
-					      G_DBUS_CALL_FLAGS_NONE,
-					      -1,
-					      NULL,
-					      &dbus_error
-					      );
-		if (dbus_error != NULL ) {
-			g_warning ("Error in dbus - %s", dbus_error->message);
-			g_error_free (dbus_error);
-			ret = TRUE;
+/**
+ * gpm_control_can_suspend_cb:
+ **/
+static void
+gpm_control_can_suspend_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GpmControl *control = GPM_CONTROL (user_data);
+	gboolean allowed;
+
+	if (egg_console_kit_can_finish (EGG_CONSOLE_KIT (source), res, &allowed, NULL))
+		control->priv->can_suspend = allowed;
+	g_object_unref (control);
+}
+
+/**
+ * gpm_control_can_hibernate_cb:
+ **/
+static void
+gpm_control_can_hibernate_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GpmControl *control = GPM_CONTROL (user_data);
+	gboolean allowed;
+
+	if (egg_console_kit_can_finish (EGG_CONSOLE_KIT (source), res, &allowed, NULL))
+		control->priv->can_hibernate = allowed;
+	g_object_unref (control);
+}
+
+/**
+ * gpm_control_console_kit_refresh:
+ *
+ * Asks ConsoleKit in the background what we may do, so that the answer
+ * is already known when the user wants to sleep.
+ **/
+static void
+gpm_control_console_kit_refresh (GpmControl *control)
+{
+	egg_console_kit_can_suspend_async (control->priv->console,
+					   gpm_control_can_suspend_cb,
+					   g_object_ref (control));
+	egg_console_kit_can_hibernate_async (control->priv->console,
+					     gpm_control_can_hibernate_cb,
+					     g_object_ref (control));
+}
+
+/**
+ * gpm_control_sleep_denied:
+ **/
+static void
+gpm_control_sleep_denied (GTask *task)
+{
+	GpmControl *control = g_task_get_source_object (task);
+	GpmControlSleep *state = g_task_get_task_data (task);
+	const gchar *method;
+
+	method = gpm_control_action_get_method (state->action);
+	g_debug ("cannot %s as not allowed from policy", method);
+	control->priv->sleeping = FALSE;
+	control->priv->sleep_task = NULL;
+	g_task_return_new_error (task, GPM_CONTROL_ERROR, GPM_CONTROL_ERROR_GENERAL,
+				 "Cannot %s", method);
+	g_object_unref (task);
+}
+
+/**
+ * gpm_control_sleep_allowed_cb:
+ *
+ * Only used when ConsoleKit had not answered in the background yet.
+ **/
+static void
+gpm_control_sleep_allowed_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GTask *task = G_TASK (user_data);
+	GpmControl *control = g_task_get_source_object (task);
+	GpmControlSleep *state = g_task_get_task_data (task);
+	gboolean allowed;
+
+	/* a failure has already been warned about, and is not allowed */
+	if (egg_console_kit_can_finish (EGG_CONSOLE_KIT (source), res, &allowed, NULL)) {
+		if (state->action == GPM_CONTROL_ACTION_SUSPEND)
+			control->priv->can_suspend = allowed;
+		else
+			control->priv->can_hibernate = allowed;
+	}
+	if (!allowed) {
+		gpm_control_sleep_denied (task);
+		return;
+	}
+	gpm_control_sleep_prepare (task);
+}
+
+/**
+ * gpm_control_sleep_async:
+ *
+ * Suspends or hibernates, the steps are the same apart from the names.
+ * The keyrings are locked, logind connected to and the screen locked all
+ * at the same time, so the time to sleep is the slowest step rather than
+ * the sum of all of them. Every step is given up on after
+ * GPM_CONTROL_PREPARE_TIMEOUT seconds, and the main loop keeps running
+ * throughout.
+ *
+ * @external is set when logind has told us it is about to sleep, so we
+ * only have to prepare and then release the delay inhibitor.
+ **/
+static void
+gpm_control_sleep_async (GpmControl *control, GpmControlAction action, gboolean external,
+			 GAsyncReadyCallback callback, gpointer user_data)
+{
+	GpmControlSleep *state;
+	const gchar *method;
+	gint allowed;
+	GTask *task;
+
+	g_return_if_fail (GPM_IS_CONTROL (control));
+
+	method = gpm_control_action_get_method (action);
+	task = g_task_new (control, NULL, callback, user_data);
+
+	/* the button may be pressed again while we are still locking */
+	if (control->priv->sleeping) {
+		g_task_return_new_error (task, GPM_CONTROL_ERROR, GPM_CONTROL_ERROR_BUSY,
+					 "Cannot %s: already going to sleep", method);
+		g_object_unref (task);
+		return;
+	}
+
+	control->priv->sleeping = TRUE;
+	control->priv->sleep_task = task;
+	state = g_new0 (GpmControlSleep, 1);
+	state->action = action;
+	state->external = external;
+	state->screensaver = gpm_screensaver_new ();
+	state->cancellable = g_cancellable_new ();
+	state->timer = gpm_timer_new ();
+	state->start = g_get_monotonic_time ();
+	g_task_set_task_data (task, state, (GDestroyNotify) gpm_control_sleep_free);
+
+	/* a sleep started elsewhere may be either, so lock if either would */
+	if (action == GPM_CONTROL_ACTION_SUSPEND)
+		state->do_lock = gpm_control_get_lock_policy (control, GPM_SETTINGS_LOCK_ON_SUSPEND);
+	else if (action == GPM_CONTROL_ACTION_HIBERNATE)
+		state->do_lock = gpm_control_get_lock_policy (control, GPM_SETTINGS_LOCK_ON_HIBERNATE);
+	else
+		state->do_lock = gpm_control_get_lock_policy (control, GPM_SETTINGS_LOCK_ON_SUSPEND) ||
+				 gpm_control_get_lock_policy (control, GPM_SETTINGS_LOCK_ON_HIBERNATE);
+	state->nm_sleep = g_settings_get_boolean (control->priv->settings, GPM_SETTINGS_NETWORKMANAGER_SLEEP);
+
+	/* nothing is done if ConsoleKit says we may not sleep */
+	if (!external && !LOGIND_RUNNING()) {
+		if (action == GPM_CONTROL_ACTION_SUSPEND)
+			allowed = control->priv->can_suspend;
+		else
+			allowed = control->priv->can_hibernate;
+
+		/* not answered yet, so this once we have to wait for it */
+		if (allowed < 0) {
+			if (action == GPM_CONTROL_ACTION_SUSPEND)
+				egg_console_kit_can_suspend_async (control->priv->console,
+								   gpm_control_sleep_allowed_cb, task);
+			else
+				egg_console_kit_can_hibernate_async (control->priv->console,
+								     gpm_control_sleep_allowed_cb, task);
+			return;
 		}
-		else {
-			g_variant_unref(res);
-			ret = TRUE;
+
+		/* the policy may change, so have a fresh answer for next time */
+		gpm_control_console_kit_refresh (control);
+		if (!allowed) {
+			gpm_control_sleep_denied (task);
+			return;
 		}
 	}
-	else {
-		console = egg_console_kit_new ();
-		ret = egg_console_kit_hibernate (console, error);
-		g_object_unref (console);
-	}
+	gpm_control_sleep_prepare (task);
+}
 
-	g_debug ("emitting resume");
-	g_signal_emit (control, signals [RESUME], 0, GPM_CONTROL_ACTION_HIBERNATE);
+/**
+ * gpm_control_suspend_async:
+ **/
+void
+gpm_control_suspend_async (GpmControl *control, GAsyncReadyCallback callback, gpointer user_data)
+{
+	gpm_control_sleep_async (control, GPM_CONTROL_ACTION_SUSPEND, FALSE, callback, user_data);
+}
 
-	if (do_lock) {
-		gpm_screensaver_poke (screensaver);
-		if (throttle_cookie)
-			gpm_screensaver_remove_throttle (screensaver, throttle_cookie);
+/**
+ * gpm_control_suspend_finish:
+ **/
+gboolean
+gpm_control_suspend_finish (GpmControl *control, GAsyncResult *res, GError **error)
+{
+	g_return_val_if_fail (g_task_is_valid (res, control), FALSE);
+	return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+/**
+ * gpm_control_hibernate_async:
+ **/
+void
+gpm_control_hibernate_async (GpmControl *control, GAsyncReadyCallback callback, gpointer user_data)
+{
+	gpm_control_sleep_async (control, GPM_CONTROL_ACTION_HIBERNATE, FALSE, callback, user_data);
+}
+
+/**
+ * gpm_control_hibernate_finish:
+ **/
+gboolean
+gpm_control_hibernate_finish (GpmControl *control, GAsyncResult *res, GError **error)
+{
+	g_return_val_if_fail (g_task_is_valid (res, control), FALSE);
+	return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+/**
+ * gpm_control_logind_signal_cb:
+ *
+ * Sleeps started elsewhere, e.g. by systemctl, another session or logind
+ * handling the lid itself, get the same preparation as our own, and the
+ * resume work is driven from logind rather than the reply to Suspend.
+ **/
+static void
+gpm_control_logind_signal_cb (GDBusProxy *proxy, const gchar *sender_name,
+			      const gchar *signal_name, GVariant *parameters,
+			      GpmControl *control)
+{
+	GpmControlSleep *state;
+	gboolean start;
+
+	if (g_strcmp0 (signal_name, "PrepareForSleep") != 0)
+		return;
+	g_variant_get (parameters, "(b)", &start);
+	g_debug ("logind PrepareForSleep(%s)", start ? "true" : "false");
+
+	if (start) {
+		if (control->priv->sleep_task == NULL) {
+			/* logind does not say which, so neither policy is assumed */
+			gpm_control_sleep_async (control, GPM_CONTROL_ACTION_UNKNOWN, TRUE, NULL, NULL);
+			return;
+		}
+		state = g_task_get_task_data (control->priv->sleep_task);
+		if (state->request == 0) {
+			/* someone else got there while we were preparing */
+			state->external = TRUE;
+			return;
+		}
+		gpm_control_uninhibit (control);
+		return;
 	}
 
-	nm_sleep = g_settings_get_boolean (control->priv->settings, GPM_SETTINGS_NETWORKMANAGER_SLEEP);
-	if (nm_sleep)
-		gpm_networkmanager_wake ();
+	if (control->priv->sleep_task == NULL) {
+		gpm_control_inhibit (control);
+		return;
+	}
+	state = g_task_get_task_data (control->priv->sleep_task);
+	if (state->request == 0) {
+		/* the inhibitor timed out before we were ready */
+		state->woken = TRUE;
+		return;
+	}
+	if (state->external || state->replied)
+		gpm_control_sleep_complete (control->priv->sleep_task, NULL);
+	else
+		gpm_control_sleep_resume (control->priv->sleep_task);
+}
 
-out:
-	g_object_unref (screensaver);
-	return ret;
+/**
+ * gpm_control_set_logind_proxy:
+ **/
+static void
+gpm_control_set_logind_proxy (GpmControl *control, GDBusProxy *proxy)
+{
+	/* the monitor and a sleep request may both have connected */
+	if (control->priv->logind_proxy != NULL)
+		return;
+	control->priv->logind_proxy = g_object_ref (proxy);
+	g_signal_connect (proxy, "g-signal",
+			  G_CALLBACK (gpm_control_logind_signal_cb), control);
+	gpm_control_inhibit (control);
+}
+
+/**
+ * gpm_control_logind_monitor_cb:
+ **/
+static void
+gpm_control_logind_monitor_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GpmControl *control = GPM_CONTROL (user_data);
+	GDBusProxy *proxy;
+	GError *error = NULL;
+
+	proxy = gpm_proxy_pool_get_finish (GPM_PROXY_POOL (source), res, &error);
+	if (proxy == NULL) {
+		g_warning ("cannot monitor logind: %s", error->message);
+		g_error_free (error);
+	} else {
+		gpm_control_set_logind_proxy (control, proxy);
+		g_object_unref (proxy);
+	}
+	g_object_unref (control);
 }
 
 /**
@@ -523,6 +1144,14 @@ gpm_control_finalize (GObject *object)
 	control = GPM_CONTROL (object);
 
 	g_object_unref (control->priv->settings);
+	if (control->priv->logind_proxy != NULL) {
+		g_signal_handlers_disconnect_by_data (control->priv->logind_proxy, control);
+		g_object_unref (control->priv->logind_proxy);
+	}
+	gpm_control_uninhibit (control);
+	g_object_unref (control->priv->pool);
+	if (control->priv->console != NULL)
+		g_object_unref (control->priv->console);
 
 	g_return_if_fail (control->priv != NULL);
 	G_OBJECT_CLASS (gpm_control_parent_class)->finalize (object);
@@ -567,6 +1196,18 @@ gpm_control_init (GpmControl *control)
 	control->priv = gpm_control_get_instance_private (control);
 
 	control->priv->settings = g_settings_new (GPM_SETTINGS_SCHEMA);
+	control->priv->inhibit_fd = -1;
+
+	control->priv->pool = gpm_proxy_pool_new ();
+	if (LOGIND_RUNNING()) {
+		gpm_proxy_pool_get_async (control->priv->pool, GPM_PROXY_POOL_LOGIND, NULL,
+					  gpm_control_logind_monitor_cb, g_object_ref (control));
+	} else {
+		control->priv->console = egg_console_kit_new ();
+		control->priv->can_suspend = -1;
+		control->priv->can_hibernate = -1;
+		gpm_control_console_kit_refresh (control);
+	}
 }
 
 /**
@@ -25,6 +25,7 @@
 #define __GPM_CONTROL_H
 
 #include <glib-object.h>
+#include <gio/gio.h>
 
 G_BEGIN_DECLS
 
@@ -47,12 +48,14 @@ typedef enum
 {
 	 GPM_CONTROL_ACTION_SUSPEND,
 	 GPM_CONTROL_ACTION_HIBERNATE,
+	 GPM_CONTROL_ACTION_UNKNOWN,	/* started elsewhere */
 	 GPM_CONTROL_ACTION_LAST
 } GpmControlAction;
 
 typedef enum
 {
 	 GPM_CONTROL_ERROR_GENERAL,
+	 GPM_CONTROL_ERROR_BUSY,
 	 GPM_CONTROL_ERROR_LAST
 } GpmControlError;
 
@@ -74,9 +77,17 @@ typedef struct
 GQuark		 gpm_control_error_quark		(void);
 GType		 gpm_control_get_type			(void);
 GpmControl	*gpm_control_new			(void);
-gboolean	 gpm_control_suspend			(GpmControl	*control,
+void		 gpm_control_suspend_async		(GpmControl	*control,
+							 GAsyncReadyCallback callback,
+							 gpointer	 user_data);
+gboolean	 gpm_control_suspend_finish		(GpmControl	*control,
+							 GAsyncResult	*res,
 							 GError		**error);
-gboolean	 gpm_control_hibernate			(GpmControl	*control,
+void		 gpm_control_hibernate_async		(GpmControl	*control,
+							 GAsyncReadyCallback callback,
+							 gpointer	 user_data);
+gboolean	 gpm_control_hibernate_finish		(GpmControl	*control,
+							 GAsyncResult	*res,
 							 GError		**error);
 gboolean	 gpm_control_shutdown			(GpmControl	*control,
 						 	 GError		**error);
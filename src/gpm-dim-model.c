@@ -0,0 +1,350 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Learns how often the user undoes the idle dim straight away, and picks
+ * the dim timeout from that. History is kept apart for AC and battery
+ * power and for each part of the day, as a fixed handful of numbers per
+ * bucket. Each bucket tracks a short list of timeouts, multiples of the
+ * configured one. For each of them it keeps a running average of how
+ * many idle periods long enough to dim at it ended within a few seconds
+ * of the dim. The shortest timeout that is unwanted rarely enough dims
+ * for longest, so it is the one used.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <glib.h>
+
+#include "gpm-dim-model.h"
+
+#define GPM_DIM_MODEL_CANDIDATES	6
+#define GPM_DIM_MODEL_BANDS		4	/* of six hours */
+#define GPM_DIM_MODEL_BUCKETS		(2 * GPM_DIM_MODEL_BANDS)
+#define GPM_DIM_MODEL_GRACE		10	/* s, undimming sooner means the dim was unwanted */
+#define GPM_DIM_MODEL_TARGET		0.1f	/* of dims that can be unwanted */
+#define GPM_DIM_MODEL_WEIGHT		0.1f	/* of each idle period, once there is history */
+#define GPM_DIM_MODEL_MIN_SAMPLES	5	/* before a timeout can be ruled out */
+
+/* the timeouts tried, as multiples of the configured one */
+static const gfloat gpm_dim_model_scale[GPM_DIM_MODEL_CANDIDATES] = { 1.0f, 1.5f, 2.0f, 3.0f, 4.0f, 6.0f };
+
+typedef struct
+{
+	gfloat			 unwanted[GPM_DIM_MODEL_CANDIDATES];
+	guint8			 samples[GPM_DIM_MODEL_CANDIDATES];
+} GpmDimModelBucket;
+
+struct GpmDimModelPrivate
+{
+	guint			 timeout;	/* configured, in seconds */
+	GpmDimModelBucket	 buckets[GPM_DIM_MODEL_BUCKETS];
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE (GpmDimModel, gpm_dim_model, G_TYPE_OBJECT)
+
+/**
+ * gpm_dim_model_get_bucket:
+ * @hour: The hour of the day, from 0 to 23
+ **/
+static GpmDimModelBucket *
+gpm_dim_model_get_bucket (GpmDimModel *model, gboolean on_battery, guint hour)
+{
+	guint band = (hour % 24) / (24 / GPM_DIM_MODEL_BANDS);
+	return &model->priv->buckets[(on_battery ? GPM_DIM_MODEL_BANDS : 0) + band];
+}
+
+/**
+ * gpm_dim_model_get_candidate:
+ *
+ * Return value: the timeout tried at @index, in seconds
+ **/
+static guint
+gpm_dim_model_get_candidate (GpmDimModel *model, guint index)
+{
+	return (guint) (model->priv->timeout * gpm_dim_model_scale[index] + 0.5f);
+}
+
+/**
+ * gpm_dim_model_set_timeout:
+ * @timeout: The configured dim timeout, in seconds
+ *
+ * The history is about multiples of the timeout, so it is forgotten if
+ * the timeout changes.
+ **/
+void
+gpm_dim_model_set_timeout (GpmDimModel *model, guint timeout)
+{
+	g_return_if_fail (GPM_IS_DIM_MODEL (model));
+
+	if (model->priv->timeout == timeout)
+		return;
+	g_debug ("dim timeout now %us, forgetting history", timeout);
+	model->priv->timeout = timeout;
+	memset (model->priv->buckets, 0, sizeof (model->priv->buckets));
+}
+
+/**
+ * gpm_dim_model_get_timeout:
+ * @on_battery: If the computer is on battery power
+ * @hour: The hour of the day, from 0 to 23
+ *
+ * Return value: the shortest timeout that is unwanted rarely enough, or
+ * that there is not enough history to rule out, in seconds
+ **/
+guint
+gpm_dim_model_get_timeout (GpmDimModel *model, gboolean on_battery, guint hour)
+{
+	GpmDimModelBucket *bucket;
+	guint i;
+
+	g_return_val_if_fail (GPM_IS_DIM_MODEL (model), 0);
+
+	if (model->priv->timeout == 0)
+		return 0;
+
+	bucket = gpm_dim_model_get_bucket (model, on_battery, hour);
+	for (i=0; i<GPM_DIM_MODEL_CANDIDATES - 1; i++) {
+		if (bucket->samples[i] < GPM_DIM_MODEL_MIN_SAMPLES ||
+		    bucket->unwanted[i] <= GPM_DIM_MODEL_TARGET)
+			break;
+	}
+	return gpm_dim_model_get_candidate (model, i);
+}
+
+/**
+ * gpm_dim_model_add_idle:
+ * @on_battery: If the computer was on battery power
+ * @hour: The hour of the day the idle period started, from 0 to 23
+ * @idle_time: How long the user was idle for, in seconds
+ *
+ * Learns from an idle period, whatever the dim timeout was at the time.
+ * Only the timeouts the period was long enough to reach learn from it.
+ **/
+void
+gpm_dim_model_add_idle (GpmDimModel *model, gboolean on_battery, guint hour, guint idle_time)
+{
+	GpmDimModelBucket *bucket;
+	gfloat weight;
+	guint timeout;
+	guint i;
+
+	g_return_if_fail (GPM_IS_DIM_MODEL (model));
+
+	bucket = gpm_dim_model_get_bucket (model, on_battery, hour);
+	for (i=0; i<GPM_DIM_MODEL_CANDIDATES; i++) {
+		/* would not have dimmed at all */
+		timeout = gpm_dim_model_get_candidate (model, i);
+		if (timeout > idle_time)
+			break;
+
+		/* a plain average to start with, then recent history counts most */
+		weight = MAX (1.0f / (bucket->samples[i] + 1), GPM_DIM_MODEL_WEIGHT);
+		bucket->unwanted[i] += weight * ((idle_time - timeout < GPM_DIM_MODEL_GRACE ? 1.0f : 0.0f) -
+						 bucket->unwanted[i]);
+		if (bucket->samples[i] < G_MAXUINT8)
+			bucket->samples[i]++;
+	}
+	g_debug ("idle for %us, dim timeout now %us", idle_time,
+		 gpm_dim_model_get_timeout (model, on_battery, hour));
+}
+
+/**
+ * gpm_dim_model_to_variant:
+ *
+ * Return value: the configured timeout and the history, suitable for
+ * saving in GSettings
+ **/
+GVariant *
+gpm_dim_model_to_variant (GpmDimModel *model)
+{
+	GVariantBuilder builder;
+	GpmDimModelBucket *bucket;
+	guint i, j;
+
+	g_return_val_if_fail (GPM_IS_DIM_MODEL (model), NULL);
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("aq"));
+	for (i=0; i<GPM_DIM_MODEL_BUCKETS; i++) {
+		bucket = &model->priv->buckets[i];
+		for (j=0; j<GPM_DIM_MODEL_CANDIDATES; j++) {
+			g_variant_builder_add (&builder, "q", (guint16) (bucket->unwanted[j] * G_MAXUINT16 + 0.5f));
+			g_variant_builder_add (&builder, "q", (guint16) bucket->samples[j]);
+		}
+	}
+	return g_variant_new ("(qaq)", (guint16) MIN (model->priv->timeout, G_MAXUINT16), &builder);
+}
+
+/**
+ * gpm_dim_model_from_variant:
+ *
+ * Return value: %TRUE if @variant was saved by gpm_dim_model_to_variant()
+ **/
+gboolean
+gpm_dim_model_from_variant (GpmDimModel *model, GVariant *variant)
+{
+	GVariant *history = NULL;
+	const guint16 *values;
+	GpmDimModelBucket *bucket;
+	guint16 timeout;
+	gsize len;
+	gboolean ret = FALSE;
+	guint i, j;
+
+	g_return_val_if_fail (GPM_IS_DIM_MODEL (model), FALSE);
+	g_return_val_if_fail (variant != NULL, FALSE);
+
+	if (!g_variant_is_of_type (variant, G_VARIANT_TYPE ("(qaq)")))
+		goto out;
+	g_variant_get (variant, "(q@aq)", &timeout, &history);
+	values = g_variant_get_fixed_array (history, &len, sizeof (guint16));
+	if (len != GPM_DIM_MODEL_BUCKETS * GPM_DIM_MODEL_CANDIDATES * 2) {
+		g_debug ("ignoring dim history of %" G_GSIZE_FORMAT " values", len);
+		goto out;
+	}
+
+	model->priv->timeout = timeout;
+	for (i=0; i<GPM_DIM_MODEL_BUCKETS; i++) {
+		bucket = &model->priv->buckets[i];
+		for (j=0; j<GPM_DIM_MODEL_CANDIDATES; j++) {
+			bucket->unwanted[j] = (gfloat) *values++ / G_MAXUINT16;
+			bucket->samples[j] = (guint8) MIN (*values++, G_MAXUINT8);
+		}
+	}
+	ret = TRUE;
+out:
+	if (history != NULL)
+		g_variant_unref (history);
+	return ret;
+}
+
+/**
+ * gpm_dim_model_class_init:
+ * @klass: This class instance
+ **/
+static void
+gpm_dim_model_class_init (GpmDimModelClass *klass)
+{
+}
+
+/**
+ * gpm_dim_model_init:
+ **/
+static void
+gpm_dim_model_init (GpmDimModel *model)
+{
+	model->priv = gpm_dim_model_get_instance_private (model);
+	model->priv->timeout = 0;
+}
+
+/**
+ * gpm_dim_model_new:
+ * Return value: A new GpmDimModel instance.
+ **/
+GpmDimModel *
+gpm_dim_model_new (void)
+{
+	return g_object_new (GPM_TYPE_DIM_MODEL, NULL);
+}
+
+/***************************************************************************
+ ***                          MAKE CHECK TESTS                           ***
+ ***************************************************************************/
+#ifdef EGG_TEST
+#include "egg-test.h"
+
+void
+gpm_dim_model_test (gpointer data)
+{
+	GpmDimModel *model;
+	GpmDimModel *model_copy;
+	GVariant *variant;
+	EggTest *test = (EggTest *) data;
+	gboolean ret;
+	guint i;
+
+	if (!egg_test_start (test, "GpmDimModel"))
+		return;
+
+	/************************************************************/
+	egg_test_title (test, "get object");
+	model = gpm_dim_model_new ();
+	egg_test_assert (test, (model != NULL));
+
+	/************************************************************/
+	egg_test_title (test, "check the configured timeout is used with no history");
+	gpm_dim_model_set_timeout (model, 10);
+	egg_test_assert (test, (gpm_dim_model_get_timeout (model, TRUE, 14) == 10));
+
+	/************************************************************/
+	egg_test_title (test, "check a few quick undims are not enough to back off");
+	for (i=0; i<GPM_DIM_MODEL_MIN_SAMPLES - 1; i++)
+		gpm_dim_model_add_idle (model, TRUE, 14, 12);
+	egg_test_assert (test, (gpm_dim_model_get_timeout (model, TRUE, 14) == 10));
+
+	/************************************************************/
+	egg_test_title (test, "check backing off when the dim keeps being undone");
+	for (i=0; i<20; i++)
+		gpm_dim_model_add_idle (model, TRUE, 14, 12);
+	egg_test_assert (test, (gpm_dim_model_get_timeout (model, TRUE, 14) == 15));
+
+	/************************************************************/
+	egg_test_title (test, "check the other buckets are not changed");
+	egg_test_assert (test, (gpm_dim_model_get_timeout (model, FALSE, 14) == 10 &&
+				gpm_dim_model_get_timeout (model, TRUE, 2) == 10));
+
+	/************************************************************/
+	egg_test_title (test, "check the history can be saved and loaded");
+	variant = g_variant_ref_sink (gpm_dim_model_to_variant (model));
+	model_copy = gpm_dim_model_new ();
+	ret = gpm_dim_model_from_variant (model_copy, variant);
+	g_variant_unref (variant);
+	egg_test_assert (test, (ret && gpm_dim_model_get_timeout (model_copy, TRUE, 14) == 15));
+
+	/************************************************************/
+	egg_test_title (test, "check unknown history is not loaded");
+	variant = g_variant_ref_sink (g_variant_new ("(q@aq)", 10,
+						     g_variant_new_fixed_array (G_VARIANT_TYPE_UINT16, NULL, 0, sizeof (guint16))));
+	ret = gpm_dim_model_from_variant (model_copy, variant);
+	g_variant_unref (variant);
+	egg_test_assert (test, (!ret && gpm_dim_model_get_timeout (model_copy, TRUE, 14) == 15));
+	g_object_unref (model_copy);
+
+	/************************************************************/
+	egg_test_title (test, "check coming back down once the user stays away");
+	for (i=0; i<30; i++)
+		gpm_dim_model_add_idle (model, TRUE, 14, 100);
+	egg_test_assert (test, (gpm_dim_model_get_timeout (model, TRUE, 14) == 10));
+
+	/************************************************************/
+	egg_test_title (test, "check changing the timeout forgets the history");
+	for (i=0; i<20; i++)
+		gpm_dim_model_add_idle (model, TRUE, 14, 12);
+	gpm_dim_model_set_timeout (model, 20);
+	egg_test_assert (test, (gpm_dim_model_get_timeout (model, TRUE, 14) == 20));
+
+	g_object_unref (model);
+
+	egg_test_end (test);
+}
+
+#endif
@@ -0,0 +1,68 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __GPM_DIM_MODEL_H
+#define __GPM_DIM_MODEL_H
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define GPM_TYPE_DIM_MODEL		(gpm_dim_model_get_type ())
+#define GPM_DIM_MODEL(o)		(G_TYPE_CHECK_INSTANCE_CAST ((o), GPM_TYPE_DIM_MODEL, GpmDimModel))
+#define GPM_DIM_MODEL_CLASS(k)		(G_TYPE_CHECK_CLASS_CAST((k), GPM_TYPE_DIM_MODEL, GpmDimModelClass))
+#define GPM_IS_DIM_MODEL(o)		(G_TYPE_CHECK_INSTANCE_TYPE ((o), GPM_TYPE_DIM_MODEL))
+#define GPM_IS_DIM_MODEL_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), GPM_TYPE_DIM_MODEL))
+#define GPM_DIM_MODEL_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), GPM_TYPE_DIM_MODEL, GpmDimModelClass))
+
+typedef struct GpmDimModelPrivate GpmDimModelPrivate;
+
+typedef struct
+{
+	GObject			 parent;
+	GpmDimModelPrivate	*priv;
+} GpmDimModel;
+
+typedef struct
+{
+	GObjectClass	parent_class;
+} GpmDimModelClass;
+
+GType		 gpm_dim_model_get_type			(void);
+GpmDimModel	*gpm_dim_model_new			(void);
+void		 gpm_dim_model_test			(gpointer	 data);
+
+void		 gpm_dim_model_set_timeout		(GpmDimModel	*model,
+							 guint		 timeout);
+guint		 gpm_dim_model_get_timeout		(GpmDimModel	*model,
+							 gboolean	 on_battery,
+							 guint		 hour);
+void		 gpm_dim_model_add_idle			(GpmDimModel	*model,
+							 gboolean	 on_battery,
+							 guint		 hour,
+							 guint		 idle_time);
+GVariant	*gpm_dim_model_to_variant		(GpmDimModel	*model);
+gboolean	 gpm_dim_model_from_variant		(GpmDimModel	*model,
+							 GVariant	*variant);
+
+G_END_DECLS
+
+#endif /* __GPM_DIM_MODEL_H */
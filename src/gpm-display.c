@@ -0,0 +1,555 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Applies the display state wanted for a transition in one go. The
+ * backlight, the keyboard backlight and the manager each react to the
+ * same idle or lid event; they only say what they want here, and the
+ * last word for each part wins. The state is applied once they have all
+ * been heard, in an order that keeps the user from seeing the steps: the
+ * screen is lit before its brightness is set, and the keyboard goes dark
+ * before the screen does. The panel brightness is not set at all when
+ * the screen is switched off, as it is set again when it comes back.
+ *
+ * The DPMS mode last applied is remembered, so the dim and normal
+ * transitions do not ask for DPMS on again and again. The brightness
+ * funcs are always called, as their owners also set the lights outside
+ * of a transition and already skip a value that is set.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <glib.h>
+#include <glib/gi18n.h>
+
+#include "gpm-display.h"
+#include "gpm-dpms.h"
+#include "gpm-screensaver.h"
+
+/*
+ * What actually switches the screen and throttles the screensaver, so
+ * that the ordering can be tested without either.
+ */
+typedef struct {
+	gboolean	 (*set_dpms_mode)	(GpmDisplay		*display,
+						 GpmDpmsMode		 mode,
+						 GError			**error);
+	guint32		 (*add_throttle)	(GpmDisplay		*display);
+	void		 (*remove_throttle)	(GpmDisplay		*display,
+						 guint32		 cookie);
+} GpmDisplayBackend;
+
+struct GpmDisplayPrivate
+{
+	const GpmDisplayBackend	*backend;
+	GpmDpms			*dpms;
+	GpmScreensaver		*screensaver;
+	GpmDpmsMode		 applied_dpms_mode;	/* or unknown */
+	guint32			 throttle_id;
+	GpmDisplayLightFunc	 panel_func;
+	gpointer		 panel_data;
+	GpmDisplayLightFunc	 kbd_func;
+	gpointer		 kbd_data;
+	/* wanted, but not applied yet */
+	gboolean		 has_brightness;
+	guint			 brightness;
+	gboolean		 has_kbd_brightness;
+	guint			 kbd_brightness;
+	GpmDpmsMode		 dpms_mode;	/* or unknown for unchanged */
+	guint			 commit_id;
+};
+
+static gpointer gpm_display_object = NULL;
+
+G_DEFINE_TYPE_WITH_PRIVATE (GpmDisplay, gpm_display, G_TYPE_OBJECT)
+
+/**
+ * gpm_display_update_throttle:
+ *
+ * Throttles the screensaver while the screen is off, since nobody can
+ * see it anyway. Only talks to the screensaver when that changes.
+ **/
+static void
+gpm_display_update_throttle (GpmDisplay *display, GpmDpmsMode mode)
+{
+	if (mode == GPM_DPMS_MODE_ON && display->priv->throttle_id != 0) {
+		display->priv->backend->remove_throttle (display, display->priv->throttle_id);
+		display->priv->throttle_id = 0;
+	} else if (mode != GPM_DPMS_MODE_ON && display->priv->throttle_id == 0) {
+		display->priv->throttle_id = display->priv->backend->add_throttle (display);
+	}
+}
+
+/**
+ * gpm_display_set_dpms:
+ *
+ * Switches the screen, unless it is already in @mode.
+ **/
+static gboolean
+gpm_display_set_dpms (GpmDisplay *display, GpmDpmsMode mode, GError **error)
+{
+	if (mode == display->priv->applied_dpms_mode) {
+		g_debug ("DPMS already %u", mode);
+		return TRUE;
+	}
+	if (!display->priv->backend->set_dpms_mode (display, mode, error)) {
+		display->priv->applied_dpms_mode = GPM_DPMS_MODE_UNKNOWN;
+		return FALSE;
+	}
+	display->priv->applied_dpms_mode = mode;
+	gpm_display_update_throttle (display, mode);
+	return TRUE;
+}
+
+/**
+ * gpm_display_dpms_mode_changed_cb:
+ *
+ * Catches the screen being switched on or off by someone else.
+ **/
+static void
+gpm_display_dpms_mode_changed_cb (GpmDpms *dpms, GpmDpmsMode mode, GpmDisplay *display)
+{
+	g_debug ("DPMS mode changed: %u", mode);
+	display->priv->applied_dpms_mode = mode;
+	gpm_display_update_throttle (display, mode);
+}
+
+/**
+ * gpm_display_real_set_dpms_mode:
+ **/
+static gboolean
+gpm_display_real_set_dpms_mode (GpmDisplay *display, GpmDpmsMode mode, GError **error)
+{
+	return gpm_dpms_set_mode (display->priv->dpms, mode, error);
+}
+
+/**
+ * gpm_display_real_add_throttle:
+ **/
+static guint32
+gpm_display_real_add_throttle (GpmDisplay *display)
+{
+	/* TRANSLATORS: this is the mate-screensaver throttle */
+	return gpm_screensaver_add_throttle (display->priv->screensaver,
+					     _("Display DPMS activated"));
+}
+
+/**
+ * gpm_display_real_remove_throttle:
+ **/
+static void
+gpm_display_real_remove_throttle (GpmDisplay *display, guint32 cookie)
+{
+	gpm_screensaver_remove_throttle (display->priv->screensaver, cookie);
+}
+
+static const GpmDisplayBackend gpm_display_backend_real = {
+	gpm_display_real_set_dpms_mode,
+	gpm_display_real_add_throttle,
+	gpm_display_real_remove_throttle
+};
+
+/**
+ * gpm_display_open_real:
+ **/
+static void
+gpm_display_open_real (GpmDisplay *display)
+{
+	display->priv->backend = &gpm_display_backend_real;
+	display->priv->screensaver = gpm_screensaver_new ();
+	display->priv->dpms = gpm_dpms_new ();
+	g_signal_connect (display->priv->dpms, "mode-changed",
+			  G_CALLBACK (gpm_display_dpms_mode_changed_cb), display);
+}
+
+/**
+ * gpm_display_apply:
+ **/
+static gboolean
+gpm_display_apply (GpmDisplay *display, GError **error)
+{
+	GpmDisplayPrivate *priv = display->priv;
+	GpmDpmsMode mode;
+	gboolean has_brightness;
+	gboolean has_kbd_brightness;
+	gboolean ret = TRUE;
+
+	/* take the transaction, as the funcs may start another */
+	mode = priv->dpms_mode;
+	has_brightness = priv->has_brightness && priv->panel_func != NULL;
+	has_kbd_brightness = priv->has_kbd_brightness && priv->kbd_func != NULL;
+	priv->dpms_mode = GPM_DPMS_MODE_UNKNOWN;
+	priv->has_brightness = FALSE;
+	priv->has_kbd_brightness = FALSE;
+
+	if (mode == GPM_DPMS_MODE_ON) {
+		/* light the screen up before setting how bright it is */
+		ret = gpm_display_set_dpms (display, mode, error);
+		if (has_brightness)
+			priv->panel_func (priv->brightness, priv->panel_data);
+		if (has_kbd_brightness)
+			priv->kbd_func (priv->kbd_brightness, priv->kbd_data);
+
+	} else if (mode != GPM_DPMS_MODE_UNKNOWN) {
+		/* keyboard first, so it is never the only thing left lit */
+		if (has_kbd_brightness)
+			priv->kbd_func (priv->kbd_brightness, priv->kbd_data);
+		ret = gpm_display_set_dpms (display, mode, error);
+		if (ret) {
+			if (has_brightness)
+				g_debug ("not setting brightness %u of a dark screen", priv->brightness);
+		} else if (has_brightness) {
+			priv->panel_func (priv->brightness, priv->panel_data);
+		}
+
+	} else {
+		if (has_brightness)
+			priv->panel_func (priv->brightness, priv->panel_data);
+		if (has_kbd_brightness)
+			priv->kbd_func (priv->kbd_brightness, priv->kbd_data);
+	}
+	return ret;
+}
+
+/**
+ * gpm_display_commit_cb:
+ **/
+static gboolean
+gpm_display_commit_cb (GpmDisplay *display)
+{
+	GError *error = NULL;
+
+	display->priv->commit_id = 0;
+	if (!gpm_display_apply (display, &error)) {
+		g_warning ("failed to change DPMS: %s", error->message);
+		g_error_free (error);
+	}
+	return FALSE;
+}
+
+/**
+ * gpm_display_set_panel_func:
+ * @func: Sets the panel brightness, or %NULL to stop
+ **/
+void
+gpm_display_set_panel_func (GpmDisplay *display, GpmDisplayLightFunc func, gpointer user_data)
+{
+	g_return_if_fail (GPM_IS_DISPLAY (display));
+	display->priv->panel_func = func;
+	display->priv->panel_data = user_data;
+}
+
+/**
+ * gpm_display_set_kbd_func:
+ * @func: Sets the keyboard brightness, or %NULL to stop
+ **/
+void
+gpm_display_set_kbd_func (GpmDisplay *display, GpmDisplayLightFunc func, gpointer user_data)
+{
+	g_return_if_fail (GPM_IS_DISPLAY (display));
+	display->priv->kbd_func = func;
+	display->priv->kbd_data = user_data;
+}
+
+/**
+ * gpm_display_set_brightness:
+ * @percentage: The panel brightness wanted
+ **/
+void
+gpm_display_set_brightness (GpmDisplay *display, guint percentage)
+{
+	g_return_if_fail (GPM_IS_DISPLAY (display));
+	display->priv->has_brightness = TRUE;
+	display->priv->brightness = percentage;
+}
+
+/**
+ * gpm_display_set_kbd_brightness:
+ * @percentage: The keyboard brightness wanted
+ **/
+void
+gpm_display_set_kbd_brightness (GpmDisplay *display, guint percentage)
+{
+	g_return_if_fail (GPM_IS_DISPLAY (display));
+	display->priv->has_kbd_brightness = TRUE;
+	display->priv->kbd_brightness = percentage;
+}
+
+/**
+ * gpm_display_set_dpms_mode:
+ * @mode: The DPMS mode wanted
+ **/
+void
+gpm_display_set_dpms_mode (GpmDisplay *display, GpmDpmsMode mode)
+{
+	g_return_if_fail (GPM_IS_DISPLAY (display));
+	display->priv->dpms_mode = mode;
+}
+
+/**
+ * gpm_display_commit:
+ *
+ * Applies the wanted state once everyone reacting to the current event
+ * has had their say.
+ **/
+void
+gpm_display_commit (GpmDisplay *display)
+{
+	g_return_if_fail (GPM_IS_DISPLAY (display));
+
+	if (display->priv->commit_id != 0)
+		return;
+	display->priv->commit_id = g_idle_add_full (G_PRIORITY_HIGH_IDLE,
+						    (GSourceFunc) gpm_display_commit_cb,
+						    display, NULL);
+	g_source_set_name_by_id (display->priv->commit_id, "[GpmDisplay] commit");
+}
+
+/**
+ * gpm_display_commit_now:
+ *
+ * Applies the wanted state straight away, along with anything already
+ * waiting to be committed.
+ *
+ * Return value: %FALSE if the DPMS mode could not be changed
+ **/
+gboolean
+gpm_display_commit_now (GpmDisplay *display, GError **error)
+{
+	g_return_val_if_fail (GPM_IS_DISPLAY (display), FALSE);
+
+	if (display->priv->commit_id != 0) {
+		g_source_remove (display->priv->commit_id);
+		display->priv->commit_id = 0;
+	}
+	return gpm_display_apply (display, error);
+}
+
+/**
+ * gpm_display_finalize:
+ **/
+static void
+gpm_display_finalize (GObject *object)
+{
+	GpmDisplay *display;
+
+	g_return_if_fail (object != NULL);
+	g_return_if_fail (GPM_IS_DISPLAY (object));
+	display = GPM_DISPLAY (object);
+
+	if (display->priv->commit_id != 0)
+		g_source_remove (display->priv->commit_id);
+	if (display->priv->throttle_id != 0)
+		display->priv->backend->remove_throttle (display, display->priv->throttle_id);
+	if (display->priv->dpms != NULL) {
+		g_signal_handlers_disconnect_by_data (display->priv->dpms, display);
+		g_object_unref (display->priv->dpms);
+	}
+	if (display->priv->screensaver != NULL)
+		g_object_unref (display->priv->screensaver);
+
+	G_OBJECT_CLASS (gpm_display_parent_class)->finalize (object);
+}
+
+/**
+ * gpm_display_class_init:
+ * @klass: This class instance
+ **/
+static void
+gpm_display_class_init (GpmDisplayClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = gpm_display_finalize;
+}
+
+/**
+ * gpm_display_init:
+ **/
+static void
+gpm_display_init (GpmDisplay *display)
+{
+	display->priv = gpm_display_get_instance_private (display);
+	display->priv->dpms_mode = GPM_DPMS_MODE_UNKNOWN;
+	display->priv->applied_dpms_mode = GPM_DPMS_MODE_UNKNOWN;
+}
+
+/**
+ * gpm_display_new:
+ * Return value: A new GpmDisplay instance.
+ **/
+GpmDisplay *
+gpm_display_new (void)
+{
+	if (gpm_display_object != NULL) {
+		g_object_ref (gpm_display_object);
+	} else {
+		gpm_display_object = g_object_new (GPM_TYPE_DISPLAY, NULL);
+		g_object_add_weak_pointer (gpm_display_object, &gpm_display_object);
+		gpm_display_open_real (GPM_DISPLAY (gpm_display_object));
+	}
+	return GPM_DISPLAY (gpm_display_object);
+}
+
+/***************************************************************************
+ ***                          MAKE CHECK TESTS                           ***
+ ***************************************************************************/
+#ifdef EGG_TEST
+#include "egg-test.h"
+
+static GString *_calls = NULL;
+
+static gboolean
+gpm_display_test_set_dpms_mode (GpmDisplay *display, GpmDpmsMode mode, GError **error)
+{
+	g_string_append_printf (_calls, "dpms:%u ", mode);
+	return TRUE;
+}
+
+static guint32
+gpm_display_test_add_throttle (GpmDisplay *display)
+{
+	g_string_append (_calls, "throttle ");
+	return 1;
+}
+
+static void
+gpm_display_test_remove_throttle (GpmDisplay *display, guint32 cookie)
+{
+	g_string_append (_calls, "unthrottle ");
+}
+
+static const GpmDisplayBackend gpm_display_backend_test = {
+	gpm_display_test_set_dpms_mode,
+	gpm_display_test_add_throttle,
+	gpm_display_test_remove_throttle
+};
+
+static void
+gpm_display_test_panel_cb (guint percentage, gpointer user_data)
+{
+	g_string_append_printf (_calls, "panel:%u ", percentage);
+}
+
+static void
+gpm_display_test_kbd_cb (guint percentage, gpointer user_data)
+{
+	g_string_append_printf (_calls, "kbd:%u ", percentage);
+}
+
+/**
+ * gpm_display_test_commit:
+ *
+ * Return value: the calls made by the commit, or %NULL if it failed
+ **/
+static const gchar *
+gpm_display_test_commit (GpmDisplay *display)
+{
+	g_string_truncate (_calls, 0);
+	if (!gpm_display_commit_now (display, NULL))
+		return NULL;
+	return _calls->str;
+}
+
+void
+gpm_display_test (gpointer data)
+{
+	GpmDisplay *display;
+	const gchar *calls;
+	EggTest *test = (EggTest *) data;
+
+	if (!egg_test_start (test, "GpmDisplay"))
+		return;
+
+	/* no screen or screensaver, just the order things are done in */
+	_calls = g_string_new (NULL);
+	display = g_object_new (GPM_TYPE_DISPLAY, NULL);
+	display->priv->backend = &gpm_display_backend_test;
+	gpm_display_set_panel_func (display, gpm_display_test_panel_cb, NULL);
+	gpm_display_set_kbd_func (display, gpm_display_test_kbd_cb, NULL);
+
+	/************************************************************/
+	egg_test_title (test, "check the screen is lit before the panel is set");
+	gpm_display_set_kbd_brightness (display, 100);
+	gpm_display_set_brightness (display, 80);
+	gpm_display_set_dpms_mode (display, GPM_DPMS_MODE_ON);
+	calls = gpm_display_test_commit (display);
+	if (g_strcmp0 (calls, "dpms:0 panel:80 kbd:100 ") == 0)
+		egg_test_success (test, NULL);
+	else
+		egg_test_failed (test, "calls: %s", calls);
+
+	/************************************************************/
+	egg_test_title (test, "check the keyboard goes off before the screen");
+	gpm_display_set_brightness (display, 30);
+	gpm_display_set_dpms_mode (display, GPM_DPMS_MODE_OFF);
+	gpm_display_set_kbd_brightness (display, 0);
+	calls = gpm_display_test_commit (display);
+	if (g_strcmp0 (calls, "kbd:0 dpms:3 throttle ") == 0)
+		egg_test_success (test, NULL);
+	else
+		egg_test_failed (test, "calls: %s", calls);
+
+	/************************************************************/
+	egg_test_title (test, "check the panel is not set while dark");
+	egg_test_assert (test, (strstr (calls, "panel") == NULL));
+
+	/************************************************************/
+	egg_test_title (test, "check the throttle is not added again");
+	gpm_display_set_dpms_mode (display, GPM_DPMS_MODE_STANDBY);
+	calls = gpm_display_test_commit (display);
+	if (g_strcmp0 (calls, "dpms:1 ") == 0)
+		egg_test_success (test, NULL);
+	else
+		egg_test_failed (test, "calls: %s", calls);
+
+	/************************************************************/
+	egg_test_title (test, "check the throttle is removed when the screen is lit");
+	gpm_display_set_brightness (display, 80);
+	gpm_display_set_dpms_mode (display, GPM_DPMS_MODE_ON);
+	calls = gpm_display_test_commit (display);
+	if (g_strcmp0 (calls, "dpms:0 unthrottle panel:80 ") == 0)
+		egg_test_success (test, NULL);
+	else
+		egg_test_failed (test, "calls: %s", calls);
+
+	/************************************************************/
+	egg_test_title (test, "check a lit screen is not switched on again");
+	gpm_display_set_brightness (display, 40);
+	gpm_display_set_dpms_mode (display, GPM_DPMS_MODE_ON);
+	calls = gpm_display_test_commit (display);
+	if (g_strcmp0 (calls, "panel:40 ") == 0)
+		egg_test_success (test, NULL);
+	else
+		egg_test_failed (test, "calls: %s", calls);
+
+	/************************************************************/
+	egg_test_title (test, "check nothing is done with nothing wanted");
+	calls = gpm_display_test_commit (display);
+	egg_test_assert (test, (g_strcmp0 (calls, "") == 0));
+
+	g_object_unref (display);
+	g_string_free (_calls, TRUE);
+
+	egg_test_end (test);
+}
+
+#endif
@@ -0,0 +1,78 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __GPM_DISPLAY_H
+#define __GPM_DISPLAY_H
+
+#include <glib-object.h>
+
+#include "gpm-dpms.h"
+
+G_BEGIN_DECLS
+
+#define GPM_TYPE_DISPLAY		(gpm_display_get_type ())
+#define GPM_DISPLAY(o)			(G_TYPE_CHECK_INSTANCE_CAST ((o), GPM_TYPE_DISPLAY, GpmDisplay))
+#define GPM_DISPLAY_CLASS(k)		(G_TYPE_CHECK_CLASS_CAST((k), GPM_TYPE_DISPLAY, GpmDisplayClass))
+#define GPM_IS_DISPLAY(o)		(G_TYPE_CHECK_INSTANCE_TYPE ((o), GPM_TYPE_DISPLAY))
+#define GPM_IS_DISPLAY_CLASS(k)		(G_TYPE_CHECK_CLASS_TYPE ((k), GPM_TYPE_DISPLAY))
+#define GPM_DISPLAY_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), GPM_TYPE_DISPLAY, GpmDisplayClass))
+
+typedef struct GpmDisplayPrivate GpmDisplayPrivate;
+
+typedef struct
+{
+	GObject			 parent;
+	GpmDisplayPrivate	*priv;
+} GpmDisplay;
+
+typedef struct
+{
+	GObjectClass	parent_class;
+} GpmDisplayClass;
+
+/* sets a light to a percentage, for whoever owns the hardware */
+typedef void	(*GpmDisplayLightFunc)			(guint		 percentage,
+							 gpointer	 user_data);
+
+GType		 gpm_display_get_type			(void);
+GpmDisplay	*gpm_display_new			(void);
+
+void		 gpm_display_set_panel_func		(GpmDisplay	*display,
+							 GpmDisplayLightFunc func,
+							 gpointer	 user_data);
+void		 gpm_display_set_kbd_func		(GpmDisplay	*display,
+							 GpmDisplayLightFunc func,
+							 gpointer	 user_data);
+
+void		 gpm_display_set_brightness		(GpmDisplay	*display,
+							 guint		 percentage);
+void		 gpm_display_set_kbd_brightness		(GpmDisplay	*display,
+							 guint		 percentage);
+void		 gpm_display_set_dpms_mode		(GpmDisplay	*display,
+							 GpmDpmsMode	 mode);
+void		 gpm_display_commit			(GpmDisplay	*display);
+gboolean	 gpm_display_commit_now			(GpmDisplay	*display,
+							 GError		**error);
+void		 gpm_display_test			(gpointer	 data);
+
+G_END_DECLS
+
+#endif /* __GPM_DISPLAY_H */
@@ -42,6 +42,7 @@
 #include <X11/extensions/dpms.h>
 
 #include "gpm-dpms.h"
+#include "gpm-timer.h"
 
 static void   gpm_dpms_finalize  (GObject   *object);
 
@@ -52,6 +53,7 @@ struct GpmDpmsPrivate
 {
 	gboolean		 dpms_capable;
 	GpmDpmsMode		 mode;
+	GpmTimer		*timer;
 	guint			 timer_id;
 	Display			*display;
 };
@@ -296,8 +298,9 @@ gpm_dpms_init (GpmDpms *dpms)
 	/* DPMSCapable() can never change for a given display */
 	dpms->priv->display = GDK_DISPLAY_XDISPLAY (gdk_display_get_default());
 	dpms->priv->dpms_capable = DPMSCapable (dpms->priv->display);
-	dpms->priv->timer_id = g_timeout_add_seconds (GPM_DPMS_POLL_TIME, (GSourceFunc)gpm_dpms_poll_mode_cb, dpms);
-	g_source_set_name_by_id (dpms->priv->timer_id, "[GpmDpms] poll");
+	dpms->priv->timer = gpm_timer_new ();
+	dpms->priv->timer_id = gpm_timer_add_seconds (dpms->priv->timer, GPM_DPMS_POLL_TIME, "[GpmDpms] poll",
+						      (GSourceFunc) gpm_dpms_poll_mode_cb, dpms);
 
 	/* ensure we clear the default timeouts (Standby: 1200s, Suspend: 1800s, Off: 2400s) */
 	gpm_dpms_clear_timeouts (dpms);
@@ -319,9 +322,10 @@ gpm_dpms_finalize (GObject *object)
 	g_return_if_fail (dpms->priv != NULL);
 
 	if (dpms->priv->timer_id != 0) {
-		g_source_remove (dpms->priv->timer_id);
+		gpm_timer_remove (dpms->priv->timer, dpms->priv->timer_id);
 		dpms->priv->timer_id = 0;
 	}
+	g_object_unref (dpms->priv->timer);
 
 	G_OBJECT_CLASS (gpm_dpms_parent_class)->finalize (object);
 }
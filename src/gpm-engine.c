@@ -23,6 +23,7 @@
 #include "config.h"
 
 #include <string.h>
+#include <math.h>
 #include <glib.h>
 #include <glib/gi18n.h>
 #include <libupower-glib/upower.h>
@@ -33,22 +34,55 @@
 #include "gpm-engine.h"
 #include "gpm-icon-names.h"
 #include "gpm-phone.h"
+#include "gpm-timer.h"
+#include "gpm-trace.h"
 
 static void     gpm_engine_finalize   (GObject	  *object);
 
 #define GPM_ENGINE_RESUME_DELAY		2*1000
 #define GPM_ENGINE_WARN_ACCURACY	20
 
+typedef enum {
+	GPM_ENGINE_SUMMARY_CHANGE_NONE,
+	GPM_ENGINE_SUMMARY_CHANGE_MINOR,	/* publish when the interval allows */
+	GPM_ENGINE_SUMMARY_CHANGE_MAJOR		/* publish now */
+} GpmEngineSummaryChange;
+
+typedef struct {
+	UpDeviceState		 state;
+	gdouble			 percentage;
+	gint64			 time_to_empty;
+	gint64			 time_to_full;
+} GpmEngineSummaryState;
+
+typedef struct {
+	UpDevice		*device;	/* owned by the array */
+	gchar			*id;		/* object or native path */
+	guint			 handle;
+	guint			 index;		/* in the array */
+} GpmEngineDevice;
+
 struct GpmEnginePrivate
 {
 	GSettings		*settings;
 	UpClient		*client;
 	UpDevice		*battery_composite;
 	GPtrArray		*array;
+	GHashTable		*devices;	/* handle -> GpmEngineDevice */
+	GHashTable		*ids;		/* id -> GpmEngineDevice */
+	guint			 next_handle;
 	GpmPhone		*phone;
 	GpmIconPolicy		 icon_policy;
-	gchar			*previous_icon;
+	GQuark			 previous_icon;
 	gchar			*previous_summary;
+	GHashTable		*summary_states;	/* handle -> GpmEngineSummaryState */
+	gboolean		 summary_removed;
+	gint64			 summary_published;	/* monotonic, us */
+	GpmTimer		*timer;
+	guint			 summary_id;
+	guint			 summary_interval;
+	gdouble			 summary_percentage_threshold;
+	guint			 summary_time_threshold;
 
 	gboolean		 use_time_primary;
 	gboolean		 time_is_accurate;
@@ -59,6 +93,8 @@ struct GpmEnginePrivate
 	guint			 low_time;
 	guint			 critical_time;
 	guint			 action_time;
+
+	GpmTraceWriter		*trace;
 };
 
 enum {
@@ -71,6 +107,9 @@ enum {
 	DISCHARGING,
 	LOW_CAPACITY,
 	DEVICES_CHANGED,
+	DEVICE_ADDED,
+	DEVICE_REMOVED,
+	DEVICE_CHANGED,
 	LAST_SIGNAL
 };
 
@@ -159,7 +198,7 @@ gpm_engine_get_summary (GpmEngine *engine)
  *
  * Returns the icon
  **/
-static gchar *
+static GQuark
 gpm_engine_get_icon_priv (GpmEngine *engine, UpDeviceKind device_kind, UpDeviceLevel warning, gboolean use_state)
 {
 	guint i;
@@ -190,109 +229,119 @@ gpm_engine_get_icon_priv (GpmEngine *engine, UpDeviceKind device_kind, UpDeviceL
 		if (kind == device_kind && is_present) {
 			if (warning != GPM_ENGINE_WARNING_NONE) {
 				if (warning_temp == warning)
-					return gpm_upower_get_device_icon (device);
+					return gpm_upower_get_device_icon_quark (device);
 				continue;
 			}
 			if (use_state) {
 				if (state == UP_DEVICE_STATE_CHARGING || state == UP_DEVICE_STATE_DISCHARGING)
-					return gpm_upower_get_device_icon (device);
+					return gpm_upower_get_device_icon_quark (device);
 				continue;
 			}
-			return gpm_upower_get_device_icon (device);
+			return gpm_upower_get_device_icon_quark (device);
 		}
 	}
-	return NULL;
+	return 0;
 }
 
 /**
- * gpm_engine_get_icon:
+ * gpm_engine_get_icon_quark:
  *
- * Returns the icon
+ * Returns the icon, or 0 for none
  **/
-gchar *
-gpm_engine_get_icon (GpmEngine *engine)
+static GQuark
+gpm_engine_get_icon_quark (GpmEngine *engine)
 {
-	gchar *icon = NULL;
-
-	g_return_val_if_fail (GPM_IS_ENGINE (engine), NULL);
+	GQuark icon;
 
 	/* policy */
 	if (engine->priv->icon_policy == GPM_ICON_POLICY_NEVER) {
 		g_debug ("no icon allowed, so no icon will be displayed.");
-		return NULL;
+		return 0;
 	}
 
 	/* we try CRITICAL: BATTERY, UPS, MOUSE, KEYBOARD */
 	icon = gpm_engine_get_icon_priv (engine, UP_DEVICE_KIND_BATTERY, GPM_ENGINE_WARNING_CRITICAL, FALSE);
-	if (icon != NULL)
+	if (icon != 0)
 		return icon;
 	icon = gpm_engine_get_icon_priv (engine, UP_DEVICE_KIND_UPS, GPM_ENGINE_WARNING_CRITICAL, FALSE);
-	if (icon != NULL)
+	if (icon != 0)
 		return icon;
 	icon = gpm_engine_get_icon_priv (engine, UP_DEVICE_KIND_MOUSE, GPM_ENGINE_WARNING_CRITICAL, FALSE);
-	if (icon != NULL)
+	if (icon != 0)
 		return icon;
 	icon = gpm_engine_get_icon_priv (engine, UP_DEVICE_KIND_KEYBOARD, GPM_ENGINE_WARNING_CRITICAL, FALSE);
-	if (icon != NULL)
+	if (icon != 0)
 		return icon;
 
 	/* policy */
 	if (engine->priv->icon_policy == GPM_ICON_POLICY_CRITICAL) {
 		g_debug ("no devices critical, so no icon will be displayed.");
-		return NULL;
+		return 0;
 	}
 
 	/* we try CRITICAL: BATTERY, UPS, MOUSE, KEYBOARD */
 	icon = gpm_engine_get_icon_priv (engine, UP_DEVICE_KIND_BATTERY, GPM_ENGINE_WARNING_LOW, FALSE);
-	if (icon != NULL)
+	if (icon != 0)
 		return icon;
 	icon = gpm_engine_get_icon_priv (engine, UP_DEVICE_KIND_UPS, GPM_ENGINE_WARNING_LOW, FALSE);
-	if (icon != NULL)
+	if (icon != 0)
 		return icon;
 	icon = gpm_engine_get_icon_priv (engine, UP_DEVICE_KIND_MOUSE, GPM_ENGINE_WARNING_LOW, FALSE);
-	if (icon != NULL)
+	if (icon != 0)
 		return icon;
 	icon = gpm_engine_get_icon_priv (engine, UP_DEVICE_KIND_KEYBOARD, GPM_ENGINE_WARNING_LOW, FALSE);
-	if (icon != NULL)
+	if (icon != 0)
 		return icon;
 
 	/* policy */
 	if (engine->priv->icon_policy == GPM_ICON_POLICY_LOW) {
 		g_debug ("no devices low, so no icon will be displayed.");
-		return NULL;
+		return 0;
 	}
 
 	/* we try (DIS)CHARGING: BATTERY, UPS */
 	icon = gpm_engine_get_icon_priv (engine, UP_DEVICE_KIND_BATTERY, GPM_ENGINE_WARNING_NONE, TRUE);
-	if (icon != NULL)
+	if (icon != 0)
 		return icon;
 	icon = gpm_engine_get_icon_priv (engine, UP_DEVICE_KIND_UPS, GPM_ENGINE_WARNING_NONE, TRUE);
-	if (icon != NULL)
+	if (icon != 0)
 		return icon;
 
 	/* policy */
 	if (engine->priv->icon_policy == GPM_ICON_POLICY_CHARGE) {
 		g_debug ("no devices (dis)charging, so no icon will be displayed.");
-		return NULL;
+		return 0;
 	}
 
 	/* we try PRESENT: BATTERY, UPS */
 	icon = gpm_engine_get_icon_priv (engine, UP_DEVICE_KIND_BATTERY, GPM_ENGINE_WARNING_NONE, FALSE);
-	if (icon != NULL)
+	if (icon != 0)
 		return icon;
 	icon = gpm_engine_get_icon_priv (engine, UP_DEVICE_KIND_UPS, GPM_ENGINE_WARNING_NONE, FALSE);
-	if (icon != NULL)
+	if (icon != 0)
 		return icon;
 
 	/* policy */
 	if (engine->priv->icon_policy == GPM_ICON_POLICY_PRESENT) {
 		g_debug ("no devices present, so no icon will be displayed.");
-		return NULL;
+		return 0;
 	}
 
 	/* we fallback to the ac_adapter icon */
 	g_debug ("Using fallback");
-	return g_strdup (GPM_ICON_AC_ADAPTER);
+	return g_quark_from_static_string (GPM_ICON_AC_ADAPTER);
+}
+
+/**
+ * gpm_engine_get_icon:
+ *
+ * Returns the icon, free with g_free()
+ **/
+gchar *
+gpm_engine_get_icon (GpmEngine *engine)
+{
+	g_return_val_if_fail (GPM_IS_ENGINE (engine), NULL);
+	return g_strdup (g_quark_to_string (gpm_engine_get_icon_quark (engine)));
 }
 
 /**
@@ -301,56 +350,118 @@ gpm_engine_get_icon (GpmEngine *engine)
 static gboolean
 gpm_engine_recalculate_state_icon (GpmEngine *engine)
 {
-	gchar *icon;
+	GQuark icon;
 
 	g_return_val_if_fail (engine != NULL, FALSE);
 	g_return_val_if_fail (GPM_IS_ENGINE (engine), FALSE);
 
 	/* show a different icon if we are disconnected */
-	icon = gpm_engine_get_icon (engine);
-	if (icon == NULL) {
-		/* none before, now none */
-		if (engine->priv->previous_icon == NULL)
-			return FALSE;
-		/* icon before, now none */
-		g_debug ("** EMIT: icon-changed: none");
-		g_signal_emit (engine, signals [ICON_CHANGED], 0, NULL);
-
-		g_free (engine->priv->previous_icon);
-		engine->priv->previous_icon = NULL;
-		return TRUE;
+	icon = gpm_engine_get_icon_quark (engine);
+	if (icon == engine->priv->previous_icon) {
+		g_debug ("no change");
+		/* nothing to do */
+		return FALSE;
 	}
 
-	/* no icon before, now icon */
-	if (engine->priv->previous_icon == NULL) {
-		g_debug ("** EMIT: icon-changed: %s", icon);
-		g_signal_emit (engine, signals [ICON_CHANGED], 0, icon);
-		engine->priv->previous_icon = icon;
-		return TRUE;
-	}
+	/* the string is NULL when there is no icon any more */
+	engine->priv->previous_icon = icon;
+	g_debug ("** EMIT: icon-changed: %s", icon != 0 ? g_quark_to_string (icon) : "none");
+	g_signal_emit (engine, signals [ICON_CHANGED], 0, g_quark_to_string (icon));
+	return TRUE;
+}
 
-	/* icon before, now different */
-	if (strcmp (engine->priv->previous_icon, icon) != 0) {
-		g_free (engine->priv->previous_icon);
-		engine->priv->previous_icon = icon;
-		g_debug ("** EMIT: icon-changed: %s", icon);
-		g_signal_emit (engine, signals [ICON_CHANGED], 0, icon);
-		return TRUE;
+/**
+ * gpm_engine_get_summary_change:
+ *
+ * Compares the devices with what they looked like when the summary was
+ * last published, so that the tooltip is not rebuilt for every tiny
+ * change in the percentage or time remaining.
+ **/
+static GpmEngineSummaryChange
+gpm_engine_get_summary_change (GpmEngine *engine)
+{
+	guint i;
+	guint shown = 0;
+	UpDevice *device;
+	UpDeviceState state;
+	gdouble percentage;
+	gint64 time_to_empty;
+	gint64 time_to_full;
+	gboolean is_present;
+	GpmEngineSummaryState *published;
+	GpmEngineSummaryChange change = GPM_ENGINE_SUMMARY_CHANGE_NONE;
+
+	for (i=0; i<engine->priv->array->len; i++) {
+		device = g_ptr_array_index (engine->priv->array, i);
+		g_object_get (device,
+			      "is-present", &is_present,
+			      "state", &state,
+			      "percentage", &percentage,
+			      "time-to-empty", &time_to_empty,
+			      "time-to-full", &time_to_full,
+			      NULL);
+		if (!is_present || state == UP_DEVICE_STATE_EMPTY)
+			continue;
+		shown++;
+
+		/* new device, or it started or stopped charging */
+		published = g_hash_table_lookup (engine->priv->summary_states,
+						 GUINT_TO_POINTER (gpm_engine_get_device_handle (device)));
+		if (published == NULL || published->state != state)
+			return GPM_ENGINE_SUMMARY_CHANGE_MAJOR;
+
+		if (fabs (published->percentage - percentage) >= engine->priv->summary_percentage_threshold ||
+		    ABS (published->time_to_empty - time_to_empty) >= engine->priv->summary_time_threshold ||
+		    ABS (published->time_to_full - time_to_full) >= engine->priv->summary_time_threshold)
+			change = GPM_ENGINE_SUMMARY_CHANGE_MINOR;
 	}
 
-	g_debug ("no change");
-	/* nothing to do */
-	g_free (icon);
-	return FALSE;
+	/* a device went away */
+	if (engine->priv->summary_removed ||
+	    shown != g_hash_table_size (engine->priv->summary_states))
+		return GPM_ENGINE_SUMMARY_CHANGE_MAJOR;
+	return change;
 }
 
 /**
- * gpm_engine_recalculate_state_summary:
+ * gpm_engine_publish_summary:
  */
 static gboolean
-gpm_engine_recalculate_state_summary (GpmEngine *engine)
+gpm_engine_publish_summary (GpmEngine *engine)
 {
+	guint i;
 	gchar *summary;
+	UpDevice *device;
+	gboolean is_present;
+	GpmEngineSummaryState *published;
+
+	if (engine->priv->summary_id != 0) {
+		gpm_timer_remove (engine->priv->timer, engine->priv->summary_id);
+		engine->priv->summary_id = 0;
+	}
+	engine->priv->summary_published = g_get_monotonic_time ();
+
+	/* remember what the devices looked like for next time */
+	g_hash_table_remove_all (engine->priv->summary_states);
+	engine->priv->summary_removed = FALSE;
+	for (i=0; i<engine->priv->array->len; i++) {
+		device = g_ptr_array_index (engine->priv->array, i);
+		published = g_new0 (GpmEngineSummaryState, 1);
+		g_object_get (device,
+			      "is-present", &is_present,
+			      "state", &published->state,
+			      "percentage", &published->percentage,
+			      "time-to-empty", &published->time_to_empty,
+			      "time-to-full", &published->time_to_full,
+			      NULL);
+		if (!is_present || published->state == UP_DEVICE_STATE_EMPTY) {
+			g_free (published);
+			continue;
+		}
+		g_hash_table_insert (engine->priv->summary_states,
+				     GUINT_TO_POINTER (gpm_engine_get_device_handle (device)),
+				     published);
+	}
 
 	summary = gpm_engine_get_summary (engine);
 	if (engine->priv->previous_summary == NULL) {
@@ -373,6 +484,57 @@ gpm_engine_recalculate_state_summary (GpmEngine *engine)
 	return FALSE;
 }
 
+/**
+ * gpm_engine_publish_summary_cb:
+ */
+static gboolean
+gpm_engine_publish_summary_cb (GpmEngine *engine)
+{
+	engine->priv->summary_id = 0;
+	gpm_engine_publish_summary (engine);
+	return FALSE;
+}
+
+/**
+ * gpm_engine_recalculate_state_summary:
+ */
+static gboolean
+gpm_engine_recalculate_state_summary (GpmEngine *engine)
+{
+	GpmEngineSummaryChange change;
+	gint64 elapsed;
+	guint delay;
+
+	change = gpm_engine_get_summary_change (engine);
+	if (change == GPM_ENGINE_SUMMARY_CHANGE_NONE)
+		return FALSE;
+	if (change == GPM_ENGINE_SUMMARY_CHANGE_MAJOR || engine->priv->previous_summary == NULL)
+		return gpm_engine_publish_summary (engine);
+
+	/* rate limit the small changes, coalescing them into one update */
+	elapsed = (g_get_monotonic_time () - engine->priv->summary_published) / G_USEC_PER_SEC;
+	if (elapsed >= engine->priv->summary_interval)
+		return gpm_engine_publish_summary (engine);
+	if (engine->priv->summary_id == 0) {
+		delay = engine->priv->summary_interval - elapsed;
+		engine->priv->summary_id = gpm_timer_add_seconds (engine->priv->timer, delay, "[GpmEngine] publish-summary",
+								  (GSourceFunc) gpm_engine_publish_summary_cb, engine);
+	}
+	return FALSE;
+}
+
+/**
+ * gpm_engine_get_published_summary:
+ *
+ * Return value: the summary as last sent in ::summary-changed, free with g_free()
+ **/
+gchar *
+gpm_engine_get_published_summary (GpmEngine *engine)
+{
+	g_return_val_if_fail (GPM_IS_ENGINE (engine), NULL);
+	return g_strdup (engine->priv->previous_summary);
+}
+
 /**
  * gpm_engine_recalculate_state:
  */
@@ -406,6 +568,13 @@ gpm_engine_settings_key_changed_cb (GSettings *settings, const gchar *key, GpmEn
 
 		/* perhaps change icon */
 		gpm_engine_recalculate_state_icon (engine);
+
+	} else if (g_strcmp0 (key, GPM_SETTINGS_TOOLTIP_INTERVAL) == 0) {
+		engine->priv->summary_interval = g_settings_get_int (settings, key);
+	} else if (g_strcmp0 (key, GPM_SETTINGS_TOOLTIP_PERCENTAGE_THRESHOLD) == 0) {
+		engine->priv->summary_percentage_threshold = g_settings_get_double (settings, key);
+	} else if (g_strcmp0 (key, GPM_SETTINGS_TOOLTIP_TIME_THRESHOLD) == 0) {
+		engine->priv->summary_time_threshold = g_settings_get_int (settings, key);
 	}
 }
 
@@ -473,6 +642,114 @@ gpm_engine_update_composite_device (GpmEngine *engine, UpDevice *original_device
 	return engine->priv->battery_composite;
 }
 
+/**
+ * gpm_engine_device_free:
+ **/
+static void
+gpm_engine_device_free (GpmEngineDevice *entry)
+{
+	g_free (entry->id);
+	g_free (entry);
+}
+
+/**
+ * gpm_engine_get_device_id:
+ *
+ * Return value: the object path, or the native path for devices that are
+ * not on the bus such as phones, or %NULL. Free with g_free()
+ **/
+static gchar *
+gpm_engine_get_device_id (UpDevice *device)
+{
+	gchar *native_path = NULL;
+
+	if (up_device_get_object_path (device) != NULL)
+		return g_strdup (up_device_get_object_path (device));
+	g_object_get (device, "native-path", &native_path, NULL);
+	return native_path;
+}
+
+/**
+ * gpm_engine_get_device_handle:
+ *
+ * The handle is given out by the engine when the device is added, and
+ * stays the same until it is removed. A device that comes back gets a
+ * new one.
+ *
+ * Return value: the handle, or 0 if the engine does not have the device
+ **/
+guint
+gpm_engine_get_device_handle (UpDevice *device)
+{
+	g_return_val_if_fail (UP_IS_DEVICE (device), 0);
+	return GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (device), "engine-handle"));
+}
+
+/**
+ * gpm_engine_lookup_device:
+ *
+ * Return value: (transfer none): the #UpDevice with @handle, or %NULL
+ **/
+UpDevice *
+gpm_engine_lookup_device (GpmEngine *engine, guint handle)
+{
+	GpmEngineDevice *entry;
+
+	g_return_val_if_fail (GPM_IS_ENGINE (engine), NULL);
+	entry = g_hash_table_lookup (engine->priv->devices, GUINT_TO_POINTER (handle));
+	return entry != NULL ? entry->device : NULL;
+}
+
+/**
+ * gpm_engine_lookup_id:
+ *
+ * Return value: the handle of the device with @id, or 0
+ **/
+static guint
+gpm_engine_lookup_id (GpmEngine *engine, const gchar *id)
+{
+	GpmEngineDevice *entry;
+
+	entry = g_hash_table_lookup (engine->priv->ids, id);
+	return entry != NULL ? entry->handle : 0;
+}
+
+/**
+ * gpm_engine_device_remove:
+ *
+ * Moves the last device into the hole, so nothing has to be searched.
+ **/
+static gboolean
+gpm_engine_device_remove (GpmEngine *engine, guint handle)
+{
+	GpmEngineDevice *entry;
+	GpmEngineDevice *moved;
+	UpDevice *last;
+
+	entry = g_hash_table_lookup (engine->priv->devices, GUINT_TO_POINTER (handle));
+	if (entry == NULL)
+		return FALSE;
+
+	g_debug ("removing %s", entry->id);
+	g_signal_handlers_disconnect_by_func (entry->device, gpm_engine_device_changed_cb, engine);
+	g_object_set_data (G_OBJECT (entry->device), "engine-handle", NULL);
+	if (g_hash_table_remove (engine->priv->summary_states, GUINT_TO_POINTER (handle)))
+		engine->priv->summary_removed = TRUE;
+
+	last = g_ptr_array_index (engine->priv->array, engine->priv->array->len - 1);
+	if (last != entry->device) {
+		moved = g_hash_table_lookup (engine->priv->devices,
+					     GUINT_TO_POINTER (gpm_engine_get_device_handle (last)));
+		moved->index = entry->index;
+	}
+	g_ptr_array_remove_index_fast (engine->priv->array, entry->index);
+
+	g_hash_table_remove (engine->priv->ids, entry->id);
+	g_hash_table_remove (engine->priv->devices, GUINT_TO_POINTER (handle));
+	g_signal_emit (engine, signals [DEVICE_REMOVED], 0, handle);
+	return TRUE;
+}
+
 /**
  * gpm_engine_device_add:
  **/
@@ -483,6 +760,21 @@ gpm_engine_device_add (GpmEngine *engine, UpDevice *device)
 	UpDeviceState state;
 	UpDeviceKind kind;
 	UpDevice *composite;
+	GpmEngineDevice *entry;
+	gchar *id;
+
+	/* it could never be found again to be removed */
+	id = gpm_engine_get_device_id (device);
+	if (id == NULL) {
+		g_warning ("ignoring device with no object or native path");
+		return;
+	}
+
+	/* already known, e.g. added by coldplug and by the device-added signal */
+	if (g_hash_table_contains (engine->priv->ids, id)) {
+		g_free (id);
+		return;
+	}
 
 	/* assign warning */
 	warning = gpm_engine_get_warning (engine, device);
@@ -512,8 +804,21 @@ gpm_engine_device_add (GpmEngine *engine, UpDevice *device)
 		g_object_set_data (G_OBJECT(composite), "engine-state-old", GUINT_TO_POINTER(state));
 	}
 
+	/* record the initial state for gpm-trace-replay */
+	if (engine->priv->trace != NULL)
+		gpm_trace_writer_add_device (engine->priv->trace, device);
+
 	g_signal_connect (device, "notify", G_CALLBACK (gpm_engine_device_changed_cb), engine);
+	entry = g_new0 (GpmEngineDevice, 1);
+	entry->device = device;
+	entry->id = id;
+	entry->handle = engine->priv->next_handle++;
+	entry->index = engine->priv->array->len;
+	g_object_set_data (G_OBJECT (device), "engine-handle", GUINT_TO_POINTER (entry->handle));
 	g_ptr_array_add (engine->priv->array, g_object_ref (device));
+	g_hash_table_insert (engine->priv->devices, GUINT_TO_POINTER (entry->handle), entry);
+	g_hash_table_insert (engine->priv->ids, entry->id, entry);
+	g_signal_emit (engine, signals [DEVICE_ADDED], 0, device);
 	gpm_engine_recalculate_state (engine);
 }
 
@@ -561,17 +866,14 @@ gpm_engine_device_added_cb (UpClient *client, UpDevice *device, GpmEngine *engin
 static void
 gpm_engine_device_removed_cb (UpClient *client, const char *object_path, GpmEngine *engine)
 {
-	guint i;
-
-	for (i = 0; i < engine->priv->array->len; i++) {
-		UpDevice *device = g_ptr_array_index (engine->priv->array, i);
-
-		if (g_strcmp0 (object_path, up_device_get_object_path (device)) == 0) {
-			g_ptr_array_remove_index (engine->priv->array, i);
-			break;
-		}
-	}
-	gpm_engine_recalculate_state (engine);
+	guint handle;
+
+	/* never seen, so never added */
+	handle = gpm_engine_lookup_id (engine, object_path);
+	if (handle == 0)
+		return;
+	if (gpm_engine_device_remove (engine, handle))
+		gpm_engine_recalculate_state (engine);
 }
 
 /**
@@ -586,6 +888,13 @@ gpm_engine_device_changed_cb (UpDevice *device, GParamSpec *pspec, GpmEngine *en
 	UpDeviceLevel warning_old;
 	UpDeviceLevel warning;
 
+	/* record the raw change for gpm-trace-replay */
+	if (engine->priv->trace != NULL)
+		gpm_trace_writer_add_device (engine->priv->trace, device);
+
+	/* before it is swapped for the composite device */
+	g_signal_emit (engine, signals [DEVICE_CHANGED], 0, device);
+
 	/* get device properties */
 	g_object_get (device,
 		      "kind", &kind,
@@ -702,23 +1011,24 @@ static void
 phone_device_added_cb (GpmPhone *phone, guint idx, GpmEngine *engine)
 {
 	UpDevice *device;
+	gchar *native_path;
 	device = up_device_new ();
 
 	g_debug ("phone added %u", idx);
 
 	/* get device properties */
+	native_path = g_strdup_printf ("dummy:phone_%u", idx);
 	g_object_set (device,
 		      "kind", UP_DEVICE_KIND_PHONE,
 		      "is-rechargeable", TRUE,
-		      "native-path", g_strdup_printf ("dummy:phone_%u", idx),
+		      "native-path", native_path,
 		      "is-present", TRUE,
 		      NULL);
+	g_free (native_path);
 
 	/* state changed */
 	gpm_engine_device_add (engine, device);
-	g_ptr_array_add (engine->priv->array, g_object_ref (device));
 	g_object_unref (device);
-	gpm_engine_recalculate_state (engine);
 }
 
 /**
@@ -727,28 +1037,18 @@ phone_device_added_cb (GpmPhone *phone, guint idx, GpmEngine *engine)
 static void
 phone_device_removed_cb (GpmPhone *phone, guint idx, GpmEngine *engine)
 {
-	guint i;
-	UpDevice *device;
-	UpDeviceKind kind;
+	guint handle;
+	gchar *native_path;
 
 	g_debug ("phone removed %u", idx);
 
-	for (i=0; i<engine->priv->array->len; i++) {
-		device = g_ptr_array_index (engine->priv->array, i);
-
-		/* get device properties */
-		g_object_get (device,
-			      "kind", &kind,
-			      NULL);
-
-		if (kind == UP_DEVICE_KIND_PHONE) {
-			g_ptr_array_remove_index (engine->priv->array, i);
-			break;
-		}
-	}
+	native_path = g_strdup_printf ("dummy:phone_%u", idx);
+	handle = gpm_engine_lookup_id (engine, native_path);
+	g_free (native_path);
 
 	/* state changed */
-	gpm_engine_recalculate_state (engine);
+	if (handle != 0 && gpm_engine_device_remove (engine, handle))
+		gpm_engine_recalculate_state (engine);
 }
 
 /**
@@ -757,36 +1057,29 @@ phone_device_removed_cb (GpmPhone *phone, guint idx, GpmEngine *engine)
 static void
 phone_device_refresh_cb (GpmPhone *phone, guint idx, GpmEngine *engine)
 {
-	guint i;
 	UpDevice *device;
-	UpDeviceKind kind;
 	UpDeviceState state;
-	gboolean is_present;
-	gdouble percentage;
+	guint handle;
+	gchar *native_path;
 
 	g_debug ("phone refresh %u", idx);
 
-	for (i=0; i<engine->priv->array->len; i++) {
-		device = g_ptr_array_index (engine->priv->array, i);
-
-		/* get device properties */
-		g_object_get (device,
-			      "kind", &kind,
-			      "state", &state,
-			      "percentage", &percentage,
-			      "is-present", &is_present,
-			      NULL);
-
-		if (kind == UP_DEVICE_KIND_PHONE) {
-			is_present = gpm_phone_get_present (phone, idx);
-			state = gpm_phone_get_on_ac (phone, idx) ? UP_DEVICE_STATE_CHARGING : UP_DEVICE_STATE_DISCHARGING;
-			percentage = gpm_phone_get_percentage (phone, idx);
-			break;
-		}
+	native_path = g_strdup_printf ("dummy:phone_%u", idx);
+	handle = gpm_engine_lookup_id (engine, native_path);
+	g_free (native_path);
+	device = handle != 0 ? gpm_engine_lookup_device (engine, handle) : NULL;
+	if (device == NULL) {
+		g_debug ("phone %u was never added", idx);
+		return;
 	}
 
-	/* state changed */
-	gpm_engine_recalculate_state (engine);
+	/* the notify handler recalculates the state */
+	state = gpm_phone_get_on_ac (phone, idx) ? UP_DEVICE_STATE_CHARGING : UP_DEVICE_STATE_DISCHARGING;
+	g_object_set (device,
+		      "is-present", gpm_phone_get_present (phone, idx),
+		      "state", state,
+		      "percentage", (gdouble) gpm_phone_get_percentage (phone, idx),
+		      NULL);
 }
 
 /**
@@ -797,9 +1090,27 @@ static void
 gpm_engine_init (GpmEngine *engine)
 {
 	guint idle_id;
+	const gchar *trace_filename;
+	GError *error = NULL;
 	engine->priv = gpm_engine_get_instance_private (engine);
 
+	/* optionally record every device change so it can be replayed later */
+	trace_filename = g_getenv ("GPM_TRACE_FILE");
+	if (trace_filename != NULL) {
+		engine->priv->trace = gpm_trace_writer_new (trace_filename, &error);
+		if (engine->priv->trace == NULL) {
+			g_warning ("failed to record trace: %s", error->message);
+			g_error_free (error);
+		} else {
+			g_debug ("recording device trace to %s", trace_filename);
+		}
+	}
+
 	engine->priv->array = g_ptr_array_new_with_free_func (g_object_unref);
+	engine->priv->devices = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+						       NULL, (GDestroyNotify) gpm_engine_device_free);
+	engine->priv->ids = g_hash_table_new (g_str_hash, g_str_equal);
+	engine->priv->next_handle = 1;
 	engine->priv->client = up_client_new ();
 	g_signal_connect (engine->priv->client, "device-added",
 			  G_CALLBACK (gpm_engine_device_added_cb), engine);
@@ -810,6 +1121,7 @@ gpm_engine_init (GpmEngine *engine)
 	g_signal_connect (engine->priv->settings, "changed",
 			  G_CALLBACK (gpm_engine_settings_key_changed_cb), engine);
 
+	engine->priv->timer = gpm_timer_new ();
 	engine->priv->phone = gpm_phone_new ();
 	g_signal_connect (engine->priv->phone, "device-added",
 			  G_CALLBACK (phone_device_added_cb), engine);
@@ -823,8 +1135,14 @@ gpm_engine_init (GpmEngine *engine)
 	g_signal_connect (engine->priv->battery_composite, "notify",
 			  G_CALLBACK (gpm_engine_device_changed_cb), engine);
 
-	engine->priv->previous_icon = NULL;
+	engine->priv->previous_icon = 0;
 	engine->priv->previous_summary = NULL;
+	engine->priv->summary_states = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+
+	/* how often the tooltip may change, and what is worth changing it for */
+	engine->priv->summary_interval = g_settings_get_int (engine->priv->settings, GPM_SETTINGS_TOOLTIP_INTERVAL);
+	engine->priv->summary_percentage_threshold = g_settings_get_double (engine->priv->settings, GPM_SETTINGS_TOOLTIP_PERCENTAGE_THRESHOLD);
+	engine->priv->summary_time_threshold = g_settings_get_int (engine->priv->settings, GPM_SETTINGS_TOOLTIP_TIME_THRESHOLD);
 
 	/* do we want to display the icon in the tray */
 	engine->priv->icon_policy = g_settings_get_enum (engine->priv->settings, GPM_SETTINGS_ICON_POLICY);
@@ -923,6 +1241,27 @@ gpm_engine_class_init (GpmEngineClass *klass)
 			      G_STRUCT_OFFSET (GpmEngineClass, devices_changed),
 			      NULL, NULL, g_cclosure_marshal_VOID__VOID,
 			      G_TYPE_NONE, 0);
+	signals [DEVICE_ADDED] =
+		g_signal_new ("device-added",
+			      G_TYPE_FROM_CLASS (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (GpmEngineClass, device_added),
+			      NULL, NULL, g_cclosure_marshal_VOID__POINTER,
+			      G_TYPE_NONE, 1, G_TYPE_POINTER);
+	signals [DEVICE_REMOVED] =
+		g_signal_new ("device-removed",
+			      G_TYPE_FROM_CLASS (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (GpmEngineClass, device_removed),
+			      NULL, NULL, g_cclosure_marshal_VOID__UINT,
+			      G_TYPE_NONE, 1, G_TYPE_UINT);
+	signals [DEVICE_CHANGED] =
+		g_signal_new ("device-changed",
+			      G_TYPE_FROM_CLASS (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (GpmEngineClass, device_changed),
+			      NULL, NULL, g_cclosure_marshal_VOID__POINTER,
+			      G_TYPE_NONE, 1, G_TYPE_POINTER);
 }
 
 /**
@@ -940,13 +1279,19 @@ gpm_engine_finalize (GObject *object)
 	engine = GPM_ENGINE (object);
 	engine->priv = gpm_engine_get_instance_private (engine);
 
+	g_hash_table_unref (engine->priv->ids);
+	g_hash_table_unref (engine->priv->devices);
 	g_ptr_array_unref (engine->priv->array);
 	g_object_unref (engine->priv->client);
 	g_object_unref (engine->priv->phone);
 	g_object_unref (engine->priv->battery_composite);
 
-	g_free (engine->priv->previous_icon);
+	if (engine->priv->summary_id != 0)
+		gpm_timer_remove (engine->priv->timer, engine->priv->summary_id);
+	g_object_unref (engine->priv->timer);
+	g_hash_table_unref (engine->priv->summary_states);
 	g_free (engine->priv->previous_summary);
+	gpm_trace_writer_free (engine->priv->trace);
 
 	G_OBJECT_CLASS (gpm_engine_parent_class)->finalize (object);
 }
@@ -63,14 +63,24 @@ typedef struct
 	void		(* discharging)		(GpmEngine	*engine,
 						 UpDevice	*device);
 	void		(* devices_changed)	(GpmEngine	*engine);
+	void		(* device_added)	(GpmEngine	*engine,
+						 UpDevice	*device);
+	void		(* device_removed)	(GpmEngine	*engine,
+						 guint		 handle);
+	void		(* device_changed)	(GpmEngine	*engine,
+						 UpDevice	*device);
 } GpmEngineClass;
 
 GType		 gpm_engine_get_type		(void);
 GpmEngine	*gpm_engine_new			(void);
 gchar		*gpm_engine_get_icon		(GpmEngine	*engine);
 gchar		*gpm_engine_get_summary		(GpmEngine	*engine);
+gchar		*gpm_engine_get_published_summary (GpmEngine	*engine);
 GPtrArray	*gpm_engine_get_devices		(GpmEngine	*engine);
 UpDevice	*gpm_engine_get_primary_device	(GpmEngine	*engine);
+guint		 gpm_engine_get_device_handle	(UpDevice	*device);
+UpDevice	*gpm_engine_lookup_device	(GpmEngine	*engine,
+						 guint		 handle);
 
 G_END_DECLS
 
@@ -43,29 +43,77 @@
 #include "gpm-idle.h"
 #include "gpm-load.h"
 #include "gpm-session.h"
+#include "gpm-timer.h"
 
 /* Sets the idle percent limit, i.e. how hard the computer can work
    while considered "at idle" */
 #define GPM_IDLE_CPU_LIMIT			5
 #define	GPM_IDLE_IDLETIME_ID			1
+#define	GPM_IDLE_ACTIVITY_ID			2
+
+/* a deadline this close is treated as passed, as the idle time and the
+ * timer do not always agree to the ms */
+#define GPM_IDLE_DEADLINE_SLACK			500 /* ms */
+
+typedef struct
+{
+	GpmIdleMode		 mode;
+	guint			 timeout_ac;		/* in seconds, 0 to disable */
+	guint			 timeout_battery;	/* in seconds, 0 to disable */
+	GpmIdleInhibit		 inhibit;
+	gint64			 since;			/* idle time in ms, or -1 if held back */
+	gint64			 deadline;		/* idle time in ms, or -1 */
+	gboolean		 reached;
+} GpmIdleStage;
+
+/*
+ * The stages the user goes through while idle, in the order of
+ * GpmIdleMode. Each stage is reached once the idle time passes its
+ * timeout, counted from the last input rather than from the stage
+ * before, and the first stage also sets the idletime alarm that says the
+ * user has gone idle. A stage is held back while any of its inhibit
+ * flags apply, and then counts its timeout from when it stopped being
+ * held back. All but the first are off until given a timeout, and the
+ * mode is the deepest stage reached, so one with a longer timeout than
+ * a deeper stage never takes the mode back.
+ */
+static const GpmIdleStage gpm_idle_stages[] = {
+	{ GPM_IDLE_MODE_DIM,		0, 0,	GPM_IDLE_INHIBIT_IDLE, 0, -1, FALSE },
+	{ GPM_IDLE_MODE_KBD_OFF,	0, 0,	GPM_IDLE_INHIBIT_IDLE, 0, -1, FALSE },
+	{ GPM_IDLE_MODE_BLANK,		0, 0,	GPM_IDLE_INHIBIT_IDLE, 0, -1, FALSE },
+	{ GPM_IDLE_MODE_DPMS_OFF,	0, 0,	GPM_IDLE_INHIBIT_IDLE, 0, -1, FALSE },
+	{ GPM_IDLE_MODE_SLEEP,		0, 0,	GPM_IDLE_INHIBIT_IDLE |
+						GPM_IDLE_INHIBIT_SUSPEND |
+						GPM_IDLE_INHIBIT_SESSION |
+						GPM_IDLE_INHIBIT_CPU, 0, -1, FALSE },
+	{ GPM_IDLE_MODE_HIBERNATE,	0, 0,	GPM_IDLE_INHIBIT_IDLE |
+						GPM_IDLE_INHIBIT_SUSPEND |
+						GPM_IDLE_INHIBIT_SESSION |
+						GPM_IDLE_INHIBIT_CPU, 0, -1, FALSE }
+};
 
 struct GpmIdlePrivate
 {
 	EggIdletime	*idletime;
+	GpmTimer	*timer;
 	GpmLoad		*load;
 	GpmSession	*session;
 	GpmIdleMode	 mode;
-	guint		 timeout_dim;		/* in seconds */
-	guint		 timeout_blank;		/* in seconds */
-	guint		 timeout_sleep;		/* in seconds */
-	guint		 timeout_blank_id;
-	guint		 timeout_sleep_id;
+	GArray		*stages;		/* of GpmIdleStage */
+	guint		 alarm_timeout;		/* in seconds */
+	guint		 activity_timeout;	/* in seconds, 0 to disable */
+	gint64		 idle_start;		/* on the idletime clock in ms, or -1 */
+	guint		 timeout_id;
+	gint64		 timeout_deadline;	/* idle time in ms */
+	gboolean	 on_battery;
 	gboolean	 x_idle;
+	gboolean	 session_idle;
 	gboolean	 check_type_cpu;
 };
 
 enum {
 	IDLE_CHANGED,
+	ACTIVITY,
 	LAST_SIGNAL
 };
 
@@ -84,10 +132,16 @@ gpm_idle_mode_to_string (GpmIdleMode mode)
 		return "normal";
 	if (mode == GPM_IDLE_MODE_DIM)
 		return "dim";
+	if (mode == GPM_IDLE_MODE_KBD_OFF)
+		return "kbd-off";
 	if (mode == GPM_IDLE_MODE_BLANK)
 		return "blank";
+	if (mode == GPM_IDLE_MODE_DPMS_OFF)
+		return "dpms-off";
 	if (mode == GPM_IDLE_MODE_SLEEP)
 		return "sleep";
+	if (mode == GPM_IDLE_MODE_HIBERNATE)
+		return "hibernate";
 	return "unknown";
 }
 
@@ -131,216 +185,300 @@ gpm_idle_get_mode (GpmIdle *idle)
 }
 
 /**
- * gpm_idle_blank_cb:
+ * gpm_idle_get_stage:
+ **/
+static GpmIdleStage *
+gpm_idle_get_stage (GpmIdle *idle, GpmIdleMode mode)
+{
+	GpmIdleStage *stage;
+	guint i;
+
+	for (i=0; i<idle->priv->stages->len; i++) {
+		stage = &g_array_index (idle->priv->stages, GpmIdleStage, i);
+		if (stage->mode == mode)
+			return stage;
+	}
+	return NULL;
+}
+
+/**
+ * gpm_idle_stage_get_timeout:
+ *
+ * Return value: the timeout of the stage for the power source, in seconds
+ **/
+static guint
+gpm_idle_stage_get_timeout (GpmIdle *idle, const GpmIdleStage *stage)
+{
+	return idle->priv->on_battery ? stage->timeout_battery : stage->timeout_ac;
+}
+
+/**
+ * gpm_idle_get_inhibit:
+ *
+ * Return value: what is holding stages back right now, apart from the CPU
+ **/
+static GpmIdleInhibit
+gpm_idle_get_inhibit (GpmIdle *idle)
+{
+	GpmIdleInhibit inhibit = GPM_IDLE_INHIBIT_NONE;
+
+	if (gpm_session_get_idle_inhibited (idle->priv->session))
+		inhibit |= GPM_IDLE_INHIBIT_IDLE;
+	if (gpm_session_get_suspend_inhibited (idle->priv->session))
+		inhibit |= GPM_IDLE_INHIBIT_SUSPEND;
+	if (!idle->priv->session_idle)
+		inhibit |= GPM_IDLE_INHIBIT_SESSION;
+	return inhibit;
+}
+
+/**
+ * gpm_idle_is_cpu_busy:
  **/
 static gboolean
-gpm_idle_blank_cb (GpmIdle *idle)
+gpm_idle_is_cpu_busy (GpmIdle *idle)
 {
-	if (idle->priv->mode > GPM_IDLE_MODE_BLANK) {
-		g_debug ("ignoring current mode %s", gpm_idle_mode_to_string (idle->priv->mode));
+	gdouble load;
+
+	if (!idle->priv->check_type_cpu)
 		return FALSE;
+
+	/* check if system is "idle" enough */
+	load = gpm_load_get_current (idle->priv->load);
+	if (load > GPM_IDLE_CPU_LIMIT) {
+		g_debug ("Detected that the CPU is busy");
+		return TRUE;
 	}
-	gpm_idle_set_mode (idle, GPM_IDLE_MODE_BLANK);
 	return FALSE;
 }
 
 /**
- * gpm_idle_sleep_cb:
+ * gpm_idle_remove_timeout:
  **/
-static gboolean
-gpm_idle_sleep_cb (GpmIdle *idle)
+static void
+gpm_idle_remove_timeout (GpmIdle *idle)
 {
-	gdouble load;
-	gboolean ret = FALSE;
-
-	/* get our computed load value */
-	if (idle->priv->check_type_cpu) {
-		load = gpm_load_get_current (idle->priv->load);
-		if (load > GPM_IDLE_CPU_LIMIT) {
-			/* check if system is "idle" enough */
-			g_debug ("Detected that the CPU is busy");
-			ret = TRUE;
-			goto out;
-		}
+	if (idle->priv->timeout_id != 0) {
+		egg_idletime_timeout_remove (idle->priv->idletime, idle->priv->timeout_id);
+		idle->priv->timeout_id = 0;
 	}
-	gpm_idle_set_mode (idle, GPM_IDLE_MODE_SLEEP);
-out:
-	return ret;
+}
+
+static void gpm_idle_evaluate (GpmIdle *idle);
+
+/**
+ * gpm_idle_timeout_cb:
+ *
+ * The nearest stage deadline has passed.
+ **/
+static gboolean
+gpm_idle_timeout_cb (GpmIdle *idle)
+{
+	idle->priv->timeout_id = 0;
+	gpm_idle_evaluate (idle);
+	return FALSE;
 }
 
 /**
  * gpm_idle_evaluate:
+ *
+ * Works out the deepest stage that has been reached, and sets the one
+ * timer for the nearest deadline of the stages that have not. All the
+ * deadlines are idle times, so one that was missed is met straight away
+ * rather than pushed back.
  **/
 static void
 gpm_idle_evaluate (GpmIdle *idle)
 {
-	gboolean is_idle;
-	gboolean is_idle_inhibited;
-	gboolean is_suspend_inhibited;
-
-	is_idle = gpm_session_get_idle (idle->priv->session);
-	is_idle_inhibited = gpm_session_get_idle_inhibited (idle->priv->session);
-	is_suspend_inhibited = gpm_session_get_suspend_inhibited (idle->priv->session);
-	g_debug ("session_idle=%i, idle_inhibited=%i, suspend_inhibited=%i, x_idle=%i", is_idle, is_idle_inhibited, is_suspend_inhibited, idle->priv->x_idle);
-
-	/* check we are really idle */
+	GpmIdleStage *stage;
+	GpmIdleInhibit inhibit;
+	GpmIdleMode mode = GPM_IDLE_MODE_NORMAL;
+	gint64 idle_time;
+	gint64 next = -1;
+	guint timeout;
+	guint i;
+
+	inhibit = gpm_idle_get_inhibit (idle);
+	g_debug ("x_idle=%i, inhibit=0x%x", idle->priv->x_idle, inhibit);
+
+	/* the user is back, so the idle time starts again from zero */
 	if (!idle->priv->x_idle) {
-		gpm_idle_set_mode (idle, GPM_IDLE_MODE_NORMAL);
-		g_debug ("X not idle");
-		if (idle->priv->timeout_blank_id != 0) {
-			g_source_remove (idle->priv->timeout_blank_id);
-			idle->priv->timeout_blank_id = 0;
-		}
-		if (idle->priv->timeout_sleep_id != 0) {
-			g_source_remove (idle->priv->timeout_sleep_id);
-			idle->priv->timeout_sleep_id = 0;
+		for (i=0; i<idle->priv->stages->len; i++) {
+			stage = &g_array_index (idle->priv->stages, GpmIdleStage, i);
+			stage->reached = FALSE;
+			stage->since = 0;
+			stage->deadline = -1;
 		}
-		goto out;
+		gpm_idle_remove_timeout (idle);
+		gpm_idle_set_mode (idle, GPM_IDLE_MODE_NORMAL);
+		return;
 	}
 
-	/* are we inhibited from going idle */
-	if (is_idle_inhibited) {
-		g_debug ("inhibited, so using normal state");
-		gpm_idle_set_mode (idle, GPM_IDLE_MODE_NORMAL);
-		if (idle->priv->timeout_blank_id != 0) {
-			g_source_remove (idle->priv->timeout_blank_id);
-			idle->priv->timeout_blank_id = 0;
-		}
-		if (idle->priv->timeout_sleep_id != 0) {
-			g_source_remove (idle->priv->timeout_sleep_id);
-			idle->priv->timeout_sleep_id = 0;
+	idle_time = egg_idletime_get_time (idle->priv->idletime);
+	for (i=0; i<idle->priv->stages->len; i++) {
+		stage = &g_array_index (idle->priv->stages, GpmIdleStage, i);
+		timeout = gpm_idle_stage_get_timeout (idle, stage);
+		stage->deadline = -1;
+
+		/* switched off */
+		if (i > 0 && timeout == 0) {
+			stage->reached = FALSE;
+			continue;
 		}
-		goto out;
-	}
 
-	/* normal to dim */
-	if (idle->priv->mode == GPM_IDLE_MODE_NORMAL) {
-		g_debug ("normal to dim");
-		gpm_idle_set_mode (idle, GPM_IDLE_MODE_DIM);
-	}
+		/* held back, so count again from when it is not */
+		if ((stage->inhibit & inhibit) != 0) {
+			if (stage->since >= 0)
+				g_debug ("%s held back", gpm_idle_mode_to_string (stage->mode));
+			stage->reached = FALSE;
+			stage->since = -1;
+			continue;
+		}
+		if (stage->since < 0)
+			stage->since = idle_time;
+		if (stage->reached) {
+			mode = stage->mode;
+			continue;
+		}
 
-	/* set up blank callback even when session is not idle,
-	 * but only if we actually want to blank. */
-	if (idle->priv->timeout_blank_id == 0 &&
-	    idle->priv->timeout_blank != 0) {
-		g_debug ("setting up blank callback for %us", idle->priv->timeout_blank);
-		idle->priv->timeout_blank_id = g_timeout_add_seconds (idle->priv->timeout_blank,
-								      (GSourceFunc) gpm_idle_blank_cb, idle);
-		g_source_set_name_by_id (idle->priv->timeout_blank_id, "[GpmIdle] blank");
+		stage->deadline = stage->since + (gint64) timeout * 1000;
+		if (stage->deadline <= idle_time + GPM_IDLE_DEADLINE_SLACK) {
+			if ((stage->inhibit & GPM_IDLE_INHIBIT_CPU) != 0 &&
+			    gpm_idle_is_cpu_busy (idle)) {
+				stage->since = idle_time;
+				stage->deadline = idle_time + (gint64) MAX (timeout, 1) * 1000;
+			} else {
+				stage->reached = TRUE;
+				stage->deadline = -1;
+				mode = stage->mode;
+				continue;
+			}
+		}
+		if (next < 0 || stage->deadline < next)
+			next = stage->deadline;
 	}
 
-	/* are we inhibited from sleeping */
-	if (is_suspend_inhibited) {
-		g_debug ("suspend inhibited");
-		if (idle->priv->timeout_sleep_id != 0) {
-			g_source_remove (idle->priv->timeout_sleep_id);
-			idle->priv->timeout_sleep_id = 0;
-		}
-	} else if (is_idle) {
-	/* only do the sleep timeout when the session is idle and we aren't inhibited from sleeping */
-		if (idle->priv->timeout_sleep_id == 0 &&
-		    idle->priv->timeout_sleep != 0) {
-			g_debug ("setting up sleep callback %us", idle->priv->timeout_sleep);
-			idle->priv->timeout_sleep_id = g_timeout_add_seconds (idle->priv->timeout_sleep,
-									      (GSourceFunc) gpm_idle_sleep_cb, idle);
-			g_source_set_name_by_id (idle->priv->timeout_sleep_id, "[GpmIdle] sleep");
+	/* one timer for whichever deadline is nearest, set before the
+	 * signal so that anything it does can evaluate again */
+	if (idle->priv->timeout_id == 0 || idle->priv->timeout_deadline != next) {
+		gpm_idle_remove_timeout (idle);
+		if (next >= 0) {
+			idle->priv->timeout_deadline = next;
+			idle->priv->timeout_id = egg_idletime_timeout_add (idle->priv->idletime,
+									   next - idle_time,
+									   "[GpmIdle] deadline",
+									   (GSourceFunc) gpm_idle_timeout_cb, idle);
 		}
 	}
-out:
-	return;
+	gpm_idle_set_mode (idle, mode);
 }
 
 /**
- *  gpm_idle_adjust_timeout_dim:
- *  @idle_time: The new timeout we want to set, in seconds.
- *  @timeout: Current idle time, in seconds.
- *
- *  On slow machines, or machines that have lots to load duing login,
- *  the current idle time could be bigger than the requested timeout.
- *  In this case the scheduled idle timeout will never fire, unless
- *  some user activity (keyboard, mouse) resets the current idle time.
- *  Instead of relying on user activity to correct this issue, we need
- *  to adjust timeout, as related to current idle time, so the idle
- *  timeout will fire as designed.
+ * gpm_idle_sync_alarm:
  *
- *  Return value: timeout to set, adjusted acccording to current idle time.
+ * Sets the idletime alarm to the timeout of the first stage.
  **/
-static guint
-gpm_idle_adjust_timeout_dim (guint idle_time, guint timeout)
+static void
+gpm_idle_sync_alarm (GpmIdle *idle)
 {
-	/* allow 2 sec margin for messaging delay. */
-	idle_time += 2;
+	GpmIdleStage *stage;
+	guint timeout;
 
-	/* Double timeout until it's larger than current idle time.
-	 * Give up for ultra slow machines. (86400 sec = 24 hours) */
-	while (timeout < idle_time && timeout < 86400 && timeout > 0) {
-		timeout *= 2;
-	}
-	return timeout;
+	stage = &g_array_index (idle->priv->stages, GpmIdleStage, 0);
+	timeout = gpm_idle_stage_get_timeout (idle, stage);
+	if (timeout == idle->priv->alarm_timeout)
+		return;
+
+	g_debug ("Setting %s idle timeout: %us", gpm_idle_mode_to_string (stage->mode), timeout);
+	idle->priv->alarm_timeout = timeout;
+	if (timeout > 0)
+		egg_idletime_alarm_set (idle->priv->idletime, GPM_IDLE_IDLETIME_ID, timeout * 1000);
+	else
+		egg_idletime_alarm_remove (idle->priv->idletime, GPM_IDLE_IDLETIME_ID);
 }
 
 /**
- * gpm_idle_set_timeout_dim:
- * @timeout: The new timeout we want to set, in seconds
+ * gpm_idle_set_stage_timeout:
+ * @mode: The stage, e.g. GPM_IDLE_MODE_BLANK
+ * @timeout_ac: The timeout on AC power, in seconds, or 0 to disable
+ * @timeout_battery: The timeout on battery power, in seconds, or 0 to disable
  **/
 gboolean
-gpm_idle_set_timeout_dim (GpmIdle *idle, guint timeout)
+gpm_idle_set_stage_timeout (GpmIdle *idle, GpmIdleMode mode, guint timeout_ac, guint timeout_battery)
 {
-	gint64 idle_time_in_msec;
-	guint timeout_adjusted;
+	GpmIdleStage *stage;
 
 	g_return_val_if_fail (GPM_IS_IDLE (idle), FALSE);
 
-	idle_time_in_msec = egg_idletime_get_time (idle->priv->idletime);
-	timeout_adjusted  = gpm_idle_adjust_timeout_dim (idle_time_in_msec / 1000, timeout);
-	g_debug ("Current idle time=%lldms, timeout was %us, becomes %us after adjustment",
-		   (long long int)idle_time_in_msec, timeout, timeout_adjusted);
-	timeout = timeout_adjusted;
-
-	g_debug ("Setting dim idle timeout: %us", timeout);
-	if (idle->priv->timeout_dim != timeout) {
-		idle->priv->timeout_dim = timeout;
-
-		if (timeout > 0)
-			egg_idletime_alarm_set (idle->priv->idletime, GPM_IDLE_IDLETIME_ID, timeout * 1000);
-		else
-			egg_idletime_alarm_remove (idle->priv->idletime, GPM_IDLE_IDLETIME_ID);
+	stage = gpm_idle_get_stage (idle, mode);
+	if (stage == NULL) {
+		g_warning ("no idle stage %s", gpm_idle_mode_to_string (mode));
+		return FALSE;
 	}
+
+	g_debug ("Setting %s idle timeout: %us on AC, %us on battery",
+		 gpm_idle_mode_to_string (mode), timeout_ac, timeout_battery);
+	if (stage->timeout_ac == timeout_ac && stage->timeout_battery == timeout_battery)
+		return TRUE;
+	stage->timeout_ac = timeout_ac;
+	stage->timeout_battery = timeout_battery;
+	if (stage == &g_array_index (idle->priv->stages, GpmIdleStage, 0))
+		gpm_idle_sync_alarm (idle);
+	gpm_idle_evaluate (idle);
 	return TRUE;
 }
 
 /**
- * gpm_idle_set_timeout_blank:
- * @timeout: The new timeout we want to set, in seconds
+ * gpm_idle_set_timeout_activity:
+ * @timeout: The shortest idle period to report, in seconds, or 0 to only
+ *	     report those that reached the first stage
+ *
+ * Whatever the stages are set to, the "activity" signal gives the length
+ * of every idle period of at least @timeout once the user is back.
  **/
-gboolean
-gpm_idle_set_timeout_blank (GpmIdle *idle, guint timeout)
+void
+gpm_idle_set_timeout_activity (GpmIdle *idle, guint timeout)
 {
-	g_return_val_if_fail (GPM_IS_IDLE (idle), FALSE);
+	g_return_if_fail (GPM_IS_IDLE (idle));
 
-	g_debug ("Setting blank idle timeout: %us", timeout);
-	if (idle->priv->timeout_blank != timeout) {
-		idle->priv->timeout_blank = timeout;
-		gpm_idle_evaluate (idle);
-	}
-	return TRUE;
+	if (idle->priv->activity_timeout == timeout)
+		return;
+	g_debug ("Reporting idle periods from %us", timeout);
+	idle->priv->activity_timeout = timeout;
+	if (timeout > 0)
+		egg_idletime_alarm_set (idle->priv->idletime, GPM_IDLE_ACTIVITY_ID, timeout * 1000);
+	else
+		egg_idletime_alarm_remove (idle->priv->idletime, GPM_IDLE_ACTIVITY_ID);
+}
+
+/**
+ * gpm_idle_set_on_battery:
+ * @on_battery: If the battery profile of each stage should be used
+ **/
+void
+gpm_idle_set_on_battery (GpmIdle *idle, gboolean on_battery)
+{
+	g_return_if_fail (GPM_IS_IDLE (idle));
+
+	if (idle->priv->on_battery == on_battery)
+		return;
+	g_debug ("Using the %s idle timeouts", on_battery ? "battery" : "AC");
+	idle->priv->on_battery = on_battery;
+	gpm_idle_sync_alarm (idle);
+	gpm_idle_evaluate (idle);
 }
 
 /**
- * gpm_idle_set_timeout_sleep:
+ * gpm_idle_set_timeout_dim:
  * @timeout: The new timeout we want to set, in seconds
+ *
+ * If the user has already been idle for longer, the screen dims straight
+ * away.
  **/
 gboolean
-gpm_idle_set_timeout_sleep (GpmIdle *idle, guint timeout)
+gpm_idle_set_timeout_dim (GpmIdle *idle, guint timeout)
 {
 	g_return_val_if_fail (GPM_IS_IDLE (idle), FALSE);
-
-	g_debug ("Setting sleep idle timeout: %us", timeout);
-	if (idle->priv->timeout_sleep != timeout) {
-		idle->priv->timeout_sleep = timeout;
-		gpm_idle_evaluate (idle);
-	}
-	return TRUE;
+	return gpm_idle_set_stage_timeout (idle, GPM_IDLE_MODE_DIM, timeout, timeout);
 }
 
 /**
@@ -353,6 +491,7 @@ static void
 gpm_idle_session_idle_changed_cb (GpmSession *session, gboolean is_idle, GpmIdle *idle)
 {
 	g_debug ("Received mate session idle changed: %i", is_idle);
+	idle->priv->session_idle = is_idle;
 	idle->priv->x_idle = is_idle;
 	gpm_idle_evaluate (idle);
 }
@@ -377,6 +516,13 @@ gpm_idle_idletime_alarm_expired_cb (EggIdletime *idletime, guint alarm_id, GpmId
 {
 	g_debug ("idletime alarm: %u", alarm_id);
 
+	/* work out when the user went, the idle time is not kept after */
+	if (idle->priv->idle_start < 0)
+		idle->priv->idle_start = egg_idletime_get_clock (idletime) -
+					 egg_idletime_get_time (idletime);
+	if (alarm_id == GPM_IDLE_ACTIVITY_ID)
+		return;
+
 	/* set again */
 	idle->priv->x_idle = TRUE;
 	gpm_idle_evaluate (idle);
@@ -390,10 +536,18 @@ gpm_idle_idletime_alarm_expired_cb (EggIdletime *idletime, guint alarm_id, GpmId
 static void
 gpm_idle_idletime_reset_cb (EggIdletime *idletime, GpmIdle *idle)
 {
+	gint64 idle_start = idle->priv->idle_start;
+
 	g_debug ("idletime reset");
 
 	idle->priv->x_idle = FALSE;
+	idle->priv->idle_start = -1;
 	gpm_idle_evaluate (idle);
+
+	/* after the mode is back to normal */
+	if (idle_start >= 0)
+		g_signal_emit (idle, signals [ACTIVITY], 0,
+			       (guint) ((egg_idletime_get_clock (idletime) - idle_start) / 1000));
 }
 
 /**
@@ -412,25 +566,42 @@ gpm_idle_finalize (GObject *object)
 
 	g_return_if_fail (idle->priv != NULL);
 
-	if (idle->priv->timeout_blank_id != 0) {
-		g_source_remove (idle->priv->timeout_blank_id);
-		idle->priv->timeout_blank_id = 0;
-	}
-
-	if (idle->priv->timeout_sleep_id != 0) {
-		g_source_remove (idle->priv->timeout_sleep_id);
-		idle->priv->timeout_sleep_id = 0;
-	}
+	gpm_idle_remove_timeout (idle);
+	g_array_unref (idle->priv->stages);
 
 	g_object_unref (idle->priv->load);
 	g_object_unref (idle->priv->session);
 
 	egg_idletime_alarm_remove (idle->priv->idletime, GPM_IDLE_IDLETIME_ID);
+	egg_idletime_alarm_remove (idle->priv->idletime, GPM_IDLE_ACTIVITY_ID);
+	egg_idletime_set_timeout_funcs (idle->priv->idletime, NULL, NULL, NULL);
 	g_object_unref (idle->priv->idletime);
+	g_object_unref (idle->priv->timer);
 
 	G_OBJECT_CLASS (gpm_idle_parent_class)->finalize (object);
 }
 
+/**
+ * gpm_idle_timer_add_cb:
+ *
+ * The idle deadlines can be a little late, so they share wakeups.
+ **/
+static guint
+gpm_idle_timer_add_cb (guint interval, const gchar *name, GSourceFunc func,
+		       gpointer user_data, GpmTimer *timer)
+{
+	return gpm_timer_add (timer, interval, GPM_IDLE_DEADLINE_SLACK, name, func, user_data);
+}
+
+/**
+ * gpm_idle_timer_remove_cb:
+ **/
+static void
+gpm_idle_timer_remove_cb (guint id, GpmTimer *timer)
+{
+	gpm_timer_remove (timer, id);
+}
+
 /**
  * gpm_idle_class_init:
  * @klass: This class instance
@@ -449,6 +620,13 @@ gpm_idle_class_init (GpmIdleClass *klass)
 			      G_STRUCT_OFFSET (GpmIdleClass, idle_changed),
 			      NULL, NULL, g_cclosure_marshal_VOID__INT,
 			      G_TYPE_NONE, 1, G_TYPE_INT);
+	signals [ACTIVITY] =
+		g_signal_new ("activity",
+			      G_TYPE_FROM_CLASS (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (GpmIdleClass, activity),
+			      NULL, NULL, g_cclosure_marshal_VOID__UINT,
+			      G_TYPE_NONE, 1, G_TYPE_UINT);
 }
 
 /**
@@ -463,18 +641,28 @@ gpm_idle_init (GpmIdle *idle)
 {
 	idle->priv = gpm_idle_get_instance_private (idle);
 
-	idle->priv->timeout_dim = G_MAXUINT;
-	idle->priv->timeout_blank = G_MAXUINT;
-	idle->priv->timeout_sleep = G_MAXUINT;
-	idle->priv->timeout_blank_id = 0;
-	idle->priv->timeout_sleep_id = 0;
+	idle->priv->stages = g_array_sized_new (FALSE, FALSE, sizeof (GpmIdleStage),
+						G_N_ELEMENTS (gpm_idle_stages));
+	g_array_append_vals (idle->priv->stages, gpm_idle_stages, G_N_ELEMENTS (gpm_idle_stages));
+	idle->priv->alarm_timeout = G_MAXUINT;
+	idle->priv->activity_timeout = 0;
+	idle->priv->idle_start = -1;
+	idle->priv->timeout_id = 0;
+	idle->priv->timeout_deadline = -1;
+	idle->priv->on_battery = FALSE;
 	idle->priv->x_idle = FALSE;
 	idle->priv->load = gpm_load_new ();
 	idle->priv->session = gpm_session_new ();
+	idle->priv->session_idle = gpm_session_get_idle (idle->priv->session);
 	g_signal_connect (idle->priv->session, "idle-changed", G_CALLBACK (gpm_idle_session_idle_changed_cb), idle);
 	g_signal_connect (idle->priv->session, "inhibited-changed", G_CALLBACK (gpm_idle_session_inhibited_changed_cb), idle);
 
+	idle->priv->timer = gpm_timer_new ();
 	idle->priv->idletime = egg_idletime_new ();
+	egg_idletime_set_timeout_funcs (idle->priv->idletime,
+					(EggIdletimeTimeoutAddFunc) gpm_idle_timer_add_cb,
+					(EggIdletimeTimeoutRemoveFunc) gpm_idle_timer_remove_cb,
+					idle->priv->timer);
 	g_signal_connect (idle->priv->idletime, "reset", G_CALLBACK (gpm_idle_idletime_reset_cb), idle);
 	g_signal_connect (idle->priv->idletime, "alarm-expired", G_CALLBACK (gpm_idle_idletime_alarm_expired_cb), idle);
 
@@ -502,38 +690,42 @@ gpm_idle_new (void)
  ***************************************************************************/
 #ifdef EGG_TEST
 #include "egg-test.h"
-#include "gpm-dpms.h"
 
 static GpmIdleMode _mode = 0;
+static guint _sleep_count = 0;
+static guint _activity = 0;
 
 static void
 gpm_idle_test_idle_changed_cb (GpmIdle *idle, GpmIdleMode mode, EggTest *test)
 {
 	_mode = mode;
+	if (mode == GPM_IDLE_MODE_SLEEP)
+		_sleep_count++;
 	g_debug ("idle-changed %s", gpm_idle_mode_to_string (mode));
-	egg_test_loop_quit (test);
 }
 
-static gboolean
-gpm_idle_test_delay_cb (EggTest *test)
+static void
+gpm_idle_test_activity_cb (GpmIdle *idle, guint idle_time, EggTest *test)
 {
-	g_warning ("timing out");
-	egg_test_loop_quit (test);
-	return FALSE;
+	_activity = idle_time;
 }
 
 void
 gpm_idle_test (gpointer data)
 {
 	GpmIdle *idle;
-	gboolean ret;
+	EggIdletime *idletime;
 	EggTest *test = (EggTest *) data;
 	GpmIdleMode mode;
-	GpmDpms *dpms;
+	GTimer *timer;
+	guint i;
 
 	if (!egg_test_start (test, "GpmIdle"))
 		return;
 
+	/* all the idle time, and the timeouts, on a virtual clock */
+	idletime = egg_idletime_new_for_backend (EGG_IDLETIME_BACKEND_FAKE);
+
 	/************************************************************/
 	egg_test_title (test, "get object");
 	idle = gpm_idle_new ();
@@ -545,10 +737,12 @@ gpm_idle_test (gpointer data)
 	/* set up defaults */
 	gpm_idle_set_check_cpu (idle, FALSE);
 	gpm_idle_set_timeout_dim (idle, 4);
-	gpm_idle_set_timeout_blank (idle, 5);
-	gpm_idle_set_timeout_sleep (idle, 15);
+	gpm_idle_set_stage_timeout (idle, GPM_IDLE_MODE_BLANK, 5, 7);
+	gpm_idle_set_stage_timeout (idle, GPM_IDLE_MODE_SLEEP, 15, 10);
 	g_signal_connect (idle, "idle-changed",
 			  G_CALLBACK (gpm_idle_test_idle_changed_cb), test);
+	g_signal_connect (idle, "activity",
+			  G_CALLBACK (gpm_idle_test_activity_cb), test);
 
 	/************************************************************/
 	egg_test_title (test, "check cpu type");
@@ -556,27 +750,23 @@ gpm_idle_test (gpointer data)
 
 	/************************************************************/
 	egg_test_title (test, "check timeout dim");
-	egg_test_assert (test, (idle->priv->timeout_dim == 4));
+	egg_test_assert (test, (gpm_idle_get_stage (idle, GPM_IDLE_MODE_DIM)->timeout_ac == 4));
 
 	/************************************************************/
 	egg_test_title (test, "check timeout blank");
-	egg_test_assert (test, (idle->priv->timeout_blank == 5));
+	egg_test_assert (test, (gpm_idle_get_stage (idle, GPM_IDLE_MODE_BLANK)->timeout_ac == 5));
 
 	/************************************************************/
 	egg_test_title (test, "check timeout sleep");
-	egg_test_assert (test, (idle->priv->timeout_sleep == 15));
+	egg_test_assert (test, (gpm_idle_get_stage (idle, GPM_IDLE_MODE_SLEEP)->timeout_ac == 15));
 
 	/************************************************************/
 	egg_test_title (test, "check x_idle");
 	egg_test_assert (test, (idle->priv->x_idle == FALSE));
 
 	/************************************************************/
-	egg_test_title (test, "check blank id");
-	egg_test_assert (test, (idle->priv->timeout_blank_id == 0));
-
-	/************************************************************/
-	egg_test_title (test, "check sleep id");
-	egg_test_assert (test, (idle->priv->timeout_sleep_id == 0));
+	egg_test_title (test, "check no deadline timer");
+	egg_test_assert (test, (idle->priv->timeout_id == 0));
 
 	/************************************************************/
 	egg_test_title (test, "check normal at startup");
@@ -587,18 +777,17 @@ gpm_idle_test (gpointer data)
 		egg_test_failed (test, "mode: %s", gpm_idle_mode_to_string (mode));
 
 	/************************************************************/
-	g_print ("*****************************\n");
-	g_print ("*** DO NOT MOVE THE MOUSE ***\n");
-	g_print ("*****************************\n");
-	egg_test_loop_wait (test, 2000 + 10000);
-	egg_test_loop_check (test);
+	egg_test_title (test, "check still normal just before the dim timeout");
+	egg_idletime_fake_advance (idletime, 3999);
+	egg_test_assert (test, (_mode == GPM_IDLE_MODE_NORMAL));
 
 	/************************************************************/
 	egg_test_title (test, "check callback mode");
+	egg_idletime_fake_advance (idletime, 1);
 	if (_mode == GPM_IDLE_MODE_DIM)
 		egg_test_success (test, NULL);
 	else
-		egg_test_failed (test, "mode: %s", gpm_idle_mode_to_string (mode));
+		egg_test_failed (test, "mode: %s", gpm_idle_mode_to_string (_mode));
 
 	/************************************************************/
 	egg_test_title (test, "check current mode");
@@ -613,23 +802,22 @@ gpm_idle_test (gpointer data)
 	egg_test_assert (test, (idle->priv->x_idle == TRUE));
 
 	/************************************************************/
-	egg_test_title (test, "check blank id");
-	egg_test_assert (test, (idle->priv->timeout_blank_id != 0));
+	egg_test_title (test, "check the timer is for the blank deadline");
+	egg_test_assert (test, (idle->priv->timeout_id != 0 &&
+				idle->priv->timeout_deadline == 5000 &&
+				gpm_idle_get_stage (idle, GPM_IDLE_MODE_BLANK)->deadline == 5000));
 
 	/************************************************************/
-	egg_test_title (test, "check sleep id");
-	egg_test_assert (test, (idle->priv->timeout_sleep_id == 0));
-
-	/************************************************************/
-	egg_test_loop_wait (test, 5000 + 1000);
-	egg_test_loop_check (test);
+	egg_test_title (test, "check sleep is not scheduled");
+	egg_test_assert (test, (gpm_idle_get_stage (idle, GPM_IDLE_MODE_SLEEP)->deadline == -1));
 
 	/************************************************************/
 	egg_test_title (test, "check callback mode");
+	egg_idletime_fake_advance (idletime, 1000);
 	if (_mode == GPM_IDLE_MODE_BLANK)
 		egg_test_success (test, NULL);
 	else
-		egg_test_failed (test, "mode: %s", gpm_idle_mode_to_string (mode));
+		egg_test_failed (test, "mode: %s", gpm_idle_mode_to_string (_mode));
 
 	/************************************************************/
 	egg_test_title (test, "check current mode");
@@ -640,44 +828,36 @@ gpm_idle_test (gpointer data)
 		egg_test_failed (test, "mode: %s", gpm_idle_mode_to_string (mode));
 
 	/************************************************************/
-	g_print ("**********************\n");
-	g_print ("*** MOVE THE MOUSE ***\n");
-	g_print ("**********************\n");
-	egg_test_loop_wait (test, G_MAXUINT);
-	egg_test_loop_check (test);
+	egg_test_title (test, "check no sleep while the session is not idle");
+	egg_idletime_fake_advance (idletime, 60000);
+	egg_test_assert (test, (_mode == GPM_IDLE_MODE_BLANK && _sleep_count == 0));
 
 	/************************************************************/
 	egg_test_title (test, "check callback mode");
+	egg_idletime_fake_activity (idletime);
 	if (_mode == GPM_IDLE_MODE_NORMAL)
 		egg_test_success (test, NULL);
 	else
-		egg_test_failed (test, "mode: %s", gpm_idle_mode_to_string (mode));
-
-	/************************************************************/
-	egg_test_title (test, "check current mode");
-	mode = gpm_idle_get_mode (idle);
-	if (mode == GPM_IDLE_MODE_NORMAL)
-		egg_test_success (test, NULL);
-	else
-		egg_test_failed (test, "mode: %s", gpm_idle_mode_to_string (mode));
+		egg_test_failed (test, "mode: %s", gpm_idle_mode_to_string (_mode));
 
 	/************************************************************/
 	egg_test_title (test, "check x_idle");
 	egg_test_assert (test, (idle->priv->x_idle == FALSE));
 
 	/************************************************************/
-	egg_test_title (test, "check blank id");
-	egg_test_assert (test, (idle->priv->timeout_blank_id == 0));
+	egg_test_title (test, "check no deadline timer");
+	egg_test_assert (test, (idle->priv->timeout_id == 0));
 
 	/************************************************************/
-	g_print ("*****************************\n");
-	g_print ("*** DO NOT MOVE THE MOUSE ***\n");
-	g_print ("*****************************\n");
-	egg_test_loop_wait (test, 4000 + 1500);
-	egg_test_loop_check (test);
+	egg_test_title (test, "check the whole idle period was reported");
+	if (_activity == 65)
+		egg_test_success (test, NULL);
+	else
+		egg_test_failed (test, "idle for %us", _activity);
 
 	/************************************************************/
 	egg_test_title (test, "check current mode");
+	egg_idletime_fake_advance (idletime, 4000);
 	mode = gpm_idle_get_mode (idle);
 	if (mode == GPM_IDLE_MODE_DIM)
 		egg_test_success (test, NULL);
@@ -685,50 +865,110 @@ gpm_idle_test (gpointer data)
 		egg_test_failed (test, "mode: %s", gpm_idle_mode_to_string (mode));
 
 	/************************************************************/
-	egg_test_title (test, "check x_idle");
-	egg_test_assert (test, (idle->priv->x_idle == TRUE));
-
-	egg_test_loop_wait (test, 15000);
-	egg_test_loop_check (test);
+	egg_test_title (test, "check sleep is scheduled once the session is idle");
+	g_signal_emit_by_name (idle->priv->session, "idle-changed", TRUE);
+	egg_test_assert (test, (gpm_idle_get_stage (idle, GPM_IDLE_MODE_SLEEP)->deadline >= 0));
 
 	/************************************************************/
-	egg_test_title (test, "check current mode");
+	egg_test_title (test, "check blank then sleep");
+	egg_idletime_fake_advance (idletime, 1000);
 	mode = gpm_idle_get_mode (idle);
-	if (mode == GPM_IDLE_MODE_BLANK)
+	egg_idletime_fake_advance (idletime, 14000);
+	if (mode == GPM_IDLE_MODE_BLANK && _mode == GPM_IDLE_MODE_SLEEP && _sleep_count == 1)
 		egg_test_success (test, NULL);
 	else
-		egg_test_failed (test, "mode: %s", gpm_idle_mode_to_string (mode));
+		egg_test_failed (test, "mode: %s", gpm_idle_mode_to_string (_mode));
 
 	/************************************************************/
-	egg_test_title (test, "set dpms off");
-	dpms = gpm_dpms_new ();
-	ret = gpm_dpms_set_mode (dpms, GPM_DPMS_MODE_OFF, NULL);
-	egg_test_assert (test, ret);
+	egg_test_title (test, "run dim, blank and sleep many times");
+	timer = g_timer_new ();
+	for (i = 0; i < 10000; i++) {
+		egg_idletime_fake_activity (idletime);
+		egg_idletime_fake_advance (idletime, 15000);
+	}
+	if (_sleep_count == 10001)
+		egg_test_success (test, "%u cycles in %.1fms", i, g_timer_elapsed (timer, NULL) * 1000.0f);
+	else
+		egg_test_failed (test, "slept %u times", _sleep_count);
+	g_timer_destroy (timer);
 
-	/* wait for normal event to be suppressed */
-	g_timeout_add (2000, (GSourceFunc) gpm_idle_test_delay_cb, test);
-	egg_test_loop_wait (test, G_MAXUINT);
-	egg_test_loop_check (test);
+	/************************************************************/
+	egg_test_title (test, "check the battery profile is used on battery");
+	gpm_idle_set_on_battery (idle, TRUE);
+	egg_idletime_fake_activity (idletime);
+	egg_idletime_fake_advance (idletime, 6000);
+	egg_test_assert (test, (_mode == GPM_IDLE_MODE_DIM));
 
 	/************************************************************/
-	egg_test_title (test, "check current mode");
+	egg_test_title (test, "check blank then sleep on battery");
+	egg_idletime_fake_advance (idletime, 1000);
 	mode = gpm_idle_get_mode (idle);
-	if (mode == GPM_IDLE_MODE_BLANK)
+	egg_idletime_fake_advance (idletime, 3000);
+	if (mode == GPM_IDLE_MODE_BLANK && _mode == GPM_IDLE_MODE_SLEEP && _sleep_count == 10002)
 		egg_test_success (test, NULL);
 	else
-		egg_test_failed (test, "mode: %s", gpm_idle_mode_to_string (mode));
+		egg_test_failed (test, "mode: %s, slept %u times", gpm_idle_mode_to_string (_mode), _sleep_count);
 
 	/************************************************************/
-	egg_test_title (test, "check x_idle");
-	egg_test_assert (test, (idle->priv->x_idle == TRUE));
+	egg_test_title (test, "check a dim timeout set after its time dims straight away");
+	gpm_idle_set_timeout_dim (idle, 0);
+	egg_idletime_fake_activity (idletime);
+	egg_idletime_fake_advance (idletime, 6000);
+	mode = gpm_idle_get_mode (idle);
+	gpm_idle_set_timeout_dim (idle, 5);
+	egg_idletime_fake_advance (idletime, 0);
+	if (mode == GPM_IDLE_MODE_NORMAL && _mode == GPM_IDLE_MODE_DIM)
+		egg_test_success (test, NULL);
+	else
+		egg_test_failed (test, "mode: %s", gpm_idle_mode_to_string (_mode));
+
+	/************************************************************/
+	egg_test_title (test, "check the dim timeout was not pushed back");
+	egg_test_assert (test, (gpm_idle_get_stage (idle, GPM_IDLE_MODE_DIM)->timeout_ac == 5));
+
+	/************************************************************/
+	egg_test_title (test, "check the blank deadline is still the idle time it was");
+	egg_test_assert (test, (idle->priv->timeout_deadline == 7000));
+
+	/************************************************************/
+	egg_test_title (test, "check an idle period too short to dim is reported");
+	gpm_idle_set_timeout_activity (idle, 2);
+	egg_idletime_fake_activity (idletime);
+	_activity = 0;
+	egg_idletime_fake_advance (idletime, 3000);
+	egg_idletime_fake_activity (idletime);
+	if (_mode == GPM_IDLE_MODE_NORMAL && _activity == 3)
+		egg_test_success (test, NULL);
+	else
+		egg_test_failed (test, "mode: %s, idle for %us", gpm_idle_mode_to_string (_mode), _activity);
 
-	gpm_dpms_set_mode (dpms, GPM_DPMS_MODE_ON, NULL);
+	/************************************************************/
+	egg_test_title (test, "check the keyboard goes off between dim and blank");
+	gpm_idle_set_stage_timeout (idle, GPM_IDLE_MODE_KBD_OFF, 6, 6);
+	egg_idletime_fake_advance (idletime, 6000);
+	mode = gpm_idle_get_mode (idle);
+	egg_idletime_fake_advance (idletime, 1000);
+	if (mode == GPM_IDLE_MODE_KBD_OFF && _mode == GPM_IDLE_MODE_BLANK)
+		egg_test_success (test, NULL);
+	else
+		egg_test_failed (test, "mode: %s then %s", gpm_idle_mode_to_string (mode),
+				 gpm_idle_mode_to_string (_mode));
+
+	/************************************************************/
+	egg_test_title (test, "check a later shallower stage does not take the mode back");
+	gpm_idle_set_stage_timeout (idle, GPM_IDLE_MODE_KBD_OFF, 8, 8);
+	egg_idletime_fake_activity (idletime);
+	egg_idletime_fake_advance (idletime, 8000);
+	if (_mode == GPM_IDLE_MODE_BLANK)
+		egg_test_success (test, NULL);
+	else
+		egg_test_failed (test, "mode: %s", gpm_idle_mode_to_string (_mode));
+	gpm_idle_set_stage_timeout (idle, GPM_IDLE_MODE_KBD_OFF, 0, 0);
 
 	g_object_unref (idle);
-	g_object_unref (dpms);
+	g_object_unref (idletime);
 
 	egg_test_end (test);
 }
 
 #endif
-
@@ -35,13 +35,26 @@ G_BEGIN_DECLS
 #define GPM_IS_IDLE_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), GPM_TYPE_IDLE))
 #define GPM_IDLE_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), GPM_TYPE_IDLE, GpmIdleClass))
 
+/* shallowest first, so a mode implies everything before it */
 typedef enum {
 	GPM_IDLE_MODE_NORMAL,
 	GPM_IDLE_MODE_DIM,
-	GPM_IDLE_MODE_BLANK,
-	GPM_IDLE_MODE_SLEEP
+	GPM_IDLE_MODE_KBD_OFF,		/* the keyboard backlight goes off */
+	GPM_IDLE_MODE_BLANK,		/* the screen goes to the DPMS policy mode */
+	GPM_IDLE_MODE_DPMS_OFF,		/* the screen goes fully off */
+	GPM_IDLE_MODE_SLEEP,
+	GPM_IDLE_MODE_HIBERNATE
 } GpmIdleMode;
 
+/* what holds an idle stage back */
+typedef enum {
+	GPM_IDLE_INHIBIT_NONE		= 0,
+	GPM_IDLE_INHIBIT_IDLE		= 1 << 0,	/* an idle inhibitor */
+	GPM_IDLE_INHIBIT_SUSPEND	= 1 << 1,	/* a suspend inhibitor */
+	GPM_IDLE_INHIBIT_SESSION	= 1 << 2,	/* the session is not idle */
+	GPM_IDLE_INHIBIT_CPU		= 1 << 3	/* the CPU is busy */
+} GpmIdleInhibit;
+
 typedef struct GpmIdlePrivate GpmIdlePrivate;
 
 typedef struct
@@ -55,6 +68,8 @@ typedef struct
 	GObjectClass	parent_class;
 	void		(* idle_changed)		(GpmIdle	*idle,
 							 GpmIdleMode	 mode);
+	void		(* activity)			(GpmIdle	*idle,
+							 guint		 idle_time);
 } GpmIdleClass;
 
 GType		 gpm_idle_get_type			(void);
@@ -64,10 +79,14 @@ void		 gpm_idle_set_check_cpu			(GpmIdle	*idle,
 							 gboolean	 check_type_cpu);
 gboolean	 gpm_idle_set_timeout_dim		(GpmIdle	*idle,
 							 guint		 timeout);
-gboolean	 gpm_idle_set_timeout_blank		(GpmIdle	*idle,
-							 guint		 timeout);
-gboolean	 gpm_idle_set_timeout_sleep		(GpmIdle	*idle,
+gboolean	 gpm_idle_set_stage_timeout		(GpmIdle	*idle,
+							 GpmIdleMode	 mode,
+							 guint		 timeout_ac,
+							 guint		 timeout_battery);
+void		 gpm_idle_set_timeout_activity		(GpmIdle	*idle,
 							 guint		 timeout);
+void		 gpm_idle_set_on_battery		(GpmIdle	*idle,
+							 gboolean	 on_battery);
 void		 gpm_idle_test				(gpointer	 data);
 
 G_END_DECLS
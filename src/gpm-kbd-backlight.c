@@ -28,25 +28,48 @@
 #include "gpm-button.h"
 #include "gpm-common.h"
 #include "gpm-control.h"
+#include "gpm-display.h"
 #include "gpm-idle.h"
 #include "gpm-kbd-backlight.h"
+#include "gpm-policy.h"
 #include "gsd-media-keys-window.h"
 
+#define GPM_KBD_BACKLIGHT_UPOWER_PATH    "/org/freedesktop/UPower"
+#define GPM_KBD_BACKLIGHT_NODE_PREFIX    "KbdBacklight"
+
+/* one UPower keyboard backlight, written to one call at a time */
+typedef struct
+{
+    GpmKbdBacklight *backlight;
+    gchar           *object_path;
+    GCancellable    *cancellable;     /* cancelled when the device is freed */
+    GDBusProxy      *proxy;
+    gboolean         ready;
+    gint             brightness;      /* last known hardware level */
+    gint             max_brightness;
+    gint             target;          /* newest level asked for */
+    gint             written;         /* level of the call in flight */
+    gboolean         in_flight;
+} GpmKbdBacklightDevice;
+
 struct GpmKbdBacklightPrivate
 {
     UpClient        *client;
     GpmButton       *button;
     GSettings       *settings;
+    GpmPolicy       *policy;
     GpmControl      *control;
     GpmIdle         *idle;
+    GpmDisplay      *display;
     gboolean         can_dim;
     gboolean         system_is_idle;
     GTimer          *idle_timer;
     guint            idle_dim_timeout;
-    guint            brightness;
-    guint            max_brightness;
     guint            brightness_percent;
-    GDBusProxy      *upower_proxy;
+    GPtrArray       *devices;         /* of GpmKbdBacklightDevice */
+    GCancellable    *cancellable;
+    GDBusConnection *system_bus;
+    guint            upower_watch_id;
     GDBusConnection     *bus_connection;
     guint            bus_object_id;
     GtkWidget		*popup;
@@ -61,6 +84,8 @@ static guint signals [LAST_SIGNAL] = { 0 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (GpmKbdBacklight, gpm_kbd_backlight, G_TYPE_OBJECT)
 
+static gboolean gpm_kbd_backlight_evaluate_power_source_and_set (GpmKbdBacklight *backlight);
+
 /**
  * gpm_kbd_backlight_error_quark:
  * Return value: Our personal error quark.
@@ -74,6 +99,106 @@ gpm_kbd_backlight_error_quark (void)
    return quark;
 }
 
+/**
+ * gpm_kbd_backlight_device_free:
+ **/
+static void
+gpm_kbd_backlight_device_free (GpmKbdBacklightDevice *device)
+{
+   /* the callbacks still pending only see G_IO_ERROR_CANCELLED */
+   g_cancellable_cancel (device->cancellable);
+   g_object_unref (device->cancellable);
+   if (device->proxy != NULL) {
+       g_signal_handlers_disconnect_by_data (device->proxy, device);
+       g_object_unref (device->proxy);
+   }
+   g_free (device->object_path);
+   g_free (device);
+}
+
+/**
+ * gpm_kbd_backlight_get_primary:
+ *
+ * Return value: the device the brightness is reported from, the first
+ * one that has answered, or %NULL
+ **/
+static GpmKbdBacklightDevice *
+gpm_kbd_backlight_get_primary (GpmKbdBacklight *backlight)
+{
+   GpmKbdBacklightDevice *device;
+   guint i;
+
+   for (i = 0; i < backlight->priv->devices->len; i++) {
+       device = g_ptr_array_index (backlight->priv->devices, i);
+       if (device->ready && device->max_brightness > 0)
+           return device;
+   }
+   return NULL;
+}
+
+static void gpm_kbd_backlight_device_write (GpmKbdBacklightDevice *device);
+
+/**
+ * gpm_kbd_backlight_device_write_cb:
+ **/
+static void
+gpm_kbd_backlight_device_write_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+   GpmKbdBacklightDevice *device = user_data;
+   GVariant *result;
+   GError *error = NULL;
+
+   result = g_dbus_proxy_call_finish (G_DBUS_PROXY (source), res, &error);
+   if (result == NULL) {
+       /* the device has already been freed */
+       if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+           g_error_free (error);
+           return;
+       }
+       g_warning ("Failed to set brightness of %s to %i: %s",
+                  device->object_path, device->written, error->message);
+       g_error_free (error);
+
+       /* do not retry, unless something newer was asked for */
+       if (device->target == device->written)
+           device->target = device->brightness;
+   } else {
+       device->brightness = device->written;
+       g_variant_unref (result);
+   }
+   device->in_flight = FALSE;
+
+   /* only the newest level that came in meanwhile is written */
+   if (device->target != device->brightness)
+       gpm_kbd_backlight_device_write (device);
+}
+
+/**
+ * gpm_kbd_backlight_device_write:
+ *
+ * Writes the target level, unless a write is already in flight, in
+ * which case that write picks up the target when it completes.
+ **/
+static void
+gpm_kbd_backlight_device_write (GpmKbdBacklightDevice *device)
+{
+   if (!device->ready || device->in_flight)
+       return;
+   if (device->target < 0 || device->target == device->brightness)
+       return;
+
+   device->in_flight = TRUE;
+   device->written = device->target;
+   g_dbus_proxy_call (device->proxy,
+                      "SetBrightness",
+                      g_variant_new ("(i)", device->written),
+                      G_DBUS_CALL_FLAGS_NONE,
+                      -1,
+                      device->cancellable,
+                      gpm_kbd_backlight_device_write_cb,
+                      device);
+}
+
 /**
  * gpm_kbd_backlight_get_brightness:
  * @backlight:
@@ -107,37 +232,39 @@ gpm_kbd_backlight_set (GpmKbdBacklight *backlight,
                        guint percentage,
                        gboolean save)
 {
+   GpmKbdBacklightDevice *primary;
+   GpmKbdBacklightDevice *device;
    gint scale;
-   guint goal;
+   gint goal;
+   guint i;
 
    g_return_val_if_fail (GPM_IS_KBD_BACKLIGHT (backlight), FALSE);
    /* avoid warnings if no keyboard brightness is available */
-   if (backlight->priv->max_brightness < 1)
+   primary = gpm_kbd_backlight_get_primary (backlight);
+   if (primary == NULL)
        return FALSE;
-   /* if we're setting the same we are, don't bother */
-   //g_return_val_if_fail (backlight->priv->brightness_percent != percentage, FALSE);
 
-   goal = gpm_discrete_from_percent (percentage, backlight->priv->max_brightness);
+   goal = gpm_discrete_from_percent (percentage, primary->max_brightness);
    scale = percentage > backlight->priv->brightness_percent ? 1 : -1;
 
    /* if percentage change too small force next value */
-   if (goal == backlight->priv->brightness) {
+   if (goal == primary->target) {
        goal += percentage == backlight->priv->brightness_percent ? 0 : scale;
    }
-
-   /* step loop down by 1 for a dimming effect */
-   while (backlight->priv->brightness != goal) {
-       backlight->priv->brightness += scale;
-       backlight->priv->brightness_percent = gpm_discrete_to_percent (backlight->priv->brightness, backlight->priv->max_brightness);
-
-       g_dbus_proxy_call (backlight->priv->upower_proxy,
-                      "SetBrightness",
-                   g_variant_new ("(i)", (gint) backlight->priv->brightness),
-                   G_DBUS_CALL_FLAGS_NONE,
-                   -1,
-                   NULL,
-                   NULL,
-                   NULL);
+   goal = CLAMP (goal, 0, primary->max_brightness);
+   backlight->priv->brightness_percent = gpm_discrete_to_percent (goal, primary->max_brightness);
+
+   /* the other devices follow at the same percentage */
+   for (i = 0; i < backlight->priv->devices->len; i++) {
+       device = g_ptr_array_index (backlight->priv->devices, i);
+       if (!device->ready)
+           continue;
+       if (device == primary)
+           device->target = goal;
+       else
+           device->target = gpm_discrete_from_percent (backlight->priv->brightness_percent,
+                                                       device->max_brightness);
+       gpm_kbd_backlight_device_write (device);
    }
 
    /* On user interaction, save the target brightness in the only setting we
@@ -149,11 +276,13 @@ gpm_kbd_backlight_set (GpmKbdBacklight *backlight,
         * the scaling would yield the current value.  It's however not possible
         * to make it accurate as any value that is higher than the dim percentage
         * cannot be saved (as the saved value is 0-100). */
-       if (g_settings_get_boolean (backlight->priv->settings, GPM_SETTINGS_KBD_BACKLIGHT_BATT_REDUCE) &&
+       const GpmPolicySnapshot *policy = gpm_policy_get (backlight->priv->policy);
+
+       if (policy->kbd_backlight_battery_reduce &&
            up_client_get_on_battery (backlight->priv->client)) {
            gint dim_pct;
 
-           dim_pct = g_settings_get_int (backlight->priv->settings, GPM_SETTINGS_KBD_BRIGHTNESS_DIM_BY_ON_BATT);
+           dim_pct = policy->kbd_brightness_dim_by_on_battery;
 
            if (dim_pct > 100) {
               g_warning ("Cannot scale brightness down by more than 100%%. Scaling by 50%%");
@@ -167,7 +296,7 @@ gpm_kbd_backlight_set (GpmKbdBacklight *backlight,
        g_settings_set_int (backlight->priv->settings, GPM_SETTINGS_KBD_BRIGHTNESS_ON_AC, ac_value);
    }
 
-   g_debug("Set brightness to %u", backlight->priv->brightness);
+   g_debug("Set brightness to %i", goal);
    return TRUE;
 }
 
@@ -320,11 +449,20 @@ gpm_kbd_backlight_set_brightness (GpmKbdBacklight *backlight,
 }
 
 static void
-gpm_kbd_backlight_on_brightness_changed (GpmKbdBacklight *backlight,
-                    guint value)
+gpm_kbd_backlight_on_brightness_changed (GpmKbdBacklightDevice *device,
+                    gint value)
 {
-   backlight->priv->brightness = value;
-   backlight->priv->brightness_percent = gpm_discrete_to_percent (value, backlight->priv->max_brightness);
+   GpmKbdBacklight *backlight = device->backlight;
+
+   device->brightness = value;
+
+   /* changed from outside, e.g. by the firmware, so start from there */
+   if (!device->in_flight)
+       device->target = value;
+
+   if (device != gpm_kbd_backlight_get_primary (backlight))
+       return;
+   backlight->priv->brightness_percent = gpm_discrete_to_percent (value, device->max_brightness);
    g_signal_emit (backlight, signals [BRIGHTNESS_CHANGED], 0, backlight->priv->brightness_percent);
 }
 
@@ -338,12 +476,12 @@ gpm_kbd_backlight_on_dbus_signal (GDBusProxy *proxy,
                  GVariant   *parameters,
                  gpointer    user_data)
 {
-   guint value;
-   GpmKbdBacklight *backlight = GPM_KBD_BACKLIGHT (user_data);
+   gint value;
+   GpmKbdBacklightDevice *device = user_data;
 
    if (g_strcmp0 (signal_name, "BrightnessChanged") == 0) {
        g_variant_get (parameters, "(i)", &value);
-       gpm_kbd_backlight_on_brightness_changed (backlight, value);
+       gpm_kbd_backlight_on_brightness_changed (device, value);
        return;
    }
 
@@ -356,7 +494,7 @@ gpm_kbd_backlight_get_ac_percentage_dimmed (GpmKbdBacklight *backlight,
 {
    guint value;
 
-   value = g_settings_get_int (backlight->priv->settings, GPM_SETTINGS_KBD_BRIGHTNESS_ON_AC);
+   value = gpm_policy_get (backlight->priv->policy)->kbd_brightness_on_ac;
    if (value > 100) {
       value = 100;
    }
@@ -377,27 +515,55 @@ gpm_kbd_backlight_get_ac_percentage_dimmed (GpmKbdBacklight *backlight,
    return value;
 }
 
+/**
+ * gpm_kbd_backlight_evaluate_power_source:
+ * @value: Return location for the brightness for the power source
+ *
+ * Return value: %FALSE if the policy is to leave the brightness alone
+ **/
 static gboolean
-gpm_kbd_backlight_evaluate_power_source_and_set (GpmKbdBacklight *backlight)
+gpm_kbd_backlight_evaluate_power_source (GpmKbdBacklight *backlight,
+                                         guint *value)
 {
-   guint value;
+   const GpmPolicySnapshot *policy = gpm_policy_get (backlight->priv->policy);
    guint dim_by = 0;
 
-   if (g_settings_get_boolean (backlight->priv->settings, GPM_SETTINGS_KBD_BACKLIGHT_ENABLE) == FALSE) {
+   if (policy->kbd_backlight_enable == FALSE) {
       g_debug ("policy is no dimming");
-      return TRUE;
+      return FALSE;
    }
 
    if (up_client_get_on_battery (backlight->priv->client) &&
-       g_settings_get_boolean (backlight->priv->settings, GPM_SETTINGS_KBD_BACKLIGHT_BATT_REDUCE)) {
-      dim_by = g_settings_get_int (backlight->priv->settings, GPM_SETTINGS_KBD_BRIGHTNESS_DIM_BY_ON_BATT);
+       policy->kbd_backlight_battery_reduce) {
+      dim_by = policy->kbd_brightness_dim_by_on_battery;
    }
 
-   value = gpm_kbd_backlight_get_ac_percentage_dimmed (backlight, dim_by);
+   *value = gpm_kbd_backlight_get_ac_percentage_dimmed (backlight, dim_by);
+   return TRUE;
+}
+
+static gboolean
+gpm_kbd_backlight_evaluate_power_source_and_set (GpmKbdBacklight *backlight)
+{
+   guint value;
+
+   if (!gpm_kbd_backlight_evaluate_power_source (backlight, &value))
+      return TRUE;
 
    return gpm_kbd_backlight_set (backlight, value, FALSE);
 }
 
+/**
+ * gpm_kbd_backlight_display_kbd_cb:
+ *
+ * Called by the display coordinator when a transition is applied.
+ **/
+static void
+gpm_kbd_backlight_display_kbd_cb (guint percentage, gpointer user_data)
+{
+   gpm_kbd_backlight_set (GPM_KBD_BACKLIGHT (user_data), percentage, FALSE);
+}
+
 /**
  * gpm_kbd_backlight_control_resume_cb:
  * @control: The control class instance
@@ -429,7 +595,7 @@ gpm_kbd_backlight_client_changed_cb (UpClient *client,
                                      GParamSpec *pspec,
                                      GpmKbdBacklight *backlight)
 {
-   if (g_settings_get_boolean (backlight->priv->settings, GPM_SETTINGS_KBD_BACKLIGHT_BATT_REDUCE)) {
+   if (gpm_policy_get (backlight->priv->policy)->kbd_backlight_battery_reduce) {
       gpm_kbd_backlight_evaluate_power_source_and_set (backlight);
    }
 }
@@ -502,6 +668,7 @@ gpm_kbd_backlight_idle_changed_cb (GpmIdle *idle,
                   GpmIdleMode mode,
                   GpmKbdBacklight *backlight)
 {
+   const GpmPolicySnapshot *policy = gpm_policy_get (backlight->priv->policy);
    guint value;
    gboolean enable_action;
 
@@ -511,23 +678,332 @@ gpm_kbd_backlight_idle_changed_cb (GpmIdle *idle,
        return;
 
    enable_action = up_client_get_on_battery (backlight->priv->client)
-       ? g_settings_get_boolean (backlight->priv->settings, GPM_SETTINGS_IDLE_DIM_BATT)
-       : g_settings_get_boolean (backlight->priv->settings, GPM_SETTINGS_IDLE_DIM_AC);
+       ? policy->idle_dim_battery
+       : policy->idle_dim_ac;
 
    if (!enable_action)
        return;
 
+   /* applied along with the screen, see GpmDisplay */
    if (mode == GPM_IDLE_MODE_NORMAL) {
        g_debug ("GPM_IDLE_MODE_NORMAL");
-       gpm_kbd_backlight_evaluate_power_source_and_set (backlight);
+       if (!gpm_kbd_backlight_evaluate_power_source (backlight, &value))
+           return;
+       gpm_display_set_kbd_brightness (backlight->priv->display, value);
+       gpm_display_commit (backlight->priv->display);
    } else if (mode == GPM_IDLE_MODE_DIM) {
        g_debug ("GPM_IDLE_MODE_DIM");
-       value = g_settings_get_int (backlight->priv->settings, GPM_SETTINGS_KBD_BRIGHTNESS_DIM_BY_ON_IDLE);
+       value = policy->kbd_brightness_dim_by_on_idle;
        value = gpm_kbd_backlight_get_ac_percentage_dimmed (backlight, value);
-       gpm_kbd_backlight_set (backlight, value, FALSE);
-   } else if (mode == GPM_IDLE_MODE_BLANK) {
-       gpm_kbd_backlight_set (backlight, 0u, FALSE);
+       gpm_display_set_kbd_brightness (backlight->priv->display, value);
+       gpm_display_commit (backlight->priv->display);
+   } else if (mode >= GPM_IDLE_MODE_KBD_OFF && mode <= GPM_IDLE_MODE_DPMS_OFF) {
+       gpm_display_set_kbd_brightness (backlight->priv->display, 0u);
+       gpm_display_commit (backlight->priv->display);
+   }
+}
+
+/**
+ * gpm_kbd_backlight_device_ready:
+ **/
+static void
+gpm_kbd_backlight_device_ready (GpmKbdBacklightDevice *device)
+{
+   GpmKbdBacklight *backlight = device->backlight;
+
+   g_debug ("keyboard backlight %s at %i of %i",
+            device->object_path, device->brightness, device->max_brightness);
+   device->ready = TRUE;
+   device->target = device->brightness;
+   if (device == gpm_kbd_backlight_get_primary (backlight))
+       backlight->priv->brightness_percent = gpm_discrete_to_percent (device->brightness,
+                                                                      device->max_brightness);
+   if (device->max_brightness > 1)
+       backlight->priv->can_dim = TRUE;
+
+   /* set initial values for whether we're on AC or battery */
+   gpm_kbd_backlight_evaluate_power_source_and_set (backlight);
+}
+
+/**
+ * gpm_kbd_backlight_device_get_brightness_cb:
+ **/
+static void
+gpm_kbd_backlight_device_get_brightness_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+   GpmKbdBacklightDevice *device = user_data;
+   GVariant *result;
+   GError *error = NULL;
+
+   result = g_dbus_proxy_call_finish (G_DBUS_PROXY (source), res, &error);
+   if (result == NULL) {
+       if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+           g_warning ("Failed to get brightness of %s: %s", device->object_path, error->message);
+           g_ptr_array_remove (device->backlight->priv->devices, device);
+       }
+       g_error_free (error);
+       return;
+   }
+   g_variant_get (result, "(i)", &device->brightness);
+   g_variant_unref (result);
+   gpm_kbd_backlight_device_ready (device);
+}
+
+/**
+ * gpm_kbd_backlight_device_get_max_brightness_cb:
+ **/
+static void
+gpm_kbd_backlight_device_get_max_brightness_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+   GpmKbdBacklightDevice *device = user_data;
+   GVariant *result;
+   GError *error = NULL;
+
+   result = g_dbus_proxy_call_finish (G_DBUS_PROXY (source), res, &error);
+   if (result == NULL) {
+       if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+           /* no keyboard backlight behind this object */
+           if (g_dbus_error_is_remote_error (error))
+               g_debug ("No keyboard backlight at %s: %s", device->object_path, error->message);
+           else
+               g_warning ("Failed to get max brightness of %s: %s", device->object_path, error->message);
+           g_ptr_array_remove (device->backlight->priv->devices, device);
+       }
+       g_error_free (error);
+       return;
+   }
+   g_variant_get (result, "(i)", &device->max_brightness);
+   g_variant_unref (result);
+   if (device->max_brightness < 1) {
+       g_ptr_array_remove (device->backlight->priv->devices, device);
+       return;
+   }
+
+   g_dbus_proxy_call (device->proxy,
+                      "GetBrightness",
+                      NULL,
+                      G_DBUS_CALL_FLAGS_NONE,
+                      -1,
+                      device->cancellable,
+                      gpm_kbd_backlight_device_get_brightness_cb,
+                      device);
+}
+
+/**
+ * gpm_kbd_backlight_device_proxy_cb:
+ **/
+static void
+gpm_kbd_backlight_device_proxy_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+   GpmKbdBacklightDevice *device = user_data;
+   GDBusProxy *proxy;
+   GError *error = NULL;
+
+   /* the device may be gone, so do not touch it until we know */
+   proxy = g_dbus_proxy_new_finish (res, &error);
+   if (proxy == NULL) {
+       if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+           g_warning ("Could not connect to %s: %s", device->object_path, error->message);
+           g_ptr_array_remove (device->backlight->priv->devices, device);
+       }
+       g_error_free (error);
+       return;
+   }
+   device->proxy = proxy;
+
+   g_signal_connect (device->proxy,
+             "g-signal",
+             G_CALLBACK (gpm_kbd_backlight_on_dbus_signal),
+             device);
+   g_dbus_proxy_call (device->proxy,
+                      "GetMaxBrightness",
+                      NULL,
+                      G_DBUS_CALL_FLAGS_NONE,
+                      -1,
+                      device->cancellable,
+                      gpm_kbd_backlight_device_get_max_brightness_cb,
+                      device);
+}
+
+/**
+ * gpm_kbd_backlight_device_add:
+ **/
+static void
+gpm_kbd_backlight_device_add (GpmKbdBacklight *backlight,
+                              GDBusConnection *connection,
+                              const gchar *object_path)
+{
+   GpmKbdBacklightDevice *device;
+
+   guint i;
+
+   /* already known from an earlier look */
+   for (i = 0; i < backlight->priv->devices->len; i++) {
+       device = g_ptr_array_index (backlight->priv->devices, i);
+       if (g_strcmp0 (device->object_path, object_path) == 0)
+           return;
+   }
+
+   device = g_new0 (GpmKbdBacklightDevice, 1);
+   device->backlight = backlight;
+   device->object_path = g_strdup (object_path);
+   device->cancellable = g_cancellable_new ();
+   device->target = -1;
+   g_ptr_array_add (backlight->priv->devices, device);
+
+   g_dbus_proxy_new (connection,
+                     G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
+                     NULL,
+                     "org.freedesktop.UPower",
+                     object_path,
+                     "org.freedesktop.UPower.KbdBacklight",
+                     device->cancellable,
+                     gpm_kbd_backlight_device_proxy_cb,
+                     device);
+}
+
+/**
+ * gpm_kbd_backlight_introspect_cb:
+ *
+ * UPower exports each keyboard backlight as a KbdBacklight node of its
+ * own object, so use all of them that are not already known.
+ **/
+static void
+gpm_kbd_backlight_introspect_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+   GpmKbdBacklight *backlight = user_data;
+   GDBusConnection *connection = G_DBUS_CONNECTION (source);
+   GDBusNodeInfo *info = NULL;
+   GVariant *result;
+   GError *error = NULL;
+   const gchar *xml;
+   gchar *path;
+   guint i;
+
+   result = g_dbus_connection_call_finish (connection, res, &error);
+   if (result != NULL) {
+       g_variant_get (result, "(&s)", &xml);
+       info = g_dbus_node_info_new_for_xml (xml, &error);
+       g_variant_unref (result);
+   }
+   if (info == NULL) {
+       if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+           g_error_free (error);
+           return;
+       }
+       g_debug ("Cannot list the UPower objects, trying the default keyboard backlight: %s",
+                error->message);
+       g_error_free (error);
+       gpm_kbd_backlight_device_add (backlight, connection,
+                                     GPM_KBD_BACKLIGHT_UPOWER_PATH "/" GPM_KBD_BACKLIGHT_NODE_PREFIX);
+       return;
+   }
+
+   for (i = 0; info->nodes != NULL && info->nodes[i] != NULL; i++) {
+       if (!g_str_has_prefix (info->nodes[i]->path, GPM_KBD_BACKLIGHT_NODE_PREFIX))
+           continue;
+       path = g_strdup_printf ("%s/%s", GPM_KBD_BACKLIGHT_UPOWER_PATH, info->nodes[i]->path);
+       gpm_kbd_backlight_device_add (backlight, connection, path);
+       g_free (path);
+   }
+   g_dbus_node_info_unref (info);
+}
+
+/**
+ * gpm_kbd_backlight_scan:
+ *
+ * Looks for keyboard backlights that are not known yet.
+ **/
+static void
+gpm_kbd_backlight_scan (GpmKbdBacklight *backlight)
+{
+   if (backlight->priv->system_bus == NULL)
+       return;
+   g_dbus_connection_call (backlight->priv->system_bus,
+                           "org.freedesktop.UPower",
+                           GPM_KBD_BACKLIGHT_UPOWER_PATH,
+                           "org.freedesktop.DBus.Introspectable",
+                           "Introspect",
+                           NULL,
+                           G_VARIANT_TYPE ("(s)"),
+                           G_DBUS_CALL_FLAGS_NONE,
+                           -1,
+                           backlight->priv->cancellable,
+                           gpm_kbd_backlight_introspect_cb,
+                           backlight);
+}
+
+/**
+ * gpm_kbd_backlight_upower_appeared_cb:
+ **/
+static void
+gpm_kbd_backlight_upower_appeared_cb (GDBusConnection *connection, const gchar *name,
+                                      const gchar *name_owner, gpointer user_data)
+{
+   gpm_kbd_backlight_scan (GPM_KBD_BACKLIGHT (user_data));
+}
+
+/**
+ * gpm_kbd_backlight_upower_vanished_cb:
+ *
+ * The objects go with UPower, and come back as new ones if it restarts.
+ **/
+static void
+gpm_kbd_backlight_upower_vanished_cb (GDBusConnection *connection, const gchar *name,
+                                      gpointer user_data)
+{
+   GpmKbdBacklight *backlight = GPM_KBD_BACKLIGHT (user_data);
+
+   if (backlight->priv->devices->len == 0)
+       return;
+   g_debug ("UPower has gone, forgetting the keyboard backlights");
+   g_ptr_array_set_size (backlight->priv->devices, 0);
+   backlight->priv->can_dim = FALSE;
+}
+
+/**
+ * gpm_kbd_backlight_client_device_added_cb:
+ *
+ * A keyboard may bring a backlight of its own.
+ **/
+static void
+gpm_kbd_backlight_client_device_added_cb (UpClient *client, UpDevice *device,
+                                          GpmKbdBacklight *backlight)
+{
+   UpDeviceKind kind;
+
+   g_object_get (device, "kind", &kind, NULL);
+   if (kind == UP_DEVICE_KIND_KEYBOARD)
+       gpm_kbd_backlight_scan (backlight);
+}
+
+/**
+ * gpm_kbd_backlight_bus_get_cb:
+ **/
+static void
+gpm_kbd_backlight_bus_get_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+   GpmKbdBacklight *backlight = user_data;
+   GDBusConnection *connection;
+   GError *error = NULL;
+
+   connection = g_bus_get_finish (res, &error);
+   if (connection == NULL) {
+       if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+           g_printerr ("Could not connect to UPower system bus: %s", error->message);
+       g_error_free (error);
+       return;
    }
+   backlight->priv->system_bus = connection;
+
+   /* scans as soon as UPower is there, and again if it restarts */
+   backlight->priv->upower_watch_id =
+       g_bus_watch_name_on_connection (connection,
+                                       "org.freedesktop.UPower",
+                                       G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                       gpm_kbd_backlight_upower_appeared_cb,
+                                       gpm_kbd_backlight_upower_vanished_cb,
+                                       backlight, NULL);
 }
 
 /**
@@ -544,9 +1020,14 @@ gpm_kbd_backlight_finalize (GObject *object)
 
    backlight = GPM_KBD_BACKLIGHT (object);
 
-   if (backlight->priv->upower_proxy != NULL) {
-       g_object_unref (backlight->priv->upower_proxy);
-   }
+   /* the callbacks still pending only see G_IO_ERROR_CANCELLED */
+   g_cancellable_cancel (backlight->priv->cancellable);
+   g_object_unref (backlight->priv->cancellable);
+   if (backlight->priv->upower_watch_id != 0)
+       g_bus_unwatch_name (backlight->priv->upower_watch_id);
+   if (backlight->priv->system_bus != NULL)
+       g_object_unref (backlight->priv->system_bus);
+   g_ptr_array_unref (backlight->priv->devices);
    if (backlight->priv->bus_connection != NULL) {
        g_dbus_connection_unregister_object (backlight->priv->bus_connection,
                             backlight->priv->bus_object_id);
@@ -554,12 +1035,18 @@ gpm_kbd_backlight_finalize (GObject *object)
    }
 
    g_timer_destroy (backlight->priv->idle_timer);
+   if (backlight->priv->popup != NULL)
+       gtk_widget_destroy (backlight->priv->popup);
 
    g_object_unref (backlight->priv->control);
    g_object_unref (backlight->priv->settings);
+   g_object_unref (backlight->priv->policy);
+   g_signal_handlers_disconnect_by_data (backlight->priv->client, backlight);
    g_object_unref (backlight->priv->client);
    g_object_unref (backlight->priv->button);
    g_object_unref (backlight->priv->idle);
+   gpm_display_set_kbd_func (backlight->priv->display, NULL, NULL);
+   g_object_unref (backlight->priv->display);
 
    g_return_if_fail (backlight->priv != NULL);
    G_OBJECT_CLASS (gpm_kbd_backlight_parent_class)->finalize (object);
@@ -597,85 +1084,24 @@ gpm_kbd_backlight_class_init (GpmKbdBacklightClass *klass)
 static void
 gpm_kbd_backlight_init (GpmKbdBacklight *backlight)
 {
-   GVariant *u_brightness;
-   GVariant *u_max_brightness;
-   GError   *error = NULL;
-
    backlight->priv = gpm_kbd_backlight_get_instance_private (backlight);
 
-   backlight->priv->upower_proxy = g_dbus_proxy_new_for_bus_sync (G_BUS_TYPE_SYSTEM,
-                                      G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
-                                      NULL,
-                                      "org.freedesktop.UPower",
-                                      "/org/freedesktop/UPower/KbdBacklight",
-                                      "org.freedesktop.UPower.KbdBacklight",
-                                      NULL,
-                                      &error);
-   if (backlight->priv->upower_proxy == NULL) {
-       g_printerr ("Could not connect to UPower system bus: %s", error->message);
-       g_error_free (error);
-       goto err;
-   }
-
-   g_signal_connect (backlight->priv->upower_proxy,
-             "g-signal",
-             G_CALLBACK (gpm_kbd_backlight_on_dbus_signal),
-             backlight);
-
-   u_brightness = g_dbus_proxy_call_sync (backlight->priv->upower_proxy,
-                          "GetBrightness",
-                          NULL,
-                          G_DBUS_CALL_FLAGS_NONE,
-                          -1,
-                          NULL,
-                          &error);
-   if (u_brightness == NULL) {
-       if (error->domain != G_DBUS_ERROR || error->code != G_DBUS_ERROR_UNKNOWN_METHOD)
-           g_warning ("Failed to get brightness: %s", error->message);
-       g_error_free (error);
-       goto err;
-   }
-
-   error = NULL;
-   u_max_brightness = g_dbus_proxy_call_sync (backlight->priv->upower_proxy,
-                          "GetMaxBrightness",
-                          NULL,
-                          G_DBUS_CALL_FLAGS_NONE,
-                          -1,
-                          NULL,
-                          &error);
-   if (u_max_brightness == NULL) {
-       g_warning ("Failed to get max brightness: %s", error->message);
-       g_error_free (error);
-       g_variant_unref (u_brightness);
-       goto err;
-   }
-
-   g_variant_get (u_brightness, "(i)", &backlight->priv->brightness);
-   g_variant_get (u_max_brightness, "(i)", &backlight->priv->max_brightness);
-
-   backlight->priv->brightness_percent = gpm_discrete_to_percent (backlight->priv->brightness,
-                                      backlight->priv->max_brightness);
-
-   g_variant_unref (u_brightness);
-   g_variant_unref (u_max_brightness);
-   goto noerr;
-
-err:
-   backlight->priv->brightness = 0;
+   /* nothing can be dimmed until a device has answered */
    backlight->priv->brightness_percent = 100;
-   backlight->priv->max_brightness = 0;
-
-noerr:
+   backlight->priv->can_dim = FALSE;
+   backlight->priv->devices = g_ptr_array_new_with_free_func ((GDestroyNotify) gpm_kbd_backlight_device_free);
+   backlight->priv->cancellable = g_cancellable_new ();
    backlight->priv->idle_timer = g_timer_new ();
-   backlight->priv->can_dim = backlight->priv->max_brightness > 1;
 
    /* Use upower for ac changed signal */
    backlight->priv->client = up_client_new ();
    g_signal_connect (backlight->priv->client, "notify",
              G_CALLBACK (gpm_kbd_backlight_client_changed_cb), backlight);
+   g_signal_connect (backlight->priv->client, "device-added",
+             G_CALLBACK (gpm_kbd_backlight_client_device_added_cb), backlight);
 
    backlight->priv->settings = g_settings_new (GPM_SETTINGS_SCHEMA);
+   backlight->priv->policy = gpm_policy_new ();
 
    /* watch for kbd brightness up and down button presses */
    backlight->priv->button = gpm_button_new ();
@@ -686,15 +1112,13 @@ noerr:
    g_signal_connect (backlight->priv->idle, "idle-changed",
              G_CALLBACK (gpm_kbd_backlight_idle_changed_cb), backlight);
 
-    /* use a visual widget */
-   backlight->priv->popup = msd_media_keys_window_new ();
-   msd_media_keys_window_set_action_custom (MSD_MEDIA_KEYS_WINDOW (backlight->priv->popup),
-                                            "gpm-brightness-kbd", TRUE);
-   gtk_window_set_position (GTK_WINDOW (backlight->priv->popup), GTK_WIN_POS_NONE);
+   /* idle transitions are applied along with the screen */
+   backlight->priv->display = gpm_display_new ();
+   gpm_display_set_kbd_func (backlight->priv->display, gpm_kbd_backlight_display_kbd_cb, backlight);
 
    /* since gpm is just starting we can pretty safely assume that we're not idle */
    backlight->priv->system_is_idle = FALSE;
-   backlight->priv->idle_dim_timeout = g_settings_get_int (backlight->priv->settings, GPM_SETTINGS_IDLE_DIM_TIME);
+   backlight->priv->idle_dim_timeout = gpm_policy_get (backlight->priv->policy)->idle_dim_time;
    gpm_idle_set_timeout_dim (backlight->priv->idle, backlight->priv->idle_dim_timeout);
 
    /* make sure we turn the keyboard backlight back on after resuming */
@@ -702,8 +1126,9 @@ noerr:
    g_signal_connect (backlight->priv->control, "resume",
              G_CALLBACK (gpm_kbd_backlight_control_resume_cb), backlight);
 
-   /* set initial values for whether we're on AC or battery*/
-   gpm_kbd_backlight_evaluate_power_source_and_set (backlight);
+   /* the initial values are set as each device answers */
+   g_bus_get (G_BUS_TYPE_SYSTEM, backlight->priv->cancellable,
+              gpm_kbd_backlight_bus_get_cb, backlight);
 }
 
 /**
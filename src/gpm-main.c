@@ -39,8 +39,12 @@
 
 #include "gpm-icon-names.h"
 #include "gpm-common.h"
+#include "gpm-button.h"
+#include "gpm-idle.h"
 #include "gpm-manager.h"
 #include "gpm-session.h"
+#include "gpm-watchdog.h"
+#include "gpm-startup.h"
 
 #include "org.mate.PowerManager.h"
 
@@ -146,6 +150,15 @@ gpm_main_end_session_cb (GpmSession *session, guint flags, GMainLoop *loop)
 	g_main_loop_quit (loop);
 }
 
+/**
+ * gpm_main_startup_finished_cb:
+ **/
+static void
+gpm_main_startup_finished_cb (GpmStartup *startup, GMainLoop *loop)
+{
+	g_main_loop_quit (loop);
+}
+
 /**
  * main:
  **/
@@ -158,8 +171,12 @@ main (int argc, char *argv[])
 	gboolean version = FALSE;
 	gboolean timed_exit = FALSE;
 	gboolean immediate_exit = FALSE;
+	gboolean watch = FALSE;
 	GpmSession *session = NULL;
 	GpmManager *manager = NULL;
+	GpmWatchdog *watchdog = NULL;
+	GpmStartup *startup = NULL;
+	gchar *timeline;
 	GError *error = NULL;
 	GOptionContext *context;
 	gint ret;
@@ -171,7 +188,9 @@ main (int argc, char *argv[])
 		{ "timed-exit", '\0', 0, G_OPTION_ARG_NONE, &timed_exit,
 		  N_("Exit after a small delay (for debugging)"), NULL },
 		{ "immediate-exit", '\0', 0, G_OPTION_ARG_NONE, &immediate_exit,
-		  N_("Exit after the manager has loaded (for debugging)"), NULL },
+		  N_("Exit after the manager has started, and print how long each part took (for debugging)"), NULL },
+		{ "watchdog", '\0', 0, G_OPTION_ARG_NONE, &watch,
+		  N_("Log when the main loop stops responding (for debugging)"), NULL },
 		{ NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL }
 	};
 
@@ -227,6 +246,18 @@ main (int argc, char *argv[])
 
 	loop = g_main_loop_new (NULL, FALSE);
 
+	/* watch for stalls from as early as we can */
+	watchdog = gpm_watchdog_new ();
+	if (watch) {
+		/* these come from X events, which are not named otherwise */
+		gpm_watchdog_watch_type (watchdog, GPM_TYPE_BUTTON);
+		gpm_watchdog_watch_type (watchdog, GPM_TYPE_IDLE);
+		gpm_watchdog_start (watchdog, GPM_WATCHDOG_INTERVAL, GPM_WATCHDOG_THRESHOLD);
+	}
+
+	/* time everything the manager starts */
+	startup = gpm_startup_new ();
+
 	/* optionally register with the session */
 	session = gpm_session_new ();
 	g_signal_connect (session, "stop", G_CALLBACK (gpm_main_stop_cb), loop);
@@ -266,12 +297,24 @@ main (int argc, char *argv[])
 
 	if (immediate_exit == FALSE) {
 		g_main_loop_run (loop);
+	} else {
+		/* run just long enough for the deferred and async parts */
+		if (!gpm_startup_is_finished (startup)) {
+			g_signal_connect (startup, "finished",
+					  G_CALLBACK (gpm_main_startup_finished_cb), loop);
+			g_main_loop_run (loop);
+		}
+		timeline = gpm_startup_get_timeline (startup);
+		g_print ("%s", timeline);
+		g_free (timeline);
 	}
 
 	g_main_loop_unref (loop);
 
 	g_object_unref (session);
 	g_object_unref (manager);
+	g_object_unref (watchdog);
+	g_object_unref (startup);
 unref_program:
 	g_option_context_free (context);
 	return 0;
@@ -40,7 +40,6 @@
 #include <gtk/gtk.h>
 #include <dbus/dbus-glib.h>
 #include <dbus/dbus-glib-lowlevel.h>
-#include <canberra-gtk.h>
 #include <libupower-glib/upower.h>
 #include <libnotify/notify.h>
 
@@ -49,6 +48,7 @@
 #include "gpm-button.h"
 #include "gpm-control.h"
 #include "gpm-common.h"
+#include "gpm-display.h"
 #include "gpm-dpms.h"
 #include "gpm-idle.h"
 #include "gpm-manager.h"
@@ -56,7 +56,13 @@
 #include "gpm-backlight.h"
 #include "gpm-kbd-backlight.h"
 #include "gpm-session.h"
+#include "gpm-watchdog.h"
+#include "gpm-startup.h"
+#include "gpm-proxy-pool.h"
+#include "gpm-alert.h"
 #include "gpm-icon-names.h"
+#include "gpm-policy.h"
+#include "gpm-timer.h"
 #include "gpm-tray-icon.h"
 #include "gpm-engine.h"
 #include "gpm-upower.h"
@@ -76,8 +82,10 @@ struct GpmManagerPrivate
 {
 	GpmButton		*button;
 	GSettings		*settings;
-	GpmDpms			*dpms;
+	GpmPolicy		*policy;
+	GpmDisplay		*display;
 	GpmIdle			*idle;
+	GpmSession		*session;
 	GpmControl		*control;
 	GpmScreensaver		*screensaver;
 	GpmTrayIcon		*tray_icon;
@@ -86,20 +94,16 @@ struct GpmManagerPrivate
 	GpmKbdBacklight		*kbd_backlight;
 	EggConsoleKit		*console;
 	guint32			 screensaver_ac_throttle_id;
-	guint32			 screensaver_dpms_throttle_id;
 	guint32			 screensaver_lid_throttle_id;
-	guint32                  critical_alert_timeout_id;
-	ca_proplist             *critical_alert_loop_props;
 	UpClient		*client;
 	gboolean		 on_battery;
 	gboolean		 just_resumed;
 	GtkStatusIcon		*status_icon;
-	NotifyNotification	*notification_general;
-	NotifyNotification	*notification_warning_low;
-	NotifyNotification	*notification_discharging;
-	NotifyNotification	*notification_fully_charged;
+	GpmAlert		*alert;
+	GpmTimer		*timer;
 	gint32                   systemd_inhibit;
-	GDBusProxy              *systemd_inhibit_proxy;
+	GpmProxyPool		*proxy_pool;
+	GpmStartup		*startup;
 };
 
 typedef enum {
@@ -116,6 +120,13 @@ typedef enum {
 	GPM_MANAGER_SOUND_LAST
 } GpmManagerSound;
 
+enum {
+	SUMMARY_CHANGED,
+	LAST_SIGNAL
+};
+
+static guint signals [LAST_SIGNAL] = { 0 };
+
 G_DEFINE_TYPE_WITH_PRIVATE (GpmManager, gpm_manager, G_TYPE_OBJECT)
 
 /**
@@ -152,41 +163,6 @@ gpm_manager_error_get_type (void)
 	return etype;
 }
 
-/**
- * gpm_manager_play_loop_timeout_cb:
- **/
-static gboolean
-gpm_manager_play_loop_timeout_cb (GpmManager *manager)
-{
-	ca_context *context;
-	context = ca_gtk_context_get_for_screen (gdk_screen_get_default ());
-	ca_context_play_full (context, 0,
-			      manager->priv->critical_alert_loop_props,
-			      NULL,
-			      NULL);
-	return TRUE;
-}
-
-/**
- * gpm_manager_play_loop_stop:
- **/
-static gboolean
-gpm_manager_play_loop_stop (GpmManager *manager)
-{
-	if (manager->priv->critical_alert_timeout_id == 0) {
-		g_warning ("no sound loop present to stop");
-		return FALSE;
-	}
-
-	g_source_remove (manager->priv->critical_alert_timeout_id);
-	ca_proplist_destroy (manager->priv->critical_alert_loop_props);
-
-	manager->priv->critical_alert_loop_props = NULL;
-	manager->priv->critical_alert_timeout_id = 0;
-
-	return TRUE;
-}
-
 /**
  * gpm_manager_play_loop_start:
  **/
@@ -196,10 +172,8 @@ gpm_manager_play_loop_start (GpmManager *manager, GpmManagerSound action, gboole
 	const gchar *id = NULL;
 	const gchar *desc = NULL;
 	gboolean ret;
-	gint retval;
-	ca_context *context;
 
-	ret = g_settings_get_boolean (manager->priv->settings, GPM_SETTINGS_ENABLE_SOUND);
+	ret = gpm_policy_get (manager->priv->policy)->enable_sound;
 	if (!ret && !force) {
 		g_debug ("ignoring sound due to policy");
 		return FALSE;
@@ -210,12 +184,6 @@ gpm_manager_play_loop_start (GpmManager *manager, GpmManagerSound action, gboole
 		return FALSE;
 	}
 
-	/* if a sound loop is already running, stop the existing loop */
-	if (manager->priv->critical_alert_timeout_id != 0) {
-		g_warning ("was instructed to play a sound loop with one already playing");
-		gpm_manager_play_loop_stop (manager);
-	}
-
 	if (action == GPM_MANAGER_SOUND_BATTERY_LOW) {
 		id = "battery-low";
 		/* TRANSLATORS: this is the sound description */
@@ -228,25 +196,8 @@ gpm_manager_play_loop_start (GpmManager *manager, GpmManagerSound action, gboole
 		return FALSE;
 	}
 
-	ca_proplist_create (&(manager->priv->critical_alert_loop_props));
-	ca_proplist_sets (manager->priv->critical_alert_loop_props,
-			  CA_PROP_EVENT_ID, id);
-	ca_proplist_sets (manager->priv->critical_alert_loop_props,
-			  CA_PROP_EVENT_DESCRIPTION, desc);
-
-	manager->priv->critical_alert_timeout_id = g_timeout_add_seconds (timeout,
-									  (GSourceFunc) gpm_manager_play_loop_timeout_cb,
-									  manager);
-
-	g_source_set_name_by_id (manager->priv->critical_alert_timeout_id, "[GpmManager] play-loop");
-
-	/* play the sound, using sounds from the naming spec */
-	context = ca_gtk_context_get_for_screen (gdk_screen_get_default ());
-	retval = ca_context_play (context, 0,
-				  CA_PROP_EVENT_ID, id,
-				  CA_PROP_EVENT_DESCRIPTION, desc, NULL);
-	if (retval < 0)
-		g_warning ("failed to play %s: %s", id, ca_strerror (retval));
+	/* queued, played from the alert thread */
+	gpm_alert_play_loop_start (manager->priv->alert, id, desc, timeout);
 	return TRUE;
 }
 
@@ -259,10 +210,8 @@ gpm_manager_play (GpmManager *manager, GpmManagerSound action, gboolean force)
 	const gchar *id = NULL;
 	const gchar *desc = NULL;
 	gboolean ret;
-	gint retval;
-	ca_context *context;
 
-	ret = g_settings_get_boolean (manager->priv->settings, GPM_SETTINGS_ENABLE_SOUND);
+	ret = gpm_policy_get (manager->priv->policy)->enable_sound;
 	if (!ret && !force) {
 		g_debug ("ignoring sound due to policy");
 		return FALSE;
@@ -316,13 +265,8 @@ gpm_manager_play (GpmManager *manager, GpmManagerSound action, gboolean force)
 		return FALSE;
 	}
 
-	/* play the sound, using sounds from the naming spec */
-	context = ca_gtk_context_get_for_screen (gdk_screen_get_default ());
-	retval = ca_context_play (context, 0,
-				  CA_PROP_EVENT_ID, id,
-				  CA_PROP_EVENT_DESCRIPTION, desc, NULL);
-	if (retval < 0)
-		g_warning ("failed to play %s: %s", id, ca_strerror (retval));
+	/* queued, played from the alert thread */
+	gpm_alert_play (manager->priv->alert, id, desc);
 	return TRUE;
 }
 
@@ -353,20 +297,49 @@ gpm_manager_is_inhibit_valid (GpmManager *manager, gboolean user_action, const c
 static void
 gpm_manager_sync_policy_sleep (GpmManager *manager)
 {
-	guint sleep_display;
-	guint sleep_computer;
+	const GpmPolicySnapshot *policy = gpm_policy_get (manager->priv->policy);
+
+	/* set the new sleep (inactivity) values, for both power sources */
+	gpm_idle_set_stage_timeout (manager->priv->idle, GPM_IDLE_MODE_BLANK,
+				    policy->sleep_display_ac, policy->sleep_display_battery);
+	gpm_idle_set_stage_timeout (manager->priv->idle, GPM_IDLE_MODE_SLEEP,
+				    policy->sleep_computer_ac, policy->sleep_computer_battery);
+	gpm_idle_set_on_battery (manager->priv->idle, manager->priv->on_battery);
+}
 
-	if (!manager->priv->on_battery) {
-		sleep_computer = g_settings_get_int (manager->priv->settings, GPM_SETTINGS_SLEEP_COMPUTER_AC);
-		sleep_display = g_settings_get_int (manager->priv->settings, GPM_SETTINGS_SLEEP_DISPLAY_AC);
-	} else {
-		sleep_computer = g_settings_get_int (manager->priv->settings, GPM_SETTINGS_SLEEP_COMPUTER_BATT);
-		sleep_display = g_settings_get_int (manager->priv->settings, GPM_SETTINGS_SLEEP_DISPLAY_BATT);
+/**
+ * gpm_manager_blank_screen_dpms:
+ **/
+static gboolean
+gpm_manager_blank_screen_dpms (GpmManager *manager)
+{
+	GError *error = NULL;
+
+	gpm_display_set_dpms_mode (manager->priv->display, GPM_DPMS_MODE_OFF);
+	gpm_display_commit_now (manager->priv->display, &error);
+	if (error) {
+		g_debug ("Unable to set DPMS mode: %s", error->message);
+		g_error_free (error);
+		return FALSE;
 	}
+	return TRUE;
+}
+
+/**
+ * gpm_manager_blank_screen_lock_cb:
+ **/
+static void
+gpm_manager_blank_screen_lock_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GpmManager *manager = GPM_MANAGER (user_data);
+	GError *error = NULL;
 
-	/* set the new sleep (inactivity) value */
-	gpm_idle_set_timeout_blank (manager->priv->idle, sleep_display);
-	gpm_idle_set_timeout_sleep (manager->priv->idle, sleep_computer);
+	if (!gpm_screensaver_lock_finish (GPM_SCREENSAVER (source), res, &error)) {
+		g_debug ("Could not lock screen via mate-screensaver: %s", error->message);
+		g_error_free (error);
+	}
+	gpm_manager_blank_screen_dpms (manager);
+	g_object_unref (manager);
 }
 
 /**
@@ -384,22 +357,17 @@ static gboolean
 gpm_manager_blank_screen (GpmManager *manager, GError **noerror)
 {
 	gboolean do_lock;
-	gboolean ret = TRUE;
-	GError *error = NULL;
 
 	do_lock = gpm_control_get_lock_policy (manager->priv->control,
 					       GPM_SETTINGS_LOCK_ON_BLANK_SCREEN);
 	if (do_lock) {
-		if (!gpm_screensaver_lock (manager->priv->screensaver))
-			g_debug ("Could not lock screen via mate-screensaver");
-	}
-	gpm_dpms_set_mode (manager->priv->dpms, GPM_DPMS_MODE_OFF, &error);
-	if (error) {
-		g_debug ("Unable to set DPMS mode: %s", error->message);
-		g_error_free (error);
-		ret = FALSE;
+		/* turn the screen off once the fade has finished */
+		gpm_screensaver_lock_async (manager->priv->screensaver, NULL,
+					    gpm_manager_blank_screen_lock_cb,
+					    g_object_ref (manager));
+		return TRUE;
 	}
-	return ret;
+	return gpm_manager_blank_screen_dpms (manager);
 }
 
 /**
@@ -417,7 +385,8 @@ gpm_manager_unblank_screen (GpmManager *manager, GError **noerror)
 	gboolean ret = TRUE;
 	GError *error = NULL;
 
-	gpm_dpms_set_mode (manager->priv->dpms, GPM_DPMS_MODE_ON, &error);
+	gpm_display_set_dpms_mode (manager->priv->display, GPM_DPMS_MODE_ON);
+	gpm_display_commit_now (manager->priv->display, &error);
 	if (error) {
 		g_debug ("Unable to set DPMS mode: %s", error->message);
 		g_error_free (error);
@@ -430,96 +399,6 @@ gpm_manager_unblank_screen (GpmManager *manager, GError **noerror)
 	return ret;
 }
 
-/**
- * gpm_manager_notify_close:
- **/
-static gboolean
-gpm_manager_notify_close (GpmManager *manager, NotifyNotification *notification)
-{
-	gboolean ret = FALSE;
-	GError *error = NULL;
-
-	/* exists? */
-	if (notification == NULL)
-		goto out;
-
-	/* try to close */
-	ret = notify_notification_close (notification, &error);
-	if (!ret) {
-		g_warning ("failed to close notification: %s", error->message);
-		g_error_free (error);
-		goto out;
-	}
-out:
-	return ret;
-}
-
-/**
- * gpm_manager_notification_closed_cb:
- **/
-static void
-gpm_manager_notification_closed_cb (NotifyNotification *notification, NotifyNotification **notification_class)
-{
-	g_debug ("caught notification closed signal %p", notification);
-	/* the object is already unreffed in _close_signal_handler */
-	*notification_class = NULL;
-}
-
-/**
- * gpm_manager_notify:
- **/
-static gboolean
-gpm_manager_notify (GpmManager *manager, NotifyNotification **notification_class,
-		    const gchar *title, const gchar *message,
-		    guint timeout, const gchar *icon, NotifyUrgency urgency)
-{
-	gboolean ret;
-	GError *error = NULL;
-	NotifyNotification *notification;
-	GtkWidget *dialog;
-
-	/* close any existing notification of this class */
-	gpm_manager_notify_close (manager, *notification_class);
-
-	/* if the status icon is hidden, don't point at it */
-	if (manager->priv->status_icon != NULL &&
-	    gtk_status_icon_is_embedded (manager->priv->status_icon))
-		notification = notify_notification_new (title, message, gtk_status_icon_get_icon_name(manager->priv->status_icon));
-	else
-		notification = notify_notification_new (title, message, icon);
-	notify_notification_set_timeout (notification, timeout);
-	notify_notification_set_urgency (notification, urgency);
-	g_signal_connect (notification, "closed", G_CALLBACK (gpm_manager_notification_closed_cb), notification_class);
-
-	g_debug ("notification %p: %s : %s", notification, title, message);
-
-	/* try to show */
-	ret = notify_notification_show (notification, &error);
-	if (!ret) {
-		g_warning ("failed to show notification: %s", error->message);
-		g_error_free (error);
-
-		/* show modal dialog as libmatenotify failed */
-		dialog = gtk_message_dialog_new_with_markup (NULL, GTK_DIALOG_DESTROY_WITH_PARENT,
-							     GTK_MESSAGE_INFO, GTK_BUTTONS_CLOSE,
-							     "<span size='larger'><b>%s</b></span>", title);
-		gtk_message_dialog_format_secondary_markup (GTK_MESSAGE_DIALOG (dialog), "%s", message);
-
-		/* wait async for close */
-		gtk_widget_show (dialog);
-		g_signal_connect_swapped (dialog, "response", G_CALLBACK (gtk_widget_destroy), dialog);
-
-		g_object_unref (notification);
-		goto out;
-	}
-
-	/* save this local instance as the class instance */
-	g_object_add_weak_pointer (G_OBJECT (notification), (gpointer) &notification);
-	*notification_class = notification;
-out:
-	return ret;
-}
-
 /**
  * gpm_manager_sleep_failure_response_cb:
  **/
@@ -561,7 +440,7 @@ gpm_manager_sleep_failure (GpmManager *manager, gboolean is_suspend, const gchar
 	GtkWidget *dialog;
 
 	/* only show this if specified in settings */
-	show_sleep_failed = g_settings_get_boolean (manager->priv->settings, GPM_SETTINGS_NOTIFY_SLEEP_FAILED);
+	show_sleep_failed = gpm_policy_get (manager->priv->policy)->notify_sleep_failed;
 
 	g_debug ("sleep failed");
 	gpm_manager_play (manager, GPM_MANAGER_SOUND_SUSPEND_ERROR, TRUE);
@@ -611,26 +490,39 @@ out:
 	g_string_free (string, TRUE);
 }
 
+/**
+ * gpm_manager_action_sleep_cb:
+ **/
+static void
+gpm_manager_action_sleep_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GpmManager *manager = GPM_MANAGER (user_data);
+	GError *error = NULL;
+
+	if (!g_task_propagate_boolean (G_TASK (res), &error)) {
+		if (g_error_matches (error, GPM_CONTROL_ERROR, GPM_CONTROL_ERROR_BUSY))
+			g_debug ("%s", error->message);
+		else
+			gpm_manager_sleep_failure (manager, TRUE, error->message);
+		g_error_free (error);
+	}
+	gpm_button_reset_time (manager->priv->button);
+	g_object_unref (manager);
+}
+
 /**
  * gpm_manager_action_suspend:
  **/
 static gboolean
 gpm_manager_action_suspend (GpmManager *manager, const gchar *reason)
 {
-	gboolean ret;
-	GError *error = NULL;
-
 	/* check to see if we are inhibited */
 	if (gpm_manager_is_inhibit_valid (manager, FALSE, "suspend") == FALSE)
 		return FALSE;
 
 	g_debug ("suspending, reason: %s", reason);
-	ret = gpm_control_suspend (manager->priv->control, &error);
-	if (!ret) {
-		gpm_manager_sleep_failure (manager, TRUE, error->message);
-		g_error_free (error);
-	}
-	gpm_button_reset_time (manager->priv->button);
+	gpm_control_suspend_async (manager->priv->control,
+				   gpm_manager_action_sleep_cb, g_object_ref (manager));
 	return TRUE;
 }
 
@@ -640,42 +532,32 @@ gpm_manager_action_suspend (GpmManager *manager, const gchar *reason)
 static gboolean
 gpm_manager_action_hibernate (GpmManager *manager, const gchar *reason)
 {
-	gboolean ret;
-	GError *error = NULL;
-
 	/* check to see if we are inhibited */
 	if (gpm_manager_is_inhibit_valid (manager, FALSE, "hibernate") == FALSE)
 		return FALSE;
 
 	g_debug ("hibernating, reason: %s", reason);
-	ret = gpm_control_hibernate (manager->priv->control, &error);
-	if (!ret) {
-		gpm_manager_sleep_failure (manager, TRUE, error->message);
-		g_error_free (error);
-	}
-	gpm_button_reset_time (manager->priv->button);
+	gpm_control_hibernate_async (manager->priv->control,
+				     gpm_manager_action_sleep_cb, g_object_ref (manager));
 	return TRUE;
 }
 
 /**
  * gpm_manager_perform_policy:
  * @manager: This class instance
- * @policy: The policy that we should do, e.g. "suspend"
+ * @policy: The policy that we should do, e.g. GPM_ACTION_POLICY_SUSPEND
  * @reason: The reason we are performing the policy action, e.g. "battery critical"
  *
  * Does one of the policy actions specified in the settings.
  **/
 static gboolean
-gpm_manager_perform_policy (GpmManager  *manager, const gchar *policy_key, const gchar *reason)
+gpm_manager_perform_policy (GpmManager  *manager, GpmActionPolicy policy, const gchar *reason)
 {
-	GpmActionPolicy policy;
-
 	/* are we inhibited? */
 	if (gpm_manager_is_inhibit_valid (manager, FALSE, "policy action") == FALSE)
 		return FALSE;
 
-	policy = g_settings_get_enum (manager->priv->settings, policy_key);
-	g_debug ("action: %s set to %u (%s)", policy_key, policy, reason);
+	g_debug ("action: %u (%s)", policy, reason);
 
 	if (policy == GPM_ACTION_POLICY_NOTHING) {
 		g_debug ("doing nothing, reason: %s", reason);
@@ -693,11 +575,8 @@ gpm_manager_perform_policy (GpmManager  *manager, const gchar *policy_key, const
 		gpm_control_shutdown (manager->priv->control, NULL);
 
 	} else if (policy == GPM_ACTION_POLICY_INTERACTIVE) {
-		GpmSession *session;
 		g_debug ("logout, reason: %s", reason);
-		session = gpm_session_new ();
-		gpm_session_logout (session);
-		g_object_unref (session);
+		gpm_session_logout (manager->priv->session);
 	} else {
 		g_warning ("unknown action %u", policy);
 	}
@@ -705,6 +584,56 @@ gpm_manager_perform_policy (GpmManager  *manager, const gchar *policy_key, const
 	return TRUE;
 }
 
+/**
+ * gpm_manager_idle_sleep_fallback_cb:
+ **/
+static void
+gpm_manager_idle_sleep_fallback_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GError *error = NULL;
+
+	if (!g_task_propagate_boolean (G_TASK (res), &error)) {
+		g_warning ("cannot suspend or hibernate: %s", error->message);
+		g_error_free (error);
+	}
+}
+
+/**
+ * gpm_manager_idle_suspend_cb:
+ **/
+static void
+gpm_manager_idle_suspend_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GError *error = NULL;
+
+	if (!gpm_control_suspend_finish (GPM_CONTROL (source), res, &error)) {
+		if (!g_error_matches (error, GPM_CONTROL_ERROR, GPM_CONTROL_ERROR_BUSY)) {
+			g_warning ("cannot suspend (error: %s), so trying hibernate", error->message);
+			gpm_control_hibernate_async (GPM_CONTROL (source),
+						     gpm_manager_idle_sleep_fallback_cb, NULL);
+		}
+		g_error_free (error);
+	}
+}
+
+/**
+ * gpm_manager_idle_hibernate_cb:
+ **/
+static void
+gpm_manager_idle_hibernate_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GError *error = NULL;
+
+	if (!gpm_control_hibernate_finish (GPM_CONTROL (source), res, &error)) {
+		if (!g_error_matches (error, GPM_CONTROL_ERROR, GPM_CONTROL_ERROR_BUSY)) {
+			g_warning ("cannot hibernate (error: %s), so trying suspend", error->message);
+			gpm_control_suspend_async (GPM_CONTROL (source),
+						   gpm_manager_idle_sleep_fallback_cb, NULL);
+		}
+		g_error_free (error);
+	}
+}
+
 /**
  * gpm_manager_idle_do_sleep:
  * @manager: This class instance
@@ -715,45 +644,25 @@ gpm_manager_perform_policy (GpmManager  *manager, const gchar *policy_key, const
 static void
 gpm_manager_idle_do_sleep (GpmManager *manager)
 {
-	gboolean ret;
-	GError *error = NULL;
 	GpmActionPolicy policy;
 
 	if (!manager->priv->on_battery)
-		policy = g_settings_get_enum (manager->priv->settings, GPM_SETTINGS_ACTION_SLEEP_TYPE_AC);
+		policy = gpm_policy_get (manager->priv->policy)->action_sleep_type_ac;
 	else
-		policy = g_settings_get_enum (manager->priv->settings, GPM_SETTINGS_ACTION_SLEEP_TYPE_BATT);
+		policy = gpm_policy_get (manager->priv->policy)->action_sleep_type_battery;
 
 	if (policy == GPM_ACTION_POLICY_NOTHING) {
 		g_debug ("doing nothing as system idle action");
 
 	} else if (policy == GPM_ACTION_POLICY_SUSPEND) {
 		g_debug ("suspending, reason: System idle");
-		ret = gpm_control_suspend (manager->priv->control, &error);
-		if (!ret) {
-			g_warning ("cannot suspend (error: %s), so trying hibernate", error->message);
-			g_error_free (error);
-			error = NULL;
-			ret = gpm_control_hibernate (manager->priv->control, &error);
-			if (!ret) {
-				g_warning ("cannot suspend or hibernate: %s", error->message);
-				g_error_free (error);
-			}
-		}
+		gpm_control_suspend_async (manager->priv->control,
+					   gpm_manager_idle_suspend_cb, NULL);
 
 	} else if (policy == GPM_ACTION_POLICY_HIBERNATE) {
 		g_debug ("hibernating, reason: System idle");
-		ret = gpm_control_hibernate (manager->priv->control, &error);
-		if (!ret) {
-			g_warning ("cannot hibernate (error: %s), so trying suspend", error->message);
-			g_error_free (error);
-			error = NULL;
-			ret = gpm_control_suspend (manager->priv->control, &error);
-			if (!ret) {
-				g_warning ("cannot suspend or hibernate: %s", error->message);
-				g_error_free (error);
-			}
-		}
+		gpm_control_hibernate_async (manager->priv->control,
+					     gpm_manager_idle_hibernate_cb, NULL);
 	}
 }
 
@@ -791,6 +700,12 @@ gpm_manager_idle_changed_cb (GpmIdle *idle, GpmIdleMode mode, GpmManager *manage
 		if (gpm_manager_is_inhibit_valid (manager, FALSE, "timeout action") == FALSE)
 			return;
 		gpm_manager_idle_do_sleep (manager);
+	} else if (mode == GPM_IDLE_MODE_HIBERNATE) {
+		g_debug ("Idle state changed: HIBERNATE");
+		if (gpm_manager_is_inhibit_valid (manager, FALSE, "timeout action") == FALSE)
+			return;
+		gpm_control_hibernate_async (manager->priv->control,
+					     gpm_manager_idle_hibernate_cb, NULL);
 	}
 }
 
@@ -818,38 +733,16 @@ gpm_manager_lid_button_pressed (GpmManager *manager, gboolean pressed)
 
 	if (!manager->priv->on_battery) {
 		g_debug ("Performing AC policy");
-		gpm_manager_perform_policy (manager, GPM_SETTINGS_BUTTON_LID_AC,
+		gpm_manager_perform_policy (manager, gpm_policy_get (manager->priv->policy)->button_lid_ac,
 					    "The lid has been closed on ac power.");
 		return;
 	}
 
 	g_debug ("Performing battery policy");
-	gpm_manager_perform_policy (manager, GPM_SETTINGS_BUTTON_LID_BATT,
+	gpm_manager_perform_policy (manager, gpm_policy_get (manager->priv->policy)->button_lid_battery,
 				    "The lid has been closed on battery power.");
 }
 
-static void
-gpm_manager_update_dpms_throttle (GpmManager *manager)
-{
-	GpmDpmsMode mode;
-	gpm_dpms_get_mode (manager->priv->dpms, &mode, NULL);
-
-	/* Throttle the manager when DPMS is active since we can't see it anyway */
-	if (mode == GPM_DPMS_MODE_ON) {
-		if (manager->priv->screensaver_dpms_throttle_id != 0) {
-			gpm_screensaver_remove_throttle (manager->priv->screensaver, manager->priv->screensaver_dpms_throttle_id);
-			manager->priv->screensaver_dpms_throttle_id = 0;
-		}
-	} else {
-		/* if throttle already exists then remove */
-		if (manager->priv->screensaver_dpms_throttle_id != 0) {
-			gpm_screensaver_remove_throttle (manager->priv->screensaver, manager->priv->screensaver_dpms_throttle_id);
-		}
-		/* TRANSLATORS: this is the mate-screensaver throttle */
-		manager->priv->screensaver_dpms_throttle_id = gpm_screensaver_add_throttle (manager->priv->screensaver, _("Display DPMS activated"));
-	}
-}
-
 static void
 gpm_manager_update_ac_throttle (GpmManager *manager)
 {
@@ -897,6 +790,7 @@ gpm_manager_update_lid_throttle (GpmManager *manager, gboolean lid_is_closed)
 static void
 gpm_manager_button_pressed_cb (GpmButton *button, const gchar *type, GpmManager *manager)
 {
+	const GpmPolicySnapshot *policy = gpm_policy_get (manager->priv->policy);
 	gchar *message;
 	g_debug ("Button press event type=%s", type);
 
@@ -907,38 +801,54 @@ gpm_manager_button_pressed_cb (GpmButton *button, const gchar *type, GpmManager
 	}
 
 	if (g_strcmp0 (type, GPM_BUTTON_POWER) == 0) {
-		gpm_manager_perform_policy (manager, GPM_SETTINGS_BUTTON_POWER, "The power button has been pressed.");
+		gpm_manager_perform_policy (manager, policy->button_power, "The power button has been pressed.");
 	} else if (g_strcmp0 (type, GPM_BUTTON_SLEEP) == 0) {
-		gpm_manager_perform_policy (manager, GPM_SETTINGS_BUTTON_SUSPEND, "The suspend button has been pressed.");
+		gpm_manager_perform_policy (manager, policy->button_suspend, "The suspend button has been pressed.");
 	} else if (g_strcmp0 (type, GPM_BUTTON_SUSPEND) == 0) {
-		gpm_manager_perform_policy (manager, GPM_SETTINGS_BUTTON_SUSPEND, "The suspend button has been pressed.");
+		gpm_manager_perform_policy (manager, policy->button_suspend, "The suspend button has been pressed.");
 	} else if (g_strcmp0 (type, GPM_BUTTON_HIBERNATE) == 0) {
-		gpm_manager_perform_policy (manager, GPM_SETTINGS_BUTTON_HIBERNATE, "The hibernate button has been pressed.");
-	} else if (g_strcmp0 (type, GPM_BUTTON_LID_OPEN) == 0) {
-		gpm_manager_lid_button_pressed (manager, FALSE);
-	} else if (g_strcmp0 (type, GPM_BUTTON_LID_CLOSED) == 0) {
-		gpm_manager_lid_button_pressed (manager, TRUE);
+		gpm_manager_perform_policy (manager, policy->button_hibernate, "The hibernate button has been pressed.");
 	} else if (g_strcmp0 (type, GPM_BUTTON_BATTERY) == 0) {
+		/* still starting up */
+		if (manager->priv->engine == NULL)
+			return;
 		message = gpm_engine_get_summary (manager->priv->engine);
-		gpm_manager_notify (manager, &manager->priv->notification_general,
-				    _("Power Information"),
-				    message,
-				    GPM_MANAGER_NOTIFY_TIMEOUT_LONG,
-				    "dialog-information",
-				    NOTIFY_URGENCY_NORMAL);
+		gpm_alert_notify (manager->priv->alert, GPM_ALERT_NOTIFY_GENERAL,
+				  _("Power Information"),
+				  message,
+				  GPM_MANAGER_NOTIFY_TIMEOUT_LONG,
+				  "dialog-information",
+				  NOTIFY_URGENCY_NORMAL);
 		g_free (message);
 	}
 
 	/* really belongs in mate-screensaver */
 	if (g_strcmp0 (type, GPM_BUTTON_LOCK) == 0)
 		gpm_screensaver_lock (manager->priv->screensaver);
+}
+
+/**
+ * gpm_manager_lid_changed_cb:
+ * @button: The button class instance
+ * @is_closed: TRUE if the lid has been closed
+ * @manager: This class instance
+ **/
+static void
+gpm_manager_lid_changed_cb (GpmButton *button, gboolean is_closed, GpmManager *manager)
+{
+	g_debug ("Lid event closed=%i", is_closed);
+
+	/* ConsoleKit/systemd say we are not on active console */
+	if (!LOGIND_RUNNING() && !egg_console_kit_is_active (manager->priv->console)) {
+		g_debug ("ignoring as not on active console");
+		return;
+	}
+
+	gpm_manager_lid_button_pressed (manager, is_closed);
 
 	/* disable or enable the fancy screensaver, as we don't want
 	 * this starting when the lid is shut */
-	if (g_strcmp0 (type, GPM_BUTTON_LID_CLOSED) == 0)
-		gpm_manager_update_lid_throttle (manager, TRUE);
-	else if (g_strcmp0 (type, GPM_BUTTON_LID_OPEN) == 0)
-		gpm_manager_update_lid_throttle (manager, FALSE);
+	gpm_manager_update_lid_throttle (manager, is_closed);
 }
 
 /**
@@ -964,15 +874,13 @@ gpm_manager_client_changed_cb (UpClient *client, GParamSpec *pspec, GpmManager *
 	/* close any discharging notifications */
 	if (!on_battery) {
 		g_debug ("clearing notify due ac being present");
-		gpm_manager_notify_close (manager, manager->priv->notification_warning_low);
-		gpm_manager_notify_close (manager, manager->priv->notification_discharging);
+		gpm_alert_close (manager->priv->alert, GPM_ALERT_NOTIFY_WARNING_LOW);
+		gpm_alert_close (manager->priv->alert, GPM_ALERT_NOTIFY_DISCHARGING);
 	}
 
 	/* if we are playing a critical charge sound loop, stop it */
-	if (!on_battery && manager->priv->critical_alert_timeout_id) {
-		g_debug ("stopping alert loop due to ac being present");
-		gpm_manager_play_loop_stop (manager);
-	}
+	if (!on_battery && gpm_alert_play_loop_stop (manager->priv->alert))
+		g_debug ("stopped alert loop due to ac being present");
 
 	/* save in local cache */
 	manager->priv->on_battery = on_battery;
@@ -1000,13 +908,13 @@ gpm_manager_client_changed_cb (UpClient *client, GParamSpec *pspec, GpmManager *
 
 	/* We do the lid close on battery action if the ac adapter is removed
 	   when the laptop is closed and on battery. Fixes #331655 */
-	event_when_closed = g_settings_get_boolean (manager->priv->settings, GPM_SETTINGS_SLEEP_WHEN_CLOSED);
+	event_when_closed = gpm_policy_get (manager->priv->policy)->event_when_closed_battery;
 
 	/* We keep track of the lid state so we can do the
 	   lid close on battery action if the ac adapter is removed when the laptop
 	   is closed. Fixes #331655 */
 	if (event_when_closed && on_battery && lid_is_closed) {
-		gpm_manager_perform_policy (manager, GPM_SETTINGS_BUTTON_LID_BATT,
+		gpm_manager_perform_policy (manager, gpm_policy_get (manager->priv->policy)->button_lid_battery,
 					    "The lid has been closed, and the ac adapter "
 					    "removed (and GSettings is okay).");
 	}
@@ -1025,10 +933,10 @@ static gboolean
 manager_critical_action_do (GpmManager *manager)
 {
 	/* stop playing the alert as it's too late to do anything now */
-	if (manager->priv->critical_alert_timeout_id)
-		gpm_manager_play_loop_stop (manager);
+	gpm_alert_play_loop_stop (manager->priv->alert);
 
-	gpm_manager_perform_policy (manager, GPM_SETTINGS_ACTION_CRITICAL_BATT, "Battery is critically low.");
+	gpm_manager_perform_policy (manager, gpm_policy_get (manager->priv->policy)->action_critical_battery,
+				    "Battery is critically low.");
 	return FALSE;
 }
 
@@ -1041,15 +949,23 @@ gpm_manager_class_init (GpmManagerClass *klass)
 {
 	GObjectClass *object_class = G_OBJECT_CLASS (klass);
 	object_class->finalize = gpm_manager_finalize;
+
+	signals [SUMMARY_CHANGED] =
+		g_signal_new ("summary-changed",
+			      G_TYPE_FROM_CLASS (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (GpmManagerClass, summary_changed),
+			      NULL, NULL, g_cclosure_marshal_VOID__STRING,
+			      G_TYPE_NONE, 1, G_TYPE_STRING);
 }
 
 /**
- * gpm_manager_settings_changed_cb:
+ * gpm_manager_policy_changed_cb:
  *
  * We might have to do things when the keys change; do them here.
  **/
 static void
-gpm_manager_settings_changed_cb (GSettings *settings, const gchar *key, GpmManager *manager)
+gpm_manager_policy_changed_cb (GpmPolicy *policy, const gchar *key, GpmManager *manager)
 {
 	if (g_strcmp0 (key, GPM_SETTINGS_SLEEP_COMPUTER_BATT) == 0 ||
 	    g_strcmp0 (key, GPM_SETTINGS_SLEEP_COMPUTER_AC) == 0 ||
@@ -1064,6 +980,9 @@ gpm_manager_settings_changed_cb (GSettings *settings, const gchar *key, GpmManag
 static void
 gpm_manager_engine_icon_changed_cb (GpmEngine  *engine, gchar *icon, GpmManager *manager)
 {
+	/* the tray icon asks for the icon when it is made */
+	if (manager->priv->tray_icon == NULL)
+		return;
 	gpm_tray_icon_set_icon (manager->priv->tray_icon, icon);
 }
 
@@ -1073,7 +992,88 @@ gpm_manager_engine_icon_changed_cb (GpmEngine  *engine, gchar *icon, GpmManager
 static void
 gpm_manager_engine_summary_changed_cb (GpmEngine *engine, gchar *summary, GpmManager *manager)
 {
-	gpm_tray_icon_set_tooltip (manager->priv->tray_icon, summary);
+	if (manager->priv->tray_icon != NULL)
+		gpm_tray_icon_set_tooltip (manager->priv->tray_icon, summary);
+
+	/* the engine has already rate limited this, so pass it on for applets */
+	g_signal_emit (manager, signals [SUMMARY_CHANGED], 0, summary);
+}
+
+/**
+ * gpm_manager_get_summary:
+ *
+ * D-Bus method: the tooltip text as last shown in the notification icon.
+ **/
+gboolean
+gpm_manager_get_summary (GpmManager *manager, gchar **summary, GError **error)
+{
+	g_return_val_if_fail (GPM_IS_MANAGER (manager), FALSE);
+	g_return_val_if_fail (summary != NULL, FALSE);
+
+	*summary = NULL;
+	if (manager->priv->engine != NULL)
+		*summary = gpm_engine_get_published_summary (manager->priv->engine);
+	if (*summary == NULL)
+		*summary = g_strdup ("");
+	return TRUE;
+}
+
+/**
+ * gpm_manager_get_inhibitors:
+ *
+ * D-Bus method: the session inhibitors, as parallel arrays of the
+ * application, the reason and the mate-session inhibit flags. This is
+ * answered from the table GpmSession keeps, without asking mate-session.
+ **/
+gboolean
+gpm_manager_get_inhibitors (GpmManager *manager, gchar ***app_ids, gchar ***reasons,
+			    GArray **flags, GError **error)
+{
+	GpmSessionInhibitor *inhibitor;
+	GPtrArray *inhibitors;
+	guint i;
+
+	g_return_val_if_fail (GPM_IS_MANAGER (manager), FALSE);
+
+	inhibitors = gpm_session_get_inhibitors (manager->priv->session);
+	*app_ids = g_new0 (gchar *, inhibitors->len + 1);
+	*reasons = g_new0 (gchar *, inhibitors->len + 1);
+	*flags = g_array_sized_new (FALSE, FALSE, sizeof (guint), inhibitors->len);
+	for (i = 0; i < inhibitors->len; i++) {
+		inhibitor = g_ptr_array_index (inhibitors, i);
+		(*app_ids)[i] = g_strdup (inhibitor->app_id != NULL ? inhibitor->app_id : "");
+		(*reasons)[i] = g_strdup (inhibitor->reason != NULL ? inhibitor->reason : "");
+		g_array_append_val (*flags, inhibitor->flags);
+	}
+	g_ptr_array_unref (inhibitors);
+	return TRUE;
+}
+
+/**
+ * gpm_manager_get_main_loop_stalls:
+ *
+ * D-Bus method: the main loop watchdog histogram, as the upper limit of
+ * each bucket in ms and the heartbeats in each, and the latest stalls.
+ * Everything is empty unless started with --watchdog.
+ **/
+gboolean
+gpm_manager_get_main_loop_stalls (GpmManager *manager, GArray **limits, GArray **counts,
+				  gchar ***stalls, GError **error)
+{
+	GpmWatchdog *watchdog;
+
+	g_return_val_if_fail (GPM_IS_MANAGER (manager), FALSE);
+
+	watchdog = gpm_watchdog_new ();
+	if (gpm_watchdog_is_running (watchdog)) {
+		gpm_watchdog_get_histogram (watchdog, limits, counts);
+	} else {
+		*limits = g_array_new (FALSE, FALSE, sizeof (guint));
+		*counts = g_array_new (FALSE, FALSE, sizeof (guint));
+	}
+	*stalls = gpm_watchdog_get_stalls (watchdog);
+	g_object_unref (watchdog);
+	return TRUE;
 }
 
 /**
@@ -1107,8 +1107,8 @@ gpm_manager_engine_low_capacity_cb (GpmEngine *engine, UpDevice *device, GpmMana
 	/* TRANSLATORS: notify the user that that battery is broken as the capacity is very low */
 	message = g_strdup_printf (_("Battery has a very low capacity (%1.1f%%), "
 				     "which means that it may be old or broken."), capacity);
-	gpm_manager_notify (manager, &manager->priv->notification_general, title, message, GPM_MANAGER_NOTIFY_TIMEOUT_SHORT,
-			    "dialog-information", NOTIFY_URGENCY_LOW);
+	gpm_alert_notify (manager->priv->alert, GPM_ALERT_NOTIFY_GENERAL, title, message, GPM_MANAGER_NOTIFY_TIMEOUT_SHORT,
+			  "dialog-information", NOTIFY_URGENCY_LOW);
 out:
 	g_free (message);
 }
@@ -1126,7 +1126,7 @@ gpm_manager_engine_fully_charged_cb (GpmEngine *engine, UpDevice *device, GpmMan
 	const gchar *title;
 
 	/* only action this if specified in the setings */
-	ret = g_settings_get_boolean (manager->priv->settings, GPM_SETTINGS_NOTIFY_FULLY_CHARGED);
+	ret = gpm_policy_get (manager->priv->policy)->notify_fully_charged;
 	if (!ret) {
 		g_debug ("no notification");
 		goto out;
@@ -1150,14 +1150,14 @@ gpm_manager_engine_fully_charged_cb (GpmEngine *engine, UpDevice *device, GpmMan
 			plural = 2;
 
 		/* hide the discharging notification */
-		gpm_manager_notify_close (manager, manager->priv->notification_warning_low);
-		gpm_manager_notify_close (manager, manager->priv->notification_discharging);
+		gpm_alert_close (manager->priv->alert, GPM_ALERT_NOTIFY_WARNING_LOW);
+		gpm_alert_close (manager->priv->alert, GPM_ALERT_NOTIFY_DISCHARGING);
 
 		/* TRANSLATORS: show the charged notification */
 		title = ngettext ("Battery Charged", "Batteries Charged", plural);
-		gpm_manager_notify (manager, &manager->priv->notification_fully_charged,
-				    title, NULL, GPM_MANAGER_NOTIFY_TIMEOUT_SHORT,
-				    "dialog-information", NOTIFY_URGENCY_LOW);
+		gpm_alert_notify (manager->priv->alert, GPM_ALERT_NOTIFY_FULLY_CHARGED,
+				  title, NULL, GPM_MANAGER_NOTIFY_TIMEOUT_SHORT,
+				  "dialog-information", NOTIFY_URGENCY_LOW);
 	}
 out:
 	g_free (native_path);
@@ -1180,7 +1180,7 @@ gpm_manager_engine_discharging_cb (GpmEngine *engine, UpDevice *device, GpmManag
 	const gchar *kind_desc;
 
 	/* only action this if specified in the settings */
-	ret = g_settings_get_boolean (manager->priv->settings, GPM_SETTINGS_NOTIFY_DISCHARGING);
+	ret = gpm_policy_get (manager->priv->policy)->notify_discharging;
 	if (!ret) {
 		g_debug ("no notification");
 		goto out;
@@ -1229,8 +1229,8 @@ gpm_manager_engine_discharging_cb (GpmEngine *engine, UpDevice *device, GpmManag
 
 	icon = gpm_upower_get_device_icon (device);
 	/* show the notification */
-	gpm_manager_notify (manager, &manager->priv->notification_discharging, title, message, GPM_MANAGER_NOTIFY_TIMEOUT_LONG,
-			    icon, NOTIFY_URGENCY_NORMAL);
+	gpm_alert_notify (manager->priv->alert, GPM_ALERT_NOTIFY_DISCHARGING, title, message, GPM_MANAGER_NOTIFY_TIMEOUT_LONG,
+			  icon, NOTIFY_URGENCY_NORMAL);
 out:
 	g_free (icon);
 	g_free (remaining_text);
@@ -1321,8 +1321,7 @@ gpm_manager_engine_charge_low_cb (GpmEngine *engine, UpDevice *device, GpmManage
 		message = g_strdup_printf (_("Approximately <b>%s</b> of remaining UPS backup power (%.0f%%)"),
 					   remaining_text, percentage);
 	} else if (kind == UP_DEVICE_KIND_MOUSE) {
-		gboolean notify = g_settings_get_boolean (manager->priv->settings,
-				GPM_SETTINGS_NOTIFY_LOW_CAPACITY_MOUSE);
+		gboolean notify = gpm_policy_get (manager->priv->policy)->notify_low_capacity_mouse;
 		if(!notify)
 			goto out;
 
@@ -1377,7 +1376,7 @@ gpm_manager_engine_charge_low_cb (GpmEngine *engine, UpDevice *device, GpmManage
 
 	/* get correct icon */
 	icon = gpm_upower_get_device_icon (device);
-	gpm_manager_notify (manager, &manager->priv->notification_warning_low, title, message, GPM_MANAGER_NOTIFY_TIMEOUT_LONG, icon, NOTIFY_URGENCY_NORMAL);
+	gpm_alert_notify (manager->priv->alert, GPM_ALERT_NOTIFY_WARNING_LOW, title, message, GPM_MANAGER_NOTIFY_TIMEOUT_LONG, icon, NOTIFY_URGENCY_NORMAL);
 	gpm_manager_play (manager, GPM_MANAGER_SOUND_BATTERY_CAUTION, TRUE);
 out:
 	g_free (icon);
@@ -1427,7 +1426,7 @@ gpm_manager_engine_charge_critical_cb (GpmEngine *engine, UpDevice *device, GpmM
 		}
 
 		/* we have to do different warnings depending on the policy */
-		policy = g_settings_get_enum (manager->priv->settings, GPM_SETTINGS_ACTION_CRITICAL_BATT);
+		policy = gpm_policy_get (manager->priv->policy)->action_critical_battery;
 
 		/* use different text for different actions */
 		if (policy == GPM_ACTION_POLICY_NOTHING) {
@@ -1460,8 +1459,7 @@ gpm_manager_engine_charge_critical_cb (GpmEngine *engine, UpDevice *device, GpmM
 					   remaining_text, percentage);
 		g_free (remaining_text);
 	} else if (kind == UP_DEVICE_KIND_MOUSE) {
-		gboolean notify = g_settings_get_boolean (manager->priv->settings,
-				GPM_SETTINGS_NOTIFY_LOW_CAPACITY_MOUSE);
+		gboolean notify = gpm_policy_get (manager->priv->policy)->notify_low_capacity_mouse;
 		if(!notify)
 			goto out;
 
@@ -1531,7 +1529,7 @@ gpm_manager_engine_charge_critical_cb (GpmEngine *engine, UpDevice *device, GpmM
 
 	/* get correct icon */
 	icon = gpm_upower_get_device_icon (device);
-	gpm_manager_notify (manager, &manager->priv->notification_warning_low, title, message, GPM_MANAGER_NOTIFY_TIMEOUT_NEVER, icon, NOTIFY_URGENCY_CRITICAL);
+	gpm_alert_notify (manager->priv->alert, GPM_ALERT_NOTIFY_WARNING_LOW, title, message, GPM_MANAGER_NOTIFY_TIMEOUT_NEVER, icon, NOTIFY_URGENCY_CRITICAL);
 
 	switch (kind) {
 
@@ -1563,7 +1561,6 @@ gpm_manager_engine_charge_action_cb (GpmEngine *engine, UpDevice *device, GpmMan
 	gchar *icon = NULL;
 	UpDeviceKind kind;
 	GpmActionPolicy policy;
-	guint timer_id;
 
 	/* get device properties */
 	g_object_get (device,
@@ -1584,7 +1581,7 @@ gpm_manager_engine_charge_action_cb (GpmEngine *engine, UpDevice *device, GpmMan
 		title = _("Laptop battery critically low");
 
 		/* we have to do different warnings depending on the policy */
-		policy = g_settings_get_enum (manager->priv->settings, GPM_SETTINGS_ACTION_CRITICAL_BATT);
+		policy = gpm_policy_get (manager->priv->policy)->action_critical_battery;
 
 		/* use different text for different actions */
 		if (policy == GPM_ACTION_POLICY_NOTHING) {
@@ -1612,15 +1609,15 @@ gpm_manager_engine_charge_action_cb (GpmEngine *engine, UpDevice *device, GpmMan
 		}
 
 		/* wait 20 seconds for user-panic */
-		timer_id = g_timeout_add_seconds (20, (GSourceFunc) manager_critical_action_do, manager);
-		g_source_set_name_by_id (timer_id, "[GpmManager] battery critical-action");
+		gpm_timer_add_seconds (manager->priv->timer, 20, "[GpmManager] battery critical-action",
+				       (GSourceFunc) manager_critical_action_do, manager);
 
 	} else if (kind == UP_DEVICE_KIND_UPS) {
 		/* TRANSLATORS: UPS is really, really, low */
 		title = _("UPS critically low");
 
 		/* we have to do different warnings depending on the policy */
-		policy = g_settings_get_enum (manager->priv->settings, GPM_SETTINGS_ACTION_CRITICAL_UPS);
+		policy = gpm_policy_get (manager->priv->policy)->action_critical_ups;
 
 		/* use different text for different actions */
 		if (policy == GPM_ACTION_POLICY_NOTHING) {
@@ -1641,8 +1638,8 @@ gpm_manager_engine_charge_action_cb (GpmEngine *engine, UpDevice *device, GpmMan
 		}
 
 		/* wait 20 seconds for user-panic */
-		timer_id = g_timeout_add_seconds (20, (GSourceFunc) manager_critical_action_do, manager);
-		g_source_set_name_by_id (timer_id, "[GpmManager] ups critical-action");
+		gpm_timer_add_seconds (manager->priv->timer, 20, "[GpmManager] ups critical-action",
+				       (GSourceFunc) manager_critical_action_do, manager);
 
 	}
 
@@ -1654,39 +1651,15 @@ gpm_manager_engine_charge_action_cb (GpmEngine *engine, UpDevice *device, GpmMan
 
 	/* get correct icon */
 	icon = gpm_upower_get_device_icon (device);
-	gpm_manager_notify (manager, &manager->priv->notification_warning_low,
-			    title, message, GPM_MANAGER_NOTIFY_TIMEOUT_NEVER,
-			    icon, NOTIFY_URGENCY_CRITICAL);
+	gpm_alert_notify (manager->priv->alert, GPM_ALERT_NOTIFY_WARNING_LOW,
+			  title, message, GPM_MANAGER_NOTIFY_TIMEOUT_NEVER,
+			  icon, NOTIFY_URGENCY_CRITICAL);
 	gpm_manager_play (manager, GPM_MANAGER_SOUND_BATTERY_LOW, TRUE);
 out:
 	g_free (icon);
 	g_free (message);
 }
 
-/**
- * gpm_manager_dpms_mode_changed_cb:
- * @mode: The DPMS mode, e.g. GPM_DPMS_MODE_OFF
- * @info: This class instance
- *
- * Log when the DPMS mode is changed.
- **/
-static void
-gpm_manager_dpms_mode_changed_cb (GpmDpms *dpms, GpmDpmsMode mode, GpmManager *manager)
-{
-	g_debug ("DPMS mode changed: %u", mode);
-
-	if (mode == GPM_DPMS_MODE_ON)
-		g_debug ("dpms on");
-	else if (mode == GPM_DPMS_MODE_STANDBY)
-		g_debug ("dpms standby");
-	else if (mode == GPM_DPMS_MODE_SUSPEND)
-		g_debug ("suspend");
-	else if (mode == GPM_DPMS_MODE_OFF)
-		g_debug ("dpms off");
-
-	gpm_manager_update_dpms_throttle (manager);
-}
-
 /*
  * gpm_manager_reset_just_resumed_cb
  */
@@ -1695,14 +1668,7 @@ gpm_manager_reset_just_resumed_cb (gpointer user_data)
 {
 	GpmManager *manager = GPM_MANAGER (user_data);
 
-	if (manager->priv->notification_general != NULL)
-		gpm_manager_notify_close (manager, manager->priv->notification_general);
-	if (manager->priv->notification_warning_low != NULL)
-		gpm_manager_notify_close (manager, manager->priv->notification_warning_low);
-	if (manager->priv->notification_discharging != NULL)
-		gpm_manager_notify_close (manager, manager->priv->notification_discharging);
-	if (manager->priv->notification_fully_charged != NULL)
-		gpm_manager_notify_close (manager, manager->priv->notification_fully_charged);
+	gpm_alert_close_all (manager->priv->alert);
 
 	manager->priv->just_resumed = FALSE;
 	return FALSE;
@@ -1714,84 +1680,90 @@ gpm_manager_reset_just_resumed_cb (gpointer user_data)
 static void
 gpm_manager_control_resume_cb (GpmControl *control, GpmControlAction action, GpmManager *manager)
 {
-	guint timer_id;
 	manager->priv->just_resumed = TRUE;
-	timer_id = g_timeout_add_seconds (1, gpm_manager_reset_just_resumed_cb, manager);
-	g_source_set_name_by_id (timer_id, "[GpmManager] just-resumed");
+	gpm_timer_add_seconds (manager->priv->timer, 1, "[GpmManager] just-resumed",
+			       gpm_manager_reset_just_resumed_cb, manager);
 }
 
 /**
- * gpm_main_systemd_inhibit:
- *
- * Return a fd to the to the inhibitor, that we can close on exit.
+ * gpm_manager_systemd_inhibit_cb:
+ **/
+static void
+gpm_manager_systemd_inhibit_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GpmManager *manager = GPM_MANAGER (user_data);
+	GUnixFDList *fd_list = NULL;
+	GVariant *result;
+	GError *error = NULL;
+	gint32 idx;
+
+	result = g_dbus_proxy_call_with_unix_fd_list_finish (G_DBUS_PROXY (source), &fd_list, res, &error);
+	if (result == NULL) {
+		g_warning ("Error in dbus - %s", error->message);
+		g_error_free (error);
+		goto out;
+	}
+	g_variant_get (result, "(h)", &idx);
+	manager->priv->systemd_inhibit = g_unix_fd_list_get (fd_list, idx, &error);
+	if (manager->priv->systemd_inhibit == -1) {
+		g_debug ("Failed to get systemd inhibitor: %s", error->message);
+		g_error_free (error);
+	} else {
+		g_debug ("System inhibitor fd is %d", manager->priv->systemd_inhibit);
+	}
+	g_object_unref (fd_list);
+	g_variant_unref (result);
+out:
+	gpm_startup_end (manager->priv->startup, "logind-inhibit");
+	g_object_unref (manager);
+}
+
+/**
+ * gpm_manager_systemd_inhibit_proxy_cb:
+ **/
+static void
+gpm_manager_systemd_inhibit_proxy_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GpmManager *manager = GPM_MANAGER (user_data);
+	GDBusProxy *proxy;
+	GError *error = NULL;
+
+	proxy = gpm_proxy_pool_get_finish (GPM_PROXY_POOL (source), res, &error);
+	if (proxy == NULL) {
+		g_warning ("Error connecting to dbus - %s", error->message);
+		g_error_free (error);
+		gpm_startup_end (manager->priv->startup, "logind-inhibit");
+		g_object_unref (manager);
+		return;
+	}
+
+	g_debug ("Inhibiting systemd sleep");
+	g_dbus_proxy_call_with_unix_fd_list (proxy, "Inhibit",
+					     g_variant_new ("(ssss)",
+							    "handle-power-key:handle-suspend-key:handle-lid-switch",
+							    g_get_user_name (),
+							    "Mate power manager handles these events",
+							    "block"),
+					     G_DBUS_CALL_FLAGS_NONE,
+					     -1,
+					     NULL,
+					     NULL,
+					     gpm_manager_systemd_inhibit_cb, manager);
+	g_object_unref (proxy);
+}
+
+/**
+ * gpm_manager_systemd_inhibit:
  *
- * Return value: fd, -1 on error
+ * Takes a block inhibitor on the keys and the lid, so that logind leaves
+ * them to us. The fd is closed in finalize to hand them back.
  **/
-static gint32
-gpm_manager_systemd_inhibit (GDBusProxy *proxy) {
-    GError *error = NULL;
-    gint32 r = -1;
-    gint32 fd = -1;
-    GVariant *res;
-    GUnixFDList *fd_list = NULL;
-
-    /* Should we define these elsewhere? */
-    const char* arg_what = "handle-power-key:handle-suspend-key:handle-lid-switch";
-    const char* arg_who = g_get_user_name ();
-    const char* arg_why = "Mate power manager handles these events";
-    const char* arg_mode = "block";
-
-    g_debug ("Inhibiting systemd sleep");
-    proxy = g_dbus_proxy_new_for_bus_sync (G_BUS_TYPE_SYSTEM,
-                                       G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
-                                        NULL,
-                                        "org.freedesktop.login1",
-                                        "/org/freedesktop/login1",
-                                        "org.freedesktop.login1.Manager",
-                                        NULL,
-                                        &error );
-    //append all our arguments
-    if (proxy == NULL) {
-        g_error ("Error connecting to dbus - %s", error->message);
-        g_error_free (error);
-        return -1;
-    }
-    res = g_dbus_proxy_call_with_unix_fd_list_sync (proxy, "Inhibit",
-                            g_variant_new( "(ssss)",
-                                arg_what,
-                                arg_who,
-                                arg_why,
-                                arg_mode
-                            ),
-                            G_DBUS_CALL_FLAGS_NONE,
-                            -1,
-                            NULL,
-                            &fd_list,
-                            NULL,
-                            &error
-                            );
-    if (error != NULL) {
-        g_error ("Error in dbus - %s", error->message);
-        g_error_free (error);
-        return -EIO;
-    }
-    if (res == NULL)
-       return -EIO;
-
-    g_variant_get(res, "(h)", &r);
-    g_debug ("Inhibiting systemd sleep res = %i", r);
-
-    fd = g_unix_fd_list_get (fd_list, r, &error);
-    if (fd == -1) {
-        g_debug("Failed to get systemd inhibitor");
-        return r;
-    }
-
-    g_debug ("System inhibitor fd is %d", fd);
-    g_object_unref (fd_list);
-    g_variant_unref (res);
-    g_debug ("Inhibiting systemd sleep - success");
-    return r;
+static void
+gpm_manager_systemd_inhibit (GpmManager *manager)
+{
+	gpm_startup_begin (manager->priv->startup, "logind-inhibit");
+	gpm_proxy_pool_get_async (manager->priv->proxy_pool, GPM_PROXY_POOL_LOGIND, NULL,
+				  gpm_manager_systemd_inhibit_proxy_cb, g_object_ref (manager));
 }
 
 static void
@@ -1799,77 +1771,157 @@ on_icon_theme_change (GtkSettings *settings,
                       GParamSpec  *pspec,
                       GpmManager  *manager)
 {
-	gchar *icon = gpm_engine_get_icon (manager->priv->engine);
-	if (icon == NULL) {
-		return;
-	}
+	/* the rendered icons are stale, the names are not */
+	if (manager->priv->tray_icon != NULL)
+		gpm_tray_icon_invalidate_icons (manager->priv->tray_icon);
+}
 
+/**
+ * gpm_manager_startup_notify:
+ **/
+static void
+gpm_manager_startup_notify (gpointer user_data)
+{
+	GpmManager *manager = GPM_MANAGER (user_data);
+
+	/* nothing is shown before this */
+	gpm_alert_connect (manager->priv->alert);
+}
+
+/**
+ * gpm_manager_startup_tray_icon:
+ **/
+static void
+gpm_manager_startup_tray_icon (gpointer user_data)
+{
+	GpmManager *manager = GPM_MANAGER (user_data);
+	gchar *icon;
+	gchar *summary;
+
+	g_debug ("creating new tray icon");
+	manager->priv->tray_icon = gpm_tray_icon_new (manager->priv->engine);
+
+	/* the engine may have changed these before we were here */
+	icon = gpm_engine_get_icon (manager->priv->engine);
 	gpm_tray_icon_set_icon (manager->priv->tray_icon, icon);
 	g_free (icon);
+	summary = gpm_engine_get_summary (manager->priv->engine);
+	gpm_tray_icon_set_tooltip (manager->priv->tray_icon, summary);
+	g_free (summary);
+
+	/* keep a reference for the notifications */
+	manager->priv->status_icon = gpm_tray_icon_get_status_icon (manager->priv->tray_icon);
+	gpm_alert_set_status_icon (manager->priv->alert, manager->priv->status_icon);
+
+	g_signal_connect (gtk_settings_get_default (),
+	                  "notify::gtk-icon-theme-name",
+	                  G_CALLBACK (on_icon_theme_change),
+	                  manager);
+}
+
+/**
+ * gpm_manager_startup_engine:
+ **/
+static void
+gpm_manager_startup_engine (gpointer user_data)
+{
+	GpmManager *manager = GPM_MANAGER (user_data);
+
+	manager->priv->engine = gpm_engine_new ();
+	g_signal_connect (manager->priv->engine, "low-capacity",
+			  G_CALLBACK (gpm_manager_engine_low_capacity_cb), manager);
+	g_signal_connect (manager->priv->engine, "icon-changed",
+			  G_CALLBACK (gpm_manager_engine_icon_changed_cb), manager);
+	g_signal_connect (manager->priv->engine, "summary-changed",
+			  G_CALLBACK (gpm_manager_engine_summary_changed_cb), manager);
+	g_signal_connect (manager->priv->engine, "fully-charged",
+			  G_CALLBACK (gpm_manager_engine_fully_charged_cb), manager);
+	g_signal_connect (manager->priv->engine, "discharging",
+			  G_CALLBACK (gpm_manager_engine_discharging_cb), manager);
+	g_signal_connect (manager->priv->engine, "charge-low",
+			  G_CALLBACK (gpm_manager_engine_charge_low_cb), manager);
+	g_signal_connect (manager->priv->engine, "charge-critical",
+			  G_CALLBACK (gpm_manager_engine_charge_critical_cb), manager);
+	g_signal_connect (manager->priv->engine, "charge-action",
+			  G_CALLBACK (gpm_manager_engine_charge_action_cb), manager);
 }
 
 /**
  * gpm_manager_init:
  * @manager: This class instance
+ *
+ * Only what has to work before the first key press or idle timeout is
+ * made here, and anything that has to talk to another process does so
+ * asynchronously. The notifications, the tray icon and the engine are
+ * deferred until the main loop is running, and GpmStartup keeps the
+ * timeline of it all.
  **/
 static void
 gpm_manager_init (GpmManager *manager)
 {
 	gboolean check_type_cpu;
 	DBusGConnection *connection;
+	GpmStartup *startup;
 	GError *error = NULL;
 
 	manager->priv = gpm_manager_get_instance_private (manager);
+	startup = manager->priv->startup = gpm_startup_new ();
 	connection = dbus_g_bus_get (DBUS_BUS_SESSION, &error);
+	manager->priv->proxy_pool = gpm_proxy_pool_new ();
 
 	/* We want to inhibit the systemd suspend options, and take care of them ourselves */
-	if (LOGIND_RUNNING()) {
-		manager->priv->systemd_inhibit = gpm_manager_systemd_inhibit (manager->priv->systemd_inhibit_proxy);
-	}
+	manager->priv->systemd_inhibit = -1;
+	if (LOGIND_RUNNING())
+		gpm_manager_systemd_inhibit (manager);
 
 	/* init to unthrottled */
 	manager->priv->screensaver_ac_throttle_id = 0;
-	manager->priv->screensaver_dpms_throttle_id = 0;
 	manager->priv->screensaver_lid_throttle_id = 0;
 
-	manager->priv->critical_alert_timeout_id = 0;
-	manager->priv->critical_alert_loop_props = NULL;
-
 	/* init to not just_resumed */
 	manager->priv->just_resumed = FALSE;
 
 	/* don't apply policy when not active, so listen to ConsoleKit */
+	gpm_startup_begin (startup, "console-kit");
 	manager->priv->console = egg_console_kit_new ();
+	gpm_startup_end (startup, "console-kit");
+
+	/* notifications and sounds never block the policy */
+	manager->priv->alert = gpm_alert_new ();
+	manager->priv->timer = gpm_timer_new ();
 
-	manager->priv->notification_general = NULL;
-	manager->priv->notification_warning_low = NULL;
-	manager->priv->notification_discharging = NULL;
-	manager->priv->notification_fully_charged = NULL;
+	gpm_startup_begin (startup, "upower");
 	manager->priv->settings = g_settings_new (GPM_SETTINGS_SCHEMA);
-	g_signal_connect (manager->priv->settings, "changed",
-			  G_CALLBACK (gpm_manager_settings_changed_cb), manager);
+	manager->priv->policy = gpm_policy_new ();
+	g_signal_connect (manager->priv->policy, "changed",
+			  G_CALLBACK (gpm_manager_policy_changed_cb), manager);
 	manager->priv->client = up_client_new ();
 	g_signal_connect (manager->priv->client, "notify::lid-is-closed",
 			  G_CALLBACK (gpm_manager_client_changed_cb), manager);
 	g_signal_connect (manager->priv->client, "notify::on-battery",
 			  G_CALLBACK (gpm_manager_client_changed_cb), manager);
 
-	/* use libmatenotify */
-	notify_init (GPM_NAME);
-
 	/* coldplug so we are in the correct state at startup */
 	g_object_get (manager->priv->client,
 		      "on-battery", &manager->priv->on_battery,
 		      NULL);
+	gpm_startup_end (startup, "upower");
 
+	gpm_startup_begin (startup, "button");
 	manager->priv->button = gpm_button_new ();
 	g_signal_connect (manager->priv->button, "button-pressed",
 			  G_CALLBACK (gpm_manager_button_pressed_cb), manager);
+	g_signal_connect (manager->priv->button, "lid-changed",
+			  G_CALLBACK (gpm_manager_lid_changed_cb), manager);
+	gpm_startup_end (startup, "button");
 
 	/* try and start an interactive service */
+	gpm_startup_begin (startup, "screensaver");
 	manager->priv->screensaver = gpm_screensaver_new ();
+	gpm_startup_end (startup, "screensaver");
 
 	/* try an start an interactive service */
+	gpm_startup_begin (startup, "backlight");
 	manager->priv->backlight = gpm_backlight_new ();
 	if (manager->priv->backlight != NULL) {
 		/* add the new brightness lcd DBUS interface */
@@ -1878,67 +1930,51 @@ gpm_manager_init (GpmManager *manager)
 		dbus_g_connection_register_g_object (connection, GPM_DBUS_PATH_BACKLIGHT,
 						     G_OBJECT (manager->priv->backlight));
 	}
+	gpm_startup_end (startup, "backlight");
 
-    manager->priv->kbd_backlight = gpm_kbd_backlight_new ();
-    if (manager->priv->kbd_backlight != NULL) {
-    	dbus_g_object_type_install_info (GPM_TYPE_KBD_BACKLIGHT,
+	gpm_startup_begin (startup, "kbd-backlight");
+	manager->priv->kbd_backlight = gpm_kbd_backlight_new ();
+	if (manager->priv->kbd_backlight != NULL) {
+		dbus_g_object_type_install_info (GPM_TYPE_KBD_BACKLIGHT,
 						 &dbus_glib_gpm_kbd_backlight_object_info);
 		dbus_g_connection_register_g_object (connection, GPM_DBUS_PATH_KBD_BACKLIGHT,
 						     G_OBJECT (manager->priv->kbd_backlight));
+	}
+	gpm_startup_end (startup, "kbd-backlight");
 
-    }
-
+	gpm_startup_begin (startup, "idle");
 	manager->priv->idle = gpm_idle_new ();
+	manager->priv->session = gpm_session_new ();
 	g_signal_connect (manager->priv->idle, "idle-changed",
 			  G_CALLBACK (gpm_manager_idle_changed_cb), manager);
 
 	/* set up the check_type_cpu, so we can disable the CPU load check */
-	check_type_cpu = g_settings_get_boolean (manager->priv->settings, GPM_SETTINGS_IDLE_CHECK_CPU);
+	check_type_cpu = gpm_policy_get (manager->priv->policy)->check_type_cpu;
 	gpm_idle_set_check_cpu (manager->priv->idle, check_type_cpu);
+	gpm_startup_end (startup, "idle");
 
-	manager->priv->dpms = gpm_dpms_new ();
-	g_signal_connect (manager->priv->dpms, "mode-changed",
-			  G_CALLBACK (gpm_manager_dpms_mode_changed_cb), manager);
+	/* this also throttles the screensaver while the screen is off */
+	gpm_startup_begin (startup, "display");
+	manager->priv->display = gpm_display_new ();
+	gpm_startup_end (startup, "display");
 
 	/* use the control object */
 	g_debug ("creating new control instance");
+	gpm_startup_begin (startup, "control");
 	manager->priv->control = gpm_control_new ();
 	g_signal_connect (manager->priv->control, "resume",
 			  G_CALLBACK (gpm_manager_control_resume_cb), manager);
-
-	g_debug ("creating new tray icon");
-	manager->priv->tray_icon = gpm_tray_icon_new ();
-
-	/* keep a reference for the notifications */
-	manager->priv->status_icon = gpm_tray_icon_get_status_icon (manager->priv->tray_icon);
+	gpm_startup_end (startup, "control");
 
 	gpm_manager_sync_policy_sleep (manager);
 
-	manager->priv->engine = gpm_engine_new ();
-	g_signal_connect (manager->priv->engine, "low-capacity",
-			  G_CALLBACK (gpm_manager_engine_low_capacity_cb), manager);
-	g_signal_connect (manager->priv->engine, "icon-changed",
-			  G_CALLBACK (gpm_manager_engine_icon_changed_cb), manager);
-	g_signal_connect (manager->priv->engine, "summary-changed",
-			  G_CALLBACK (gpm_manager_engine_summary_changed_cb), manager);
-	g_signal_connect (manager->priv->engine, "fully-charged",
-			  G_CALLBACK (gpm_manager_engine_fully_charged_cb), manager);
-	g_signal_connect (manager->priv->engine, "discharging",
-			  G_CALLBACK (gpm_manager_engine_discharging_cb), manager);
-	g_signal_connect (manager->priv->engine, "charge-low",
-			  G_CALLBACK (gpm_manager_engine_charge_low_cb), manager);
-	g_signal_connect (manager->priv->engine, "charge-critical",
-			  G_CALLBACK (gpm_manager_engine_charge_critical_cb), manager);
-	g_signal_connect (manager->priv->engine, "charge-action",
-			  G_CALLBACK (gpm_manager_engine_charge_action_cb), manager);
-
-	g_signal_connect (gtk_settings_get_default (),
-	                  "notify::gtk-icon-theme-name",
-	                  G_CALLBACK (on_icon_theme_change),
-	                  manager);
-
 	/* update ac throttle */
 	gpm_manager_update_ac_throttle (manager);
+
+	/* nothing here is needed to handle a key press or going idle */
+	gpm_startup_defer (startup, "notify", gpm_manager_startup_notify, manager);
+	gpm_startup_defer (startup, "engine", gpm_manager_startup_engine, manager);
+	gpm_startup_defer (startup, "tray-icon", gpm_manager_startup_tray_icon, manager);
 }
 
 /**
@@ -1959,30 +1995,23 @@ gpm_manager_finalize (GObject *object)
 
 	g_return_if_fail (manager->priv != NULL);
 
-	/* close any notifications (also unrefs them) */
-	if (manager->priv->notification_general != NULL)
-		gpm_manager_notify_close (manager, manager->priv->notification_general);
-	if (manager->priv->notification_warning_low != NULL)
-		gpm_manager_notify_close (manager, manager->priv->notification_warning_low);
-	if (manager->priv->notification_discharging != NULL)
-		gpm_manager_notify_close (manager, manager->priv->notification_discharging);
-	if (manager->priv->notification_fully_charged != NULL)
-		gpm_manager_notify_close (manager, manager->priv->notification_fully_charged);
-
-	if (manager->priv->critical_alert_timeout_id != 0) {
-		g_source_remove (manager->priv->critical_alert_timeout_id);
-		manager->priv->critical_alert_timeout_id = 0;
-	}
+	/* closes any notifications and stops the sound loop */
+	g_object_unref (manager->priv->alert);
+	g_object_unref (manager->priv->timer);
 
 	g_signal_handlers_disconnect_by_func (gtk_settings_get_default (),
 	                                      on_icon_theme_change,
 	                                      manager);
 
 	g_object_unref (manager->priv->settings);
-	g_object_unref (manager->priv->dpms);
+	g_object_unref (manager->priv->policy);
+	g_object_unref (manager->priv->display);
 	g_object_unref (manager->priv->idle);
-	g_object_unref (manager->priv->engine);
-	g_object_unref (manager->priv->tray_icon);
+	g_object_unref (manager->priv->session);
+	if (manager->priv->engine != NULL)
+		g_object_unref (manager->priv->engine);
+	if (manager->priv->tray_icon != NULL)
+		g_object_unref (manager->priv->tray_icon);
 	g_object_unref (manager->priv->screensaver);
 	g_object_unref (manager->priv->control);
 	g_object_unref (manager->priv->button);
@@ -1990,17 +2019,14 @@ gpm_manager_finalize (GObject *object)
 	g_object_unref (manager->priv->kbd_backlight);
 	g_object_unref (manager->priv->console);
 	g_object_unref (manager->priv->client);
-	g_object_unref (manager->priv->status_icon);
-
-	if (LOGIND_RUNNING()) {
-		/* Let systemd take over again ... */
-		if (manager->priv->systemd_inhibit > 0) {
-			close(manager->priv->systemd_inhibit);
-		}
-		if (manager->priv->systemd_inhibit_proxy != NULL) {
-			g_object_unref (manager->priv->systemd_inhibit_proxy);
-		}
-	}
+	if (manager->priv->status_icon != NULL)
+		g_object_unref (manager->priv->status_icon);
+	g_object_unref (manager->priv->proxy_pool);
+	g_object_unref (manager->priv->startup);
+
+	/* Let systemd take over again ... */
+	if (manager->priv->systemd_inhibit >= 0)
+		close (manager->priv->systemd_inhibit);
 
 	G_OBJECT_CLASS (gpm_manager_parent_class)->finalize (object);
 }
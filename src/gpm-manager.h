@@ -49,6 +49,8 @@ typedef struct
 typedef struct
 {
 	GObjectClass	parent_class;
+	void		(* summary_changed)	(GpmManager	*manager,
+						 const gchar	*summary);
 } GpmManagerClass;
 
 typedef enum
@@ -73,6 +75,19 @@ gboolean	 gpm_manager_can_suspend		(GpmManager	*manager,
 gboolean	 gpm_manager_can_hibernate		(GpmManager	*manager,
 							 gboolean	*can_hibernate,
 							 GError		**error);
+gboolean	 gpm_manager_get_summary		(GpmManager	*manager,
+							 gchar		**summary,
+							 GError		**error);
+gboolean	 gpm_manager_get_inhibitors		(GpmManager	*manager,
+							 gchar		***app_ids,
+							 gchar		***reasons,
+							 GArray		**flags,
+							 GError		**error);
+gboolean	 gpm_manager_get_main_loop_stalls	(GpmManager	*manager,
+							 GArray		**limits,
+							 GArray		**counts,
+							 gchar		***stalls,
+							 GError		**error);
 
 G_END_DECLS
 
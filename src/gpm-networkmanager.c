@@ -25,13 +25,41 @@
 #endif
 
 #include <glib.h>
-#include <dbus/dbus-glib.h>
+#include <gio/gio.h>
 
 #include "gpm-networkmanager.h"
+#include "gpm-proxy-pool.h"
 
-#define NM_LISTENER_SERVICE	"org.freedesktop.NetworkManager"
-#define NM_LISTENER_PATH	"/org/freedesktop/NetworkManager"
-#define NM_LISTENER_INTERFACE	"org.freedesktop.NetworkManager"
+/**
+ * gpm_networkmanager_call:
+ *
+ * Sends @method without waiting for a reply, using the shared proxy.
+ **/
+static gboolean
+gpm_networkmanager_call (const gchar *method)
+{
+	GpmProxyPool *pool;
+	GDBusProxy *proxy;
+	gboolean ret = FALSE;
+
+	pool = gpm_proxy_pool_new ();
+	proxy = gpm_proxy_pool_get (pool, GPM_PROXY_POOL_NETWORKMANAGER);
+	if (proxy == NULL) {
+		g_warning ("Not connected to NetworkManager");
+		goto out;
+	}
+	if (!gpm_proxy_pool_has_owner (pool, GPM_PROXY_POOL_NETWORKMANAGER)) {
+		g_warning ("Failed to get name owner");
+		goto out;
+	}
+	g_dbus_proxy_call (proxy, method, NULL,
+			   G_DBUS_CALL_FLAGS_NONE, -1,
+			   NULL, NULL, NULL);
+	ret = TRUE;
+out:
+	g_object_unref (pool);
+	return ret;
+}
 
 /**
  * gpm_networkmanager_sleep:
@@ -43,28 +71,7 @@
 gboolean
 gpm_networkmanager_sleep (void)
 {
-	DBusGConnection *connection = NULL;
-	DBusGProxy *nm_proxy = NULL;
-	GError *error = NULL;
-
-	connection = dbus_g_bus_get (DBUS_BUS_SYSTEM, &error);
-	if (error) {
-		g_warning ("%s", error->message);
-		g_error_free (error);
-		return FALSE;
-	}
-
-	nm_proxy = dbus_g_proxy_new_for_name (connection,
-			NM_LISTENER_SERVICE,
-			NM_LISTENER_PATH,
-			NM_LISTENER_INTERFACE);
-	if (!nm_proxy) {
-		g_warning ("Failed to get name owner");
-		return FALSE;
-	}
-	dbus_g_proxy_call_no_reply (nm_proxy, "sleep", G_TYPE_INVALID);
-	g_object_unref (G_OBJECT (nm_proxy));
-	return TRUE;
+	return gpm_networkmanager_call ("sleep");
 }
 
 /**
@@ -77,26 +84,5 @@ gpm_networkmanager_sleep (void)
 gboolean
 gpm_networkmanager_wake (void)
 {
-	DBusGConnection *connection = NULL;
-	DBusGProxy *nm_proxy = NULL;
-	GError *error = NULL;
-
-	connection = dbus_g_bus_get (DBUS_BUS_SYSTEM, &error);
-	if (error) {
-		g_warning ("%s", error->message);
-		g_error_free (error);
-		return FALSE;
-	}
-
-	nm_proxy = dbus_g_proxy_new_for_name (connection,
-			NM_LISTENER_SERVICE,
-			NM_LISTENER_PATH,
-			NM_LISTENER_INTERFACE);
-	if (!nm_proxy) {
-		g_warning ("Failed to get name owner");
-		return FALSE;
-	}
-	dbus_g_proxy_call_no_reply (nm_proxy, "wake", G_TYPE_INVALID);
-	g_object_unref (G_OBJECT (nm_proxy));
-	return TRUE;
+	return gpm_networkmanager_call ("wake");
 }
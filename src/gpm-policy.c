@@ -0,0 +1,253 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * The settings the daemon reads when something happens, read once each
+ * time they change instead of once per event. Readers get a snapshot
+ * that never changes under them; a change builds a new one and swaps it
+ * in, and the old one is only dropped once the main loop is idle, so a
+ * snapshot read before a change that fires synchronously (a key being
+ * written by the same process) stays valid to the end of that handler.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "gpm-common.h"
+#include "gpm-policy.h"
+
+static void     gpm_policy_finalize   (GObject	  *object);
+
+struct GpmPolicyPrivate
+{
+	GSettings		*settings;
+	GpmPolicySnapshot	*snapshot;
+};
+
+enum {
+	CHANGED,
+	LAST_SIGNAL
+};
+
+static guint signals [LAST_SIGNAL] = { 0 };
+static gpointer gpm_policy_object = NULL;
+
+G_DEFINE_TYPE_WITH_PRIVATE (GpmPolicy, gpm_policy, G_TYPE_OBJECT)
+
+/**
+ * gpm_policy_snapshot_ref:
+ *
+ * Keeps a snapshot past the handler it was read in, e.g. across an
+ * async call.
+ **/
+GpmPolicySnapshot *
+gpm_policy_snapshot_ref (GpmPolicySnapshot *snapshot)
+{
+	g_return_val_if_fail (snapshot != NULL, NULL);
+	g_atomic_int_inc (&snapshot->ref_count);
+	return snapshot;
+}
+
+/**
+ * gpm_policy_snapshot_unref:
+ **/
+void
+gpm_policy_snapshot_unref (GpmPolicySnapshot *snapshot)
+{
+	g_return_if_fail (snapshot != NULL);
+	if (g_atomic_int_dec_and_test (&snapshot->ref_count))
+		g_free (snapshot);
+}
+
+/**
+ * gpm_policy_snapshot_retire_cb:
+ **/
+static gboolean
+gpm_policy_snapshot_retire_cb (GpmPolicySnapshot *snapshot)
+{
+	gpm_policy_snapshot_unref (snapshot);
+	return FALSE;
+}
+
+/**
+ * gpm_policy_snapshot_new:
+ **/
+static GpmPolicySnapshot *
+gpm_policy_snapshot_new (GSettings *settings)
+{
+	GpmPolicySnapshot *snapshot;
+
+	snapshot = g_new0 (GpmPolicySnapshot, 1);
+	snapshot->ref_count = 1;
+
+	snapshot->action_critical_battery = g_settings_get_enum (settings, GPM_SETTINGS_ACTION_CRITICAL_BATT);
+	snapshot->action_critical_ups = g_settings_get_enum (settings, GPM_SETTINGS_ACTION_CRITICAL_UPS);
+	snapshot->action_sleep_type_ac = g_settings_get_enum (settings, GPM_SETTINGS_ACTION_SLEEP_TYPE_AC);
+	snapshot->action_sleep_type_battery = g_settings_get_enum (settings, GPM_SETTINGS_ACTION_SLEEP_TYPE_BATT);
+	snapshot->button_lid_ac = g_settings_get_enum (settings, GPM_SETTINGS_BUTTON_LID_AC);
+	snapshot->button_lid_battery = g_settings_get_enum (settings, GPM_SETTINGS_BUTTON_LID_BATT);
+	snapshot->button_suspend = g_settings_get_enum (settings, GPM_SETTINGS_BUTTON_SUSPEND);
+	snapshot->button_hibernate = g_settings_get_enum (settings, GPM_SETTINGS_BUTTON_HIBERNATE);
+	snapshot->button_power = g_settings_get_enum (settings, GPM_SETTINGS_BUTTON_POWER);
+	snapshot->event_when_closed_battery = g_settings_get_boolean (settings, GPM_SETTINGS_SLEEP_WHEN_CLOSED);
+
+	snapshot->sleep_computer_ac = g_settings_get_int (settings, GPM_SETTINGS_SLEEP_COMPUTER_AC);
+	snapshot->sleep_computer_battery = g_settings_get_int (settings, GPM_SETTINGS_SLEEP_COMPUTER_BATT);
+	snapshot->sleep_display_ac = g_settings_get_int (settings, GPM_SETTINGS_SLEEP_DISPLAY_AC);
+	snapshot->sleep_display_battery = g_settings_get_int (settings, GPM_SETTINGS_SLEEP_DISPLAY_BATT);
+	snapshot->check_type_cpu = g_settings_get_boolean (settings, GPM_SETTINGS_IDLE_CHECK_CPU);
+
+	snapshot->backlight_enable = g_settings_get_boolean (settings, GPM_SETTINGS_BACKLIGHT_ENABLE);
+	snapshot->backlight_battery_reduce = g_settings_get_boolean (settings, GPM_SETTINGS_BACKLIGHT_BATTERY_REDUCE);
+	snapshot->brightness_ac = g_settings_get_double (settings, GPM_SETTINGS_BRIGHTNESS_AC);
+	snapshot->brightness_dim_battery = g_settings_get_int (settings, GPM_SETTINGS_BRIGHTNESS_DIM_BATT);
+	snapshot->ambient_enable = g_settings_get_boolean (settings, GPM_SETTINGS_AMBIENT_ENABLE);
+	snapshot->idle_dim_ac = g_settings_get_boolean (settings, GPM_SETTINGS_IDLE_DIM_AC);
+	snapshot->idle_dim_battery = g_settings_get_boolean (settings, GPM_SETTINGS_IDLE_DIM_BATT);
+	snapshot->idle_brightness = g_settings_get_int (settings, GPM_SETTINGS_IDLE_BRIGHTNESS);
+	snapshot->idle_dim_time = g_settings_get_int (settings, GPM_SETTINGS_IDLE_DIM_TIME);
+	snapshot->dpms_method_ac = g_settings_get_enum (settings, GPM_SETTINGS_DPMS_METHOD_AC);
+	snapshot->dpms_method_battery = g_settings_get_enum (settings, GPM_SETTINGS_DPMS_METHOD_BATT);
+
+	snapshot->kbd_backlight_enable = g_settings_get_boolean (settings, GPM_SETTINGS_KBD_BACKLIGHT_ENABLE);
+	snapshot->kbd_backlight_battery_reduce = g_settings_get_boolean (settings, GPM_SETTINGS_KBD_BACKLIGHT_BATT_REDUCE);
+	snapshot->kbd_brightness_on_ac = g_settings_get_int (settings, GPM_SETTINGS_KBD_BRIGHTNESS_ON_AC);
+	snapshot->kbd_brightness_dim_by_on_battery = g_settings_get_int (settings, GPM_SETTINGS_KBD_BRIGHTNESS_DIM_BY_ON_BATT);
+	snapshot->kbd_brightness_dim_by_on_idle = g_settings_get_int (settings, GPM_SETTINGS_KBD_BRIGHTNESS_DIM_BY_ON_IDLE);
+
+	snapshot->enable_sound = g_settings_get_boolean (settings, GPM_SETTINGS_ENABLE_SOUND);
+	snapshot->notify_sleep_failed = g_settings_get_boolean (settings, GPM_SETTINGS_NOTIFY_SLEEP_FAILED);
+	snapshot->notify_discharging = g_settings_get_boolean (settings, GPM_SETTINGS_NOTIFY_DISCHARGING);
+	snapshot->notify_fully_charged = g_settings_get_boolean (settings, GPM_SETTINGS_NOTIFY_FULLY_CHARGED);
+	snapshot->notify_low_capacity_mouse = g_settings_get_boolean (settings, GPM_SETTINGS_NOTIFY_LOW_CAPACITY_MOUSE);
+
+	return snapshot;
+}
+
+/**
+ * gpm_policy_settings_changed_cb:
+ **/
+static void
+gpm_policy_settings_changed_cb (GSettings *settings, const gchar *key, GpmPolicy *policy)
+{
+	GpmPolicySnapshot *old;
+
+	old = policy->priv->snapshot;
+	g_atomic_pointer_set (&policy->priv->snapshot, gpm_policy_snapshot_new (settings));
+	g_idle_add ((GSourceFunc) gpm_policy_snapshot_retire_cb, old);
+
+	g_signal_emit (policy, signals [CHANGED], 0, key);
+}
+
+/**
+ * gpm_policy_get:
+ *
+ * Return value: the current settings, valid until the main loop next
+ * goes idle; use gpm_policy_snapshot_ref() to keep them for longer.
+ **/
+const GpmPolicySnapshot *
+gpm_policy_get (GpmPolicy *policy)
+{
+	g_return_val_if_fail (GPM_IS_POLICY (policy), NULL);
+	return g_atomic_pointer_get (&policy->priv->snapshot);
+}
+
+/**
+ * gpm_policy_get_settings:
+ *
+ * Return value: the settings the snapshot is built from, for writing
+ * keys back, not owned by the caller.
+ **/
+GSettings *
+gpm_policy_get_settings (GpmPolicy *policy)
+{
+	g_return_val_if_fail (GPM_IS_POLICY (policy), NULL);
+	return policy->priv->settings;
+}
+
+/**
+ * gpm_policy_class_init:
+ * @klass: This class instance
+ **/
+static void
+gpm_policy_class_init (GpmPolicyClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = gpm_policy_finalize;
+
+	signals [CHANGED] =
+		g_signal_new ("changed",
+			      G_TYPE_FROM_CLASS (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (GpmPolicyClass, changed),
+			      NULL, NULL, g_cclosure_marshal_VOID__STRING,
+			      G_TYPE_NONE, 1, G_TYPE_STRING);
+}
+
+/**
+ * gpm_policy_init:
+ **/
+static void
+gpm_policy_init (GpmPolicy *policy)
+{
+	policy->priv = gpm_policy_get_instance_private (policy);
+
+	policy->priv->settings = g_settings_new (GPM_SETTINGS_SCHEMA);
+	policy->priv->snapshot = gpm_policy_snapshot_new (policy->priv->settings);
+	g_signal_connect (policy->priv->settings, "changed",
+			  G_CALLBACK (gpm_policy_settings_changed_cb), policy);
+}
+
+/**
+ * gpm_policy_finalize:
+ * @object: This class instance
+ **/
+static void
+gpm_policy_finalize (GObject *object)
+{
+	GpmPolicy *policy;
+	g_return_if_fail (object != NULL);
+	g_return_if_fail (GPM_IS_POLICY (object));
+
+	policy = GPM_POLICY (object);
+	g_object_unref (policy->priv->settings);
+	gpm_policy_snapshot_unref (policy->priv->snapshot);
+
+	G_OBJECT_CLASS (gpm_policy_parent_class)->finalize (object);
+}
+
+/**
+ * gpm_policy_new:
+ * Return value: The shared GpmPolicy instance.
+ **/
+GpmPolicy *
+gpm_policy_new (void)
+{
+	if (gpm_policy_object != NULL) {
+		g_object_ref (gpm_policy_object);
+	} else {
+		gpm_policy_object = g_object_new (GPM_TYPE_POLICY, NULL);
+		g_object_add_weak_pointer (gpm_policy_object, &gpm_policy_object);
+	}
+	return GPM_POLICY (gpm_policy_object);
+}
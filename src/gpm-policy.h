@@ -0,0 +1,118 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __GPM_POLICY_H
+#define __GPM_POLICY_H
+
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "gpm-common.h"
+#include "gpm-dpms.h"
+
+G_BEGIN_DECLS
+
+#define GPM_TYPE_POLICY		(gpm_policy_get_type ())
+#define GPM_POLICY(o)		(G_TYPE_CHECK_INSTANCE_CAST ((o), GPM_TYPE_POLICY, GpmPolicy))
+#define GPM_POLICY_CLASS(k)	(G_TYPE_CHECK_CLASS_CAST((k), GPM_TYPE_POLICY, GpmPolicyClass))
+#define GPM_IS_POLICY(o)	(G_TYPE_CHECK_INSTANCE_TYPE ((o), GPM_TYPE_POLICY))
+#define GPM_IS_POLICY_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), GPM_TYPE_POLICY))
+#define GPM_POLICY_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), GPM_TYPE_POLICY, GpmPolicyClass))
+
+/* the settings read on event paths, never changed once built */
+typedef struct
+{
+	/* actions */
+	GpmActionPolicy	 action_critical_battery;
+	GpmActionPolicy	 action_critical_ups;
+	GpmActionPolicy	 action_sleep_type_ac;
+	GpmActionPolicy	 action_sleep_type_battery;
+	GpmActionPolicy	 button_lid_ac;
+	GpmActionPolicy	 button_lid_battery;
+	GpmActionPolicy	 button_suspend;
+	GpmActionPolicy	 button_hibernate;
+	GpmActionPolicy	 button_power;
+	gboolean	 event_when_closed_battery;
+
+	/* inactivity, in seconds */
+	guint		 sleep_computer_ac;
+	guint		 sleep_computer_battery;
+	guint		 sleep_display_ac;
+	guint		 sleep_display_battery;
+	gboolean	 check_type_cpu;
+
+	/* backlight */
+	gboolean	 backlight_enable;
+	gboolean	 backlight_battery_reduce;
+	gdouble		 brightness_ac;
+	guint		 brightness_dim_battery;
+	gboolean	 ambient_enable;
+	gboolean	 idle_dim_ac;
+	gboolean	 idle_dim_battery;
+	guint		 idle_brightness;
+	guint		 idle_dim_time;
+	GpmDpmsMode	 dpms_method_ac;
+	GpmDpmsMode	 dpms_method_battery;
+
+	/* keyboard backlight */
+	gboolean	 kbd_backlight_enable;
+	gboolean	 kbd_backlight_battery_reduce;
+	guint		 kbd_brightness_on_ac;
+	guint		 kbd_brightness_dim_by_on_battery;
+	guint		 kbd_brightness_dim_by_on_idle;
+
+	/* notifications */
+	gboolean	 enable_sound;
+	gboolean	 notify_sleep_failed;
+	gboolean	 notify_discharging;
+	gboolean	 notify_fully_charged;
+	gboolean	 notify_low_capacity_mouse;
+
+	/*< private >*/
+	gint		 ref_count;
+} GpmPolicySnapshot;
+
+typedef struct GpmPolicyPrivate GpmPolicyPrivate;
+
+typedef struct
+{
+	GObject		 parent;
+	GpmPolicyPrivate *priv;
+} GpmPolicy;
+
+typedef struct
+{
+	GObjectClass	parent_class;
+	void		(* changed)			(GpmPolicy	*policy,
+							 const gchar	*key);
+} GpmPolicyClass;
+
+GType		 gpm_policy_get_type			(void);
+GpmPolicy	*gpm_policy_new				(void);
+
+const GpmPolicySnapshot *gpm_policy_get			(GpmPolicy	*policy);
+GSettings	*gpm_policy_get_settings		(GpmPolicy	*policy);
+GpmPolicySnapshot *gpm_policy_snapshot_ref		(GpmPolicySnapshot *snapshot);
+void		 gpm_policy_snapshot_unref		(GpmPolicySnapshot *snapshot);
+
+G_END_DECLS
+
+#endif /* __GPM_POLICY_H */
@@ -33,7 +33,6 @@
 #define UPOWER_ENABLE_DEPRECATED
 #include <libupower-glib/upower.h>
 
-#include "egg-console-kit.h"
 
 #include "gpm-tray-icon.h"
 #include "gpm-common.h"
@@ -60,7 +59,6 @@ struct GpmPrefsPrivate
 	gboolean		 can_suspend;
 	gboolean		 can_hibernate;
 	GSettings		*settings;
-	EggConsoleKit		*console;
 };
 
 enum {
@@ -575,6 +573,39 @@ prefs_setup_general (GpmPrefs *prefs)
 		gtk_widget_hide (GET_WIDGET ("box_general_suspend"));
 }
 
+/**
+ * gpm_prefs_console_kit_can:
+ * @proxy: the ConsoleKit manager proxy
+ * @method: a ConsoleKit method returning "yes", "no" or "challenge"
+ *
+ * The dialog has nothing to show until it knows, so this waits for the reply.
+ **/
+static gboolean
+gpm_prefs_console_kit_can (GDBusProxy *proxy, const gchar *method)
+{
+	GError *error = NULL;
+	GVariant *res;
+	const gchar *r;
+	gboolean ret = FALSE;
+
+	res = g_dbus_proxy_call_sync (proxy, method,
+				      NULL,
+				      G_DBUS_CALL_FLAGS_NONE,
+				      -1,
+				      NULL,
+				      &error
+				      );
+	if (res == NULL) {
+		g_warning ("Error in dbus - %s", error->message);
+		g_error_free (error);
+		return FALSE;
+	}
+	g_variant_get (res, "(&s)", &r);
+	ret = g_strcmp0 (r, "yes") == 0 || g_strcmp0 (r, "challenge") == 0;
+	g_variant_unref (res);
+	return ret;
+}
+
 /**
  * gpm_prefs_init:
  * @prefs: This prefs class instance
@@ -604,7 +635,6 @@ gpm_prefs_init (GpmPrefs *prefs)
 	prefs->priv = gpm_prefs_get_instance_private (prefs);
 
 	prefs->priv->client = up_client_new ();
-	prefs->priv->console = egg_console_kit_new ();
 	prefs->priv->settings = g_settings_new (GPM_SETTINGS_SCHEMA);
 
 	prefs->priv->can_shutdown = FALSE;
@@ -678,10 +708,40 @@ gpm_prefs_init (GpmPrefs *prefs)
 		g_object_unref(proxy);
 	}
 	else {
-		/* Get values from ConsoleKit */
-		egg_console_kit_can_stop (prefs->priv->console, &prefs->priv->can_shutdown, NULL);
-		egg_console_kit_can_suspend (prefs->priv->console, &prefs->priv->can_suspend, NULL);
-		egg_console_kit_can_hibernate (prefs->priv->console, &prefs->priv->can_hibernate, NULL);
+		/* get values from ConsoleKit */
+
+		proxy = g_dbus_proxy_new_for_bus_sync (G_BUS_TYPE_SYSTEM,
+						       G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
+						       NULL,
+						       "org.freedesktop.ConsoleKit",
+						       "/org/freedesktop/ConsoleKit/Manager",
+						       "org.freedesktop.ConsoleKit.Manager",
+						       NULL,
+						       &error );
+		if (proxy == NULL) {
+			g_warning ("Error connecting to ConsoleKit - %s", error->message);
+			g_clear_error (&error);
+		} else {
+			res = g_dbus_proxy_call_sync (proxy, "CanStop",
+						      NULL,
+						      G_DBUS_CALL_FLAGS_NONE,
+						      -1,
+						      NULL,
+						      &error
+						      );
+			if (error == NULL && res != NULL) {
+				g_variant_get(res,"(b)", &prefs->priv->can_shutdown);
+				g_variant_unref (res);
+			} else {
+				/* CanStop is only in newer ConsoleKit, so assume we can */
+				prefs->priv->can_shutdown = TRUE;
+				g_clear_error (&error);
+			}
+
+			prefs->priv->can_suspend = gpm_prefs_console_kit_can (proxy, "CanSuspend");
+			prefs->priv->can_hibernate = gpm_prefs_console_kit_can (proxy, "CanHibernate");
+			g_object_unref(proxy);
+		}
 	}
 
 	if (LOGIND_RUNNING()) {
@@ -826,7 +886,6 @@ gpm_prefs_finalize (GObject *object)
 
 	g_object_unref (prefs->priv->settings);
 	g_object_unref (prefs->priv->client);
-	g_object_unref (prefs->priv->console);
 	g_object_unref (prefs->priv->builder);
 
 	G_OBJECT_CLASS (gpm_prefs_parent_class)->finalize (object);
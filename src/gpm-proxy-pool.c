@@ -0,0 +1,439 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * The system services we talk to, each with one long-lived proxy that is
+ * created asynchronously when the pool is, so that nothing handling a
+ * button or the lid has to wait for a proxy to be constructed. The
+ * proxies follow their name owner, so a restarted service is picked up
+ * without making a new one.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "gpm-proxy-pool.h"
+
+struct GpmProxyPoolPrivate
+{
+	GDBusProxy		*proxies[GPM_PROXY_POOL_LAST];
+	gboolean		 pending[GPM_PROXY_POOL_LAST];
+	GQueue			 waiting[GPM_PROXY_POOL_LAST];
+};
+
+typedef struct {
+	GBusType		 bus_type;
+	GDBusProxyFlags		 flags;
+	const gchar		*name;
+	const gchar		*path;
+	const gchar		*interface;
+} GpmProxyPoolInfo;
+
+static const GpmProxyPoolInfo gpm_proxy_pool_info[] = {
+	{ G_BUS_TYPE_SYSTEM,
+	  G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
+	  "org.freedesktop.login1",
+	  "/org/freedesktop/login1",
+	  "org.freedesktop.login1.Manager" },
+	{ G_BUS_TYPE_SYSTEM,
+	  G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES |
+	  G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS |
+	  G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START,
+	  "org.freedesktop.NetworkManager",
+	  "/org/freedesktop/NetworkManager",
+	  "org.freedesktop.NetworkManager" },
+	{ G_BUS_TYPE_SESSION,
+	  G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
+	  "org.freedesktop.Notifications",
+	  "/org/freedesktop/Notifications",
+	  "org.freedesktop.Notifications" },
+};
+
+typedef struct {
+	GpmProxyPool		*pool;
+	GpmProxyPoolId		 id;
+} GpmProxyPoolRequest;
+
+typedef struct {
+	GpmProxyPoolId		 id;
+	GCancellable		*cancellable;
+	gulong			 cancelled_id;
+} GpmProxyPoolWaiter;
+
+enum {
+	OWNER_CHANGED,
+	LAST_SIGNAL
+};
+
+static guint signals [LAST_SIGNAL] = { 0 };
+static gpointer gpm_proxy_pool_object = NULL;
+
+G_DEFINE_TYPE_WITH_PRIVATE (GpmProxyPool, gpm_proxy_pool, G_TYPE_OBJECT)
+
+/**
+ * gpm_proxy_pool_waiter_free:
+ **/
+static void
+gpm_proxy_pool_waiter_free (GpmProxyPoolWaiter *waiter)
+{
+	if (waiter->cancellable != NULL)
+		g_object_unref (waiter->cancellable);
+	g_free (waiter);
+}
+
+/**
+ * gpm_proxy_pool_waiter_return:
+ *
+ * Takes the queue's reference on @task.
+ **/
+static void
+gpm_proxy_pool_waiter_return (GTask *task, GDBusProxy *proxy, const GError *error)
+{
+	GpmProxyPoolWaiter *waiter = g_task_get_task_data (task);
+
+	if (waiter->cancelled_id != 0) {
+		g_cancellable_disconnect (waiter->cancellable, waiter->cancelled_id);
+		waiter->cancelled_id = 0;
+	}
+	if (proxy != NULL)
+		g_task_return_pointer (task, g_object_ref (proxy), g_object_unref);
+	else
+		g_task_return_error (task, g_error_copy (error));
+	g_object_unref (task);
+}
+
+/**
+ * gpm_proxy_pool_name_owner_cb:
+ **/
+static void
+gpm_proxy_pool_name_owner_cb (GDBusProxy *proxy, GParamSpec *pspec, GpmProxyPool *pool)
+{
+	guint i;
+
+	for (i = 0; i < GPM_PROXY_POOL_LAST; i++) {
+		if (pool->priv->proxies[i] != proxy)
+			continue;
+		g_debug ("%s is now %s", gpm_proxy_pool_info[i].name,
+			 gpm_proxy_pool_has_owner (pool, i) ? "running" : "gone");
+		g_signal_emit (pool, signals [OWNER_CHANGED], 0, i);
+	}
+}
+
+/**
+ * gpm_proxy_pool_set_proxy:
+ **/
+static void
+gpm_proxy_pool_set_proxy (GpmProxyPool *pool, GpmProxyPoolId id, GDBusProxy *proxy)
+{
+	GTask *task;
+
+	pool->priv->proxies[id] = g_object_ref (proxy);
+	g_signal_connect (proxy, "notify::g-name-owner",
+			  G_CALLBACK (gpm_proxy_pool_name_owner_cb), pool);
+
+	while ((task = g_queue_pop_head (&pool->priv->waiting[id])) != NULL)
+		gpm_proxy_pool_waiter_return (task, proxy, NULL);
+
+	/* the owner is known for the first time */
+	g_signal_emit (pool, signals [OWNER_CHANGED], 0, id);
+}
+
+/**
+ * gpm_proxy_pool_created_cb:
+ **/
+static void
+gpm_proxy_pool_created_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GpmProxyPoolRequest *request = (GpmProxyPoolRequest *) user_data;
+	GpmProxyPool *pool = request->pool;
+	GDBusProxy *proxy;
+	GError *error = NULL;
+	GTask *task;
+
+	pool->priv->pending[request->id] = FALSE;
+	proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
+	if (proxy == NULL) {
+		g_warning ("failed to connect to %s: %s",
+			   gpm_proxy_pool_info[request->id].name, error->message);
+		while ((task = g_queue_pop_head (&pool->priv->waiting[request->id])) != NULL)
+			gpm_proxy_pool_waiter_return (task, NULL, error);
+		g_error_free (error);
+		goto out;
+	}
+
+	/* someone could not wait and made one synchronously */
+	if (pool->priv->proxies[request->id] == NULL)
+		gpm_proxy_pool_set_proxy (pool, request->id, proxy);
+	g_object_unref (proxy);
+out:
+	g_object_unref (pool);
+	g_free (request);
+}
+
+/**
+ * gpm_proxy_pool_create:
+ **/
+static void
+gpm_proxy_pool_create (GpmProxyPool *pool, GpmProxyPoolId id)
+{
+	const GpmProxyPoolInfo *info = &gpm_proxy_pool_info[id];
+	GpmProxyPoolRequest *request;
+
+	if (pool->priv->proxies[id] != NULL || pool->priv->pending[id])
+		return;
+
+	request = g_new0 (GpmProxyPoolRequest, 1);
+	request->pool = g_object_ref (pool);
+	request->id = id;
+	pool->priv->pending[id] = TRUE;
+	g_dbus_proxy_new_for_bus (info->bus_type, info->flags, NULL,
+				  info->name, info->path, info->interface,
+				  NULL, gpm_proxy_pool_created_cb, request);
+}
+
+/**
+ * gpm_proxy_pool_get:
+ *
+ * Return value: the proxy, or %NULL if it is not ready yet. The pool
+ * keeps the reference.
+ **/
+GDBusProxy *
+gpm_proxy_pool_get (GpmProxyPool *pool, GpmProxyPoolId id)
+{
+	g_return_val_if_fail (GPM_IS_PROXY_POOL (pool), NULL);
+	g_return_val_if_fail (id < GPM_PROXY_POOL_LAST, NULL);
+	return pool->priv->proxies[id];
+}
+
+/**
+ * gpm_proxy_pool_get_sync:
+ *
+ * Only for paths where blocking does not matter, such as shutting down.
+ *
+ * Return value: the proxy, or %NULL on error. The pool keeps the reference.
+ **/
+GDBusProxy *
+gpm_proxy_pool_get_sync (GpmProxyPool *pool, GpmProxyPoolId id, GError **error)
+{
+	const GpmProxyPoolInfo *info;
+	GDBusProxy *proxy;
+
+	g_return_val_if_fail (GPM_IS_PROXY_POOL (pool), NULL);
+	g_return_val_if_fail (id < GPM_PROXY_POOL_LAST, NULL);
+
+	if (pool->priv->proxies[id] != NULL)
+		return pool->priv->proxies[id];
+
+	info = &gpm_proxy_pool_info[id];
+	proxy = g_dbus_proxy_new_for_bus_sync (info->bus_type, info->flags, NULL,
+					       info->name, info->path, info->interface,
+					       NULL, error);
+	if (proxy == NULL)
+		return NULL;
+	gpm_proxy_pool_set_proxy (pool, id, proxy);
+	g_object_unref (proxy);
+	return pool->priv->proxies[id];
+}
+
+/**
+ * gpm_proxy_pool_cancelled_cb:
+ **/
+static gboolean
+gpm_proxy_pool_cancelled_cb (gpointer user_data)
+{
+	GTask *task = G_TASK (user_data);
+	GpmProxyPool *pool = g_task_get_source_object (task);
+	GpmProxyPoolWaiter *waiter = g_task_get_task_data (task);
+	GList *link;
+
+	/* already returned */
+	link = g_queue_find (&pool->priv->waiting[waiter->id], task);
+	if (link == NULL)
+		return FALSE;
+	g_queue_delete_link (&pool->priv->waiting[waiter->id], link);
+
+	/* we may still be in the signal handler, so cannot disconnect */
+	waiter->cancelled_id = 0;
+	g_task_return_error_if_cancelled (task);
+	g_object_unref (task);
+	return FALSE;
+}
+
+/**
+ * gpm_proxy_pool_cancelled_handler:
+ *
+ * May be called in any thread, so remove the waiter in the task context.
+ **/
+static void
+gpm_proxy_pool_cancelled_handler (GCancellable *cancellable, GTask *task)
+{
+	g_main_context_invoke_full (g_task_get_context (task), G_PRIORITY_DEFAULT,
+				    gpm_proxy_pool_cancelled_cb,
+				    g_object_ref (task), g_object_unref);
+}
+
+/**
+ * gpm_proxy_pool_get_async:
+ *
+ * Completes straight away if the proxy is ready, otherwise when it is.
+ **/
+void
+gpm_proxy_pool_get_async (GpmProxyPool *pool, GpmProxyPoolId id, GCancellable *cancellable,
+			  GAsyncReadyCallback callback, gpointer user_data)
+{
+	GpmProxyPoolWaiter *waiter;
+	GTask *task;
+
+	g_return_if_fail (GPM_IS_PROXY_POOL (pool));
+	g_return_if_fail (id < GPM_PROXY_POOL_LAST);
+
+	task = g_task_new (pool, cancellable, callback, user_data);
+	if (pool->priv->proxies[id] != NULL) {
+		g_task_return_pointer (task, g_object_ref (pool->priv->proxies[id]), g_object_unref);
+		g_object_unref (task);
+		return;
+	}
+
+	waiter = g_new0 (GpmProxyPoolWaiter, 1);
+	waiter->id = id;
+	g_task_set_task_data (task, waiter, (GDestroyNotify) gpm_proxy_pool_waiter_free);
+
+	/* the queue owns the reference */
+	g_queue_push_tail (&pool->priv->waiting[id], task);
+	if (cancellable != NULL) {
+		waiter->cancellable = g_object_ref (cancellable);
+		waiter->cancelled_id = g_cancellable_connect (cancellable,
+							      G_CALLBACK (gpm_proxy_pool_cancelled_handler),
+							      task, NULL);
+	}
+	gpm_proxy_pool_create (pool, id);
+}
+
+/**
+ * gpm_proxy_pool_get_finish:
+ *
+ * Return value: (transfer full): the proxy, or %NULL on error
+ **/
+GDBusProxy *
+gpm_proxy_pool_get_finish (GpmProxyPool *pool, GAsyncResult *res, GError **error)
+{
+	g_return_val_if_fail (g_task_is_valid (res, pool), NULL);
+	return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+/**
+ * gpm_proxy_pool_has_owner:
+ *
+ * Return value: %TRUE if the service is ready and running.
+ **/
+gboolean
+gpm_proxy_pool_has_owner (GpmProxyPool *pool, GpmProxyPoolId id)
+{
+	gchar *owner;
+
+	g_return_val_if_fail (GPM_IS_PROXY_POOL (pool), FALSE);
+	g_return_val_if_fail (id < GPM_PROXY_POOL_LAST, FALSE);
+
+	if (pool->priv->proxies[id] == NULL)
+		return FALSE;
+	owner = g_dbus_proxy_get_name_owner (pool->priv->proxies[id]);
+	g_free (owner);
+	return owner != NULL;
+}
+
+/**
+ * gpm_proxy_pool_finalize:
+ **/
+static void
+gpm_proxy_pool_finalize (GObject *object)
+{
+	GpmProxyPool *pool;
+	guint i;
+
+	g_return_if_fail (object != NULL);
+	g_return_if_fail (GPM_IS_PROXY_POOL (object));
+	pool = GPM_PROXY_POOL (object);
+
+	/* waiters and pending requests hold a reference */
+	for (i = 0; i < GPM_PROXY_POOL_LAST; i++) {
+		if (pool->priv->proxies[i] == NULL)
+			continue;
+		g_signal_handlers_disconnect_by_data (pool->priv->proxies[i], pool);
+		g_object_unref (pool->priv->proxies[i]);
+	}
+
+	G_OBJECT_CLASS (gpm_proxy_pool_parent_class)->finalize (object);
+}
+
+/**
+ * gpm_proxy_pool_class_init:
+ **/
+static void
+gpm_proxy_pool_class_init (GpmProxyPoolClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = gpm_proxy_pool_finalize;
+
+	signals [OWNER_CHANGED] =
+		g_signal_new ("owner-changed",
+			      G_TYPE_FROM_CLASS (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (GpmProxyPoolClass, owner_changed),
+			      NULL,
+			      NULL,
+			      g_cclosure_marshal_VOID__UINT,
+			      G_TYPE_NONE, 1, G_TYPE_UINT);
+}
+
+/**
+ * gpm_proxy_pool_init:
+ **/
+static void
+gpm_proxy_pool_init (GpmProxyPool *pool)
+{
+	guint i;
+
+	pool->priv = gpm_proxy_pool_get_instance_private (pool);
+	for (i = 0; i < GPM_PROXY_POOL_LAST; i++)
+		g_queue_init (&pool->priv->waiting[i]);
+
+	/* don't wait for anyone to ask */
+	for (i = 0; i < GPM_PROXY_POOL_LAST; i++)
+		gpm_proxy_pool_create (pool, i);
+}
+
+/**
+ * gpm_proxy_pool_new:
+ * Return value: A new proxy pool class instance.
+ **/
+GpmProxyPool *
+gpm_proxy_pool_new (void)
+{
+	if (gpm_proxy_pool_object != NULL) {
+		g_object_ref (gpm_proxy_pool_object);
+	} else {
+		gpm_proxy_pool_object = g_object_new (GPM_TYPE_PROXY_POOL, NULL);
+		g_object_add_weak_pointer (gpm_proxy_pool_object, &gpm_proxy_pool_object);
+	}
+	return GPM_PROXY_POOL (gpm_proxy_pool_object);
+}
@@ -0,0 +1,80 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __GPM_PROXY_POOL_H
+#define __GPM_PROXY_POOL_H
+
+#include <glib-object.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define GPM_TYPE_PROXY_POOL		(gpm_proxy_pool_get_type ())
+#define GPM_PROXY_POOL(o)		(G_TYPE_CHECK_INSTANCE_CAST ((o), GPM_TYPE_PROXY_POOL, GpmProxyPool))
+#define GPM_PROXY_POOL_CLASS(k)		(G_TYPE_CHECK_CLASS_CAST((k), GPM_TYPE_PROXY_POOL, GpmProxyPoolClass))
+#define GPM_IS_PROXY_POOL(o)		(G_TYPE_CHECK_INSTANCE_TYPE ((o), GPM_TYPE_PROXY_POOL))
+#define GPM_IS_PROXY_POOL_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), GPM_TYPE_PROXY_POOL))
+#define GPM_PROXY_POOL_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), GPM_TYPE_PROXY_POOL, GpmProxyPoolClass))
+
+typedef struct GpmProxyPoolPrivate GpmProxyPoolPrivate;
+
+typedef struct
+{
+	GObject			 parent;
+	GpmProxyPoolPrivate	*priv;
+} GpmProxyPool;
+
+typedef struct
+{
+	GObjectClass	parent_class;
+	void		(* owner_changed)		(GpmProxyPool	*pool,
+							 guint		 id);
+} GpmProxyPoolClass;
+
+typedef enum {
+	GPM_PROXY_POOL_LOGIND,
+	GPM_PROXY_POOL_NETWORKMANAGER,
+	GPM_PROXY_POOL_NOTIFICATIONS,
+	GPM_PROXY_POOL_LAST
+} GpmProxyPoolId;
+
+GType		 gpm_proxy_pool_get_type		(void);
+GpmProxyPool	*gpm_proxy_pool_new			(void);
+
+GDBusProxy	*gpm_proxy_pool_get			(GpmProxyPool	*pool,
+							 GpmProxyPoolId	 id);
+GDBusProxy	*gpm_proxy_pool_get_sync		(GpmProxyPool	*pool,
+							 GpmProxyPoolId	 id,
+							 GError		**error);
+void		 gpm_proxy_pool_get_async		(GpmProxyPool	*pool,
+							 GpmProxyPoolId	 id,
+							 GCancellable	*cancellable,
+							 GAsyncReadyCallback callback,
+							 gpointer	 user_data);
+GDBusProxy	*gpm_proxy_pool_get_finish		(GpmProxyPool	*pool,
+							 GAsyncResult	*res,
+							 GError		**error);
+gboolean	 gpm_proxy_pool_has_owner		(GpmProxyPool	*pool,
+							 GpmProxyPoolId	 id);
+
+G_END_DECLS
+
+#endif /* __GPM_PROXY_POOL_H */
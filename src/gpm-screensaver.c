@@ -25,7 +25,7 @@
 #include <string.h>
 #include <glib.h>
 #include <glib/gi18n.h>
-#include <dbus/dbus-glib.h>
+#include <gio/gio.h>
 
 #include "gpm-screensaver.h"
 #include "gpm-common.h"
@@ -36,11 +36,35 @@ static void     gpm_screensaver_finalize   (GObject		*object);
 #define GS_LISTENER_PATH	"/"
 #define GS_LISTENER_INTERFACE	"org.mate.ScreenSaver"
 
+#define GPM_SCREENSAVER_LOCK_TIMEOUT	5 /* seconds */
+
 struct GpmScreensaverPrivate
 {
-	DBusGProxy		*proxy;
+	GDBusConnection		*connection;
+	GCancellable		*cancellable;
+	guint			 watch_id;
+	guint			 active_id;
+	gboolean		 running;
+	gboolean		 active;
+	GHashTable		*throttles;
+	guint32			 next_cookie;
 };
 
+/* the daemon assigns its own cookies, but we hand ours out straight away */
+typedef struct {
+	guint32			 remote;
+	gboolean		 removed;
+} GpmScreensaverThrottle;
+
+typedef struct {
+	GDBusConnection		*connection;
+	guint			 subscription_id;
+	GSource			*timeout;
+	GCancellable		*cancellable;
+	gulong			 cancelled_id;
+	gboolean		 returned;
+} GpmScreensaverLock;
+
 static gpointer gpm_screensaver_object = NULL;
 
 G_DEFINE_TYPE_WITH_PRIVATE (GpmScreensaver, gpm_screensaver, G_TYPE_OBJECT)
@@ -48,82 +72,355 @@ G_DEFINE_TYPE_WITH_PRIVATE (GpmScreensaver, gpm_screensaver, G_TYPE_OBJECT)
 /**
  * gpm_screensaver_lock
  * @screensaver: This class instance
+ *
+ * Asks mate-screensaver to lock, without waiting for it to do so.
+ *
  * Return value: Success value
  **/
 gboolean
 gpm_screensaver_lock (GpmScreensaver *screensaver)
 {
-	guint sleepcount = 0;
-
 	g_return_val_if_fail (GPM_IS_SCREENSAVER (screensaver), FALSE);
 
-	if (screensaver->priv->proxy == NULL) {
+	if (screensaver->priv->connection == NULL) {
 		g_warning ("not connected");
 		return FALSE;
 	}
 
 	g_debug ("doing mate-screensaver lock");
-	dbus_g_proxy_call_no_reply (screensaver->priv->proxy,
-				    "Lock", G_TYPE_INVALID);
-
-	/* When we send the Lock signal to g-ss it takes maybe a second
-	   or so to fade the screen and lock. If we suspend mid fade then on
-	   resume the X display is still present for a split second
-	   (since fade is gamma) and as such it can leak information.
-	   Instead we wait until g-ss reports running and thus blanked
-	   solidly before we continue from the screensaver_lock action.
-	   The interior of g-ss is async, so we cannot get the dbus method
-	   to block until lock is complete. */
-	while (! gpm_screensaver_check_running (screensaver)) {
-		/* Sleep for 1/10s */
-		g_usleep (1000 * 100);
-		if (sleepcount++ > 50) {
-			g_debug ("timeout waiting for mate-screensaver");
-			break;
+	g_dbus_connection_call (screensaver->priv->connection,
+				GS_LISTENER_SERVICE, GS_LISTENER_PATH, GS_LISTENER_INTERFACE,
+				"Lock", NULL, NULL,
+				G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+	return TRUE;
+}
+
+/**
+ * gpm_screensaver_lock_free:
+ **/
+static void
+gpm_screensaver_lock_free (GpmScreensaverLock *lock)
+{
+	if (lock->cancelled_id != 0)
+		g_cancellable_disconnect (lock->cancellable, lock->cancelled_id);
+	if (lock->cancellable != NULL)
+		g_object_unref (lock->cancellable);
+	g_object_unref (lock->connection);
+	g_free (lock);
+}
+
+/**
+ * gpm_screensaver_lock_return:
+ *
+ * Completes the lock, whichever of the signal, the reply or the timeout
+ * gets here first.
+ **/
+static void
+gpm_screensaver_lock_return (GTask *task)
+{
+	GpmScreensaverLock *lock = g_task_get_task_data (task);
+
+	if (lock->returned)
+		return;
+	lock->returned = TRUE;
+
+	if (lock->subscription_id != 0) {
+		g_dbus_connection_signal_unsubscribe (lock->connection, lock->subscription_id);
+		lock->subscription_id = 0;
+	}
+	if (lock->timeout != NULL) {
+		g_source_destroy (lock->timeout);
+		g_source_unref (lock->timeout);
+		lock->timeout = NULL;
+	}
+	if (g_task_return_error_if_cancelled (task))
+		return;
+	g_task_return_boolean (task, TRUE);
+}
+
+/**
+ * gpm_screensaver_lock_active_changed_cb:
+ **/
+static void
+gpm_screensaver_lock_active_changed_cb (GDBusConnection *connection, const gchar *sender_name,
+					const gchar *object_path, const gchar *interface_name,
+					const gchar *signal_name, GVariant *parameters, gpointer user_data)
+{
+	GTask *task = G_TASK (user_data);
+	gboolean active;
+
+	g_variant_get (parameters, "(b)", &active);
+	g_debug ("mate-screensaver is now %s", active ? "active" : "inactive");
+	if (active)
+		gpm_screensaver_lock_return (task);
+}
+
+/**
+ * gpm_screensaver_lock_get_active_cb:
+ **/
+static void
+gpm_screensaver_lock_get_active_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GTask *task = G_TASK (user_data);
+	GVariant *result;
+	GError *error = NULL;
+	gboolean active;
+
+	/* already locked, so there will be no signal */
+	result = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), res, &error);
+	if (result == NULL) {
+		g_debug ("ERROR: %s", error->message);
+		g_error_free (error);
+	} else {
+		g_variant_get (result, "(b)", &active);
+		if (active)
+			gpm_screensaver_lock_return (task);
+		g_variant_unref (result);
+	}
+	g_object_unref (task);
+}
+
+/**
+ * gpm_screensaver_lock_cb:
+ **/
+static void
+gpm_screensaver_lock_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GTask *task = G_TASK (user_data);
+	GpmScreensaverLock *lock = g_task_get_task_data (task);
+	GVariant *result;
+	GError *error = NULL;
+
+	result = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), res, &error);
+	if (result == NULL) {
+		if (!lock->returned) {
+			lock->returned = TRUE;
+			g_dbus_connection_signal_unsubscribe (lock->connection, lock->subscription_id);
+			lock->subscription_id = 0;
+			g_source_destroy (lock->timeout);
+			g_source_unref (lock->timeout);
+			lock->timeout = NULL;
+			g_task_return_error (task, error);
+		} else {
+			g_error_free (error);
 		}
+		g_object_unref (task);
+		return;
 	}
+	g_variant_unref (result);
+
+	if (!lock->returned) {
+		g_dbus_connection_call (lock->connection,
+					GS_LISTENER_SERVICE, GS_LISTENER_PATH, GS_LISTENER_INTERFACE,
+					"GetActive", NULL, G_VARIANT_TYPE ("(b)"),
+					G_DBUS_CALL_FLAGS_NONE, -1, lock->cancellable,
+					gpm_screensaver_lock_get_active_cb, g_object_ref (task));
+	}
+	g_object_unref (task);
+}
 
-	return TRUE;
+/**
+ * gpm_screensaver_lock_timeout_cb:
+ **/
+static gboolean
+gpm_screensaver_lock_timeout_cb (gpointer user_data)
+{
+	g_debug ("timeout waiting for mate-screensaver");
+	gpm_screensaver_lock_return (G_TASK (user_data));
+	return FALSE;
+}
+
+/**
+ * gpm_screensaver_lock_cancelled_cb:
+ **/
+static gboolean
+gpm_screensaver_lock_cancelled_cb (gpointer user_data)
+{
+	GTask *task = G_TASK (user_data);
+	GpmScreensaverLock *lock = g_task_get_task_data (task);
+
+	/* we may still be in the signal handler, so cannot disconnect */
+	lock->cancelled_id = 0;
+	gpm_screensaver_lock_return (task);
+	return FALSE;
+}
+
+/**
+ * gpm_screensaver_lock_cancelled_handler:
+ *
+ * May be called in any thread, so complete in the task context.
+ **/
+static void
+gpm_screensaver_lock_cancelled_handler (GCancellable *cancellable, GTask *task)
+{
+	g_main_context_invoke_full (g_task_get_context (task), G_PRIORITY_DEFAULT,
+				    gpm_screensaver_lock_cancelled_cb,
+				    g_object_ref (task), g_object_unref);
+}
+
+/**
+ * gpm_screensaver_lock_async:
+ *
+ * When we send the Lock signal to g-ss it takes maybe a second or so to
+ * fade the screen and lock. If we suspend mid fade then on resume the X
+ * display is still present for a split second (since fade is gamma) and as
+ * such it can leak information. Instead we complete when g-ss reports
+ * being active, and thus blanked solidly, or after a timeout. Nothing
+ * blocks meanwhile.
+ **/
+void
+gpm_screensaver_lock_async (GpmScreensaver *screensaver, GCancellable *cancellable,
+			    GAsyncReadyCallback callback, gpointer user_data)
+{
+	GpmScreensaverLock *lock;
+	GTask *task;
+
+	g_return_if_fail (GPM_IS_SCREENSAVER (screensaver));
+
+	task = g_task_new (screensaver, cancellable, callback, user_data);
+	if (screensaver->priv->connection == NULL) {
+		g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED, "not connected");
+		g_object_unref (task);
+		return;
+	}
+
+	lock = g_new0 (GpmScreensaverLock, 1);
+	lock->connection = g_object_ref (screensaver->priv->connection);
+	if (cancellable != NULL)
+		lock->cancellable = g_object_ref (cancellable);
+	g_task_set_task_data (task, lock, (GDestroyNotify) gpm_screensaver_lock_free);
+
+	/* listen before asking, so the change cannot be missed */
+	lock->subscription_id =
+		g_dbus_connection_signal_subscribe (lock->connection, GS_LISTENER_SERVICE,
+						    GS_LISTENER_INTERFACE, "ActiveChanged",
+						    GS_LISTENER_PATH, NULL, G_DBUS_SIGNAL_FLAGS_NONE,
+						    gpm_screensaver_lock_active_changed_cb,
+						    g_object_ref (task), g_object_unref);
+	lock->timeout = g_timeout_source_new_seconds (GPM_SCREENSAVER_LOCK_TIMEOUT);
+	g_source_set_callback (lock->timeout, gpm_screensaver_lock_timeout_cb,
+			       g_object_ref (task), g_object_unref);
+	g_source_set_name (lock->timeout, "[GpmScreensaver] lock-timeout");
+	g_source_attach (lock->timeout, g_task_get_context (task));
+
+	g_debug ("doing mate-screensaver lock");
+	g_dbus_connection_call (lock->connection,
+				GS_LISTENER_SERVICE, GS_LISTENER_PATH, GS_LISTENER_INTERFACE,
+				"Lock", NULL, NULL,
+				G_DBUS_CALL_FLAGS_NONE, -1, cancellable,
+				gpm_screensaver_lock_cb, g_object_ref (task));
+
+	if (cancellable != NULL)
+		lock->cancelled_id = g_cancellable_connect (cancellable,
+							    G_CALLBACK (gpm_screensaver_lock_cancelled_handler),
+							    task, NULL);
+	g_object_unref (task);
+}
+
+/**
+ * gpm_screensaver_lock_finish:
+ **/
+gboolean
+gpm_screensaver_lock_finish (GpmScreensaver *screensaver, GAsyncResult *res, GError **error)
+{
+	g_return_val_if_fail (g_task_is_valid (res, screensaver), FALSE);
+	return g_task_propagate_boolean (G_TASK (res), error);
+}
+
+/**
+ * gpm_screensaver_unthrottle:
+ **/
+static void
+gpm_screensaver_unthrottle (GpmScreensaver *screensaver, guint32 remote)
+{
+	g_debug ("removing remote throttle: id %u", remote);
+	g_dbus_connection_call (screensaver->priv->connection,
+				GS_LISTENER_SERVICE, GS_LISTENER_PATH, GS_LISTENER_INTERFACE,
+				"UnThrottle", g_variant_new ("(u)", remote), NULL,
+				G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+}
+
+/**
+ * gpm_screensaver_throttle_cb:
+ **/
+static void
+gpm_screensaver_throttle_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GpmScreensaver *screensaver;
+	GpmScreensaverThrottle *throttle;
+	guint32 cookie = GPOINTER_TO_UINT (user_data);
+	GVariant *result;
+	GError *error = NULL;
+
+	result = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), res, &error);
+	if (result == NULL && g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		g_error_free (error);
+		return;
+	}
+
+	/* we outlive the call unless finalized, which cancels it */
+	screensaver = GPM_SCREENSAVER (gpm_screensaver_object);
+	throttle = g_hash_table_lookup (screensaver->priv->throttles, GUINT_TO_POINTER (cookie));
+	if (result == NULL) {
+		g_warning ("Throttle failed: %s", error->message);
+		g_error_free (error);
+		g_hash_table_remove (screensaver->priv->throttles, GUINT_TO_POINTER (cookie));
+		return;
+	}
+
+	/* the daemon went away while we were waiting */
+	if (throttle == NULL) {
+		g_variant_unref (result);
+		return;
+	}
+	g_variant_get (result, "(u)", &throttle->remote);
+	g_variant_unref (result);
+	g_debug ("throttle id %u is remote id %u", cookie, throttle->remote);
+
+	/* removed before the daemon told us what to remove */
+	if (throttle->removed) {
+		gpm_screensaver_unthrottle (screensaver, throttle->remote);
+		g_hash_table_remove (screensaver->priv->throttles, GUINT_TO_POINTER (cookie));
+	}
 }
 
 /**
  * gpm_screensaver_add_throttle:
  * @screensaver: This class instance
  * @reason:      The reason for throttling
+ *
+ * Asks mate-screensaver to throttle without waiting for the reply.
+ *
  * Return value: Success value, or zero for failure
  **/
 guint
 gpm_screensaver_add_throttle (GpmScreensaver *screensaver,
 			      const char     *reason)
 {
-	GError  *error = NULL;
-	gboolean ret;
+	GpmScreensaverThrottle *throttle;
 	guint32  cookie;
 
 	g_return_val_if_fail (GPM_IS_SCREENSAVER (screensaver), 0);
 	g_return_val_if_fail (reason != NULL, 0);
 
-	if (screensaver->priv->proxy == NULL) {
+	if (screensaver->priv->connection == NULL) {
 		g_warning ("not connected");
 		return 0;
 	}
 
-	ret = dbus_g_proxy_call (screensaver->priv->proxy,
-				 "Throttle", &error,
-				 G_TYPE_STRING, "Power screensaver",
-				 G_TYPE_STRING, reason,
-				 G_TYPE_INVALID,
-				 G_TYPE_UINT, &cookie,
-				 G_TYPE_INVALID);
-	if (error) {
-		g_debug ("ERROR: %s", error->message);
-		g_error_free (error);
-	}
-	if (!ret) {
-		/* abort as the DBUS method failed */
-		g_warning ("Throttle failed!");
-		return 0;
-	}
+	/* zero is reserved for failure */
+	cookie = ++screensaver->priv->next_cookie;
+	if (cookie == 0)
+		cookie = ++screensaver->priv->next_cookie;
+	throttle = g_new0 (GpmScreensaverThrottle, 1);
+	g_hash_table_insert (screensaver->priv->throttles, GUINT_TO_POINTER (cookie), throttle);
+
+	g_dbus_connection_call (screensaver->priv->connection,
+				GS_LISTENER_SERVICE, GS_LISTENER_PATH, GS_LISTENER_INTERFACE,
+				"Throttle", g_variant_new ("(ss)", "Power screensaver", reason),
+				G_VARIANT_TYPE ("(u)"),
+				G_DBUS_CALL_FLAGS_NONE, -1, screensaver->priv->cancellable,
+				gpm_screensaver_throttle_cb, GUINT_TO_POINTER (cookie));
 
 	g_debug ("adding throttle reason: '%s': id %u", reason, cookie);
 	return cookie;
@@ -135,65 +432,40 @@ gpm_screensaver_add_throttle (GpmScreensaver *screensaver,
 gboolean
 gpm_screensaver_remove_throttle (GpmScreensaver *screensaver, guint cookie)
 {
-	gboolean ret;
-	GError *error = NULL;
+	GpmScreensaverThrottle *throttle;
 
 	g_return_val_if_fail (GPM_IS_SCREENSAVER (screensaver), FALSE);
 
-	if (screensaver->priv->proxy == NULL) {
-		g_warning ("not connected");
+	throttle = g_hash_table_lookup (screensaver->priv->throttles, GUINT_TO_POINTER (cookie));
+	if (throttle == NULL) {
+		g_debug ("no throttle with id %u", cookie);
 		return FALSE;
 	}
 
 	g_debug ("removing throttle: id %u", cookie);
-	ret = dbus_g_proxy_call (screensaver->priv->proxy,
-				 "UnThrottle", &error,
-				 G_TYPE_UINT, cookie,
-				 G_TYPE_INVALID,
-				 G_TYPE_INVALID);
-	if (error) {
-		g_debug ("ERROR: %s", error->message);
-		g_error_free (error);
-	}
-	if (!ret) {
-		/* abort as the DBUS method failed */
-		g_warning ("UnThrottle failed!");
-		return FALSE;
+	if (throttle->remote == 0) {
+		/* still in flight, so remove when the reply arrives */
+		throttle->removed = TRUE;
+		return TRUE;
 	}
-
+	gpm_screensaver_unthrottle (screensaver, throttle->remote);
+	g_hash_table_remove (screensaver->priv->throttles, GUINT_TO_POINTER (cookie));
 	return TRUE;
 }
 
 /**
  * gpm_screensaver_check_running:
  * @screensaver: This class instance
- * Return value: TRUE if mate-screensaver is running
+ *
+ * Only reads the state we track from the bus, so never blocks.
+ *
+ * Return value: TRUE if mate-screensaver is running and active
  **/
 gboolean
 gpm_screensaver_check_running (GpmScreensaver *screensaver)
 {
-	gboolean ret;
-	gboolean temp = TRUE;
-	GError *error = NULL;
-
 	g_return_val_if_fail (GPM_IS_SCREENSAVER (screensaver), FALSE);
-
-	if (screensaver->priv->proxy == NULL) {
-		g_warning ("not connected");
-		return FALSE;
-	}
-
-	ret = dbus_g_proxy_call (screensaver->priv->proxy,
-				 "GetActive", &error,
-				 G_TYPE_INVALID,
-				 G_TYPE_BOOLEAN, &temp,
-				 G_TYPE_INVALID);
-	if (error) {
-		g_debug ("ERROR: %s", error->message);
-		g_error_free (error);
-	}
-
-	return ret;
+	return screensaver->priv->running && screensaver->priv->active;
 }
 
 /**
@@ -209,18 +481,91 @@ gpm_screensaver_poke (GpmScreensaver *screensaver)
 {
 	g_return_val_if_fail (GPM_IS_SCREENSAVER (screensaver), FALSE);
 
-	if (screensaver->priv->proxy == NULL) {
+	if (screensaver->priv->connection == NULL) {
 		g_warning ("not connected");
 		return FALSE;
 	}
 
 	g_debug ("poke");
-	dbus_g_proxy_call_no_reply (screensaver->priv->proxy,
-				    "SimulateUserActivity",
-				    G_TYPE_INVALID);
+	g_dbus_connection_call (screensaver->priv->connection,
+				GS_LISTENER_SERVICE, GS_LISTENER_PATH, GS_LISTENER_INTERFACE,
+				"SimulateUserActivity", NULL, NULL,
+				G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
 	return TRUE;
 }
 
+/**
+ * gpm_screensaver_active_changed_cb:
+ **/
+static void
+gpm_screensaver_active_changed_cb (GDBusConnection *connection, const gchar *sender_name,
+				   const gchar *object_path, const gchar *interface_name,
+				   const gchar *signal_name, GVariant *parameters, gpointer user_data)
+{
+	GpmScreensaver *screensaver = GPM_SCREENSAVER (user_data);
+
+	if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(b)")))
+		return;
+	g_variant_get (parameters, "(b)", &screensaver->priv->active);
+}
+
+/**
+ * gpm_screensaver_get_active_cb:
+ **/
+static void
+gpm_screensaver_get_active_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GpmScreensaver *screensaver;
+	GVariant *result;
+	GError *error = NULL;
+
+	result = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), res, &error);
+	if (result == NULL) {
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			g_debug ("ERROR: %s", error->message);
+		g_error_free (error);
+		return;
+	}
+	screensaver = GPM_SCREENSAVER (user_data);
+	g_variant_get (result, "(b)", &screensaver->priv->active);
+	g_variant_unref (result);
+}
+
+/**
+ * gpm_screensaver_name_appeared_cb:
+ **/
+static void
+gpm_screensaver_name_appeared_cb (GDBusConnection *connection, const gchar *name,
+				  const gchar *name_owner, gpointer user_data)
+{
+	GpmScreensaver *screensaver = GPM_SCREENSAVER (user_data);
+
+	g_debug ("mate-screensaver appeared as %s", name_owner);
+	screensaver->priv->running = TRUE;
+	g_dbus_connection_call (connection,
+				GS_LISTENER_SERVICE, GS_LISTENER_PATH, GS_LISTENER_INTERFACE,
+				"GetActive", NULL, G_VARIANT_TYPE ("(b)"),
+				G_DBUS_CALL_FLAGS_NONE, -1, screensaver->priv->cancellable,
+				gpm_screensaver_get_active_cb, screensaver);
+}
+
+/**
+ * gpm_screensaver_name_vanished_cb:
+ **/
+static void
+gpm_screensaver_name_vanished_cb (GDBusConnection *connection, const gchar *name,
+				  gpointer user_data)
+{
+	GpmScreensaver *screensaver = GPM_SCREENSAVER (user_data);
+
+	g_debug ("mate-screensaver is not running");
+	screensaver->priv->running = FALSE;
+	screensaver->priv->active = FALSE;
+
+	/* the daemon forgot our throttles with its connection */
+	g_hash_table_remove_all (screensaver->priv->throttles);
+}
+
 /**
  * gpm_screensaver_class_init:
  * @klass: This class instance
@@ -239,15 +584,35 @@ gpm_screensaver_class_init (GpmScreensaverClass *klass)
 static void
 gpm_screensaver_init (GpmScreensaver *screensaver)
 {
-	DBusGConnection *connection;
+	GError *error = NULL;
 
 	screensaver->priv = gpm_screensaver_get_instance_private (screensaver);
+	screensaver->priv->throttles = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+							      NULL, g_free);
+	screensaver->priv->cancellable = g_cancellable_new ();
+
+	screensaver->priv->connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, &error);
+	if (screensaver->priv->connection == NULL) {
+		g_warning ("Cannot connect to session bus: %s", error->message);
+		g_error_free (error);
+		return;
+	}
 
-	connection = dbus_g_bus_get (DBUS_BUS_SESSION, NULL);
-	screensaver->priv->proxy = dbus_g_proxy_new_for_name (connection,
-							      GS_LISTENER_SERVICE,
-							      GS_LISTENER_PATH,
-							      GS_LISTENER_INTERFACE);
+	/* track the state so that nothing has to ask for it */
+	screensaver->priv->active_id =
+		g_dbus_connection_signal_subscribe (screensaver->priv->connection,
+						    GS_LISTENER_SERVICE, GS_LISTENER_INTERFACE,
+						    "ActiveChanged", GS_LISTENER_PATH, NULL,
+						    G_DBUS_SIGNAL_FLAGS_NONE,
+						    gpm_screensaver_active_changed_cb,
+						    screensaver, NULL);
+	screensaver->priv->watch_id =
+		g_bus_watch_name_on_connection (screensaver->priv->connection,
+						GS_LISTENER_SERVICE,
+						G_BUS_NAME_WATCHER_FLAGS_NONE,
+						gpm_screensaver_name_appeared_cb,
+						gpm_screensaver_name_vanished_cb,
+						screensaver, NULL);
 }
 
 /**
@@ -264,7 +629,16 @@ gpm_screensaver_finalize (GObject *object)
 	screensaver = GPM_SCREENSAVER (object);
 	screensaver->priv = gpm_screensaver_get_instance_private (screensaver);
 
-	g_object_unref (screensaver->priv->proxy);
+	g_cancellable_cancel (screensaver->priv->cancellable);
+	g_object_unref (screensaver->priv->cancellable);
+	if (screensaver->priv->watch_id != 0)
+		g_bus_unwatch_name (screensaver->priv->watch_id);
+	if (screensaver->priv->active_id != 0)
+		g_dbus_connection_signal_unsubscribe (screensaver->priv->connection,
+						      screensaver->priv->active_id);
+	g_hash_table_unref (screensaver->priv->throttles);
+	if (screensaver->priv->connection != NULL)
+		g_object_unref (screensaver->priv->connection);
 
 	G_OBJECT_CLASS (gpm_screensaver_parent_class)->finalize (object);
 }
@@ -24,6 +24,7 @@
 #define __GPMSCREENSAVER_H
 
 #include <glib-object.h>
+#include <gio/gio.h>
 
 G_BEGIN_DECLS
 
@@ -52,6 +53,13 @@ GpmScreensaver	*gpm_screensaver_new			(void);
 void		 gpm_screensaver_test			(gpointer	 data);
 
 gboolean	 gpm_screensaver_lock			(GpmScreensaver	*screensaver);
+void		 gpm_screensaver_lock_async		(GpmScreensaver	*screensaver,
+							 GCancellable	*cancellable,
+							 GAsyncReadyCallback callback,
+							 gpointer	 user_data);
+gboolean	 gpm_screensaver_lock_finish		(GpmScreensaver	*screensaver,
+							 GAsyncResult	*res,
+							 GError		**error);
 guint32 	 gpm_screensaver_add_throttle    	(GpmScreensaver	*screensaver,
 							 const gchar	*reason);
 gboolean 	 gpm_screensaver_remove_throttle    	(GpmScreensaver	*screensaver,
@@ -38,8 +38,15 @@ void egg_idletime_test (EggTest *test);
 
 void gpm_common_test (EggTest *test);
 void gpm_idle_test (EggTest *test);
+void gpm_dim_model_test (EggTest *test);
+void gpm_ambient_test (EggTest *test);
 void gpm_phone_test (EggTest *test);
+void gpm_trace_test (EggTest *test);
+void gpm_watchdog_test (EggTest *test);
+void gpm_startup_test (EggTest *test);
+void gpm_timer_test (EggTest *test);
 void gpm_dpms_test (EggTest *test);
+void gpm_display_test (EggTest *test);
 void gpm_graph_widget_test (EggTest *test);
 void gpm_proxy_test (EggTest *test);
 void gpm_hal_manager_test (EggTest *test);
@@ -61,11 +68,18 @@ main (int argc, char **argv)
 	egg_discrete_test (test);
 	egg_color_test (test);
 	egg_array_float_test (test);
-//	egg_idletime_test (test);
+	egg_idletime_test (test);
 
 	gpm_common_test (test);
-//	gpm_idle_test (test);
+	gpm_idle_test (test);
+	gpm_dim_model_test (test);
+	gpm_ambient_test (test);
 	gpm_phone_test (test);
+	gpm_trace_test (test);
+	gpm_watchdog_test (test);
+	gpm_startup_test (test);
+	gpm_timer_test (test);
+	gpm_display_test (test);
 //	gpm_dpms_test (test);
 //	gpm_graph_widget_test (test);
 //	gpm_screensaver_test (test);
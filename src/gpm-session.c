@@ -25,7 +25,7 @@
 #include <string.h>
 #include <glib.h>
 #include <glib/gi18n.h>
-#include <dbus/dbus-glib.h>
+#include <gio/gio.h>
 
 #include "gpm-session.h"
 #include "gpm-common.h"
@@ -39,7 +39,7 @@ static void     gpm_session_finalize   (GObject		*object);
 #define GPM_SESSION_MANAGER_PRESENCE_PATH		"/org/gnome/SessionManager/Presence"
 #define GPM_SESSION_MANAGER_PRESENCE_INTERFACE		"org.gnome.SessionManager.Presence"
 #define GPM_SESSION_MANAGER_CLIENT_PRIVATE_INTERFACE	"org.gnome.SessionManager.ClientPrivate"
-#define GPM_DBUS_PROPERTIES_INTERFACE			"org.freedesktop.DBus.Properties"
+#define GPM_SESSION_MANAGER_INHIBITOR_INTERFACE		"org.gnome.SessionManager.Inhibitor"
 
 typedef enum {
 	GPM_SESSION_STATUS_ENUM_AVAILABLE = 0,
@@ -56,17 +56,31 @@ typedef enum {
 	GPM_SESSION_INHIBIT_MASK_IDLE = 8
 } GpmSessionInhibitMask;
 
+#define GPM_SESSION_INHIBIT_MASK_BITS	4
+
 struct GpmSessionPrivate
 {
-	DBusGProxy		*proxy;
-	DBusGProxy		*proxy_presence;
-	DBusGProxy		*proxy_client_private;
-	DBusGProxy		*proxy_prop;
+	GDBusProxy		*proxy;
+	GDBusProxy		*proxy_presence;
+	GDBusProxy		*proxy_client_private;
+	GCancellable		*cancellable;
 	gboolean		 is_idle_old;
 	gboolean		 is_idle_inhibited_old;
 	gboolean		 is_suspend_inhibited_old;
+	GHashTable		*inhibitors;
+	GCancellable		*inhibitors_cancellable;	/* of the queries filling it */
+	guint			 inhibit_count[GPM_SESSION_INHIBIT_MASK_BITS];
+	gboolean		 connecting;
+	gchar			*register_app_id;
+	gchar			*register_startup_id;
 };
 
+typedef struct {
+	GpmSession		*session;
+	gchar			*id;
+	const gchar		*method;
+} GpmSessionInhibitQuery;
+
 enum {
 	IDLE_CHANGED,
 	INHIBITED_CHANGED,
@@ -97,7 +111,8 @@ gpm_session_logout (GpmSession *session)
 	}
 
 	/* we have to use no reply, as the SM calls into g-p-m to get the can_suspend property */
-	dbus_g_proxy_call_no_reply (session->priv->proxy, "Shutdown", G_TYPE_INVALID);
+	g_dbus_proxy_call (session->priv->proxy, "Shutdown", NULL,
+			   G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
 	return TRUE;
 }
 
@@ -132,10 +147,10 @@ gpm_session_get_suspend_inhibited (GpmSession *session)
 }
 
 /**
- * gpm_session_presence_status_changed_cb:
+ * gpm_session_set_status:
  **/
 static void
-gpm_session_presence_status_changed_cb (DBusGProxy *proxy, guint status, GpmSession *session)
+gpm_session_set_status (GpmSession *session, guint status)
 {
 	gboolean is_idle;
 	is_idle = (status == GPM_SESSION_STATUS_ENUM_IDLE);
@@ -147,245 +162,562 @@ gpm_session_presence_status_changed_cb (DBusGProxy *proxy, guint status, GpmSess
 }
 
 /**
- * gpm_session_is_idle:
+ * gpm_session_presence_signal_cb:
  **/
-static gboolean
-gpm_session_is_idle (GpmSession *session)
+static void
+gpm_session_presence_signal_cb (GDBusProxy *proxy, const gchar *sender_name,
+				const gchar *signal_name, GVariant *parameters,
+				GpmSession *session)
 {
-	gboolean ret;
-	gboolean is_idle = FALSE;
-	GError *error = NULL;
-	GValue *value;
+	guint status;
 
-	/* no mate-session */
-	if (session->priv->proxy_prop == NULL) {
-		g_warning ("no mate-session");
-		goto out;
+	if (g_strcmp0 (signal_name, "StatusChanged") != 0)
+		return;
+	if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(u)")))
+		return;
+	g_variant_get (parameters, "(u)", &status);
+	gpm_session_set_status (session, status);
+}
+
+/**
+ * gpm_session_presence_properties_changed_cb:
+ **/
+static void
+gpm_session_presence_properties_changed_cb (GDBusProxy *proxy, GVariant *changed,
+					    GStrv invalidated, GpmSession *session)
+{
+	guint status;
+
+	if (g_variant_lookup (changed, "status", "u", &status))
+		gpm_session_set_status (session, status);
+}
+
+/**
+ * gpm_session_inhibitor_free:
+ **/
+static void
+gpm_session_inhibitor_free (GpmSessionInhibitor *inhibitor)
+{
+	g_free (inhibitor->id);
+	g_free (inhibitor->app_id);
+	g_free (inhibitor->reason);
+	g_free (inhibitor);
+}
+
+/**
+ * gpm_session_inhibit_count:
+ *
+ * Keeps a count of inhibitors for each flag, so the aggregate state never
+ * needs the table walked or the session manager asked.
+ **/
+static void
+gpm_session_inhibit_count (GpmSession *session, guint flags, gint delta)
+{
+	guint i;
+
+	for (i = 0; i < GPM_SESSION_INHIBIT_MASK_BITS; i++) {
+		if ((flags & (1 << i)) == 0)
+			continue;
+		if (delta < 0 && session->priv->inhibit_count[i] == 0) {
+			g_warning ("inhibit count for flag %u is already zero", 1 << i);
+			continue;
+		}
+		session->priv->inhibit_count[i] += delta;
 	}
+}
 
-	value = g_new0(GValue, 1);
-	/* find out if this change altered the inhibited state */
-	ret = dbus_g_proxy_call (session->priv->proxy_prop, "Get", &error,
-				 G_TYPE_STRING, GPM_SESSION_MANAGER_PRESENCE_INTERFACE,
-				 G_TYPE_STRING, "status",
-				 G_TYPE_INVALID,
-				 G_TYPE_VALUE, value,
-				 G_TYPE_INVALID);
-	if (!ret) {
-		g_warning ("failed to get idle status: %s", error->message);
-		g_error_free (error);
-		g_free (value);
-		is_idle = FALSE;
-		goto out;
+/**
+ * gpm_session_inhibit_update:
+ **/
+static void
+gpm_session_inhibit_update (GpmSession *session)
+{
+	gboolean is_idle_inhibited;
+	gboolean is_suspend_inhibited;
+
+	is_idle_inhibited = session->priv->inhibit_count[g_bit_nth_lsf (GPM_SESSION_INHIBIT_MASK_IDLE, -1)] > 0;
+	is_suspend_inhibited = session->priv->inhibit_count[g_bit_nth_lsf (GPM_SESSION_INHIBIT_MASK_SUSPEND, -1)] > 0;
+	if (is_idle_inhibited != session->priv->is_idle_inhibited_old ||
+	    is_suspend_inhibited != session->priv->is_suspend_inhibited_old) {
+		g_debug ("emitting inhibited-changed : idle=(%i), suspend=(%i)",
+			 is_idle_inhibited, is_suspend_inhibited);
+		session->priv->is_idle_inhibited_old = is_idle_inhibited;
+		session->priv->is_suspend_inhibited_old = is_suspend_inhibited;
+		g_signal_emit (session, signals [INHIBITED_CHANGED], 0,
+			       is_idle_inhibited, is_suspend_inhibited);
 	}
-	is_idle = (g_value_get_uint (value) == GPM_SESSION_STATUS_ENUM_IDLE);
-	g_free (value);
-out:
-	return is_idle;
 }
 
 /**
- * gpm_session_is_idle_inhibited:
+ * gpm_session_inhibitor_cb:
  **/
-static gboolean
-gpm_session_is_idle_inhibited (GpmSession *session)
+static void
+gpm_session_inhibitor_cb (GObject *source, GAsyncResult *res, gpointer user_data)
 {
-	gboolean ret;
-	gboolean is_inhibited = FALSE;
+	GpmSessionInhibitQuery *query = user_data;
+	GpmSessionInhibitor *inhibitor;
+	GVariant *result;
 	GError *error = NULL;
 
-	/* no mate-session */
-	if (session->priv->proxy == NULL) {
-		g_warning ("no mate-session");
+	result = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source), res, &error);
+	if (result == NULL) {
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			g_debug ("failed to %s for %s: %s", query->method, query->id, error->message);
+		g_error_free (error);
 		goto out;
 	}
 
-	/* find out if this change altered the inhibited state */
-	ret = dbus_g_proxy_call (session->priv->proxy, "IsInhibited", &error,
-				 G_TYPE_UINT, GPM_SESSION_INHIBIT_MASK_IDLE,
-				 G_TYPE_INVALID,
-				 G_TYPE_BOOLEAN, &is_inhibited,
-				 G_TYPE_INVALID);
-	if (!ret) {
-		g_warning ("failed to get inhibit status: %s", error->message);
-		g_error_free (error);
-		is_inhibited = FALSE;
+	/* removed while we were asking */
+	inhibitor = g_hash_table_lookup (query->session->priv->inhibitors, query->id);
+	if (inhibitor == NULL)
+		goto out;
+
+	if (g_strcmp0 (query->method, "GetFlags") == 0) {
+		g_variant_get (result, "(u)", &inhibitor->flags);
+		inhibitor->flags_valid = TRUE;
+		g_debug ("inhibitor %s has flags %u", inhibitor->id, inhibitor->flags);
+		gpm_session_inhibit_count (query->session, inhibitor->flags, 1);
+		gpm_session_inhibit_update (query->session);
+	} else if (g_strcmp0 (query->method, "GetAppId") == 0) {
+		g_variant_get (result, "(s)", &inhibitor->app_id);
+	} else {
+		g_variant_get (result, "(s)", &inhibitor->reason);
 	}
 out:
-	return is_inhibited;
+	if (result != NULL)
+		g_variant_unref (result);
+	g_free (query->id);
+	g_free (query);
 }
 
 /**
- * gpm_session_is_suspend_inhibited:
+ * gpm_session_inhibitor_query:
  **/
-static gboolean
-gpm_session_is_suspend_inhibited (GpmSession *session)
+static void
+gpm_session_inhibitor_query (GpmSession *session, const gchar *id, const gchar *method, const gchar *reply_type)
 {
-	gboolean ret;
-	gboolean is_inhibited = FALSE;
-	GError *error = NULL;
+	GpmSessionInhibitQuery *query;
+	gchar *owner;
 
-	/* no mate-session */
-	if (session->priv->proxy == NULL) {
-		g_warning ("no mate-session");
-		goto out;
-	}
+	/* mate-session has gone away */
+	owner = g_dbus_proxy_get_name_owner (session->priv->proxy);
+	if (owner == NULL)
+		return;
 
-	/* find out if this change altered the inhibited state */
-	ret = dbus_g_proxy_call (session->priv->proxy, "IsInhibited", &error,
-				 G_TYPE_UINT, GPM_SESSION_INHIBIT_MASK_SUSPEND,
-				 G_TYPE_INVALID,
-				 G_TYPE_BOOLEAN, &is_inhibited,
-				 G_TYPE_INVALID);
-	if (!ret) {
-		g_warning ("failed to get inhibit status: %s", error->message);
+	query = g_new0 (GpmSessionInhibitQuery, 1);
+	query->session = session;
+	query->id = g_strdup (id);
+	query->method = method;
+	g_dbus_connection_call (g_dbus_proxy_get_connection (session->priv->proxy),
+				owner,
+				id, GPM_SESSION_MANAGER_INHIBITOR_INTERFACE,
+				method, NULL, G_VARIANT_TYPE (reply_type),
+				G_DBUS_CALL_FLAGS_NONE, -1, session->priv->inhibitors_cancellable,
+				gpm_session_inhibitor_cb, query);
+	g_free (owner);
+}
+
+/**
+ * gpm_session_inhibitor_added:
+ *
+ * The inhibitor cannot count until its flags are known, the app id and
+ * reason are only for listing.
+ **/
+static void
+gpm_session_inhibitor_added (GpmSession *session, const gchar *id)
+{
+	GpmSessionInhibitor *inhibitor;
+
+	if (g_hash_table_contains (session->priv->inhibitors, id))
+		return;
+	inhibitor = g_new0 (GpmSessionInhibitor, 1);
+	inhibitor->id = g_strdup (id);
+	g_hash_table_insert (session->priv->inhibitors, inhibitor->id, inhibitor);
+
+	gpm_session_inhibitor_query (session, id, "GetFlags", "(u)");
+	gpm_session_inhibitor_query (session, id, "GetAppId", "(s)");
+	gpm_session_inhibitor_query (session, id, "GetReason", "(s)");
+}
+
+/**
+ * gpm_session_inhibitor_removed:
+ **/
+static void
+gpm_session_inhibitor_removed (GpmSession *session, const gchar *id)
+{
+	GpmSessionInhibitor *inhibitor;
+
+	inhibitor = g_hash_table_lookup (session->priv->inhibitors, id);
+	if (inhibitor == NULL)
+		return;
+	if (inhibitor->flags_valid)
+		gpm_session_inhibit_count (session, inhibitor->flags, -1);
+	g_hash_table_remove (session->priv->inhibitors, id);
+	gpm_session_inhibit_update (session);
+}
+
+/**
+ * gpm_session_get_inhibitors_cb:
+ **/
+static void
+gpm_session_get_inhibitors_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GpmSession *session;
+	GVariantIter *iter;
+	GVariant *result;
+	GError *error = NULL;
+	const gchar *id;
+
+	result = g_dbus_proxy_call_finish (G_DBUS_PROXY (source), res, &error);
+	if (result == NULL) {
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			g_warning ("failed to get inhibitors: %s", error->message);
 		g_error_free (error);
-		is_inhibited = FALSE;
+		return;
 	}
-out:
-	return is_inhibited;
+	session = GPM_SESSION (user_data);
+	g_variant_get (result, "(ao)", &iter);
+	while (g_variant_iter_next (iter, "&o", &id))
+		gpm_session_inhibitor_added (session, id);
+	g_variant_iter_free (iter);
+	g_variant_unref (result);
 }
 
 /**
- * gpm_session_stop_cb:
+ * gpm_session_inhibitors_coldplug:
  **/
 static void
-gpm_session_stop_cb (DBusGProxy *proxy, GpmSession *session)
+gpm_session_inhibitors_coldplug (GpmSession *session)
 {
-	g_debug ("emitting ::stop()");
-	g_signal_emit (session, signals [STOP], 0);
+	g_dbus_proxy_call (session->priv->proxy, "GetInhibitors", NULL,
+			   G_DBUS_CALL_FLAGS_NONE, -1, session->priv->inhibitors_cancellable,
+			   gpm_session_get_inhibitors_cb, session);
 }
 
 /**
- * gpm_session_query_end_session_cb:
+ * gpm_session_name_owner_changed_cb:
+ *
+ * The inhibitors belonged to the old session manager, so forget them all,
+ * and anything still being asked about them, before asking the new one.
  **/
 static void
-gpm_session_query_end_session_cb (DBusGProxy *proxy, guint flags, GpmSession *session)
+gpm_session_name_owner_changed_cb (GDBusProxy *proxy, GParamSpec *pspec, GpmSession *session)
 {
-	g_debug ("emitting ::query-end-session(%u)", flags);
-	g_signal_emit (session, signals [QUERY_END_SESSION], 0, flags);
+	gchar *owner;
+
+	owner = g_dbus_proxy_get_name_owner (proxy);
+	g_debug ("session manager is now %s", owner != NULL ? owner : "gone");
+
+	g_cancellable_cancel (session->priv->inhibitors_cancellable);
+	g_object_unref (session->priv->inhibitors_cancellable);
+	session->priv->inhibitors_cancellable = g_cancellable_new ();
+	g_hash_table_remove_all (session->priv->inhibitors);
+	memset (session->priv->inhibit_count, 0, sizeof (session->priv->inhibit_count));
+	gpm_session_inhibit_update (session);
+
+	if (owner != NULL)
+		gpm_session_inhibitors_coldplug (session);
+	g_free (owner);
+}
+
+/**
+ * gpm_session_get_inhibitors:
+ *
+ * Return value: (transfer container): the inhibitors we know about, which
+ * belong to @session and may not all have their details filled in yet
+ **/
+GPtrArray *
+gpm_session_get_inhibitors (GpmSession *session)
+{
+	GPtrArray *array;
+	GHashTableIter iter;
+	gpointer value;
+
+	g_return_val_if_fail (GPM_IS_SESSION (session), NULL);
+
+	array = g_ptr_array_sized_new (g_hash_table_size (session->priv->inhibitors));
+	g_hash_table_iter_init (&iter, session->priv->inhibitors);
+	while (g_hash_table_iter_next (&iter, NULL, &value))
+		g_ptr_array_add (array, value);
+	return array;
+}
+
+/**
+ * gpm_session_manager_signal_cb:
+ **/
+static void
+gpm_session_manager_signal_cb (GDBusProxy *proxy, const gchar *sender_name,
+			       const gchar *signal_name, GVariant *parameters,
+			       GpmSession *session)
+{
+	const gchar *id;
+
+	if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(o)")))
+		return;
+	g_variant_get (parameters, "(&o)", &id);
+	if (g_strcmp0 (signal_name, "InhibitorAdded") == 0)
+		gpm_session_inhibitor_added (session, id);
+	else if (g_strcmp0 (signal_name, "InhibitorRemoved") == 0)
+		gpm_session_inhibitor_removed (session, id);
+}
+
+/**
+ * gpm_session_client_private_signal_cb:
+ **/
+static void
+gpm_session_client_private_signal_cb (GDBusProxy *proxy, const gchar *sender_name,
+				      const gchar *signal_name, GVariant *parameters,
+				      GpmSession *session)
+{
+	guint flags = 0;
+
+	if (g_strcmp0 (signal_name, "Stop") == 0) {
+		g_debug ("emitting ::stop()");
+		g_signal_emit (session, signals [STOP], 0);
+		return;
+	}
+	if (g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(u)")))
+		g_variant_get (parameters, "(u)", &flags);
+	if (g_strcmp0 (signal_name, "QueryEndSession") == 0) {
+		g_debug ("emitting ::query-end-session(%u)", flags);
+		g_signal_emit (session, signals [QUERY_END_SESSION], 0, flags);
+	} else if (g_strcmp0 (signal_name, "EndSession") == 0) {
+		g_debug ("emitting ::end-session(%u)", flags);
+		g_signal_emit (session, signals [END_SESSION], 0, flags);
+	}
 }
 
 /**
- * gpm_session_end_session_cb:
+ * gpm_session_end_session_response_cb:
  **/
 static void
-gpm_session_end_session_cb (DBusGProxy *proxy, guint flags, GpmSession *session)
+gpm_session_end_session_response_cb (GObject *source, GAsyncResult *res, gpointer user_data)
 {
-	g_debug ("emitting ::end-session(%u)", flags);
-	g_signal_emit (session, signals [END_SESSION], 0, flags);
+	GVariant *result;
+	GError *error = NULL;
+
+	result = g_dbus_proxy_call_finish (G_DBUS_PROXY (source), res, &error);
+	if (result == NULL) {
+		g_warning ("failed to send session response: %s", error->message);
+		g_error_free (error);
+		return;
+	}
+	g_variant_unref (result);
 }
 
 /**
  * gpm_session_end_session_response:
+ *
+ * The response is sent without waiting for the reply.
  **/
 gboolean
 gpm_session_end_session_response (GpmSession *session, gboolean is_okay, const gchar *reason)
 {
-	gboolean ret = FALSE;
-	GError *error = NULL;
-
 	g_return_val_if_fail (GPM_IS_SESSION (session), FALSE);
-	g_return_val_if_fail (session->priv->proxy_client_private != NULL, FALSE);
 
 	/* no mate-session */
 	if (session->priv->proxy_client_private == NULL) {
 		g_warning ("no mate-session proxy");
-		goto out;
+		return FALSE;
 	}
 
 	/* send response */
-	ret = dbus_g_proxy_call (session->priv->proxy_client_private, "EndSessionResponse", &error,
-				 G_TYPE_BOOLEAN, is_okay,
-				 G_TYPE_STRING, reason,
-				 G_TYPE_INVALID,
-				 G_TYPE_INVALID);
-	if (!ret) {
-		g_warning ("failed to send session response: %s", error->message);
+	g_dbus_proxy_call (session->priv->proxy_client_private, "EndSessionResponse",
+			   g_variant_new ("(bs)", is_okay, reason != NULL ? reason : ""),
+			   G_DBUS_CALL_FLAGS_NONE, -1, NULL,
+			   gpm_session_end_session_response_cb, NULL);
+	return TRUE;
+}
+
+/**
+ * gpm_session_client_private_cb:
+ **/
+static void
+gpm_session_client_private_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GpmSession *session;
+	GDBusProxy *proxy;
+	GError *error = NULL;
+
+	proxy = g_dbus_proxy_new_finish (res, &error);
+	if (proxy == NULL) {
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			g_warning ("DBUS error: %s", error->message);
 		g_error_free (error);
-		goto out;
+		return;
 	}
-out:
-	return ret;
+	session = GPM_SESSION (user_data);
+	session->priv->proxy_client_private = proxy;
+
+	/* get Stop, QueryEndSession and EndSession */
+	g_signal_connect (proxy, "g-signal",
+			  G_CALLBACK (gpm_session_client_private_signal_cb), session);
+}
+
+/**
+ * gpm_session_register_client_cb:
+ **/
+static void
+gpm_session_register_client_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GpmSession *session;
+	GVariant *result;
+	GError *error = NULL;
+	const gchar *client_id;
+	gchar *owner;
+
+	result = g_dbus_proxy_call_finish (G_DBUS_PROXY (source), res, &error);
+	if (result == NULL) {
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			g_warning ("failed to register client: %s", error->message);
+		g_error_free (error);
+		return;
+	}
+	session = GPM_SESSION (user_data);
+	g_variant_get (result, "(&o)", &client_id);
+	g_debug ("registered startup '%s' to client id '%s'",
+		 session->priv->register_startup_id, client_id);
+
+	/* get org.gnome.SessionManager.ClientPrivate interface */
+	owner = g_dbus_proxy_get_name_owner (session->priv->proxy);
+	g_dbus_proxy_new (g_dbus_proxy_get_connection (session->priv->proxy),
+			  G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
+			  NULL, owner,
+			  client_id, GPM_SESSION_MANAGER_CLIENT_PRIVATE_INTERFACE,
+			  session->priv->cancellable,
+			  gpm_session_client_private_cb, session);
+	g_free (owner);
+	g_variant_unref (result);
+}
+
+/**
+ * gpm_session_do_register_client:
+ **/
+static void
+gpm_session_do_register_client (GpmSession *session)
+{
+	g_dbus_proxy_call (session->priv->proxy, "RegisterClient",
+			   g_variant_new ("(ss)",
+					  session->priv->register_app_id,
+					  session->priv->register_startup_id != NULL ?
+						session->priv->register_startup_id : ""),
+			   G_DBUS_CALL_FLAGS_NONE, -1, session->priv->cancellable,
+			   gpm_session_register_client_cb, session);
 }
 
 /**
  * gpm_session_register_client:
+ *
+ * Registers once we are connected to the session manager, so this never
+ * waits for it.
  **/
 gboolean
 gpm_session_register_client (GpmSession *session, const gchar *app_id, const gchar *client_startup_id)
 {
-	gboolean ret = FALSE;
-	gchar *client_id = NULL;
-	GError *error = NULL;
-	DBusGConnection *connection;
-
 	g_return_val_if_fail (GPM_IS_SESSION (session), FALSE);
+	g_return_val_if_fail (app_id != NULL, FALSE);
 
 	/* no mate-session */
-	if (session->priv->proxy == NULL) {
+	if (session->priv->proxy == NULL && !session->priv->connecting) {
 		g_warning ("no mate-session");
-		goto out;
+		return FALSE;
 	}
 
-	/* find out if this change altered the inhibited state */
-	ret = dbus_g_proxy_call (session->priv->proxy, "RegisterClient", &error,
-				 G_TYPE_STRING, app_id,
-				 G_TYPE_STRING, client_startup_id,
-				 G_TYPE_INVALID,
-				 DBUS_TYPE_G_OBJECT_PATH, &client_id,
-				 G_TYPE_INVALID);
-	if (!ret) {
-		g_warning ("failed to register client '%s': %s", client_startup_id, error->message);
-		g_error_free (error);
-		goto out;
-	}
+	g_free (session->priv->register_app_id);
+	g_free (session->priv->register_startup_id);
+	session->priv->register_app_id = g_strdup (app_id);
+	session->priv->register_startup_id = g_strdup (client_startup_id);
+	if (session->priv->proxy != NULL)
+		gpm_session_do_register_client (session);
+	return TRUE;
+}
 
-	/* get org.gnome.SessionManager.ClientPrivate interface */
-	connection = dbus_g_bus_get (DBUS_BUS_SESSION, NULL);
-	session->priv->proxy_client_private = dbus_g_proxy_new_for_name_owner (connection, GPM_SESSION_MANAGER_SERVICE,
-									       client_id, GPM_SESSION_MANAGER_CLIENT_PRIVATE_INTERFACE, &error);
-	if (session->priv->proxy_client_private == NULL) {
-		g_warning ("DBUS error: %s", error->message);
+/**
+ * gpm_session_presence_proxy_cb:
+ **/
+static void
+gpm_session_presence_proxy_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GpmSession *session;
+	GDBusProxy *proxy;
+	GVariant *status;
+	GError *error = NULL;
+
+	proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
+	if (proxy == NULL) {
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			g_warning ("DBUS error: %s", error->message);
 		g_error_free (error);
-		goto out;
+		return;
 	}
+	session = GPM_SESSION (user_data);
+	session->priv->proxy_presence = proxy;
 
-	/* get Stop */
-	dbus_g_proxy_add_signal (session->priv->proxy_client_private, "Stop", G_TYPE_INVALID);
-	dbus_g_proxy_connect_signal (session->priv->proxy_client_private, "Stop", G_CALLBACK (gpm_session_stop_cb), session, NULL);
-
-	/* get QueryEndSession */
-	dbus_g_proxy_add_signal (session->priv->proxy_client_private, "QueryEndSession", G_TYPE_UINT, G_TYPE_INVALID);
-	dbus_g_proxy_connect_signal (session->priv->proxy_client_private, "QueryEndSession", G_CALLBACK (gpm_session_query_end_session_cb), session, NULL);
-
-	/* get EndSession */
-	dbus_g_proxy_add_signal (session->priv->proxy_client_private, "EndSession", G_TYPE_UINT, G_TYPE_INVALID);
-	dbus_g_proxy_connect_signal (session->priv->proxy_client_private, "EndSession", G_CALLBACK (gpm_session_end_session_cb), session, NULL);
+	/* get StatusChanged, and the property in case that is all we get */
+	g_signal_connect (proxy, "g-signal",
+			  G_CALLBACK (gpm_session_presence_signal_cb), session);
+	g_signal_connect (proxy, "g-properties-changed",
+			  G_CALLBACK (gpm_session_presence_properties_changed_cb), session);
 
-	g_debug ("registered startup '%s' to client id '%s'", client_startup_id, client_id);
-out:
-	g_free (client_id);
-	return ret;
+	/* coldplug */
+	status = g_dbus_proxy_get_cached_property (proxy, "status");
+	if (status != NULL) {
+		if (g_variant_is_of_type (status, G_VARIANT_TYPE_UINT32))
+			gpm_session_set_status (session, g_variant_get_uint32 (status));
+		g_variant_unref (status);
+	}
+	g_debug ("idle: %i", session->priv->is_idle_old);
 }
 
 /**
- * gpm_session_inhibit_changed_cb:
+ * gpm_session_proxy_cb:
  **/
 static void
-gpm_session_inhibit_changed_cb (DBusGProxy *proxy, const gchar *id, GpmSession *session)
+gpm_session_proxy_cb (GObject *source, GAsyncResult *res, gpointer user_data)
 {
-	gboolean is_idle_inhibited;
-	gboolean is_suspend_inhibited;
+	GpmSession *session;
+	GDBusProxy *proxy;
+	GError *error = NULL;
+	gchar *owner;
+
+	proxy = g_dbus_proxy_new_for_bus_finish (res, &error);
+	if (proxy == NULL) {
+		if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			g_error_free (error);
+			return;
+		}
+		g_warning ("DBUS error: %s", error->message);
+		g_error_free (error);
+		GPM_SESSION (user_data)->priv->connecting = FALSE;
+		return;
+	}
+	session = GPM_SESSION (user_data);
+	session->priv->connecting = FALSE;
 
-	is_idle_inhibited = gpm_session_is_idle_inhibited (session);
-	is_suspend_inhibited = gpm_session_is_suspend_inhibited (session);
-	if (is_idle_inhibited != session->priv->is_idle_inhibited_old || is_suspend_inhibited != session->priv->is_suspend_inhibited_old) {
-		g_debug ("emitting inhibited-changed : idle=(%i), suspend=(%i)", is_idle_inhibited, is_suspend_inhibited);
-		session->priv->is_idle_inhibited_old = is_idle_inhibited;
-		session->priv->is_suspend_inhibited_old = is_suspend_inhibited;
-		g_signal_emit (session, signals [INHIBITED_CHANGED], 0, is_idle_inhibited, is_suspend_inhibited);
+	/* no mate-session */
+	owner = g_dbus_proxy_get_name_owner (proxy);
+	if (owner == NULL) {
+		g_warning ("no mate-session");
+		g_object_unref (proxy);
+		return;
 	}
+	g_free (owner);
+	session->priv->proxy = proxy;
+
+	/* get InhibitorAdded and InhibitorRemoved */
+	g_signal_connect (proxy, "g-signal",
+			  G_CALLBACK (gpm_session_manager_signal_cb), session);
+
+	/* a restarted session manager has none of the old inhibitors */
+	g_signal_connect (proxy, "notify::g-name-owner",
+			  G_CALLBACK (gpm_session_name_owner_changed_cb), session);
+
+	/* coldplug */
+	gpm_session_inhibitors_coldplug (session);
+
+	/* we were asked to register before we got here */
+	if (session->priv->register_app_id != NULL)
+		gpm_session_do_register_client (session);
 }
 
 /**
@@ -445,68 +777,42 @@ gpm_session_class_init (GpmSessionClass *klass)
 /**
  * gpm_session_init:
  * @session: This class instance
+ *
+ * The session manager may be slow to answer while the session starts,
+ * so connect in the background and start with nothing idle or inhibited.
  **/
 static void
 gpm_session_init (GpmSession *session)
 {
-	DBusGConnection *connection;
-	GError *error = NULL;
-
 	session->priv = gpm_session_get_instance_private (session);
 	session->priv->is_idle_old = FALSE;
 	session->priv->is_idle_inhibited_old = FALSE;
 	session->priv->is_suspend_inhibited_old = FALSE;
 	session->priv->proxy_client_private = NULL;
-
-	connection = dbus_g_bus_get (DBUS_BUS_SESSION, NULL);
+	session->priv->cancellable = g_cancellable_new ();
+	session->priv->inhibitors_cancellable = g_cancellable_new ();
+	session->priv->connecting = TRUE;
+	session->priv->inhibitors = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+							   (GDestroyNotify) gpm_session_inhibitor_free);
 
 	/* get org.gnome.SessionManager interface */
-	session->priv->proxy = dbus_g_proxy_new_for_name_owner (connection, GPM_SESSION_MANAGER_SERVICE,
-								GPM_SESSION_MANAGER_PATH,
-								GPM_SESSION_MANAGER_INTERFACE, &error);
-	if (session->priv->proxy == NULL) {
-		g_warning ("DBUS error: %s", error->message);
-		g_error_free (error);
-		return;
-	}
+	g_dbus_proxy_new_for_bus (G_BUS_TYPE_SESSION,
+				  G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES |
+				  G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START,
+				  NULL, GPM_SESSION_MANAGER_SERVICE,
+				  GPM_SESSION_MANAGER_PATH,
+				  GPM_SESSION_MANAGER_INTERFACE,
+				  session->priv->cancellable,
+				  gpm_session_proxy_cb, session);
 
 	/* get org.gnome.SessionManager.Presence interface */
-	session->priv->proxy_presence = dbus_g_proxy_new_for_name_owner (connection, GPM_SESSION_MANAGER_SERVICE,
-									 GPM_SESSION_MANAGER_PRESENCE_PATH,
-									 GPM_SESSION_MANAGER_PRESENCE_INTERFACE, &error);
-	if (session->priv->proxy_presence == NULL) {
-		g_warning ("DBUS error: %s", error->message);
-		g_error_free (error);
-		return;
-	}
-
-	/* get properties interface */
-	session->priv->proxy_prop = dbus_g_proxy_new_for_name_owner (connection, GPM_SESSION_MANAGER_SERVICE,
-								     GPM_SESSION_MANAGER_PRESENCE_PATH,
-								     GPM_DBUS_PROPERTIES_INTERFACE, &error);
-	if (session->priv->proxy_prop == NULL) {
-		g_warning ("DBUS error: %s", error->message);
-		g_error_free (error);
-		return;
-	}
-
-	/* get StatusChanged */
-	dbus_g_proxy_add_signal (session->priv->proxy_presence, "StatusChanged", G_TYPE_UINT, G_TYPE_INVALID);
-	dbus_g_proxy_connect_signal (session->priv->proxy_presence, "StatusChanged", G_CALLBACK (gpm_session_presence_status_changed_cb), session, NULL);
-
-	/* get InhibitorAdded */
-	dbus_g_proxy_add_signal (session->priv->proxy, "InhibitorAdded", DBUS_TYPE_G_OBJECT_PATH, G_TYPE_INVALID);
-	dbus_g_proxy_connect_signal (session->priv->proxy, "InhibitorAdded", G_CALLBACK (gpm_session_inhibit_changed_cb), session, NULL);
-
-	/* get InhibitorRemoved */
-	dbus_g_proxy_add_signal (session->priv->proxy, "InhibitorRemoved", DBUS_TYPE_G_OBJECT_PATH, G_TYPE_INVALID);
-	dbus_g_proxy_connect_signal (session->priv->proxy, "InhibitorRemoved", G_CALLBACK (gpm_session_inhibit_changed_cb), session, NULL);
-
-	/* coldplug */
-	session->priv->is_idle_inhibited_old = gpm_session_is_idle_inhibited (session);
-	session->priv->is_suspend_inhibited_old = gpm_session_is_suspend_inhibited (session);
-	session->priv->is_idle_old = gpm_session_is_idle (session);
-	g_debug ("idle: %i, idle_inhibited: %i, suspend_inhibited: %i", session->priv->is_idle_old, session->priv->is_idle_inhibited_old, session->priv->is_suspend_inhibited_old);
+	g_dbus_proxy_new_for_bus (G_BUS_TYPE_SESSION,
+				  G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START,
+				  NULL, GPM_SESSION_MANAGER_SERVICE,
+				  GPM_SESSION_MANAGER_PRESENCE_PATH,
+				  GPM_SESSION_MANAGER_PRESENCE_INTERFACE,
+				  session->priv->cancellable,
+				  gpm_session_presence_proxy_cb, session);
 }
 
 /**
@@ -523,11 +829,25 @@ gpm_session_finalize (GObject *object)
 	session = GPM_SESSION (object);
 	session->priv = gpm_session_get_instance_private (session);
 
-	g_object_unref (session->priv->proxy);
-	g_object_unref (session->priv->proxy_presence);
-	if (session->priv->proxy_client_private != NULL)
+	g_cancellable_cancel (session->priv->cancellable);
+	g_object_unref (session->priv->cancellable);
+	g_cancellable_cancel (session->priv->inhibitors_cancellable);
+	g_object_unref (session->priv->inhibitors_cancellable);
+	if (session->priv->proxy != NULL) {
+		g_signal_handlers_disconnect_by_data (session->priv->proxy, session);
+		g_object_unref (session->priv->proxy);
+	}
+	if (session->priv->proxy_presence != NULL) {
+		g_signal_handlers_disconnect_by_data (session->priv->proxy_presence, session);
+		g_object_unref (session->priv->proxy_presence);
+	}
+	if (session->priv->proxy_client_private != NULL) {
+		g_signal_handlers_disconnect_by_data (session->priv->proxy_client_private, session);
 		g_object_unref (session->priv->proxy_client_private);
-	g_object_unref (session->priv->proxy_prop);
+	}
+	g_free (session->priv->register_app_id);
+	g_free (session->priv->register_startup_id);
+	g_hash_table_unref (session->priv->inhibitors);
 
 	G_OBJECT_CLASS (gpm_session_parent_class)->finalize (object);
 }
@@ -36,6 +36,15 @@ G_BEGIN_DECLS
 
 typedef struct GpmSessionPrivate GpmSessionPrivate;
 
+typedef struct
+{
+	gchar			*id;
+	gchar			*app_id;
+	gchar			*reason;
+	guint			 flags;
+	gboolean		 flags_valid;
+} GpmSessionInhibitor;
+
 typedef struct
 {
 	GObject			 parent;
@@ -68,6 +77,7 @@ gboolean	 gpm_session_logout			(GpmSession	*session);
 gboolean	 gpm_session_get_idle			(GpmSession	*session);
 gboolean	 gpm_session_get_idle_inhibited		(GpmSession	*session);
 gboolean	 gpm_session_get_suspend_inhibited	(GpmSession	*session);
+GPtrArray	*gpm_session_get_inhibitors		(GpmSession	*session);
 gboolean	 gpm_session_register_client		(GpmSession	*session,
 							 const gchar	*app_id,
 							 const gchar	*client_startup_id);
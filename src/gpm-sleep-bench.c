@@ -0,0 +1,472 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Measures the time from asking GpmControl to sleep to the sleep request
+ * reaching logind (or ConsoleKit).
+ *
+ * A private dbus-daemon is started and used as both the session and the
+ * system bus, and minimal logind, ConsoleKit, screensaver and
+ * NetworkManager services are exported on it from a worker thread, so the
+ * machine never actually goes to sleep.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <glib.h>
+#include <gio/gio.h>
+#include <gio/gunixfdlist.h>
+
+#include "gpm-control.h"
+
+#define GPM_BENCH_CK_SESSION_PATH	"/org/freedesktop/ConsoleKit/Session1"
+
+static const gchar gpm_bench_introspection[] =
+	"<node>"
+	"  <interface name='org.freedesktop.login1.Manager'>"
+	"    <method name='Suspend'>"
+	"      <arg name='interactive' direction='in' type='b'/>"
+	"    </method>"
+	"    <method name='Hibernate'>"
+	"      <arg name='interactive' direction='in' type='b'/>"
+	"    </method>"
+	"    <method name='Inhibit'>"
+	"      <arg name='what' direction='in' type='s'/>"
+	"      <arg name='who' direction='in' type='s'/>"
+	"      <arg name='why' direction='in' type='s'/>"
+	"      <arg name='mode' direction='in' type='s'/>"
+	"      <arg name='fd' direction='out' type='h'/>"
+	"    </method>"
+	"    <signal name='PrepareForSleep'>"
+	"      <arg name='start' type='b'/>"
+	"    </signal>"
+	"  </interface>"
+	"  <interface name='org.freedesktop.ConsoleKit.Manager'>"
+	"    <method name='GetSessionForUnixProcess'>"
+	"      <arg name='pid' direction='in' type='u'/>"
+	"      <arg name='ssid' direction='out' type='o'/>"
+	"    </method>"
+	"    <method name='CanSuspend'>"
+	"      <arg name='can_suspend' direction='out' type='s'/>"
+	"    </method>"
+	"    <method name='CanHibernate'>"
+	"      <arg name='can_hibernate' direction='out' type='s'/>"
+	"    </method>"
+	"    <method name='Suspend'>"
+	"      <arg name='interactive' direction='in' type='b'/>"
+	"    </method>"
+	"    <method name='Hibernate'>"
+	"      <arg name='interactive' direction='in' type='b'/>"
+	"    </method>"
+	"  </interface>"
+	"  <interface name='org.freedesktop.ConsoleKit.Session'>"
+	"    <method name='IsActive'>"
+	"      <arg name='active' direction='out' type='b'/>"
+	"    </method>"
+	"    <method name='IsLocal'>"
+	"      <arg name='local' direction='out' type='b'/>"
+	"    </method>"
+	"    <signal name='ActiveChanged'>"
+	"      <arg name='active' type='b'/>"
+	"    </signal>"
+	"  </interface>"
+	"  <interface name='org.mate.ScreenSaver'>"
+	"    <method name='Lock'/>"
+	"    <method name='GetActive'>"
+	"      <arg name='active' direction='out' type='b'/>"
+	"    </method>"
+	"    <method name='Throttle'>"
+	"      <arg name='application_name' direction='in' type='s'/>"
+	"      <arg name='reason' direction='in' type='s'/>"
+	"      <arg name='cookie' direction='out' type='u'/>"
+	"    </method>"
+	"    <method name='UnThrottle'>"
+	"      <arg name='cookie' direction='in' type='u'/>"
+	"    </method>"
+	"    <method name='SimulateUserActivity'/>"
+	"    <signal name='ActiveChanged'>"
+	"      <arg name='new_value' type='b'/>"
+	"    </signal>"
+	"  </interface>"
+	"  <interface name='org.freedesktop.NetworkManager'>"
+	"    <method name='sleep'/>"
+	"    <method name='wake'/>"
+	"  </interface>"
+	"</node>";
+
+/* interface, object path and bus name of each fake service */
+static const gchar *gpm_bench_objects[][3] = {
+	{ "org.freedesktop.login1.Manager", "/org/freedesktop/login1", "org.freedesktop.login1" },
+	{ "org.freedesktop.ConsoleKit.Manager", "/org/freedesktop/ConsoleKit/Manager", "org.freedesktop.ConsoleKit" },
+	{ "org.freedesktop.ConsoleKit.Session", GPM_BENCH_CK_SESSION_PATH, NULL },
+	{ "org.mate.ScreenSaver", "/", "org.mate.ScreenSaver" },
+	{ "org.freedesktop.NetworkManager", "/org/freedesktop/NetworkManager", "org.freedesktop.NetworkManager" },
+};
+
+typedef struct {
+	gchar			*address;
+	GDBusConnection		*connection;
+	GDBusNodeInfo		*introspection;
+	GMainContext		*context;
+	GMainLoop		*loop;
+	GThread			*thread;
+	guint			 lock_delay;	/* ms */
+	gboolean		 active;
+	guint			 cookie;
+	gboolean		 ready;
+	gint64			 slept_at;	/* protected by mutex */
+	GMutex			 mutex;
+	GCond			 cond;
+} GpmBenchServices;
+
+/**
+ * gpm_bench_services_active_cb:
+ *
+ * The screensaver takes a while to fade out before it reports being active.
+ **/
+static gboolean
+gpm_bench_services_active_cb (gpointer user_data)
+{
+	GpmBenchServices *services = (GpmBenchServices *) user_data;
+
+	services->active = TRUE;
+	g_dbus_connection_emit_signal (services->connection, NULL, "/",
+				       "org.mate.ScreenSaver", "ActiveChanged",
+				       g_variant_new ("(b)", TRUE), NULL);
+	return FALSE;
+}
+
+/**
+ * gpm_bench_services_method_call:
+ **/
+static void
+gpm_bench_services_method_call (GDBusConnection *connection, const gchar *sender,
+				const gchar *object_path, const gchar *interface_name,
+				const gchar *method_name, GVariant *parameters,
+				GDBusMethodInvocation *invocation, gpointer user_data)
+{
+	GpmBenchServices *services = (GpmBenchServices *) user_data;
+	GUnixFDList *fd_list;
+	GSource *source;
+	gint fds[2];
+
+	/* the request we are timing */
+	if (g_strcmp0 (method_name, "Suspend") == 0 ||
+	    g_strcmp0 (method_name, "Hibernate") == 0) {
+		g_mutex_lock (&services->mutex);
+		services->slept_at = g_get_monotonic_time ();
+		g_mutex_unlock (&services->mutex);
+
+		/* like logind, reply once the sleep is queued */
+		g_dbus_connection_emit_signal (connection, NULL, object_path, interface_name,
+					       "PrepareForSleep", g_variant_new ("(b)", TRUE), NULL);
+		g_dbus_method_invocation_return_value (invocation, NULL);
+
+		/* we have woken up again */
+		services->active = FALSE;
+		g_dbus_connection_emit_signal (connection, NULL, object_path, interface_name,
+					       "PrepareForSleep", g_variant_new ("(b)", FALSE), NULL);
+		return;
+	}
+	if (g_strcmp0 (method_name, "Inhibit") == 0) {
+		if (pipe (fds) != 0) {
+			g_dbus_method_invocation_return_error (invocation, G_IO_ERROR, G_IO_ERROR_FAILED,
+							       "cannot create inhibitor");
+			return;
+		}
+		fd_list = g_unix_fd_list_new ();
+		g_unix_fd_list_append (fd_list, fds[0], NULL);
+		close (fds[0]);
+		close (fds[1]);
+		g_dbus_method_invocation_return_value_with_unix_fd_list (invocation,
+									 g_variant_new ("(h)", 0),
+									 fd_list);
+		g_object_unref (fd_list);
+		return;
+	}
+
+	if (g_strcmp0 (method_name, "GetSessionForUnixProcess") == 0) {
+		g_dbus_method_invocation_return_value (invocation,
+						       g_variant_new ("(o)", GPM_BENCH_CK_SESSION_PATH));
+		return;
+	}
+	if (g_strcmp0 (method_name, "CanSuspend") == 0 ||
+	    g_strcmp0 (method_name, "CanHibernate") == 0) {
+		g_dbus_method_invocation_return_value (invocation, g_variant_new ("(s)", "yes"));
+		return;
+	}
+	if (g_strcmp0 (method_name, "IsActive") == 0 ||
+	    g_strcmp0 (method_name, "IsLocal") == 0) {
+		g_dbus_method_invocation_return_value (invocation, g_variant_new ("(b)", TRUE));
+		return;
+	}
+
+	/* screensaver */
+	if (g_strcmp0 (method_name, "Lock") == 0) {
+		if (!services->active) {
+			source = g_timeout_source_new (services->lock_delay);
+			g_source_set_callback (source, gpm_bench_services_active_cb, services, NULL);
+			g_source_attach (source, services->context);
+			g_source_unref (source);
+		}
+		g_dbus_method_invocation_return_value (invocation, NULL);
+		return;
+	}
+	if (g_strcmp0 (method_name, "GetActive") == 0) {
+		g_dbus_method_invocation_return_value (invocation, g_variant_new ("(b)", services->active));
+		return;
+	}
+	if (g_strcmp0 (method_name, "Throttle") == 0) {
+		g_dbus_method_invocation_return_value (invocation, g_variant_new ("(u)", ++services->cookie));
+		return;
+	}
+
+	/* UnThrottle, SimulateUserActivity, sleep and wake */
+	g_dbus_method_invocation_return_value (invocation, NULL);
+}
+
+static const GDBusInterfaceVTable gpm_bench_services_vtable = {
+	gpm_bench_services_method_call,
+	NULL,
+	NULL,
+	{ 0 }
+};
+
+/**
+ * gpm_bench_services_thread:
+ **/
+static gpointer
+gpm_bench_services_thread (gpointer user_data)
+{
+	GpmBenchServices *services = (GpmBenchServices *) user_data;
+	GDBusInterfaceInfo *info;
+	GVariant *result;
+	GError *error = NULL;
+	guint i;
+
+	g_main_context_push_thread_default (services->context);
+
+	/* a connection of our own, so method calls are dispatched in this thread */
+	services->connection = g_dbus_connection_new_for_address_sync (services->address,
+									G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+									G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+									NULL, NULL, &error);
+	if (services->connection == NULL)
+		g_error ("cannot connect to the private bus: %s", error->message);
+
+	for (i = 0; i < G_N_ELEMENTS (gpm_bench_objects); i++) {
+		info = g_dbus_node_info_lookup_interface (services->introspection, gpm_bench_objects[i][0]);
+		g_dbus_connection_register_object (services->connection, gpm_bench_objects[i][1],
+						   info, &gpm_bench_services_vtable,
+						   services, NULL, NULL);
+		if (gpm_bench_objects[i][2] == NULL)
+			continue;
+		result = g_dbus_connection_call_sync (services->connection,
+						      "org.freedesktop.DBus", "/org/freedesktop/DBus",
+						      "org.freedesktop.DBus", "RequestName",
+						      g_variant_new ("(su)", gpm_bench_objects[i][2], 0),
+						      G_VARIANT_TYPE ("(u)"), G_DBUS_CALL_FLAGS_NONE,
+						      -1, NULL, &error);
+		if (result == NULL)
+			g_error ("cannot own %s: %s", gpm_bench_objects[i][2], error->message);
+		g_variant_unref (result);
+	}
+
+	/* we are now serving requests */
+	g_mutex_lock (&services->mutex);
+	services->ready = TRUE;
+	g_cond_signal (&services->cond);
+	g_mutex_unlock (&services->mutex);
+
+	g_main_loop_run (services->loop);
+
+	g_object_unref (services->connection);
+	g_main_context_pop_thread_default (services->context);
+	return NULL;
+}
+
+/**
+ * gpm_bench_services_new:
+ **/
+static GpmBenchServices *
+gpm_bench_services_new (const gchar *address, guint lock_delay)
+{
+	GpmBenchServices *services;
+
+	services = g_new0 (GpmBenchServices, 1);
+	services->address = g_strdup (address);
+	services->lock_delay = lock_delay;
+	services->introspection = g_dbus_node_info_new_for_xml (gpm_bench_introspection, NULL);
+	g_mutex_init (&services->mutex);
+	g_cond_init (&services->cond);
+
+	services->context = g_main_context_new ();
+	services->loop = g_main_loop_new (services->context, FALSE);
+	services->thread = g_thread_new ("fake-services", gpm_bench_services_thread, services);
+
+	g_mutex_lock (&services->mutex);
+	while (!services->ready)
+		g_cond_wait (&services->cond, &services->mutex);
+	g_mutex_unlock (&services->mutex);
+	return services;
+}
+
+/**
+ * gpm_bench_services_get_slept_at:
+ **/
+static gint64
+gpm_bench_services_get_slept_at (GpmBenchServices *services)
+{
+	gint64 slept_at;
+
+	g_mutex_lock (&services->mutex);
+	slept_at = services->slept_at;
+	g_mutex_unlock (&services->mutex);
+	return slept_at;
+}
+
+/**
+ * gpm_bench_services_free:
+ **/
+static void
+gpm_bench_services_free (GpmBenchServices *services)
+{
+	g_main_loop_quit (services->loop);
+	g_thread_join (services->thread);
+	g_main_loop_unref (services->loop);
+	g_main_context_unref (services->context);
+	g_dbus_node_info_unref (services->introspection);
+	g_mutex_clear (&services->mutex);
+	g_cond_clear (&services->cond);
+	g_free (services->address);
+	g_free (services);
+}
+
+/**
+ * gpm_bench_sleep_cb:
+ **/
+static void
+gpm_bench_sleep_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	GMainLoop *loop = (GMainLoop *) user_data;
+	GError *error = NULL;
+
+	if (!g_task_propagate_boolean (G_TASK (res), &error)) {
+		g_printerr ("failed to sleep: %s\n", error->message);
+		g_error_free (error);
+	}
+	g_main_loop_quit (loop);
+}
+
+/**
+ * main:
+ **/
+int
+main (int argc, char *argv[])
+{
+	GOptionContext *context;
+	GTestDBus *bus;
+	GpmBenchServices *services;
+	GpmControl *control;
+	GMainLoop *loop;
+	GError *error = NULL;
+	gint iterations = 10;
+	gint lock_delay = 0;
+	gboolean hibernate = FALSE;
+	gboolean ret = FALSE;
+	gdouble elapsed;
+	gdouble total = 0.0f;
+	gdouble min = G_MAXDOUBLE;
+	gdouble max = 0.0f;
+	gint64 start;
+	gint64 slept_at;
+	gint i;
+
+	const GOptionEntry options[] = {
+		{ "iterations", '\0', 0, G_OPTION_ARG_INT, &iterations,
+		  "Number of times to go to sleep", NULL },
+		{ "lock-delay", '\0', 0, G_OPTION_ARG_INT, &lock_delay,
+		  "Time the screensaver takes to lock, in ms", NULL },
+		{ "hibernate", '\0', 0, G_OPTION_ARG_NONE, &hibernate,
+		  "Hibernate rather than suspend", NULL },
+		{ NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL }
+	};
+
+	context = g_option_context_new (NULL);
+	g_option_context_add_main_entries (context, options, NULL);
+	g_option_context_set_summary (context, "Measure the time GpmControl takes to go to sleep");
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		goto out;
+	}
+	if (iterations <= 0 || lock_delay < 0) {
+		g_printerr ("%s", g_option_context_get_help (context, TRUE, NULL));
+		goto out;
+	}
+
+	/* never touch the real settings or buses */
+	g_setenv ("GSETTINGS_BACKEND", "memory", FALSE);
+	bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+	g_test_dbus_up (bus);
+	g_setenv ("DBUS_SYSTEM_BUS_ADDRESS", g_test_dbus_get_bus_address (bus), TRUE);
+
+	services = gpm_bench_services_new (g_test_dbus_get_bus_address (bus), lock_delay);
+	control = gpm_control_new ();
+	loop = g_main_loop_new (NULL, FALSE);
+
+	ret = TRUE;
+	for (i = 0; i < iterations; i++) {
+		start = g_get_monotonic_time ();
+		if (hibernate)
+			gpm_control_hibernate_async (control, gpm_bench_sleep_cb, loop);
+		else
+			gpm_control_suspend_async (control, gpm_bench_sleep_cb, loop);
+		g_main_loop_run (loop);
+
+		slept_at = gpm_bench_services_get_slept_at (services);
+		if (slept_at < start) {
+			g_printerr ("the sleep request never arrived\n");
+			ret = FALSE;
+			break;
+		}
+		elapsed = (slept_at - start) / 1000.0f;
+		g_print ("%i\t%.1fms\n", i + 1, elapsed);
+		total += elapsed;
+		min = MIN (min, elapsed);
+		max = MAX (max, elapsed);
+	}
+	if (ret)
+		g_print ("time to sleep: min %.1fms, mean %.1fms, max %.1fms\n",
+			 min, total / iterations, max);
+
+	g_main_loop_unref (loop);
+	g_object_unref (control);
+	gpm_bench_services_free (services);
+	g_test_dbus_down (bus);
+	g_object_unref (bus);
+out:
+	g_option_context_free (context);
+	return ret ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,407 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Keeps a timeline of the daemon starting up. Subsystems that are needed
+ * straight away are timed with begin and end, even when they finish
+ * asynchronously, and the rest are deferred to run one at a time once the
+ * main loop is running. When everything has finished the timeline is
+ * logged and ::finished is emitted.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <glib.h>
+
+#include "gpm-startup.h"
+
+static void     gpm_startup_finalize   (GObject	  *object);
+
+typedef struct {
+	gchar			*name;
+	gint64			 begin;
+	gint64			 end;
+} GpmStartupItem;
+
+typedef struct {
+	gchar			*name;
+	GpmStartupFunc		 func;
+	gpointer		 user_data;
+} GpmStartupDeferred;
+
+struct GpmStartupPrivate
+{
+	gint64			 start;
+	GPtrArray		*items;
+	GQueue			*deferred;
+	guint			 pending;
+	guint			 idle_id;
+	gboolean		 finished;
+};
+
+enum {
+	FINISHED,
+	LAST_SIGNAL
+};
+
+static guint signals [LAST_SIGNAL] = { 0 };
+static gpointer gpm_startup_object = NULL;
+
+G_DEFINE_TYPE_WITH_PRIVATE (GpmStartup, gpm_startup, G_TYPE_OBJECT)
+
+static void	gpm_startup_schedule	(GpmStartup	*startup);
+
+/**
+ * gpm_startup_item_free:
+ **/
+static void
+gpm_startup_item_free (GpmStartupItem *item)
+{
+	g_free (item->name);
+	g_free (item);
+}
+
+/**
+ * gpm_startup_begin:
+ * @startup: This class instance
+ * @name: The subsystem, which must be passed to gpm_startup_end() later
+ **/
+void
+gpm_startup_begin (GpmStartup *startup, const gchar *name)
+{
+	GpmStartupItem *item;
+
+	g_return_if_fail (GPM_IS_STARTUP (startup));
+	g_return_if_fail (name != NULL);
+
+	item = g_new0 (GpmStartupItem, 1);
+	item->name = g_strdup (name);
+	item->begin = g_get_monotonic_time ();
+	g_ptr_array_add (startup->priv->items, item);
+	startup->priv->pending++;
+}
+
+/**
+ * gpm_startup_end:
+ **/
+void
+gpm_startup_end (GpmStartup *startup, const gchar *name)
+{
+	GpmStartupItem *item;
+	guint i;
+
+	g_return_if_fail (GPM_IS_STARTUP (startup));
+	g_return_if_fail (name != NULL);
+
+	for (i = startup->priv->items->len; i > 0; i--) {
+		item = g_ptr_array_index (startup->priv->items, i - 1);
+		if (item->end != 0 || g_strcmp0 (item->name, name) != 0)
+			continue;
+		item->end = g_get_monotonic_time ();
+		startup->priv->pending--;
+
+		/* the last to finish may finish the startup */
+		if (startup->priv->pending == 0)
+			gpm_startup_schedule (startup);
+		return;
+	}
+	g_warning ("%s was not started", name);
+}
+
+/**
+ * gpm_startup_defer:
+ * @startup: This class instance
+ * @name: The subsystem
+ * @func: The function that starts it
+ * @user_data: User data for @func
+ *
+ * Runs @func from an idle callback once the main loop is running, after
+ * anything deferred before it.
+ **/
+void
+gpm_startup_defer (GpmStartup *startup, const gchar *name, GpmStartupFunc func, gpointer user_data)
+{
+	GpmStartupDeferred *deferred;
+
+	g_return_if_fail (GPM_IS_STARTUP (startup));
+	g_return_if_fail (func != NULL);
+
+	deferred = g_new0 (GpmStartupDeferred, 1);
+	deferred->name = g_strdup (name);
+	deferred->func = func;
+	deferred->user_data = user_data;
+	g_queue_push_tail (startup->priv->deferred, deferred);
+	gpm_startup_schedule (startup);
+}
+
+/**
+ * gpm_startup_get_timeline:
+ *
+ * Return value: one line per subsystem with when it started and how long
+ * it took, both in ms
+ **/
+gchar *
+gpm_startup_get_timeline (GpmStartup *startup)
+{
+	GpmStartupItem *item;
+	GString *string;
+	guint i;
+
+	g_return_val_if_fail (GPM_IS_STARTUP (startup), NULL);
+
+	string = g_string_new ("");
+	for (i = 0; i < startup->priv->items->len; i++) {
+		item = g_ptr_array_index (startup->priv->items, i);
+		g_string_append_printf (string, "%8.1fms ",
+					(item->begin - startup->priv->start) / 1000.0f);
+		if (item->end != 0)
+			g_string_append_printf (string, "%8.1fms ", (item->end - item->begin) / 1000.0f);
+		else
+			g_string_append (string, " running   ");
+		g_string_append_printf (string, " %s\n", item->name);
+	}
+	return g_string_free (string, FALSE);
+}
+
+/**
+ * gpm_startup_is_finished:
+ **/
+gboolean
+gpm_startup_is_finished (GpmStartup *startup)
+{
+	g_return_val_if_fail (GPM_IS_STARTUP (startup), FALSE);
+	return startup->priv->finished;
+}
+
+/**
+ * gpm_startup_idle_cb:
+ *
+ * Runs one deferred subsystem each time, so that events can be handled
+ * between them.
+ **/
+static gboolean
+gpm_startup_idle_cb (GpmStartup *startup)
+{
+	GpmStartupDeferred *deferred;
+	gchar *timeline;
+
+	deferred = g_queue_pop_head (startup->priv->deferred);
+	if (deferred != NULL) {
+		gpm_startup_begin (startup, deferred->name);
+		deferred->func (deferred->user_data);
+		gpm_startup_end (startup, deferred->name);
+		g_free (deferred->name);
+		g_free (deferred);
+		if (!g_queue_is_empty (startup->priv->deferred))
+			return TRUE;
+	}
+	startup->priv->idle_id = 0;
+
+	if (startup->priv->pending > 0 || startup->priv->finished)
+		return FALSE;
+
+	startup->priv->finished = TRUE;
+	timeline = gpm_startup_get_timeline (startup);
+	g_debug ("started in %.1fms:\n%s",
+		 (g_get_monotonic_time () - startup->priv->start) / 1000.0f, timeline);
+	g_free (timeline);
+	g_signal_emit (startup, signals [FINISHED], 0);
+	return FALSE;
+}
+
+/**
+ * gpm_startup_schedule:
+ **/
+static void
+gpm_startup_schedule (GpmStartup *startup)
+{
+	if (startup->priv->idle_id != 0 || startup->priv->finished)
+		return;
+	startup->priv->idle_id = g_idle_add_full (G_PRIORITY_LOW, (GSourceFunc) gpm_startup_idle_cb,
+						  startup, NULL);
+	g_source_set_name_by_id (startup->priv->idle_id, "[GpmStartup] idle");
+}
+
+/**
+ * gpm_startup_class_init:
+ * @klass: This class instance
+ **/
+static void
+gpm_startup_class_init (GpmStartupClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = gpm_startup_finalize;
+
+	signals [FINISHED] =
+		g_signal_new ("finished",
+			      G_TYPE_FROM_CLASS (object_class),
+			      G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (GpmStartupClass, finished),
+			      NULL, NULL, g_cclosure_marshal_VOID__VOID,
+			      G_TYPE_NONE, 0);
+}
+
+/**
+ * gpm_startup_init:
+ * @startup: This class instance
+ **/
+static void
+gpm_startup_init (GpmStartup *startup)
+{
+	startup->priv = gpm_startup_get_instance_private (startup);
+	startup->priv->start = g_get_monotonic_time ();
+	startup->priv->items = g_ptr_array_new_with_free_func ((GDestroyNotify) gpm_startup_item_free);
+	startup->priv->deferred = g_queue_new ();
+}
+
+/**
+ * gpm_startup_deferred_free:
+ **/
+static void
+gpm_startup_deferred_free (GpmStartupDeferred *deferred)
+{
+	g_free (deferred->name);
+	g_free (deferred);
+}
+
+/**
+ * gpm_startup_finalize:
+ * @object: This class instance
+ **/
+static void
+gpm_startup_finalize (GObject *object)
+{
+	GpmStartup *startup;
+	g_return_if_fail (object != NULL);
+	g_return_if_fail (GPM_IS_STARTUP (object));
+
+	startup = GPM_STARTUP (object);
+	if (startup->priv->idle_id != 0)
+		g_source_remove (startup->priv->idle_id);
+	g_queue_free_full (startup->priv->deferred, (GDestroyNotify) gpm_startup_deferred_free);
+	g_ptr_array_unref (startup->priv->items);
+
+	G_OBJECT_CLASS (gpm_startup_parent_class)->finalize (object);
+}
+
+/**
+ * gpm_startup_new:
+ * Return value: new GpmStartup instance.
+ **/
+GpmStartup *
+gpm_startup_new (void)
+{
+	if (gpm_startup_object != NULL) {
+		g_object_ref (gpm_startup_object);
+	} else {
+		gpm_startup_object = g_object_new (GPM_TYPE_STARTUP, NULL);
+		g_object_add_weak_pointer (gpm_startup_object, &gpm_startup_object);
+	}
+	return GPM_STARTUP (gpm_startup_object);
+}
+
+/***************************************************************************
+ ***                          MAKE CHECK TESTS                           ***
+ ***************************************************************************/
+#ifdef EGG_TEST
+#include "egg-test.h"
+
+static GString *test_order = NULL;
+
+static void
+gpm_startup_test_deferred_cb (gpointer user_data)
+{
+	g_string_append (test_order, user_data);
+}
+
+static gboolean
+gpm_startup_test_async_cb (GpmStartup *startup)
+{
+	g_string_append (test_order, "c");
+	gpm_startup_end (startup, "async");
+	return FALSE;
+}
+
+static void
+gpm_startup_test_finished_cb (GpmStartup *startup, GMainLoop *loop)
+{
+	g_main_loop_quit (loop);
+}
+
+void
+gpm_startup_test (gpointer data)
+{
+	GpmStartup *startup;
+	GMainLoop *loop;
+	gchar *timeline;
+	EggTest *test = (EggTest *) data;
+
+	if (egg_test_start (test, "GpmStartup") == FALSE)
+		return;
+
+	/************************************************************/
+	egg_test_title (test, "make sure we get a non null startup");
+	startup = gpm_startup_new ();
+	egg_test_assert (test, (startup != NULL));
+
+	/************************************************************/
+	egg_test_title (test, "not finished before the loop runs");
+	test_order = g_string_new ("");
+	loop = g_main_loop_new (NULL, FALSE);
+	g_signal_connect (startup, "finished", G_CALLBACK (gpm_startup_test_finished_cb), loop);
+	gpm_startup_begin (startup, "sync");
+	gpm_startup_end (startup, "sync");
+	gpm_startup_begin (startup, "async");
+	g_timeout_add (50, (GSourceFunc) gpm_startup_test_async_cb, startup);
+	gpm_startup_defer (startup, "first", gpm_startup_test_deferred_cb, "a");
+	gpm_startup_defer (startup, "second", gpm_startup_test_deferred_cb, "b");
+	egg_test_assert (test, !gpm_startup_is_finished (startup));
+
+	/************************************************************/
+	egg_test_title (test, "deferred run in order, then the async one finishes");
+	g_main_loop_run (loop);
+	if (g_strcmp0 (test_order->str, "abc") == 0 && gpm_startup_is_finished (startup))
+		egg_test_success (test, NULL);
+	else
+		egg_test_failed (test, "order was %s", test_order->str);
+
+	/************************************************************/
+	egg_test_title (test, "timeline has everything");
+	timeline = gpm_startup_get_timeline (startup);
+	if (strstr (timeline, " sync\n") != NULL &&
+	    strstr (timeline, " async\n") != NULL &&
+	    strstr (timeline, " first\n") != NULL &&
+	    strstr (timeline, " second\n") != NULL &&
+	    strstr (timeline, "running") == NULL)
+		egg_test_success (test, NULL);
+	else
+		egg_test_failed (test, "timeline was %s", timeline);
+	g_free (timeline);
+
+	g_main_loop_unref (loop);
+	g_string_free (test_order, TRUE);
+	g_object_unref (startup);
+
+	egg_test_end (test);
+}
+
+#endif
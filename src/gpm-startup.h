@@ -0,0 +1,69 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __GPM_STARTUP_H
+#define __GPM_STARTUP_H
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define GPM_TYPE_STARTUP		(gpm_startup_get_type ())
+#define GPM_STARTUP(o)			(G_TYPE_CHECK_INSTANCE_CAST ((o), GPM_TYPE_STARTUP, GpmStartup))
+#define GPM_STARTUP_CLASS(k)		(G_TYPE_CHECK_CLASS_CAST((k), GPM_TYPE_STARTUP, GpmStartupClass))
+#define GPM_IS_STARTUP(o)		(G_TYPE_CHECK_INSTANCE_TYPE ((o), GPM_TYPE_STARTUP))
+#define GPM_IS_STARTUP_CLASS(k)		(G_TYPE_CHECK_CLASS_TYPE ((k), GPM_TYPE_STARTUP))
+#define GPM_STARTUP_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), GPM_TYPE_STARTUP, GpmStartupClass))
+
+typedef struct GpmStartupPrivate GpmStartupPrivate;
+
+typedef struct
+{
+	GObject			 parent;
+	GpmStartupPrivate	*priv;
+} GpmStartup;
+
+typedef struct
+{
+	GObjectClass	parent_class;
+	void		(* finished)			(GpmStartup	*startup);
+} GpmStartupClass;
+
+typedef void	(* GpmStartupFunc)			(gpointer	 user_data);
+
+GType		 gpm_startup_get_type			(void);
+GpmStartup	*gpm_startup_new			(void);
+void		 gpm_startup_test			(gpointer	 data);
+
+void		 gpm_startup_begin			(GpmStartup	*startup,
+							 const gchar	*name);
+void		 gpm_startup_end			(GpmStartup	*startup,
+							 const gchar	*name);
+void		 gpm_startup_defer			(GpmStartup	*startup,
+							 const gchar	*name,
+							 GpmStartupFunc	 func,
+							 gpointer	 user_data);
+gboolean	 gpm_startup_is_finished		(GpmStartup	*startup);
+gchar		*gpm_startup_get_timeline		(GpmStartup	*startup);
+
+G_END_DECLS
+
+#endif /* __GPM_STARTUP_H */
@@ -0,0 +1,601 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * One wakeup for all the timers in the daemon. Every timer has a deadline
+ * and some slack it can go off late by, and the deadlines are kept in a
+ * min-heap ordered by the latest each timer can go off. Only that one
+ * time is armed, on a timerfd where there is one. When it goes off,
+ * every timer whose deadline has passed goes off with it, so timers
+ * with slack merge into the wakeups of the others.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <glib.h>
+#ifdef HAVE_SYS_TIMERFD_H
+#include <errno.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#endif /* HAVE_SYS_TIMERFD_H */
+
+#include "gpm-timer.h"
+
+static void     gpm_timer_finalize   (GObject	  *object);
+
+typedef struct
+{
+	guint			 id;
+	guint			 index;		/* in the heap */
+	gint64			 deadline;	/* monotonic, in us */
+	gint64			 latest;	/* deadline plus slack */
+	guint			 interval;	/* ms */
+	guint			 slack;		/* ms */
+	const gchar		*name;		/* interned */
+	GSourceFunc		 func;
+	gpointer		 user_data;
+} GpmTimerEntry;
+
+typedef struct
+{
+	GSource			 source;
+	GpmTimer		*timer;
+} GpmTimerSource;
+
+struct GpmTimerPrivate
+{
+	GPtrArray		*heap;		/* of GpmTimerEntry, on latest */
+	GHashTable		*entries;	/* id to GpmTimerEntry */
+	guint			 next_id;
+	GSource			*source;
+	gint			 fd;		/* timerfd, or -1 */
+#ifdef HAVE_SYS_TIMERFD_H
+	gpointer		 source_tag;
+#endif /* HAVE_SYS_TIMERFD_H */
+	gint64			 armed;		/* or -1 */
+	guint			 wakeups;
+};
+
+/* read from the watchdog thread */
+static const gchar *gpm_timer_dispatching = NULL;
+
+static gpointer gpm_timer_object = NULL;
+
+G_DEFINE_TYPE_WITH_PRIVATE (GpmTimer, gpm_timer, G_TYPE_OBJECT)
+
+/**
+ * gpm_timer_entry_free:
+ **/
+static void
+gpm_timer_entry_free (GpmTimerEntry *entry)
+{
+	g_free (entry);
+}
+
+/**
+ * gpm_timer_heap_before:
+ **/
+static gboolean
+gpm_timer_heap_before (GpmTimerEntry *a, GpmTimerEntry *b)
+{
+	if (a->latest != b->latest)
+		return a->latest < b->latest;
+	return a->id < b->id;
+}
+
+/**
+ * gpm_timer_heap_swap:
+ **/
+static void
+gpm_timer_heap_swap (GPtrArray *heap, guint i, guint j)
+{
+	GpmTimerEntry *a = g_ptr_array_index (heap, i);
+	GpmTimerEntry *b = g_ptr_array_index (heap, j);
+
+	heap->pdata[i] = b;
+	heap->pdata[j] = a;
+	b->index = i;
+	a->index = j;
+}
+
+/**
+ * gpm_timer_heap_up:
+ **/
+static void
+gpm_timer_heap_up (GPtrArray *heap, guint i)
+{
+	guint parent;
+
+	while (i > 0) {
+		parent = (i - 1) / 2;
+		if (!gpm_timer_heap_before (g_ptr_array_index (heap, i),
+					    g_ptr_array_index (heap, parent)))
+			break;
+		gpm_timer_heap_swap (heap, i, parent);
+		i = parent;
+	}
+}
+
+/**
+ * gpm_timer_heap_down:
+ **/
+static void
+gpm_timer_heap_down (GPtrArray *heap, guint i)
+{
+	guint child;
+
+	while ((child = 2 * i + 1) < heap->len) {
+		if (child + 1 < heap->len &&
+		    gpm_timer_heap_before (g_ptr_array_index (heap, child + 1),
+					   g_ptr_array_index (heap, child)))
+			child++;
+		if (!gpm_timer_heap_before (g_ptr_array_index (heap, child),
+					    g_ptr_array_index (heap, i)))
+			break;
+		gpm_timer_heap_swap (heap, i, child);
+		i = child;
+	}
+}
+
+/**
+ * gpm_timer_heap_fix:
+ *
+ * Moves an entry to where it belongs after its latest time changed.
+ **/
+static void
+gpm_timer_heap_fix (GPtrArray *heap, guint i)
+{
+	gpm_timer_heap_up (heap, i);
+	gpm_timer_heap_down (heap, i);
+}
+
+/**
+ * gpm_timer_arm:
+ *
+ * Sets the one wakeup for the latest the first timer can go off.
+ **/
+static void
+gpm_timer_arm (GpmTimer *timer)
+{
+	GpmTimerEntry *entry;
+	gint64 wake = -1;
+#ifdef HAVE_SYS_TIMERFD_H
+	struct itimerspec spec;
+#endif /* HAVE_SYS_TIMERFD_H */
+
+	if (timer->priv->heap->len > 0) {
+		entry = g_ptr_array_index (timer->priv->heap, 0);
+		wake = MAX (entry->latest, 1);
+	}
+	if (wake == timer->priv->armed)
+		return;
+	timer->priv->armed = wake;
+
+#ifdef HAVE_SYS_TIMERFD_H
+	if (timer->priv->fd >= 0) {
+		/* all zero disarms it */
+		memset (&spec, 0, sizeof (spec));
+		if (wake > 0) {
+			spec.it_value.tv_sec = wake / G_USEC_PER_SEC;
+			spec.it_value.tv_nsec = (wake % G_USEC_PER_SEC) * 1000;
+		}
+		if (timerfd_settime (timer->priv->fd, TFD_TIMER_ABSTIME, &spec, NULL) == 0)
+			return;
+		g_warning ("failed to set timerfd: %s", g_strerror (errno));
+		g_source_remove_unix_fd (timer->priv->source, timer->priv->source_tag);
+		close (timer->priv->fd);
+		timer->priv->fd = -1;
+	}
+#endif /* HAVE_SYS_TIMERFD_H */
+	g_source_set_ready_time (timer->priv->source, wake);
+}
+
+/**
+ * gpm_timer_entry_remove:
+ **/
+static void
+gpm_timer_entry_remove (GpmTimer *timer, GpmTimerEntry *entry)
+{
+	GPtrArray *heap = timer->priv->heap;
+	guint index = entry->index;
+
+	if (index != heap->len - 1)
+		gpm_timer_heap_swap (heap, index, heap->len - 1);
+	g_ptr_array_set_size (heap, heap->len - 1);
+	if (index < heap->len)
+		gpm_timer_heap_fix (heap, index);
+	g_hash_table_remove (timer->priv->entries, GUINT_TO_POINTER (entry->id));
+}
+
+/**
+ * gpm_timer_entry_compare:
+ **/
+static gint
+gpm_timer_entry_compare (GpmTimerEntry **a, GpmTimerEntry **b)
+{
+	if ((*a)->deadline != (*b)->deadline)
+		return (*a)->deadline < (*b)->deadline ? -1 : 1;
+	return (*a)->id < (*b)->id ? -1 : 1;
+}
+
+/**
+ * gpm_timer_dispatch:
+ *
+ * Fires every timer that is due, not only the one that could not wait.
+ **/
+static void
+gpm_timer_dispatch (GpmTimer *timer)
+{
+	GpmTimerEntry *entry;
+	GPtrArray *due;
+	const gchar *previous;
+	gint64 now;
+	guint *ids;
+	guint n_ids;
+	gboolean ret;
+	guint i;
+
+	timer->priv->wakeups++;
+	timer->priv->armed = -1;
+	g_source_set_ready_time (timer->priv->source, -1);
+	now = g_get_monotonic_time ();
+
+	/* callbacks can add and remove timers, so only keep the ids */
+	due = g_ptr_array_new ();
+	for (i=0; i<timer->priv->heap->len; i++) {
+		entry = g_ptr_array_index (timer->priv->heap, i);
+		if (entry->deadline <= now)
+			g_ptr_array_add (due, entry);
+	}
+	g_ptr_array_sort (due, (GCompareFunc) gpm_timer_entry_compare);
+	n_ids = due->len;
+	ids = g_new (guint, n_ids);
+	for (i=0; i<n_ids; i++)
+		ids[i] = ((GpmTimerEntry *) g_ptr_array_index (due, i))->id;
+	g_ptr_array_unref (due);
+
+	for (i=0; i<n_ids; i++) {
+		entry = g_hash_table_lookup (timer->priv->entries, GUINT_TO_POINTER (ids[i]));
+		if (entry == NULL)
+			continue;
+		previous = g_atomic_pointer_get (&gpm_timer_dispatching);
+		g_atomic_pointer_set (&gpm_timer_dispatching,
+				      entry->name != NULL ? entry->name : "unnamed timer");
+		ret = entry->func (entry->user_data);
+		g_atomic_pointer_set (&gpm_timer_dispatching, previous);
+
+		/* it can have removed itself */
+		entry = g_hash_table_lookup (timer->priv->entries, GUINT_TO_POINTER (ids[i]));
+		if (entry == NULL)
+			continue;
+		if (ret) {
+			entry->deadline = now + (gint64) entry->interval * 1000;
+			entry->latest = entry->deadline + (gint64) entry->slack * 1000;
+			gpm_timer_heap_fix (timer->priv->heap, entry->index);
+		} else {
+			gpm_timer_entry_remove (timer, entry);
+		}
+	}
+	g_free (ids);
+
+	gpm_timer_arm (timer);
+}
+
+/**
+ * gpm_timer_source_dispatch:
+ **/
+static gboolean
+gpm_timer_source_dispatch (GSource *source, GSourceFunc callback, gpointer user_data)
+{
+	GpmTimer *timer = ((GpmTimerSource *) source)->timer;
+#ifdef HAVE_SYS_TIMERFD_H
+	guint64 expirations;
+
+	/* just to clear it */
+	if (timer->priv->fd >= 0 &&
+	    read (timer->priv->fd, &expirations, sizeof (expirations)) < 0 &&
+	    errno != EAGAIN)
+		g_warning ("failed to read timerfd: %s", g_strerror (errno));
+#endif /* HAVE_SYS_TIMERFD_H */
+	gpm_timer_dispatch (timer);
+	return G_SOURCE_CONTINUE;
+}
+
+static GSourceFuncs gpm_timer_source_funcs = {
+	NULL,
+	NULL,
+	gpm_timer_source_dispatch,
+	NULL
+};
+
+/**
+ * gpm_timer_add:
+ * @interval: How long until it goes off, in ms
+ * @slack: How much later than that it can go off, in ms
+ * @name: A name for debugging, e.g. "[GpmDpms] poll"
+ * @func: Called when it goes off, returning %TRUE to go off again
+ *
+ * Like g_timeout_add(), but sharing its wakeup with any other timer
+ * that is due by the time @slack has run out.
+ *
+ * Return value: the id to pass to gpm_timer_remove()
+ **/
+guint
+gpm_timer_add (GpmTimer *timer, guint interval, guint slack, const gchar *name,
+	       GSourceFunc func, gpointer user_data)
+{
+	GpmTimerEntry *entry;
+
+	g_return_val_if_fail (GPM_IS_TIMER (timer), 0);
+	g_return_val_if_fail (func != NULL, 0);
+
+	entry = g_new0 (GpmTimerEntry, 1);
+	entry->id = timer->priv->next_id++;
+	entry->deadline = g_get_monotonic_time () + (gint64) interval * 1000;
+	entry->latest = entry->deadline + (gint64) slack * 1000;
+	entry->interval = interval;
+	entry->slack = slack;
+	entry->name = g_intern_string (name);
+	entry->func = func;
+	entry->user_data = user_data;
+	g_hash_table_insert (timer->priv->entries, GUINT_TO_POINTER (entry->id), entry);
+
+	entry->index = timer->priv->heap->len;
+	g_ptr_array_add (timer->priv->heap, entry);
+	gpm_timer_heap_up (timer->priv->heap, entry->index);
+	gpm_timer_arm (timer);
+	return entry->id;
+}
+
+/**
+ * gpm_timer_add_seconds:
+ * @interval: How long until it goes off, in seconds
+ *
+ * Like g_timeout_add_seconds(), for timers that can be a second late.
+ **/
+guint
+gpm_timer_add_seconds (GpmTimer *timer, guint interval, const gchar *name,
+		       GSourceFunc func, gpointer user_data)
+{
+	return gpm_timer_add (timer, interval * 1000, GPM_TIMER_SLACK_SECONDS, name, func, user_data);
+}
+
+/**
+ * gpm_timer_remove:
+ *
+ * Return value: %TRUE if the timer had not already gone off for good
+ **/
+gboolean
+gpm_timer_remove (GpmTimer *timer, guint id)
+{
+	GpmTimerEntry *entry;
+
+	g_return_val_if_fail (GPM_IS_TIMER (timer), FALSE);
+
+	entry = g_hash_table_lookup (timer->priv->entries, GUINT_TO_POINTER (id));
+	if (entry == NULL)
+		return FALSE;
+	gpm_timer_entry_remove (timer, entry);
+	gpm_timer_arm (timer);
+	return TRUE;
+}
+
+/**
+ * gpm_timer_get_dispatching:
+ *
+ * Can be called from any thread, to find out what the main loop is
+ * stuck in.
+ *
+ * Return value: the name of the timer being run, or %NULL
+ **/
+const gchar *
+gpm_timer_get_dispatching (void)
+{
+	return g_atomic_pointer_get (&gpm_timer_dispatching);
+}
+
+/**
+ * gpm_timer_get_wakeups:
+ *
+ * Return value: how many times the timers have woken the daemon
+ **/
+guint
+gpm_timer_get_wakeups (GpmTimer *timer)
+{
+	g_return_val_if_fail (GPM_IS_TIMER (timer), 0);
+	return timer->priv->wakeups;
+}
+
+/**
+ * gpm_timer_class_init:
+ * @klass: This class instance
+ **/
+static void
+gpm_timer_class_init (GpmTimerClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = gpm_timer_finalize;
+}
+
+/**
+ * gpm_timer_init:
+ **/
+static void
+gpm_timer_init (GpmTimer *timer)
+{
+	timer->priv = gpm_timer_get_instance_private (timer);
+
+	timer->priv->heap = g_ptr_array_new ();
+	timer->priv->entries = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+						      NULL, (GDestroyNotify) gpm_timer_entry_free);
+	timer->priv->next_id = 1;
+	timer->priv->armed = -1;
+	timer->priv->fd = -1;
+
+	timer->priv->source = g_source_new (&gpm_timer_source_funcs, sizeof (GpmTimerSource));
+	((GpmTimerSource *) timer->priv->source)->timer = timer;
+	g_source_set_name (timer->priv->source, "[GpmTimer] wakeup");
+#ifdef HAVE_SYS_TIMERFD_H
+	timer->priv->fd = timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (timer->priv->fd >= 0)
+		timer->priv->source_tag = g_source_add_unix_fd (timer->priv->source, timer->priv->fd, G_IO_IN);
+	else
+		g_debug ("no timerfd, using the main loop timeout: %s", g_strerror (errno));
+#endif /* HAVE_SYS_TIMERFD_H */
+	g_source_attach (timer->priv->source, NULL);
+}
+
+/**
+ * gpm_timer_finalize:
+ * @object: This class instance
+ **/
+static void
+gpm_timer_finalize (GObject *object)
+{
+	GpmTimer *timer;
+	g_return_if_fail (object != NULL);
+	g_return_if_fail (GPM_IS_TIMER (object));
+
+	timer = GPM_TIMER (object);
+	g_source_destroy (timer->priv->source);
+	g_source_unref (timer->priv->source);
+#ifdef HAVE_SYS_TIMERFD_H
+	if (timer->priv->fd >= 0)
+		close (timer->priv->fd);
+#endif /* HAVE_SYS_TIMERFD_H */
+	g_ptr_array_unref (timer->priv->heap);
+	g_hash_table_unref (timer->priv->entries);
+
+	G_OBJECT_CLASS (gpm_timer_parent_class)->finalize (object);
+}
+
+/**
+ * gpm_timer_new:
+ * Return value: The shared GpmTimer instance.
+ **/
+GpmTimer *
+gpm_timer_new (void)
+{
+	if (gpm_timer_object != NULL) {
+		g_object_ref (gpm_timer_object);
+	} else {
+		gpm_timer_object = g_object_new (GPM_TYPE_TIMER, NULL);
+		g_object_add_weak_pointer (gpm_timer_object, &gpm_timer_object);
+	}
+	return GPM_TIMER (gpm_timer_object);
+}
+
+/***************************************************************************
+ ***                          MAKE CHECK TESTS                           ***
+ ***************************************************************************/
+#ifdef EGG_TEST
+#include "egg-test.h"
+
+static guint test_fired = 0;
+
+static gboolean
+gpm_timer_test_count_cb (gpointer user_data)
+{
+	test_fired++;
+	return FALSE;
+}
+
+static gboolean
+gpm_timer_test_repeat_cb (guint *count)
+{
+	(*count)++;
+	return *count < 3;
+}
+
+static gboolean
+gpm_timer_test_quit_cb (GMainLoop *loop)
+{
+	g_main_loop_quit (loop);
+	return FALSE;
+}
+
+void
+gpm_timer_test (gpointer data)
+{
+	GpmTimer *timer;
+	GMainLoop *loop;
+	EggTest *test = (EggTest *) data;
+	guint count = 0;
+	guint wakeups;
+	guint id;
+	guint i;
+
+	if (!egg_test_start (test, "GpmTimer"))
+		return;
+
+	/************************************************************/
+	egg_test_title (test, "get object");
+	timer = gpm_timer_new ();
+	egg_test_assert (test, (timer != NULL));
+	loop = g_main_loop_new (NULL, FALSE);
+
+	/************************************************************/
+	egg_test_title (test, "check timers with slack go off with the first that cannot wait");
+	gpm_timer_add (timer, 100, 50, "[GpmTimer] test a", gpm_timer_test_count_cb, NULL);
+	gpm_timer_add (timer, 120, 100, "[GpmTimer] test b", gpm_timer_test_count_cb, NULL);
+	gpm_timer_add (timer, 140, 0, "[GpmTimer] test c", gpm_timer_test_count_cb, NULL);
+	gpm_timer_add (timer, 400, 0, "[GpmTimer] test quit", (GSourceFunc) gpm_timer_test_quit_cb, loop);
+	wakeups = gpm_timer_get_wakeups (timer);
+	g_main_loop_run (loop);
+	if (test_fired == 3 && gpm_timer_get_wakeups (timer) - wakeups == 2)
+		egg_test_success (test, NULL);
+	else
+		egg_test_failed (test, "fired %u in %u wakeups", test_fired,
+				 gpm_timer_get_wakeups (timer) - wakeups);
+
+	/************************************************************/
+	egg_test_title (test, "check a removed timer does not go off");
+	test_fired = 0;
+	id = gpm_timer_add (timer, 50, 0, "[GpmTimer] test removed", gpm_timer_test_count_cb, NULL);
+	gpm_timer_add (timer, 100, 0, "[GpmTimer] test quit", (GSourceFunc) gpm_timer_test_quit_cb, loop);
+	egg_test_assert (test, gpm_timer_remove (timer, id));
+	g_main_loop_run (loop);
+	egg_test_assert (test, (test_fired == 0));
+
+	/************************************************************/
+	egg_test_title (test, "check a timer goes off until it returns FALSE");
+	gpm_timer_add (timer, 10, 0, "[GpmTimer] test repeat", (GSourceFunc) gpm_timer_test_repeat_cb, &count);
+	gpm_timer_add (timer, 200, 0, "[GpmTimer] test quit", (GSourceFunc) gpm_timer_test_quit_cb, loop);
+	g_main_loop_run (loop);
+	egg_test_assert (test, (count == 3));
+
+	/************************************************************/
+	egg_test_title (test, "check many timers stay in deadline order");
+	test_fired = 0;
+	for (i=0; i<1000; i++)
+		gpm_timer_add (timer, (i * 7919) % 100, 0, "[GpmTimer] test many", gpm_timer_test_count_cb, NULL);
+	gpm_timer_add (timer, 150, 0, "[GpmTimer] test quit", (GSourceFunc) gpm_timer_test_quit_cb, loop);
+	g_main_loop_run (loop);
+	egg_test_assert (test, (test_fired == 1000 && timer->priv->heap->len == 0));
+
+	g_main_loop_unref (loop);
+	g_object_unref (timer);
+
+	egg_test_end (test);
+}
+
+#endif
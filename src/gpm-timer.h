@@ -0,0 +1,74 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __GPM_TIMER_H
+#define __GPM_TIMER_H
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define GPM_TYPE_TIMER		(gpm_timer_get_type ())
+#define GPM_TIMER(o)		(G_TYPE_CHECK_INSTANCE_CAST ((o), GPM_TYPE_TIMER, GpmTimer))
+#define GPM_TIMER_CLASS(k)	(G_TYPE_CHECK_CLASS_CAST((k), GPM_TYPE_TIMER, GpmTimerClass))
+#define GPM_IS_TIMER(o)		(G_TYPE_CHECK_INSTANCE_TYPE ((o), GPM_TYPE_TIMER))
+#define GPM_IS_TIMER_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), GPM_TYPE_TIMER))
+#define GPM_TIMER_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), GPM_TYPE_TIMER, GpmTimerClass))
+
+/* how late a timer added in whole seconds can go off */
+#define GPM_TIMER_SLACK_SECONDS	1000 /* ms */
+
+typedef struct GpmTimerPrivate GpmTimerPrivate;
+
+typedef struct
+{
+	GObject		 parent;
+	GpmTimerPrivate	*priv;
+} GpmTimer;
+
+typedef struct
+{
+	GObjectClass	parent_class;
+} GpmTimerClass;
+
+GType		 gpm_timer_get_type			(void);
+GpmTimer	*gpm_timer_new				(void);
+void		 gpm_timer_test				(gpointer	 data);
+
+guint		 gpm_timer_add				(GpmTimer	*timer,
+							 guint		 interval,
+							 guint		 slack,
+							 const gchar	*name,
+							 GSourceFunc	 func,
+							 gpointer	 user_data);
+guint		 gpm_timer_add_seconds			(GpmTimer	*timer,
+							 guint		 interval,
+							 const gchar	*name,
+							 GSourceFunc	 func,
+							 gpointer	 user_data);
+gboolean	 gpm_timer_remove			(GpmTimer	*timer,
+							 guint		 id);
+guint		 gpm_timer_get_wakeups			(GpmTimer	*timer);
+const gchar	*gpm_timer_get_dispatching		(void);
+
+G_END_DECLS
+
+#endif /* __GPM_TIMER_H */
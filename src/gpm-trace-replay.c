@@ -0,0 +1,662 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Replays a trace recorded with GPM_TRACE_FILE against a GpmEngine.
+ *
+ * A private dbus-daemon is started and used as both the session and the
+ * system bus, and a minimal UPower service is exported on it from a worker
+ * thread. The recorded device snapshots are then pushed to the engine at
+ * an accelerated rate, and the engine signals are compared with the
+ * "# expect:" line of the trace.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <glib.h>
+#include <gio/gio.h>
+#include <libupower-glib/upower.h>
+
+#include "gpm-engine.h"
+#include "gpm-trace.h"
+
+#define GPM_REPLAY_UPOWER_SERVICE	"org.freedesktop.UPower"
+#define GPM_REPLAY_UPOWER_PATH		"/org/freedesktop/UPower"
+#define GPM_REPLAY_UPOWER_INTERFACE	"org.freedesktop.UPower"
+#define GPM_REPLAY_DEVICE_INTERFACE	"org.freedesktop.UPower.Device"
+#define GPM_REPLAY_DISPLAY_DEVICE	"DisplayDevice"
+#define GPM_REPLAY_SETTLE_TIME		250 /* ms */
+
+static const gchar gpm_replay_introspection[] =
+	"<node>"
+	"  <interface name='org.freedesktop.UPower'>"
+	"    <method name='EnumerateDevices'>"
+	"      <arg name='devices' direction='out' type='ao'/>"
+	"    </method>"
+	"    <method name='GetDisplayDevice'>"
+	"      <arg name='device' direction='out' type='o'/>"
+	"    </method>"
+	"    <method name='GetCriticalAction'>"
+	"      <arg name='action' direction='out' type='s'/>"
+	"    </method>"
+	"    <signal name='DeviceAdded'>"
+	"      <arg name='device' type='o'/>"
+	"    </signal>"
+	"    <signal name='DeviceRemoved'>"
+	"      <arg name='device' type='o'/>"
+	"    </signal>"
+	"    <property name='DaemonVersion' type='s' access='read'/>"
+	"    <property name='OnBattery' type='b' access='read'/>"
+	"    <property name='LidIsClosed' type='b' access='read'/>"
+	"    <property name='LidIsPresent' type='b' access='read'/>"
+	"  </interface>"
+	"  <interface name='org.freedesktop.UPower.Device'>"
+	"    <method name='Refresh'/>"
+	"    <property name='NativePath' type='s' access='read'/>"
+	"    <property name='Type' type='u' access='read'/>"
+	"    <property name='PowerSupply' type='b' access='read'/>"
+	"    <property name='IsPresent' type='b' access='read'/>"
+	"    <property name='IsRechargeable' type='b' access='read'/>"
+	"    <property name='State' type='u' access='read'/>"
+	"    <property name='Percentage' type='d' access='read'/>"
+	"    <property name='Capacity' type='d' access='read'/>"
+	"    <property name='TimeToEmpty' type='x' access='read'/>"
+	"    <property name='TimeToFull' type='x' access='read'/>"
+	"    <property name='WarningLevel' type='u' access='read'/>"
+	"    <property name='IconName' type='s' access='read'/>"
+	"  </interface>"
+	"</node>";
+
+typedef struct {
+	gchar			*address;
+	GDBusConnection		*connection;
+	GDBusNodeInfo		*introspection;
+	GMainContext		*context;
+	GMainLoop		*loop;
+	GThread			*thread;
+	GHashTable		*devices;	/* id -> GpmTraceItem, owned by the thread */
+	gboolean		 on_battery;
+	gboolean		 ready;
+	GMutex			 mutex;
+	GCond			 cond;
+} GpmReplayUpower;
+
+typedef struct {
+	GpmReplayUpower		*upower;
+	GPtrArray		*items;
+	guint			 idx;
+	gdouble			 speed;
+	gboolean		 mirror_display;
+	GPtrArray		*received;
+	GMainLoop		*loop;
+} GpmReplay;
+
+/**
+ * gpm_replay_upower_get_path:
+ **/
+static gchar *
+gpm_replay_upower_get_path (const gchar *id)
+{
+	return g_strdup_printf ("%s/devices/%s", GPM_REPLAY_UPOWER_PATH, id);
+}
+
+/**
+ * gpm_replay_upower_get_on_battery:
+ **/
+static gboolean
+gpm_replay_upower_get_on_battery (GpmReplayUpower *upower)
+{
+	GHashTableIter iter;
+	GpmTraceItem *item;
+
+	g_hash_table_iter_init (&iter, upower->devices);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &item)) {
+		if (item->kind == UP_DEVICE_KIND_BATTERY &&
+		    item->state == UP_DEVICE_STATE_DISCHARGING)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/**
+ * gpm_replay_upower_method_call:
+ **/
+static void
+gpm_replay_upower_method_call (GDBusConnection *connection, const gchar *sender,
+			       const gchar *object_path, const gchar *interface_name,
+			       const gchar *method_name, GVariant *parameters,
+			       GDBusMethodInvocation *invocation, gpointer user_data)
+{
+	GpmReplayUpower *upower = (GpmReplayUpower *) user_data;
+	GVariantBuilder builder;
+	GHashTableIter iter;
+	const gchar *id;
+	gchar *path;
+
+	if (g_strcmp0 (method_name, "EnumerateDevices") == 0) {
+		g_variant_builder_init (&builder, G_VARIANT_TYPE ("ao"));
+		g_hash_table_iter_init (&iter, upower->devices);
+		while (g_hash_table_iter_next (&iter, (gpointer *) &id, NULL)) {
+			if (g_strcmp0 (id, GPM_REPLAY_DISPLAY_DEVICE) == 0)
+				continue;
+			path = gpm_replay_upower_get_path (id);
+			g_variant_builder_add (&builder, "o", path);
+			g_free (path);
+		}
+		g_dbus_method_invocation_return_value (invocation, g_variant_new ("(ao)", &builder));
+		return;
+	}
+	if (g_strcmp0 (method_name, "GetDisplayDevice") == 0) {
+		path = gpm_replay_upower_get_path (GPM_REPLAY_DISPLAY_DEVICE);
+		g_dbus_method_invocation_return_value (invocation, g_variant_new ("(o)", path));
+		g_free (path);
+		return;
+	}
+	if (g_strcmp0 (method_name, "GetCriticalAction") == 0) {
+		g_dbus_method_invocation_return_value (invocation, g_variant_new ("(s)", "PowerOff"));
+		return;
+	}
+
+	/* Refresh is a no-op, the trace is the only source of truth */
+	g_dbus_method_invocation_return_value (invocation, NULL);
+}
+
+/**
+ * gpm_replay_upower_get_property:
+ **/
+static GVariant *
+gpm_replay_upower_get_property (GDBusConnection *connection, const gchar *sender,
+				const gchar *object_path, const gchar *interface_name,
+				const gchar *property_name, GError **error, gpointer user_data)
+{
+	GpmReplayUpower *upower = (GpmReplayUpower *) user_data;
+	GpmTraceItem *item;
+
+	/* the daemon object */
+	if (g_strcmp0 (interface_name, GPM_REPLAY_UPOWER_INTERFACE) == 0) {
+		if (g_strcmp0 (property_name, "DaemonVersion") == 0)
+			return g_variant_new_string ("0.99.11");
+		if (g_strcmp0 (property_name, "OnBattery") == 0)
+			return g_variant_new_boolean (upower->on_battery);
+		return g_variant_new_boolean (FALSE);
+	}
+
+	/* a device object */
+	item = g_hash_table_lookup (upower->devices, strrchr (object_path, '/') + 1);
+	if (item == NULL) {
+		g_set_error (error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_OBJECT,
+			     "no device %s", object_path);
+		return NULL;
+	}
+	if (g_strcmp0 (property_name, "NativePath") == 0)
+		return g_variant_new_string (item->id);
+	if (g_strcmp0 (property_name, "Type") == 0)
+		return g_variant_new_uint32 (item->kind);
+	if (g_strcmp0 (property_name, "PowerSupply") == 0)
+		return g_variant_new_boolean (item->kind == UP_DEVICE_KIND_BATTERY);
+	if (g_strcmp0 (property_name, "IsPresent") == 0 ||
+	    g_strcmp0 (property_name, "IsRechargeable") == 0)
+		return g_variant_new_boolean (TRUE);
+	if (g_strcmp0 (property_name, "State") == 0)
+		return g_variant_new_uint32 (item->state);
+	if (g_strcmp0 (property_name, "Percentage") == 0)
+		return g_variant_new_double (item->percentage);
+	if (g_strcmp0 (property_name, "Capacity") == 0)
+		return g_variant_new_double (100.0f);
+	if (g_strcmp0 (property_name, "TimeToEmpty") == 0)
+		return g_variant_new_int64 (item->time_to_empty);
+	if (g_strcmp0 (property_name, "TimeToFull") == 0)
+		return g_variant_new_int64 (item->time_to_full);
+	if (g_strcmp0 (property_name, "WarningLevel") == 0)
+		return g_variant_new_uint32 (item->warning_level);
+	return g_variant_new_string ("");
+}
+
+static const GDBusInterfaceVTable gpm_replay_upower_vtable = {
+	gpm_replay_upower_method_call,
+	gpm_replay_upower_get_property,
+	NULL,
+	{ 0 }
+};
+
+/**
+ * gpm_replay_upower_emit_changed:
+ **/
+static void
+gpm_replay_upower_emit_changed (GpmReplayUpower *upower, const gchar *path,
+				const gchar *interface_name, GVariant *changed)
+{
+	g_dbus_connection_emit_signal (upower->connection, NULL, path,
+				       "org.freedesktop.DBus.Properties",
+				       "PropertiesChanged",
+				       g_variant_new ("(s@a{sv}@as)", interface_name, changed,
+						      g_variant_new_strv (NULL, 0)),
+				       NULL);
+}
+
+/**
+ * gpm_replay_upower_apply:
+ *
+ * Called in the service thread to apply a new device snapshot.
+ **/
+static void
+gpm_replay_upower_apply (GpmReplayUpower *upower, const GpmTraceItem *new)
+{
+	GVariantBuilder builder;
+	GpmTraceItem *item;
+	gboolean on_battery;
+	gchar *path;
+
+	item = g_hash_table_lookup (upower->devices, new->id);
+	if (item == NULL) {
+		g_warning ("device %s was not in the trace header", new->id);
+		return;
+	}
+	item->kind = new->kind;
+	item->state = new->state;
+	item->percentage = new->percentage;
+	item->time_to_empty = new->time_to_empty;
+	item->time_to_full = new->time_to_full;
+	item->warning_level = new->warning_level;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+	g_variant_builder_add (&builder, "{sv}", "State", g_variant_new_uint32 (item->state));
+	g_variant_builder_add (&builder, "{sv}", "Percentage", g_variant_new_double (item->percentage));
+	g_variant_builder_add (&builder, "{sv}", "TimeToEmpty", g_variant_new_int64 (item->time_to_empty));
+	g_variant_builder_add (&builder, "{sv}", "TimeToFull", g_variant_new_int64 (item->time_to_full));
+	g_variant_builder_add (&builder, "{sv}", "WarningLevel", g_variant_new_uint32 (item->warning_level));
+	path = gpm_replay_upower_get_path (item->id);
+	gpm_replay_upower_emit_changed (upower, path, GPM_REPLAY_DEVICE_INTERFACE,
+					g_variant_builder_end (&builder));
+	g_free (path);
+
+	/* the daemon property follows the batteries */
+	on_battery = gpm_replay_upower_get_on_battery (upower);
+	if (on_battery != upower->on_battery) {
+		upower->on_battery = on_battery;
+		g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+		g_variant_builder_add (&builder, "{sv}", "OnBattery", g_variant_new_boolean (on_battery));
+		gpm_replay_upower_emit_changed (upower, GPM_REPLAY_UPOWER_PATH, GPM_REPLAY_UPOWER_INTERFACE,
+						g_variant_builder_end (&builder));
+	}
+	g_dbus_connection_flush_sync (upower->connection, NULL, NULL);
+}
+
+/**
+ * gpm_replay_upower_apply_cb:
+ **/
+static gboolean
+gpm_replay_upower_apply_cb (gpointer user_data)
+{
+	GpmReplay *replay = (GpmReplay *) user_data;
+	GpmTraceItem *item;
+	GpmTraceItem display;
+
+	item = g_ptr_array_index (replay->items, replay->idx);
+	gpm_replay_upower_apply (replay->upower, item);
+
+	/* traces without a display device get the battery mirrored into it */
+	if (replay->mirror_display && item->kind == UP_DEVICE_KIND_BATTERY) {
+		display = *item;
+		display.id = (gchar *) GPM_REPLAY_DISPLAY_DEVICE;
+		gpm_replay_upower_apply (replay->upower, &display);
+	}
+
+	/* wake up the replay in the main thread */
+	g_mutex_lock (&replay->upower->mutex);
+	replay->upower->ready = TRUE;
+	g_cond_signal (&replay->upower->cond);
+	g_mutex_unlock (&replay->upower->mutex);
+	return FALSE;
+}
+
+/**
+ * gpm_replay_upower_thread:
+ **/
+static gpointer
+gpm_replay_upower_thread (gpointer user_data)
+{
+	GpmReplayUpower *upower = (GpmReplayUpower *) user_data;
+	GHashTableIter iter;
+	GVariant *result;
+	GError *error = NULL;
+	const gchar *id;
+	gchar *path;
+	guint i;
+
+	g_main_context_push_thread_default (upower->context);
+
+	/* a connection of our own, so method calls are dispatched in this thread */
+	upower->connection = g_dbus_connection_new_for_address_sync (upower->address,
+								      G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+								      G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+								      NULL, NULL, &error);
+	if (upower->connection == NULL)
+		g_error ("cannot connect to the private bus: %s", error->message);
+
+	for (i = 0; upower->introspection->interfaces[i] != NULL; i++) {
+		GDBusInterfaceInfo *info = upower->introspection->interfaces[i];
+
+		if (g_strcmp0 (info->name, GPM_REPLAY_UPOWER_INTERFACE) == 0) {
+			g_dbus_connection_register_object (upower->connection, GPM_REPLAY_UPOWER_PATH,
+							   info, &gpm_replay_upower_vtable,
+							   upower, NULL, NULL);
+			continue;
+		}
+		g_hash_table_iter_init (&iter, upower->devices);
+		while (g_hash_table_iter_next (&iter, (gpointer *) &id, NULL)) {
+			path = gpm_replay_upower_get_path (id);
+			g_dbus_connection_register_object (upower->connection, path,
+							   info, &gpm_replay_upower_vtable,
+							   upower, NULL, NULL);
+			g_free (path);
+		}
+	}
+
+	result = g_dbus_connection_call_sync (upower->connection,
+					      "org.freedesktop.DBus", "/org/freedesktop/DBus",
+					      "org.freedesktop.DBus", "RequestName",
+					      g_variant_new ("(su)", GPM_REPLAY_UPOWER_SERVICE, 0),
+					      G_VARIANT_TYPE ("(u)"), G_DBUS_CALL_FLAGS_NONE,
+					      -1, NULL, &error);
+	if (result == NULL)
+		g_error ("cannot own %s: %s", GPM_REPLAY_UPOWER_SERVICE, error->message);
+	g_variant_unref (result);
+
+	/* we are now serving requests */
+	g_mutex_lock (&upower->mutex);
+	upower->ready = TRUE;
+	g_cond_signal (&upower->cond);
+	g_mutex_unlock (&upower->mutex);
+
+	g_main_loop_run (upower->loop);
+
+	g_object_unref (upower->connection);
+	g_main_context_pop_thread_default (upower->context);
+	return NULL;
+}
+
+/**
+ * gpm_replay_upower_wait:
+ **/
+static void
+gpm_replay_upower_wait (GpmReplayUpower *upower)
+{
+	g_mutex_lock (&upower->mutex);
+	while (!upower->ready)
+		g_cond_wait (&upower->cond, &upower->mutex);
+	upower->ready = FALSE;
+	g_mutex_unlock (&upower->mutex);
+}
+
+/**
+ * gpm_replay_upower_new:
+ *
+ * Exports the first snapshot of every device in @items on @address.
+ **/
+static GpmReplayUpower *
+gpm_replay_upower_new (const gchar *address, GPtrArray *items, gboolean *mirror_display)
+{
+	GpmReplayUpower *upower;
+	GpmTraceItem *item;
+	GpmTraceItem *copy;
+	guint i;
+
+	upower = g_new0 (GpmReplayUpower, 1);
+	upower->address = g_strdup (address);
+	upower->introspection = g_dbus_node_info_new_for_xml (gpm_replay_introspection, NULL);
+	upower->devices = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+						 (GDestroyNotify) gpm_trace_item_free);
+	g_mutex_init (&upower->mutex);
+	g_cond_init (&upower->cond);
+
+	for (i = 0; i < items->len; i++) {
+		item = g_ptr_array_index (items, i);
+		if (g_hash_table_contains (upower->devices, item->id))
+			continue;
+		copy = gpm_trace_item_new ();
+		*copy = *item;
+		copy->id = g_strdup (item->id);
+		g_hash_table_insert (upower->devices, copy->id, copy);
+	}
+
+	/* UpClient always wants a display device */
+	*mirror_display = !g_hash_table_contains (upower->devices, GPM_REPLAY_DISPLAY_DEVICE);
+	if (*mirror_display) {
+		copy = gpm_trace_item_new ();
+		copy->id = g_strdup (GPM_REPLAY_DISPLAY_DEVICE);
+		copy->kind = UP_DEVICE_KIND_BATTERY;
+		for (i = 0; i < items->len; i++) {
+			item = g_ptr_array_index (items, i);
+			if (item->kind != UP_DEVICE_KIND_BATTERY)
+				continue;
+			copy->state = item->state;
+			copy->percentage = item->percentage;
+			copy->time_to_empty = item->time_to_empty;
+			copy->time_to_full = item->time_to_full;
+			copy->warning_level = item->warning_level;
+			break;
+		}
+		g_hash_table_insert (upower->devices, copy->id, copy);
+	}
+	upower->on_battery = gpm_replay_upower_get_on_battery (upower);
+
+	upower->context = g_main_context_new ();
+	upower->loop = g_main_loop_new (upower->context, FALSE);
+	upower->thread = g_thread_new ("fake-upower", gpm_replay_upower_thread, upower);
+	gpm_replay_upower_wait (upower);
+	return upower;
+}
+
+/**
+ * gpm_replay_upower_free:
+ **/
+static void
+gpm_replay_upower_free (GpmReplayUpower *upower)
+{
+	g_main_loop_quit (upower->loop);
+	g_thread_join (upower->thread);
+	g_main_loop_unref (upower->loop);
+	g_main_context_unref (upower->context);
+	g_hash_table_unref (upower->devices);
+	g_dbus_node_info_unref (upower->introspection);
+	g_mutex_clear (&upower->mutex);
+	g_cond_clear (&upower->cond);
+	g_free (upower->address);
+	g_free (upower);
+}
+
+/**
+ * gpm_replay_engine_signal_cb:
+ **/
+static void
+gpm_replay_engine_signal_cb (GpmEngine *engine, UpDevice *device, const gchar *name)
+{
+	GpmReplay *replay;
+	GpmTraceItem *item;
+
+	replay = g_object_get_data (G_OBJECT (engine), "gpm-replay");
+	item = g_ptr_array_index (replay->items, MIN (replay->idx, replay->items->len - 1));
+	g_print ("%" G_GINT64_FORMAT "ms\t%s\n", item->timestamp, name);
+	g_ptr_array_add (replay->received, g_strdup (name));
+}
+
+/**
+ * gpm_replay_settle_cb:
+ **/
+static gboolean
+gpm_replay_settle_cb (GpmReplay *replay)
+{
+	g_main_loop_quit (replay->loop);
+	return FALSE;
+}
+
+/**
+ * gpm_replay_step_cb:
+ **/
+static gboolean
+gpm_replay_step_cb (GpmReplay *replay)
+{
+	GpmTraceItem *item;
+	GpmTraceItem *next;
+	gdouble delay;
+	guint timer_id;
+
+	/* push this snapshot and wait for it to hit the bus */
+	g_main_context_invoke (replay->upower->context, gpm_replay_upower_apply_cb, replay);
+	gpm_replay_upower_wait (replay->upower);
+
+	/* give the engine time to see the last change */
+	if (replay->idx + 1 == replay->items->len) {
+		timer_id = g_timeout_add (GPM_REPLAY_SETTLE_TIME, (GSourceFunc) gpm_replay_settle_cb, replay);
+		g_source_set_name_by_id (timer_id, "[GpmReplay] settle");
+		return FALSE;
+	}
+
+	/* schedule the next snapshot, with the time scaled down */
+	item = g_ptr_array_index (replay->items, replay->idx);
+	next = g_ptr_array_index (replay->items, ++replay->idx);
+	delay = MAX (next->timestamp - item->timestamp, 0) / replay->speed;
+	timer_id = g_timeout_add ((guint) delay, (GSourceFunc) gpm_replay_step_cb, replay);
+	g_source_set_name_by_id (timer_id, "[GpmReplay] step");
+	return FALSE;
+}
+
+/**
+ * gpm_replay_compare:
+ **/
+static gboolean
+gpm_replay_compare (GPtrArray *received, gchar **expect)
+{
+	guint i;
+
+	if (expect == NULL || expect[0] == NULL) {
+		g_print ("no expectations in trace, add:\n%s", GPM_TRACE_EXPECT_PREFIX);
+		for (i = 0; i < received->len; i++)
+			g_print (" %s", (const gchar *) g_ptr_array_index (received, i));
+		g_print ("\n");
+		return TRUE;
+	}
+	if (g_strv_length (expect) != received->len)
+		goto fail;
+	for (i = 0; i < received->len; i++) {
+		if (g_strcmp0 (expect[i], g_ptr_array_index (received, i)) != 0)
+			goto fail;
+	}
+	return TRUE;
+fail:
+	g_print ("FAILED: expected");
+	for (i = 0; expect[i] != NULL; i++)
+		g_print (" %s", expect[i]);
+	g_print ("\n");
+	return FALSE;
+}
+
+/**
+ * main:
+ **/
+int
+main (int argc, char *argv[])
+{
+	const gchar *signal_names[] = { "discharging", "fully-charged", "low-capacity",
+					"charge-low", "charge-critical", "charge-action", NULL };
+	GOptionContext *context;
+	GTestDBus *bus;
+	GpmEngine *engine;
+	GpmReplay replay;
+	GError *error = NULL;
+	gchar **expect = NULL;
+	gdouble speed = 100000.0f;
+	gboolean ret = FALSE;
+	guint i;
+
+	const GOptionEntry options[] = {
+		{ "speed", '\0', 0, G_OPTION_ARG_DOUBLE, &speed,
+		  "Replay speed relative to the recording", NULL },
+		{ NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL }
+	};
+
+	context = g_option_context_new ("TRACE-FILE");
+	g_option_context_add_main_entries (context, options, NULL);
+	g_option_context_set_summary (context, "Replay a recorded UPower trace against GpmEngine");
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		goto out;
+	}
+	if (argc != 2 || speed <= 0) {
+		g_printerr ("%s", g_option_context_get_help (context, TRUE, NULL));
+		goto out;
+	}
+
+	memset (&replay, 0, sizeof (GpmReplay));
+	replay.speed = speed;
+	replay.items = gpm_trace_load (argv[1], &expect, &error);
+	if (replay.items == NULL) {
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		goto out;
+	}
+	if (replay.items->len == 0) {
+		g_printerr ("%s has no device snapshots\n", argv[1]);
+		g_ptr_array_unref (replay.items);
+		goto out;
+	}
+
+	/* never touch the real settings or buses */
+	g_setenv ("GSETTINGS_BACKEND", "memory", FALSE);
+	bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+	g_test_dbus_up (bus);
+	g_setenv ("DBUS_SYSTEM_BUS_ADDRESS", g_test_dbus_get_bus_address (bus), TRUE);
+
+	replay.upower = gpm_replay_upower_new (g_test_dbus_get_bus_address (bus),
+					       replay.items, &replay.mirror_display);
+	replay.received = g_ptr_array_new_with_free_func (g_free);
+	replay.loop = g_main_loop_new (NULL, FALSE);
+
+	engine = gpm_engine_new ();
+	g_object_set_data (G_OBJECT (engine), "gpm-replay", &replay);
+	for (i = 0; signal_names[i] != NULL; i++) {
+		g_signal_connect (engine, signal_names[i],
+				  G_CALLBACK (gpm_replay_engine_signal_cb),
+				  (gpointer) signal_names[i]);
+	}
+
+	/* the engine coldplugs from an idle handler queued before this one */
+	g_idle_add ((GSourceFunc) gpm_replay_step_cb, &replay);
+	g_main_loop_run (replay.loop);
+
+	ret = gpm_replay_compare (replay.received, expect);
+
+	g_object_unref (engine);
+	g_main_loop_unref (replay.loop);
+	gpm_replay_upower_free (replay.upower);
+	g_ptr_array_unref (replay.received);
+	g_ptr_array_unref (replay.items);
+	g_strfreev (expect);
+	g_test_dbus_down (bus);
+	g_object_unref (bus);
+out:
+	g_option_context_free (context);
+	return ret ? EXIT_SUCCESS : EXIT_FAILURE;
+}
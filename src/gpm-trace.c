@@ -0,0 +1,379 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * A trace is a plain text file with one UPower device snapshot per line:
+ *
+ *   <ms> <id> <kind> <state> <percentage> <time-to-empty> <time-to-full> <warning-level>
+ *
+ * where kind, state and warning-level use the UPower string names. Lines
+ * starting with '#' are comments, apart from GPM_TRACE_EXPECT_PREFIX which
+ * lists the engine signals the trace is expected to produce when replayed.
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <libupower-glib/upower.h>
+
+#include "gpm-trace.h"
+
+#define GPM_TRACE_FIELDS	8
+
+struct GpmTraceWriter
+{
+	FILE			*file;
+	gint64			 start;
+	GHashTable		*last;		/* id -> last line without the timestamp */
+};
+
+/**
+ * gpm_trace_error_quark:
+ * Return value: Our personal error quark.
+ **/
+GQuark
+gpm_trace_error_quark (void)
+{
+	static GQuark quark = 0;
+	if (!quark)
+		quark = g_quark_from_static_string ("gpm_trace_error");
+	return quark;
+}
+
+/**
+ * gpm_trace_item_new:
+ **/
+GpmTraceItem *
+gpm_trace_item_new (void)
+{
+	return g_new0 (GpmTraceItem, 1);
+}
+
+/**
+ * gpm_trace_item_free:
+ **/
+void
+gpm_trace_item_free (GpmTraceItem *item)
+{
+	if (item == NULL)
+		return;
+	g_free (item->id);
+	g_free (item);
+}
+
+/**
+ * gpm_trace_item_set_from_device:
+ *
+ * Copies the properties the engine makes policy decisions on.
+ **/
+void
+gpm_trace_item_set_from_device (GpmTraceItem *item, UpDevice *device)
+{
+	const gchar *object_path;
+
+	g_return_if_fail (item != NULL);
+	g_return_if_fail (UP_IS_DEVICE (device));
+
+	g_object_get (device,
+		      "kind", &item->kind,
+		      "state", &item->state,
+		      "percentage", &item->percentage,
+		      "time-to-empty", &item->time_to_empty,
+		      "time-to-full", &item->time_to_full,
+		      "warning-level", &item->warning_level,
+		      NULL);
+
+	g_free (item->id);
+	object_path = up_device_get_object_path (device);
+	if (object_path != NULL && strrchr (object_path, '/') != NULL)
+		item->id = g_strdup (strrchr (object_path, '/') + 1);
+	else
+		item->id = g_strdup ("unknown");
+}
+
+/**
+ * gpm_trace_item_to_string:
+ *
+ * Return value: the trace line without a trailing newline, free with g_free()
+ **/
+gchar *
+gpm_trace_item_to_string (const GpmTraceItem *item)
+{
+	gchar percentage[G_ASCII_DTOSTR_BUF_SIZE];
+
+	g_return_val_if_fail (item != NULL, NULL);
+
+	/* always use '.' whatever the locale */
+	g_ascii_formatd (percentage, sizeof (percentage), "%.1f", item->percentage);
+
+	return g_strdup_printf ("%" G_GINT64_FORMAT "\t%s\t%s\t%s\t%s\t%" G_GINT64_FORMAT "\t%" G_GINT64_FORMAT "\t%s",
+				item->timestamp,
+				item->id,
+				up_device_kind_to_string (item->kind),
+				up_device_state_to_string (item->state),
+				percentage,
+				item->time_to_empty,
+				item->time_to_full,
+				up_device_level_to_string (item->warning_level));
+}
+
+/**
+ * gpm_trace_item_from_string:
+ *
+ * Return value: a new #GpmTraceItem, or %NULL if the line is invalid
+ **/
+GpmTraceItem *
+gpm_trace_item_from_string (const gchar *line, GError **error)
+{
+	GpmTraceItem *item = NULL;
+	gchar **split;
+	const gchar *fields[GPM_TRACE_FIELDS];
+	guint i;
+	guint len = 0;
+
+	g_return_val_if_fail (line != NULL, NULL);
+
+	/* accept any mix of spaces and tabs so traces can be edited by hand */
+	split = g_strsplit_set (line, " \t", -1);
+	for (i = 0; split[i] != NULL; i++) {
+		if (split[i][0] == '\0')
+			continue;
+		if (len == GPM_TRACE_FIELDS) {
+			len++;
+			break;
+		}
+		fields[len++] = split[i];
+	}
+	if (len != GPM_TRACE_FIELDS) {
+		g_set_error (error, GPM_TRACE_ERROR, GPM_TRACE_ERROR_INVALID,
+			     "expected %i fields: '%s'", GPM_TRACE_FIELDS, line);
+		goto out;
+	}
+
+	item = gpm_trace_item_new ();
+	item->timestamp = g_ascii_strtoll (fields[0], NULL, 10);
+	item->id = g_strdup (fields[1]);
+	item->kind = up_device_kind_from_string (fields[2]);
+	item->state = up_device_state_from_string (fields[3]);
+	item->percentage = g_ascii_strtod (fields[4], NULL);
+	item->time_to_empty = g_ascii_strtoll (fields[5], NULL, 10);
+	item->time_to_full = g_ascii_strtoll (fields[6], NULL, 10);
+	item->warning_level = up_device_level_from_string (fields[7]);
+out:
+	g_strfreev (split);
+	return item;
+}
+
+/**
+ * gpm_trace_load:
+ * @filename: the trace to load
+ * @expect: (out) (allow-none): the expected signal names, free with g_strfreev()
+ *
+ * Return value: an array of #GpmTraceItem, free with g_ptr_array_unref()
+ **/
+GPtrArray *
+gpm_trace_load (const gchar *filename, gchar ***expect, GError **error)
+{
+	GPtrArray *array = NULL;
+	GPtrArray *expected;
+	GpmTraceItem *item;
+	gchar *contents = NULL;
+	gchar **lines = NULL;
+	gchar **split;
+	gchar *line;
+	guint i;
+	guint j;
+
+	g_return_val_if_fail (filename != NULL, NULL);
+
+	if (!g_file_get_contents (filename, &contents, NULL, error))
+		goto out;
+
+	array = g_ptr_array_new_with_free_func ((GDestroyNotify) gpm_trace_item_free);
+	expected = g_ptr_array_new ();
+	lines = g_strsplit (contents, "\n", -1);
+	for (i = 0; lines[i] != NULL; i++) {
+		line = g_strstrip (lines[i]);
+		if (line[0] == '\0')
+			continue;
+
+		/* the signals we should see when replaying */
+		if (g_str_has_prefix (line, GPM_TRACE_EXPECT_PREFIX)) {
+			split = g_strsplit_set (line + strlen (GPM_TRACE_EXPECT_PREFIX), " \t", -1);
+			for (j = 0; split[j] != NULL; j++) {
+				if (split[j][0] != '\0')
+					g_ptr_array_add (expected, g_strdup (split[j]));
+			}
+			g_strfreev (split);
+			continue;
+		}
+		if (line[0] == '#')
+			continue;
+
+		item = gpm_trace_item_from_string (line, error);
+		if (item == NULL) {
+			g_prefix_error (error, "%s:%u: ", filename, i + 1);
+			g_ptr_array_unref (array);
+			array = NULL;
+			break;
+		}
+		g_ptr_array_add (array, item);
+	}
+
+	g_ptr_array_add (expected, NULL);
+	if (expect != NULL && array != NULL)
+		*expect = (gchar **) g_ptr_array_free (expected, FALSE);
+	else
+		g_strfreev ((gchar **) g_ptr_array_free (expected, FALSE));
+out:
+	g_strfreev (lines);
+	g_free (contents);
+	return array;
+}
+
+/**
+ * gpm_trace_writer_new:
+ *
+ * Opens @filename for appending device snapshots.
+ **/
+GpmTraceWriter *
+gpm_trace_writer_new (const gchar *filename, GError **error)
+{
+	GpmTraceWriter *writer;
+	FILE *file;
+
+	g_return_val_if_fail (filename != NULL, NULL);
+
+	file = g_fopen (filename, "a");
+	if (file == NULL) {
+		g_set_error (error, GPM_TRACE_ERROR, GPM_TRACE_ERROR_GENERAL,
+			     "cannot open %s for writing", filename);
+		return NULL;
+	}
+
+	writer = g_new0 (GpmTraceWriter, 1);
+	writer->file = file;
+	writer->start = g_get_monotonic_time ();
+	writer->last = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	return writer;
+}
+
+/**
+ * gpm_trace_writer_add_device:
+ **/
+void
+gpm_trace_writer_add_device (GpmTraceWriter *writer, UpDevice *device)
+{
+	GpmTraceItem *item;
+	gchar *line;
+	const gchar *fields;
+
+	g_return_if_fail (writer != NULL);
+
+	item = gpm_trace_item_new ();
+	gpm_trace_item_set_from_device (item, device);
+	item->timestamp = (g_get_monotonic_time () - writer->start) / 1000;
+	line = gpm_trace_item_to_string (item);
+
+	/* UPower emits changed for every property, so skip repeats */
+	fields = strchr (line, '\t');
+	if (g_strcmp0 (g_hash_table_lookup (writer->last, item->id), fields) == 0)
+		goto out;
+	g_hash_table_insert (writer->last, g_strdup (item->id), g_strdup (fields));
+
+	/* flush every line so the trace survives a crash */
+	fprintf (writer->file, "%s\n", line);
+	fflush (writer->file);
+out:
+	g_free (line);
+	gpm_trace_item_free (item);
+}
+
+/**
+ * gpm_trace_writer_free:
+ **/
+void
+gpm_trace_writer_free (GpmTraceWriter *writer)
+{
+	if (writer == NULL)
+		return;
+	fclose (writer->file);
+	g_hash_table_unref (writer->last);
+	g_free (writer);
+}
+
+/***************************************************************************
+ ***                          MAKE CHECK TESTS                           ***
+ ***************************************************************************/
+#ifdef EGG_TEST
+#include "egg-test.h"
+
+void
+gpm_trace_test (gpointer data)
+{
+	GpmTraceItem *item;
+	GError *error = NULL;
+	gchar *text;
+	EggTest *test = (EggTest *) data;
+
+	if (egg_test_start (test, "GpmTrace") == FALSE)
+		return;
+
+	/************************************************************/
+	egg_test_title (test, "parse a valid line");
+	item = gpm_trace_item_from_string ("60000 battery_BAT0 battery discharging 9.5 900 0 low", &error);
+	if (item == NULL) {
+		egg_test_failed (test, "failed to parse: %s", error->message);
+		g_error_free (error);
+		return;
+	}
+	if (item->timestamp == 60000 &&
+	    item->kind == UP_DEVICE_KIND_BATTERY &&
+	    item->state == UP_DEVICE_STATE_DISCHARGING &&
+	    item->time_to_empty == 900 &&
+	    item->warning_level == UP_DEVICE_LEVEL_LOW)
+		egg_test_success (test, NULL);
+	else
+		egg_test_failed (test, "parsed incorrectly");
+
+	/************************************************************/
+	egg_test_title (test, "serialize the same line");
+	text = gpm_trace_item_to_string (item);
+	if (g_strcmp0 (text, "60000\tbattery_BAT0\tbattery\tdischarging\t9.5\t900\t0\tlow") == 0)
+		egg_test_success (test, NULL);
+	else
+		egg_test_failed (test, "serialized incorrectly: %s", text);
+	g_free (text);
+	gpm_trace_item_free (item);
+
+	/************************************************************/
+	egg_test_title (test, "reject a short line");
+	item = gpm_trace_item_from_string ("0 battery_BAT0 battery", NULL);
+	egg_test_assert (test, item == NULL);
+
+	egg_test_end (test);
+}
+
+#endif
+
@@ -0,0 +1,78 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __GPMTRACE_H
+#define __GPMTRACE_H
+
+#include <glib.h>
+#include <libupower-glib/upower.h>
+
+G_BEGIN_DECLS
+
+#define GPM_TRACE_ERROR		(gpm_trace_error_quark ())
+
+/* prefix of the comment line listing the engine signals a trace should produce */
+#define GPM_TRACE_EXPECT_PREFIX	"# expect:"
+
+typedef enum {
+	GPM_TRACE_ERROR_GENERAL,
+	GPM_TRACE_ERROR_INVALID
+} GpmTraceError;
+
+typedef struct {
+	gint64		 timestamp;	/* ms since the start of the trace */
+	gchar		*id;		/* last element of the object path */
+	UpDeviceKind	 kind;
+	UpDeviceState	 state;
+	gdouble		 percentage;
+	gint64		 time_to_empty;
+	gint64		 time_to_full;
+	UpDeviceLevel	 warning_level;
+} GpmTraceItem;
+
+typedef struct GpmTraceWriter GpmTraceWriter;
+
+GQuark		 gpm_trace_error_quark		(void);
+
+GpmTraceItem	*gpm_trace_item_new		(void);
+void		 gpm_trace_item_free		(GpmTraceItem	*item);
+void		 gpm_trace_item_set_from_device	(GpmTraceItem	*item,
+						 UpDevice	*device);
+gchar		*gpm_trace_item_to_string	(const GpmTraceItem *item);
+GpmTraceItem	*gpm_trace_item_from_string	(const gchar	*line,
+						 GError		**error);
+GPtrArray	*gpm_trace_load			(const gchar	*filename,
+						 gchar		***expect,
+						 GError		**error);
+
+GpmTraceWriter	*gpm_trace_writer_new		(const gchar	*filename,
+						 GError		**error);
+void		 gpm_trace_writer_add_device	(GpmTraceWriter	*writer,
+						 UpDevice	*device);
+void		 gpm_trace_writer_free		(GpmTraceWriter	*writer);
+
+#ifdef EGG_TEST
+void		 gpm_trace_test			(gpointer	 data);
+#endif
+
+G_END_DECLS
+
+#endif	/* __GPMTRACE_H */
@@ -51,12 +51,46 @@
 
 static void     gpm_tray_icon_finalize   (GObject	   *object);
 
+#define GPM_TRAY_ICON_PIXBUF_CACHE_SIZE		8
+
+typedef struct {
+	GQuark			 name;
+	gint			 size;
+	gint			 scale;
+	GdkPixbuf		*pixbuf;
+} GpmTrayIconPixbuf;
+
 struct GpmTrayIconPrivate
 {
 	GSettings		*settings;
 	GpmEngine		*engine;
 	GtkStatusIcon		*status_icon;
 	gboolean		 show_actions;
+	GtkWidget		*menu;
+	GtkWidget		*primary_item;
+	GtkWidget		*primary_separator;
+	GtkWidget		*actions_separator;
+	GtkWidget		*preferences_item;
+	GtkWidget		*about_item;
+	GHashTable		*devices;	/* engine device handle -> GtkMenuItem */
+	guint			 devices_shown;
+	GQuark			 icon_name;
+	GQueue			*pixbuf_lru;	/* most recently used first */
+	GHashTable		*pixbuf_cache;	/* GpmTrayIconPixbuf -> GList link in pixbuf_lru */
+};
+
+/* the order the devices are listed in the menu */
+static const UpDeviceKind gpm_tray_icon_kinds[] = {
+	UP_DEVICE_KIND_BATTERY,
+	UP_DEVICE_KIND_UPS,
+	UP_DEVICE_KIND_MOUSE,
+	UP_DEVICE_KIND_KEYBOARD,
+	UP_DEVICE_KIND_PDA,
+	UP_DEVICE_KIND_PHONE,
+	UP_DEVICE_KIND_MEDIA_PLAYER,
+	UP_DEVICE_KIND_TABLET,
+	UP_DEVICE_KIND_COMPUTER,
+	UP_DEVICE_KIND_GAMING_INPUT
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (GpmTrayIcon, gpm_tray_icon, G_TYPE_OBJECT)
@@ -69,6 +103,14 @@ gpm_tray_icon_enable_actions (GpmTrayIcon *icon, gboolean enabled)
 {
 	g_return_if_fail (GPM_IS_TRAY_ICON (icon));
 	icon->priv->show_actions = enabled;
+
+	/* skip for things like live-cd's and GDM */
+	gtk_widget_set_visible (icon->priv->preferences_item, enabled);
+	gtk_widget_set_visible (icon->priv->about_item, enabled);
+
+	/* only do the separator if we have at least one device */
+	gtk_widget_set_visible (icon->priv->actions_separator,
+				enabled && icon->priv->devices_shown != 0);
 }
 
 /**
@@ -109,28 +151,177 @@ gpm_tray_icon_get_status_icon (GpmTrayIcon *icon)
 	return g_object_ref (icon->priv->status_icon);
 }
 
+/**
+ * gpm_tray_icon_pixbuf_hash:
+ **/
+static guint
+gpm_tray_icon_pixbuf_hash (gconstpointer key)
+{
+	const GpmTrayIconPixbuf *entry = key;
+	return entry->name ^ (entry->size << 16) ^ (entry->scale << 28);
+}
+
+/**
+ * gpm_tray_icon_pixbuf_equal:
+ **/
+static gboolean
+gpm_tray_icon_pixbuf_equal (gconstpointer a, gconstpointer b)
+{
+	const GpmTrayIconPixbuf *entry_a = a;
+	const GpmTrayIconPixbuf *entry_b = b;
+	return entry_a->name == entry_b->name &&
+	       entry_a->size == entry_b->size &&
+	       entry_a->scale == entry_b->scale;
+}
+
+/**
+ * gpm_tray_icon_pixbuf_free:
+ **/
+static void
+gpm_tray_icon_pixbuf_free (GpmTrayIconPixbuf *entry)
+{
+	g_object_unref (entry->pixbuf);
+	g_free (entry);
+}
+
+/**
+ * gpm_tray_icon_lookup_pixbuf:
+ *
+ * Only goes to the icon theme if the name, size and scale have not been
+ * rendered recently.
+ *
+ * Return value: (transfer none): the pixbuf, or %NULL if the icon is not in the theme
+ **/
+static GdkPixbuf *
+gpm_tray_icon_lookup_pixbuf (GpmTrayIcon *icon, GQuark name, gint size, gint scale)
+{
+	GpmTrayIconPixbuf key;
+	GpmTrayIconPixbuf *entry;
+	GdkPixbuf *pixbuf;
+	GError *error = NULL;
+	GList *link;
+
+	key.name = name;
+	key.size = size;
+	key.scale = scale;
+	link = g_hash_table_lookup (icon->priv->pixbuf_cache, &key);
+	if (link != NULL) {
+		/* move to the front */
+		g_queue_unlink (icon->priv->pixbuf_lru, link);
+		g_queue_push_head_link (icon->priv->pixbuf_lru, link);
+		entry = link->data;
+		return entry->pixbuf;
+	}
+
+	pixbuf = gtk_icon_theme_load_icon_for_scale (gtk_icon_theme_get_default (),
+						     g_quark_to_string (name), size, scale,
+						     GTK_ICON_LOOKUP_FORCE_SIZE, &error);
+	if (pixbuf == NULL) {
+		g_debug ("failed to load %s: %s", g_quark_to_string (name), error->message);
+		g_error_free (error);
+		return NULL;
+	}
+
+	/* drop the least recently used */
+	if (g_queue_get_length (icon->priv->pixbuf_lru) >= GPM_TRAY_ICON_PIXBUF_CACHE_SIZE) {
+		entry = g_queue_pop_tail (icon->priv->pixbuf_lru);
+		g_hash_table_remove (icon->priv->pixbuf_cache, entry);
+		gpm_tray_icon_pixbuf_free (entry);
+	}
+
+	entry = g_new0 (GpmTrayIconPixbuf, 1);
+	entry->name = name;
+	entry->size = size;
+	entry->scale = scale;
+	entry->pixbuf = pixbuf;
+	g_queue_push_head (icon->priv->pixbuf_lru, entry);
+	g_hash_table_insert (icon->priv->pixbuf_cache, entry, icon->priv->pixbuf_lru->head);
+	return pixbuf;
+}
+
+/**
+ * gpm_tray_icon_update_status_icon:
+ **/
+static void
+gpm_tray_icon_update_status_icon (GpmTrayIcon *icon, gint size)
+{
+	GdkPixbuf *pixbuf = NULL;
+	GdkScreen *screen;
+	gint scale;
+
+	/* the status icon scales pixbufs down, so only use them when that is a no-op */
+	screen = gtk_status_icon_get_screen (icon->priv->status_icon);
+	scale = gdk_window_get_scale_factor (gdk_screen_get_root_window (screen));
+	if (size > 0 && scale == 1)
+		pixbuf = gpm_tray_icon_lookup_pixbuf (icon, icon->priv->icon_name, size, scale);
+
+	if (pixbuf != NULL)
+		gtk_status_icon_set_from_pixbuf (icon->priv->status_icon, pixbuf);
+	else
+		gtk_status_icon_set_from_icon_name (icon->priv->status_icon,
+						    g_quark_to_string (icon->priv->icon_name));
+}
+
+/**
+ * gpm_tray_icon_size_changed_cb:
+ **/
+static gboolean
+gpm_tray_icon_size_changed_cb (GtkStatusIcon *status_icon, gint size, GpmTrayIcon *icon)
+{
+	if (icon->priv->icon_name == 0)
+		return FALSE;
+	gpm_tray_icon_update_status_icon (icon, size);
+	return TRUE;
+}
+
+/**
+ * gpm_tray_icon_invalidate_icons:
+ *
+ * Drops all the rendered icons, e.g. when the icon theme changes.
+ **/
+void
+gpm_tray_icon_invalidate_icons (GpmTrayIcon *icon)
+{
+	g_return_if_fail (GPM_IS_TRAY_ICON (icon));
+
+	g_hash_table_remove_all (icon->priv->pixbuf_cache);
+	g_queue_free_full (icon->priv->pixbuf_lru, (GDestroyNotify) gpm_tray_icon_pixbuf_free);
+	icon->priv->pixbuf_lru = g_queue_new ();
+
+	if (icon->priv->icon_name != 0)
+		gpm_tray_icon_update_status_icon (icon, gtk_status_icon_get_size (icon->priv->status_icon));
+}
+
 /**
  * gpm_tray_icon_set_icon:
  * @icon_name: The icon name, e.g. GPM_ICON_APP_ICON, or NULL to remove.
  *
- * Loads a pixmap from disk, and sets as the tooltip icon.
+ * Loads a pixmap from the icon theme, and sets as the tooltip icon.
  **/
 gboolean
 gpm_tray_icon_set_icon (GpmTrayIcon *icon, const gchar *icon_name)
 {
+	GQuark name;
+
 	g_return_val_if_fail (icon != NULL, FALSE);
 	g_return_val_if_fail (GPM_IS_TRAY_ICON (icon), FALSE);
 
 	if (icon_name != NULL) {
+		/* the engine already interned the name */
+		name = g_quark_from_string (icon_name);
+		if (name == icon->priv->icon_name)
+			return TRUE;
+		icon->priv->icon_name = name;
+
 		g_debug ("Setting icon to %s", icon_name);
-		gtk_status_icon_set_from_icon_name (icon->priv->status_icon,
-		                                    icon_name);
+		gpm_tray_icon_update_status_icon (icon, gtk_status_icon_get_size (icon->priv->status_icon));
 
 		/* make sure that we are visible */
 		gpm_tray_icon_show (icon, TRUE);
 	} else {
 		/* remove icon */
 		g_debug ("no icon will be displayed");
+		icon->priv->icon_name = 0;
 
 		/* make sure that we are hidden */
 		gpm_tray_icon_show (icon, FALSE);
@@ -233,82 +424,136 @@ gpm_tray_icon_class_init (GpmTrayIconClass *klass)
 }
 
 /**
- * gpm_tray_icon_add_device:
+ * gpm_tray_icon_get_device_label:
  **/
-static guint
-gpm_tray_icon_add_device (GpmTrayIcon *icon, GtkMenu *menu, const GPtrArray *array, UpDeviceKind kind)
+static gchar *
+gpm_tray_icon_get_device_label (UpDevice *device, UpDeviceKind kind)
 {
-	guint i;
-	guint added = 0;
-	gchar *icon_name;
 	gchar *label, *vendor, *model;
-	GtkWidget *item;
-	GtkWidget *image;
-	const gchar *object_path;
-	UpDevice *device;
-	UpDeviceKind kind_tmp;
 	gdouble percentage;
 
-	/* find type */
-	for (i=0;i<array->len;i++) {
-		device = g_ptr_array_index (array, i);
-
-		/* get device properties */
-		g_object_get (device,
-			      "kind", &kind_tmp,
-			      "percentage", &percentage,
-			      "vendor", &vendor,
-			      "model", &model,
-			      NULL);
+	/* get device properties */
+	g_object_get (device,
+		      "percentage", &percentage,
+		      "vendor", &vendor,
+		      "model", &model,
+		      NULL);
 
-		if (kind != kind_tmp)
-			continue;
+	/* generate the label */
+	if ((vendor != NULL && strlen(vendor) != 0) && (model != NULL && strlen(model) != 0)) {
+		label = g_strdup_printf ("%s %s (%.1f%%)", vendor, model, percentage);
+	}
+	else if((vendor == NULL || strlen(vendor) == 0) && (model != NULL && strlen(model) != 0)) {
+		label = g_strdup_printf ("%s (%.1f%%)", model, percentage);
+	}
+	else {
+		label = g_strdup_printf ("%s (%.1f%%)", gpm_device_kind_to_localised_string (kind, 1), percentage);
+	}
+	g_free (vendor);
+	g_free (model);
+	return label;
+}
 
-		object_path = up_device_get_object_path (device);
-		g_debug ("adding device %s", object_path);
-		added++;
+/**
+ * gpm_tray_icon_update_device_item:
+ *
+ * Only touches the label and image when they have really changed, as
+ * the device changes far more often than either of them does.
+ **/
+static void
+gpm_tray_icon_update_device_item (GtkWidget *item, UpDevice *device, UpDeviceKind kind)
+{
+	gchar *label;
+	GQuark icon_name;
+	GtkWidget *image;
 
-		/* generate the label */
-		if ((vendor != NULL && strlen(vendor) != 0) && (model != NULL && strlen(model) != 0)) {
-			label = g_strdup_printf ("%s %s (%.1f%%)", vendor, model, percentage);
-		}
-		else if((vendor == NULL || strlen(vendor) == 0) && (model != NULL && strlen(model) != 0)) {
-			label = g_strdup_printf ("%s (%.1f%%)", model, percentage);
-		}
-		else {
-			label = g_strdup_printf ("%s (%.1f%%)", gpm_device_kind_to_localised_string (kind, 1), percentage);
-		}
-		item = mate_image_menu_item_new_with_label (label);
+	label = gpm_tray_icon_get_device_label (device, kind);
+	if (g_strcmp0 (g_object_get_data (G_OBJECT (item), "label"), label) != 0) {
+		gtk_menu_item_set_label (GTK_MENU_ITEM (item), label);
+		g_object_set_data_full (G_OBJECT (item), "label", label, g_free);
+	} else {
+		g_free (label);
+	}
 
-		/* generate the image */
-		icon_name = gpm_upower_get_device_icon (device);
-		image = gtk_image_new_from_icon_name (icon_name, GTK_ICON_SIZE_MENU);
+	icon_name = gpm_upower_get_device_icon_quark (device);
+	if (GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (item), "icon-name")) == icon_name)
+		return;
+	image = mate_image_menu_item_get_image (MATE_IMAGE_MENU_ITEM (item));
+	if (image != NULL) {
+		gtk_image_set_from_icon_name (GTK_IMAGE (image), g_quark_to_string (icon_name), GTK_ICON_SIZE_MENU);
+	} else {
+		image = gtk_image_new_from_icon_name (g_quark_to_string (icon_name), GTK_ICON_SIZE_MENU);
 		mate_image_menu_item_set_image (MATE_IMAGE_MENU_ITEM (item), image);
+	}
+	g_object_set_data (G_OBJECT (item), "icon-name", GUINT_TO_POINTER (icon_name));
+}
+
+/**
+ * gpm_tray_icon_add_device_item:
+ * @kind_index: Where the kind of device is in gpm_tray_icon_kinds
+ **/
+static GtkWidget *
+gpm_tray_icon_add_device_item (GpmTrayIcon *icon, const gchar *object_path, gint kind_index)
+{
+	GtkWidget *item;
 
-		/* set callback and add the menu */
-		g_signal_connect (G_OBJECT (item), "activate", G_CALLBACK (gpm_tray_icon_show_info_cb), icon);
-		g_object_set_data (G_OBJECT (item), "object-path", (gpointer) object_path);
-		gtk_menu_shell_append (GTK_MENU_SHELL (menu), item);
+	g_debug ("adding device %s", object_path);
+	item = mate_image_menu_item_new_with_label ("");
 
-		g_free (icon_name);
-		g_free (label);
-		g_free (vendor);
-		g_free (model);
-	}
-	return added;
+	/* set callback and add the menu */
+	g_signal_connect (G_OBJECT (item), "activate", G_CALLBACK (gpm_tray_icon_show_info_cb), icon);
+	g_object_set_data_full (G_OBJECT (item), "object-path", g_strdup (object_path), g_free);
+	g_object_set_data (G_OBJECT (item), "kind-index", GINT_TO_POINTER (kind_index));
+	gtk_menu_shell_append (GTK_MENU_SHELL (icon->priv->menu), item);
+	gtk_widget_show (item);
+	return item;
+}
+
+/**
+ * gpm_tray_icon_item_compare:
+ *
+ * Orders the device items by kind and then by object path, so the menu
+ * does not depend on the order the devices were found in.
+ **/
+static gint
+gpm_tray_icon_item_compare (GtkWidget *a, GtkWidget *b)
+{
+	gint kind_a = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (a), "kind-index"));
+	gint kind_b = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (b), "kind-index"));
+
+	if (kind_a != kind_b)
+		return kind_a < kind_b ? -1 : 1;
+	return g_strcmp0 (g_object_get_data (G_OBJECT (a), "object-path"),
+			  g_object_get_data (G_OBJECT (b), "object-path"));
 }
 
 /**
- * gpm_tray_icon_add_primary_device:
+ * gpm_tray_icon_item_compare_ptr:
+ **/
+static gint
+gpm_tray_icon_item_compare_ptr (gconstpointer a, gconstpointer b)
+{
+	return gpm_tray_icon_item_compare (*(GtkWidget **) a, *(GtkWidget **) b);
+}
+
+/**
+ * gpm_tray_icon_update_primary_device:
  **/
 static void
-gpm_tray_icon_add_primary_device (GpmTrayIcon *icon, GtkMenu *menu, UpDevice *device)
+gpm_tray_icon_update_primary_device (GpmTrayIcon *icon)
 {
-	GtkWidget *item;
+	UpDevice *device;
 	gchar *time_str;
 	gchar *string;
 	gint64 time_to_empty = 0;
 
+	/* show the primary device time remaining */
+	device = gpm_engine_get_primary_device (icon->priv->engine);
+	gtk_widget_set_visible (icon->priv->primary_item, device != NULL);
+	gtk_widget_set_visible (icon->priv->primary_separator, device != NULL);
+	if (device == NULL)
+		return;
+
 	/* get details */
 	g_object_get (device,
 		      "time-to-empty", &time_to_empty,
@@ -319,62 +564,232 @@ gpm_tray_icon_add_primary_device (GpmTrayIcon *icon, GtkMenu *menu, UpDevice *de
 
 	/* TRANSLATORS: % is a timestring, e.g. "6 hours 10 minutes" */
 	string = g_strdup_printf (_("%s remaining"), time_str);
-	item = mate_image_menu_item_new_with_label (string);
-	gtk_menu_shell_append (GTK_MENU_SHELL (menu), item);
+	if (g_strcmp0 (gtk_menu_item_get_label (GTK_MENU_ITEM (icon->priv->primary_item)), string) != 0)
+		gtk_menu_item_set_label (GTK_MENU_ITEM (icon->priv->primary_item), string);
 	g_free (time_str);
 	g_free (string);
+	g_object_unref (device);
+}
+
+/**
+ * gpm_tray_icon_get_kind_index:
+ *
+ * Return value: where the kind comes in the menu, or -1 if it is not shown
+ **/
+static gint
+gpm_tray_icon_get_kind_index (UpDeviceKind kind)
+{
+	guint j;
+
+	for (j = 0; j < G_N_ELEMENTS (gpm_tray_icon_kinds); j++) {
+		if (kind == gpm_tray_icon_kinds[j])
+			return j;
+	}
+	return -1;
+}
+
+/**
+ * gpm_tray_icon_update_separator:
+ **/
+static void
+gpm_tray_icon_update_separator (GpmTrayIcon *icon)
+{
+	icon->priv->devices_shown = g_hash_table_size (icon->priv->devices);
+	gtk_widget_set_visible (icon->priv->actions_separator,
+				icon->priv->show_actions && icon->priv->devices_shown != 0);
+}
+
+/**
+ * gpm_tray_icon_sync_menu:
+ *
+ * Builds the device items for the devices the engine already has; after
+ * this they are added, removed and updated one at a time.
+ **/
+static void
+gpm_tray_icon_sync_menu (GpmTrayIcon *icon)
+{
+	guint i;
+	gint kind_index;
+	gint position;
+	gboolean reorder = FALSE;
+	GPtrArray *array;
+	GPtrArray *items;
+	GHashTable *seen;
+	GHashTableIter iter;
+	GtkWidget *item;
+	UpDevice *device;
+	UpDeviceKind kind;
+	gpointer handle;
+
+	gpm_tray_icon_update_primary_device (icon);
+
+	/* add or update all device types */
+	array = gpm_engine_get_devices (icon->priv->engine);
+	items = g_ptr_array_new ();
+	seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+	for (i = 0; i < array->len; i++) {
+		device = g_ptr_array_index (array, i);
+
+		/* the statistics tool can only show devices on the bus */
+		if (up_device_get_object_path (device) == NULL)
+			continue;
+		g_object_get (device, "kind", &kind, NULL);
+		kind_index = gpm_tray_icon_get_kind_index (kind);
+		if (kind_index < 0)
+			continue;
+		handle = GUINT_TO_POINTER (gpm_engine_get_device_handle (device));
+		if (g_hash_table_contains (seen, handle))
+			continue;
+		item = g_hash_table_lookup (icon->priv->devices, handle);
+		if (item == NULL) {
+			item = gpm_tray_icon_add_device_item (icon, up_device_get_object_path (device),
+							      kind_index);
+			g_hash_table_insert (icon->priv->devices, handle, item);
+			reorder = TRUE;
+		}
+		gpm_tray_icon_update_device_item (item, device, kind);
+		g_hash_table_add (seen, handle);
+		g_ptr_array_add (items, item);
+	}
+
+	/* drop the items of devices that have gone away */
+	g_hash_table_iter_init (&iter, icon->priv->devices);
+	while (g_hash_table_iter_next (&iter, &handle, (gpointer *) &item)) {
+		if (g_hash_table_contains (seen, handle))
+			continue;
+		g_debug ("removing device %s", (const gchar *) g_object_get_data (G_OBJECT (item), "object-path"));
+		gtk_widget_destroy (item);
+		g_hash_table_iter_remove (&iter);
+	}
+
+	/* new items were appended, so move them all into order after the
+	 * primary device */
+	if (reorder) {
+		g_ptr_array_sort (items, gpm_tray_icon_item_compare_ptr);
+		position = 2;
+		for (i = 0; i < items->len; i++)
+			gtk_menu_reorder_child (GTK_MENU (icon->priv->menu),
+						g_ptr_array_index (items, i), position++);
+	}
+
+	gpm_tray_icon_update_separator (icon);
+
+	g_hash_table_unref (seen);
+	g_ptr_array_unref (items);
+	g_ptr_array_unref (array);
+}
+
+/**
+ * gpm_tray_icon_devices_changed_cb:
+ **/
+static void
+gpm_tray_icon_devices_changed_cb (GpmEngine *engine, GpmTrayIcon *icon)
+{
+	gpm_tray_icon_update_primary_device (icon);
+}
+
+/**
+ * gpm_tray_icon_device_added_cb:
+ *
+ * Inserts the new item after the items that sort before it.
+ **/
+static void
+gpm_tray_icon_device_added_cb (GpmEngine *engine, UpDevice *device, GpmTrayIcon *icon)
+{
+	gint kind_index;
+	gint position = 2;
+	GHashTableIter iter;
+	GtkWidget *item;
+	GtkWidget *item_tmp;
+	UpDeviceKind kind;
+	gpointer handle;
+
+	/* the statistics tool can only show devices on the bus */
+	if (up_device_get_object_path (device) == NULL)
+		return;
+	g_object_get (device, "kind", &kind, NULL);
+	kind_index = gpm_tray_icon_get_kind_index (kind);
+	if (kind_index < 0)
+		return;
+	handle = GUINT_TO_POINTER (gpm_engine_get_device_handle (device));
+	if (g_hash_table_contains (icon->priv->devices, handle))
+		return;
+
+	/* the same order as gpm_tray_icon_sync_menu() gives */
+	item = gpm_tray_icon_add_device_item (icon, up_device_get_object_path (device), kind_index);
+	g_hash_table_iter_init (&iter, icon->priv->devices);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &item_tmp)) {
+		if (gpm_tray_icon_item_compare (item_tmp, item) < 0)
+			position++;
+	}
+	gtk_menu_reorder_child (GTK_MENU (icon->priv->menu), item, position);
+	g_hash_table_insert (icon->priv->devices, handle, item);
+	gpm_tray_icon_update_device_item (item, device, kind);
+	gpm_tray_icon_update_separator (icon);
+}
+
+/**
+ * gpm_tray_icon_device_removed_cb:
+ **/
+static void
+gpm_tray_icon_device_removed_cb (GpmEngine *engine, guint handle, GpmTrayIcon *icon)
+{
+	GtkWidget *item;
+
+	item = g_hash_table_lookup (icon->priv->devices, GUINT_TO_POINTER (handle));
+	if (item == NULL)
+		return;
+	g_debug ("removing device %s", (const gchar *) g_object_get_data (G_OBJECT (item), "object-path"));
+	gtk_widget_destroy (item);
+	g_hash_table_remove (icon->priv->devices, GUINT_TO_POINTER (handle));
+	gpm_tray_icon_update_separator (icon);
+}
+
+/**
+ * gpm_tray_icon_device_changed_cb:
+ **/
+static void
+gpm_tray_icon_device_changed_cb (GpmEngine *engine, UpDevice *device, GpmTrayIcon *icon)
+{
+	GtkWidget *item;
+	UpDeviceKind kind;
+
+	item = g_hash_table_lookup (icon->priv->devices,
+				    GUINT_TO_POINTER (gpm_engine_get_device_handle (device)));
+	if (item == NULL)
+		return;
+	g_object_get (device, "kind", &kind, NULL);
+	gpm_tray_icon_update_device_item (item, device, kind);
 }
 
 /**
  * gpm_tray_icon_create_menu:
  *
- * Create the popup menu.
+ * Create the popup menu, which lives as long as the tray icon.
  **/
-static GtkMenu *
+static void
 gpm_tray_icon_create_menu (GpmTrayIcon *icon)
 {
-	GtkMenu *menu = (GtkMenu*) gtk_menu_new ();
+	GtkWidget *menu;
 	GtkWidget *item;
 	GtkWidget *image;
-	guint dev_cnt = 0;
-	GPtrArray *array;
-	UpDevice *device = NULL;
 	GtkStyleContext *context;
 	GtkWidget       *toplevel;
 	GdkScreen       *screen;
 	GdkVisual       *visual;
 
-	/* show the primary device time remaining */
-	device = gpm_engine_get_primary_device (icon->priv->engine);
-	if (device != NULL) {
-		gpm_tray_icon_add_primary_device (icon, menu, device);
-		item = gtk_separator_menu_item_new ();
-		gtk_menu_shell_append (GTK_MENU_SHELL (menu), item);
-	}
+	menu = gtk_menu_new ();
+	icon->priv->menu = g_object_ref_sink (menu);
 
-	/* add all device types to the drop down menu */
-	array = gpm_engine_get_devices (icon->priv->engine);
-	dev_cnt += gpm_tray_icon_add_device (icon, menu, array, UP_DEVICE_KIND_BATTERY);
-	dev_cnt += gpm_tray_icon_add_device (icon, menu, array, UP_DEVICE_KIND_UPS);
-	dev_cnt += gpm_tray_icon_add_device (icon, menu, array, UP_DEVICE_KIND_MOUSE);
-	dev_cnt += gpm_tray_icon_add_device (icon, menu, array, UP_DEVICE_KIND_KEYBOARD);
-	dev_cnt += gpm_tray_icon_add_device (icon, menu, array, UP_DEVICE_KIND_PDA);
-	dev_cnt += gpm_tray_icon_add_device (icon, menu, array, UP_DEVICE_KIND_PHONE);
-	dev_cnt += gpm_tray_icon_add_device (icon, menu, array, UP_DEVICE_KIND_MEDIA_PLAYER);
-	dev_cnt += gpm_tray_icon_add_device (icon, menu, array, UP_DEVICE_KIND_TABLET);
-	dev_cnt += gpm_tray_icon_add_device (icon, menu, array, UP_DEVICE_KIND_COMPUTER);
-	dev_cnt += gpm_tray_icon_add_device (icon, menu, array, UP_DEVICE_KIND_GAMING_INPUT);
-	g_ptr_array_unref (array);
+	/* the primary device time remaining */
+	icon->priv->primary_item = mate_image_menu_item_new_with_label ("");
+	gtk_menu_shell_append (GTK_MENU_SHELL (menu), icon->priv->primary_item);
+	icon->priv->primary_separator = gtk_separator_menu_item_new ();
+	gtk_menu_shell_append (GTK_MENU_SHELL (menu), icon->priv->primary_separator);
 
-	/* skip for things like live-cd's and GDM */
-	if (!icon->priv->show_actions)
-		goto skip_prefs;
-
-	/* only do the separator if we have at least one device */
-	if (dev_cnt != 0) {
-		item = gtk_separator_menu_item_new ();
-		gtk_menu_shell_append (GTK_MENU_SHELL (menu), item);
-	}
+	/* the devices get inserted here */
+	icon->priv->actions_separator = gtk_separator_menu_item_new ();
+	gtk_menu_shell_append (GTK_MENU_SHELL (menu), icon->priv->actions_separator);
 
 	/* preferences */
 	item = mate_image_menu_item_new_with_mnemonic (_("_Preferences"));
@@ -383,6 +798,8 @@ gpm_tray_icon_create_menu (GpmTrayIcon *icon)
 	g_signal_connect (G_OBJECT (item), "activate",
 			  G_CALLBACK (gpm_tray_icon_show_preferences_cb), icon);
 	gtk_menu_shell_append (GTK_MENU_SHELL (menu), item);
+	gtk_widget_show_all (item);
+	icon->priv->preferences_item = item;
 
 	/*Set up custom panel menu theme support-gtk3 only */
 	toplevel = gtk_widget_get_toplevel (GTK_WIDGET (menu));
@@ -402,26 +819,8 @@ gpm_tray_icon_create_menu (GpmTrayIcon *icon)
 	g_signal_connect (G_OBJECT (item), "activate",
 			  G_CALLBACK (gpm_tray_icon_show_about_cb), icon);
 	gtk_menu_shell_append (GTK_MENU_SHELL (menu), item);
-
-skip_prefs:
-	if (device != NULL)
-		g_object_unref (device);
-	return menu;
-}
-
-/**
- * gpm_tray_icon_popup_cleared_cd:
- * @widget: The popup Gtkwidget
- *
- * We have to re-enable the tooltip when the popup is removed
- **/
-static void
-gpm_tray_icon_popup_cleared_cd (GtkWidget *widget, GpmTrayIcon *icon)
-{
-	g_return_if_fail (GPM_IS_TRAY_ICON (icon));
-	g_debug ("clear tray");
-	g_object_ref_sink (widget);
-	g_object_unref (widget);
+	gtk_widget_show_all (item);
+	icon->priv->about_item = item;
 }
 
 /**
@@ -432,18 +831,10 @@ gpm_tray_icon_popup_cleared_cd (GtkWidget *widget, GpmTrayIcon *icon)
 static void
 gpm_tray_icon_popup_menu (GpmTrayIcon *icon, guint32 timestamp)
 {
-	GtkMenu *menu;
-
-	menu = gpm_tray_icon_create_menu (icon);
-
-	/* show the menu */
-	gtk_widget_show_all (GTK_WIDGET (menu));
-	gtk_menu_popup (GTK_MENU (menu), NULL, NULL,
+	/* the items are kept up to date as the devices change */
+	gtk_menu_popup (GTK_MENU (icon->priv->menu), NULL, NULL,
 			gtk_status_icon_position_menu, icon->priv->status_icon,
 			1, timestamp);
-
-	g_signal_connect (GTK_WIDGET (menu), "hide",
-			  G_CALLBACK (gpm_tray_icon_popup_cleared_cd), icon);
 }
 
 /**
@@ -499,7 +890,9 @@ gpm_tray_icon_init (GpmTrayIcon *icon)
 
 	icon->priv = gpm_tray_icon_get_instance_private (icon);
 
-	icon->priv->engine = gpm_engine_new ();
+	icon->priv->devices = g_hash_table_new (g_direct_hash, g_direct_equal);
+	icon->priv->pixbuf_lru = g_queue_new ();
+	icon->priv->pixbuf_cache = g_hash_table_new (gpm_tray_icon_pixbuf_hash, gpm_tray_icon_pixbuf_equal);
 
 	icon->priv->settings = g_settings_new (GPM_SETTINGS_SCHEMA);
 	g_signal_connect (icon->priv->settings, "changed",
@@ -515,6 +908,13 @@ gpm_tray_icon_init (GpmTrayIcon *icon)
 				 "activate",
 				 G_CALLBACK (gpm_tray_icon_activate_cb),
 				 icon, 0);
+	g_signal_connect_object (G_OBJECT (icon->priv->status_icon),
+				 "size-changed",
+				 G_CALLBACK (gpm_tray_icon_size_changed_cb),
+				 icon, 0);
+
+	/* the device items are added once we have the engine */
+	gpm_tray_icon_create_menu (icon);
 
 	allowed_in_menu = g_settings_get_boolean (icon->priv->settings, GPM_SETTINGS_SHOW_ACTIONS);
 	gpm_tray_icon_enable_actions (icon, allowed_in_menu);
@@ -534,8 +934,14 @@ gpm_tray_icon_finalize (GObject *object)
 
 	tray_icon = GPM_TRAY_ICON (object);
 
+	gtk_widget_destroy (tray_icon->priv->menu);
+	g_object_unref (tray_icon->priv->menu);
+	g_hash_table_unref (tray_icon->priv->devices);
+	g_hash_table_unref (tray_icon->priv->pixbuf_cache);
+	g_queue_free_full (tray_icon->priv->pixbuf_lru, (GDestroyNotify) gpm_tray_icon_pixbuf_free);
 	g_object_unref (tray_icon->priv->status_icon);
-	g_object_unref (tray_icon->priv->engine);
+	if (tray_icon->priv->engine != NULL)
+		g_object_unref (tray_icon->priv->engine);
 	g_return_if_fail (tray_icon->priv != NULL);
 
 	G_OBJECT_CLASS (gpm_tray_icon_parent_class)->finalize (object);
@@ -543,13 +949,38 @@ gpm_tray_icon_finalize (GObject *object)
 
 /**
  * gpm_tray_icon_new:
+ * @engine: The engine that already has, or will find, the devices
+ *
+ * The engine is made by the caller, so that the tray icon does not
+ * decide when it is made.
+ *
  * Return value: A new TrayIcon object.
  **/
 GpmTrayIcon *
-gpm_tray_icon_new (void)
+gpm_tray_icon_new (GpmEngine *engine)
 {
 	GpmTrayIcon *tray_icon;
+
+	g_return_val_if_fail (GPM_IS_ENGINE (engine), NULL);
+
 	tray_icon = g_object_new (GPM_TYPE_TRAY_ICON, NULL);
+	tray_icon->priv->engine = g_object_ref (engine);
+
+	/* build the device items once, and keep them in sync with the engine */
+	g_signal_connect_object (engine, "devices-changed",
+				 G_CALLBACK (gpm_tray_icon_devices_changed_cb),
+				 tray_icon, 0);
+	g_signal_connect_object (engine, "device-added",
+				 G_CALLBACK (gpm_tray_icon_device_added_cb),
+				 tray_icon, 0);
+	g_signal_connect_object (engine, "device-removed",
+				 G_CALLBACK (gpm_tray_icon_device_removed_cb),
+				 tray_icon, 0);
+	g_signal_connect_object (engine, "device-changed",
+				 G_CALLBACK (gpm_tray_icon_device_changed_cb),
+				 tray_icon, 0);
+	gpm_tray_icon_sync_menu (tray_icon);
+
 	return GPM_TRAY_ICON (tray_icon);
 }
 
@@ -26,6 +26,8 @@
 
 #include <glib-object.h>
 
+#include "gpm-engine.h"
+
 G_BEGIN_DECLS
 
 #define GPM_TYPE_TRAY_ICON		(gpm_tray_icon_get_type ())
@@ -51,13 +53,14 @@ typedef struct
 } GpmTrayIconClass;
 
 GType		 gpm_tray_icon_get_type			(void);
-GpmTrayIcon	*gpm_tray_icon_new			(void);
+GpmTrayIcon	*gpm_tray_icon_new			(GpmEngine	*engine);
 
 gboolean	 gpm_tray_icon_set_tooltip		(GpmTrayIcon	*icon,
 							 const gchar	*tooltip);
 gboolean	 gpm_tray_icon_set_icon			(GpmTrayIcon	*icon,
 							 const gchar	*icon_name);
 GtkStatusIcon	*gpm_tray_icon_get_status_icon		(GpmTrayIcon	*icon);
+void		 gpm_tray_icon_invalidate_icons		(GpmTrayIcon	*icon);
 
 G_END_DECLS
 
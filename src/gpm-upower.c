@@ -67,15 +67,17 @@ gpm_upower_get_device_icon_index (UpDevice *device)
 }
 
 /**
- * gpm_upower_get_device_icon:
+ * gpm_upower_get_device_icon_quark:
  *
- * Need to free the return value
+ * The icon names are interned, so comparing two of them is just an integer
+ * comparison and no memory is allocated once a name has been seen.
  *
+ * Return value: the icon name as a #GQuark, never 0
  **/
-gchar *
-gpm_upower_get_device_icon (UpDevice *device)
+GQuark
+gpm_upower_get_device_icon_quark (UpDevice *device)
 {
-	gchar *filename = NULL;
+	gchar filename[64];
 	const gchar *prefix = NULL;
 	const gchar *index_str;
 	UpDeviceKind kind;
@@ -83,7 +85,9 @@ gpm_upower_get_device_icon (UpDevice *device)
 	gboolean is_present;
 	gdouble percentage;
 
-	g_return_val_if_fail (device != NULL, NULL);
+	g_return_val_if_fail (device != NULL, 0);
+
+	filename[0] = '\0';
 
 	/* get device properties */
 	g_object_get (device,
@@ -98,54 +102,54 @@ gpm_upower_get_device_icon (UpDevice *device)
 
 	/* get the icon from some simple rules */
 	if (kind == UP_DEVICE_KIND_LINE_POWER) {
-		filename = g_strdup ("gpm-ac-adapter");
+		g_strlcpy (filename, "gpm-ac-adapter", sizeof (filename));
 	} else if (kind == UP_DEVICE_KIND_MONITOR) {
-		filename = g_strdup ("gpm-monitor");
+		g_strlcpy (filename, "gpm-monitor", sizeof (filename));
 	} else if (kind == UP_DEVICE_KIND_UPS) {
 		if (!is_present) {
 			/* battery missing */
-			filename = g_strdup_printf ("gpm-%s-missing", prefix);
+			g_snprintf (filename, sizeof (filename), "gpm-%s-missing", prefix);
 
 		} else if (state == UP_DEVICE_STATE_FULLY_CHARGED) {
-			filename = g_strdup_printf ("gpm-%s-100", prefix);
+			g_snprintf (filename, sizeof (filename), "gpm-%s-100", prefix);
 
 		} else if (state == UP_DEVICE_STATE_CHARGING) {
 			index_str = gpm_upower_get_device_icon_index (device);
-			filename = g_strdup_printf ("gpm-%s-%s-charging", prefix, index_str);
+			g_snprintf (filename, sizeof (filename), "gpm-%s-%s-charging", prefix, index_str);
 
 		} else if (state == UP_DEVICE_STATE_DISCHARGING) {
 			index_str = gpm_upower_get_device_icon_index (device);
-			filename = g_strdup_printf ("gpm-%s-%s", prefix, index_str);
+			g_snprintf (filename, sizeof (filename), "gpm-%s-%s", prefix, index_str);
 		}
 	} else if (kind == UP_DEVICE_KIND_BATTERY) {
 		if (!is_present) {
 			/* battery missing */
-			filename = g_strdup_printf ("gpm-%s-missing", prefix);
+			g_snprintf (filename, sizeof (filename), "gpm-%s-missing", prefix);
 
 		} else if (state == UP_DEVICE_STATE_EMPTY) {
-			filename = g_strdup_printf ("gpm-%s-empty", prefix);
+			g_snprintf (filename, sizeof (filename), "gpm-%s-empty", prefix);
 
 		} else if (state == UP_DEVICE_STATE_FULLY_CHARGED) {
-			filename = g_strdup_printf ("gpm-%s-charged", prefix);
+			g_snprintf (filename, sizeof (filename), "gpm-%s-charged", prefix);
 
 		} else if (state == UP_DEVICE_STATE_CHARGING) {
 			index_str = gpm_upower_get_device_icon_index (device);
-			filename = g_strdup_printf ("gpm-%s-%s-charging", prefix, index_str);
+			g_snprintf (filename, sizeof (filename), "gpm-%s-%s-charging", prefix, index_str);
 
 		} else if (state == UP_DEVICE_STATE_DISCHARGING) {
 			index_str = gpm_upower_get_device_icon_index (device);
-			filename = g_strdup_printf ("gpm-%s-%s", prefix, index_str);
+			g_snprintf (filename, sizeof (filename), "gpm-%s-%s", prefix, index_str);
 
 		} else if (state == UP_DEVICE_STATE_PENDING_CHARGE) {
 			index_str = gpm_upower_get_device_icon_index (device);
 			/* FIXME: do new grey icons */
-			filename = g_strdup_printf ("gpm-%s-%s-charging", prefix, index_str);
+			g_snprintf (filename, sizeof (filename), "gpm-%s-%s-charging", prefix, index_str);
 
 		} else if (state == UP_DEVICE_STATE_PENDING_DISCHARGE) {
 			index_str = gpm_upower_get_device_icon_index (device);
-			filename = g_strdup_printf ("gpm-%s-%s", prefix, index_str);
+			g_snprintf (filename, sizeof (filename), "gpm-%s-%s", prefix, index_str);
 		} else {
-			filename = g_strdup ("gpm-battery-missing");
+			g_strlcpy (filename, "gpm-battery-missing", sizeof (filename));
 		}
 
 	} else if (kind == UP_DEVICE_KIND_MOUSE ||
@@ -153,28 +157,40 @@ gpm_upower_get_device_icon (UpDevice *device)
 		   kind == UP_DEVICE_KIND_PHONE) {
 		if (!is_present) {
 			/* battery missing */
-			filename = g_strdup_printf ("gpm-%s-000", prefix);
+			g_snprintf (filename, sizeof (filename), "gpm-%s-000", prefix);
 
 		} else if (state == UP_DEVICE_STATE_FULLY_CHARGED) {
-			filename = g_strdup_printf ("gpm-%s-100", prefix);
+			g_snprintf (filename, sizeof (filename), "gpm-%s-100", prefix);
 
 		} else if (state == UP_DEVICE_STATE_DISCHARGING) {
 			index_str = gpm_upower_get_device_icon_index (device);
-			filename = g_strdup_printf ("gpm-%s-%s", prefix, index_str);
+			g_snprintf (filename, sizeof (filename), "gpm-%s-%s", prefix, index_str);
 		}
 	} else if (kind == UP_DEVICE_KIND_GAMING_INPUT) {
 		index_str = gpm_upower_get_device_icon_index (device);
-		filename = g_strdup_printf ("gpm-%s-%s", prefix, index_str);
+		g_snprintf (filename, sizeof (filename), "gpm-%s-%s", prefix, index_str);
 	}
 
 	/* nothing matched */
-	if (filename == NULL) {
+	if (filename[0] == '\0') {
 		g_warning ("nothing matched, falling back to default icon");
-		filename = g_strdup ("dialog-warning");
+		return g_quark_from_static_string ("dialog-warning");
 	}
 
-	g_debug ("got filename: %s", filename);
-	return filename;
+	return g_quark_from_string (filename);
+}
+
+/**
+ * gpm_upower_get_device_icon:
+ *
+ * Need to free the return value
+ *
+ **/
+gchar *
+gpm_upower_get_device_icon (UpDevice *device)
+{
+	g_return_val_if_fail (device != NULL, NULL);
+	return g_strdup (g_quark_to_string (gpm_upower_get_device_icon_quark (device)));
 }
 
 /**
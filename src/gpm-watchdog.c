@@ -0,0 +1,647 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * The watchdog finds out when the main loop stops turning. A heartbeat
+ * at high priority notes the time on every beat, and the late beats give
+ * the stall histogram. A thread watches the heartbeat, and when it stops
+ * for longer than the threshold it notes what the main loop is stuck in.
+ *
+ * The main thread publishes what it is dispatching in a slot the watching
+ * thread reads: GpmTimer names the timer it is running, idle and timeout
+ * sources are named by wrapping their dispatch, and the signals of the
+ * watched types name themselves from an emission hook. Every name is
+ * interned, so the watching thread never sees one being freed.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "gpm-timer.h"
+#include "gpm-watchdog.h"
+
+static void     gpm_watchdog_finalize   (GObject	  *object);
+
+#define GPM_WATCHDOG_STALLS_MAX		10
+
+static const guint gpm_watchdog_limits[] = { 50, 100, 250, 500, 1000, 2500, 5000, G_MAXUINT };
+#define GPM_WATCHDOG_BUCKETS		G_N_ELEMENTS (gpm_watchdog_limits)
+
+typedef struct
+{
+	guint			 signal_id;
+	gulong			 hook_id;
+} GpmWatchdogHook;
+
+typedef gboolean (*GpmWatchdogDispatchFunc) (GSource *source, GSourceFunc callback, gpointer user_data);
+
+struct GpmWatchdogPrivate
+{
+	GMutex			 mutex;
+	GCond			 cond;
+	GThread			*thread;
+	gboolean		 running;
+	gint64			 last_beat;
+	gint64			 sampled_beat;
+	const gchar		*stalled_in;	/* interned, or NULL */
+	guint			 heartbeat_id;
+	guint			 interval;
+	guint			 threshold;
+	guint			 histogram[GPM_WATCHDOG_BUCKETS];
+	GQueue			*stalls;
+	GArray			*types;		/* of GType */
+	GArray			*hooks;		/* of GpmWatchdogHook */
+};
+
+/* written by the main thread, read by the watching thread */
+static const gchar *gpm_watchdog_dispatching = NULL;
+static GThread *gpm_watchdog_main_thread = NULL;
+static guint gpm_watchdog_depth = 0;
+static GpmWatchdogDispatchFunc gpm_watchdog_idle_dispatch = NULL;
+static GpmWatchdogDispatchFunc gpm_watchdog_timeout_dispatch = NULL;
+
+static gpointer gpm_watchdog_object = NULL;
+
+G_DEFINE_TYPE_WITH_PRIVATE (GpmWatchdog, gpm_watchdog, G_TYPE_OBJECT)
+
+/**
+ * gpm_watchdog_dispatch:
+ *
+ * Publishes the name of the source around its dispatch. Only the
+ * outermost dispatch clears it again, so a name set by a signal from an
+ * unwrapped source, e.g. the X events, lasts until the next one ends.
+ **/
+static gboolean
+gpm_watchdog_dispatch (GpmWatchdogDispatchFunc dispatch, GSource *source,
+		       GSourceFunc callback, gpointer user_data)
+{
+	const gchar *previous;
+	const gchar *name;
+	gboolean ret;
+
+	if (g_thread_self () != gpm_watchdog_main_thread)
+		return dispatch (source, callback, user_data);
+
+	name = g_source_get_name (source);
+	previous = g_atomic_pointer_get (&gpm_watchdog_dispatching);
+	g_atomic_pointer_set (&gpm_watchdog_dispatching,
+			      name != NULL ? g_intern_string (name) : "unnamed source");
+	gpm_watchdog_depth++;
+	ret = dispatch (source, callback, user_data);
+	gpm_watchdog_depth--;
+	g_atomic_pointer_set (&gpm_watchdog_dispatching,
+			      gpm_watchdog_depth > 0 ? previous : NULL);
+	return ret;
+}
+
+/**
+ * gpm_watchdog_idle_dispatch_cb:
+ **/
+static gboolean
+gpm_watchdog_idle_dispatch_cb (GSource *source, GSourceFunc callback, gpointer user_data)
+{
+	return gpm_watchdog_dispatch (gpm_watchdog_idle_dispatch, source, callback, user_data);
+}
+
+/**
+ * gpm_watchdog_timeout_dispatch_cb:
+ **/
+static gboolean
+gpm_watchdog_timeout_dispatch_cb (GSource *source, GSourceFunc callback, gpointer user_data)
+{
+	return gpm_watchdog_dispatch (gpm_watchdog_timeout_dispatch, source, callback, user_data);
+}
+
+/**
+ * gpm_watchdog_signal_hook_cb:
+ **/
+static gboolean
+gpm_watchdog_signal_hook_cb (GSignalInvocationHint *ihint, guint n_param_values,
+			     const GValue *param_values, gpointer data)
+{
+	if (g_thread_self () == gpm_watchdog_main_thread)
+		g_atomic_pointer_set (&gpm_watchdog_dispatching, data);
+	return TRUE;
+}
+
+/**
+ * gpm_watchdog_dbus_signal_hook_cb:
+ *
+ * Every D-Bus signal comes through GDBusProxy::g-signal, so name the
+ * D-Bus signal rather than that.
+ **/
+static gboolean
+gpm_watchdog_dbus_signal_hook_cb (GSignalInvocationHint *ihint, guint n_param_values,
+				  const GValue *param_values, gpointer data)
+{
+	GDBusProxy *proxy;
+	gchar *name;
+
+	if (g_thread_self () != gpm_watchdog_main_thread || n_param_values < 3)
+		return TRUE;
+	proxy = g_value_get_object (&param_values[0]);
+	name = g_strdup_printf ("%s.%s", g_dbus_proxy_get_interface_name (proxy),
+				g_value_get_string (&param_values[2]));
+	g_atomic_pointer_set (&gpm_watchdog_dispatching, g_intern_string (name));
+	g_free (name);
+	return TRUE;
+}
+
+/**
+ * gpm_watchdog_hook_type:
+ **/
+static void
+gpm_watchdog_hook_type (GpmWatchdog *watchdog, GType type)
+{
+	GpmWatchdogHook hook;
+	GSignalQuery query;
+	gpointer klass;
+	gchar *name;
+	guint *ids;
+	guint n_ids;
+	guint i;
+
+	/* the signals only exist once the class does */
+	klass = g_type_class_ref (type);
+	ids = g_signal_list_ids (type, &n_ids);
+	for (i = 0; i < n_ids; i++) {
+		g_signal_query (ids[i], &query);
+		if (query.signal_flags & G_SIGNAL_NO_HOOKS)
+			continue;
+		hook.signal_id = ids[i];
+		if (type == G_TYPE_DBUS_PROXY && g_strcmp0 (query.signal_name, "g-signal") == 0) {
+			hook.hook_id = g_signal_add_emission_hook (ids[i], 0,
+								   gpm_watchdog_dbus_signal_hook_cb,
+								   NULL, NULL);
+		} else {
+			name = g_strdup_printf ("%s::%s", g_type_name (type), query.signal_name);
+			hook.hook_id = g_signal_add_emission_hook (ids[i], 0,
+								   gpm_watchdog_signal_hook_cb,
+								   (gpointer) g_intern_string (name), NULL);
+			g_free (name);
+		}
+		g_array_append_val (watchdog->priv->hooks, hook);
+	}
+	g_free (ids);
+	g_type_class_unref (klass);
+}
+
+/**
+ * gpm_watchdog_watch_type:
+ * @watchdog: This class instance
+ * @type: A type whose signals could block the main loop
+ *
+ * Names the signals of @type in the stalls they are emitted in. The
+ * signals of #GDBusProxy are always watched.
+ **/
+void
+gpm_watchdog_watch_type (GpmWatchdog *watchdog, GType type)
+{
+	g_return_if_fail (GPM_IS_WATCHDOG (watchdog));
+
+	g_array_append_val (watchdog->priv->types, type);
+	if (watchdog->priv->running)
+		gpm_watchdog_hook_type (watchdog, type);
+}
+
+/**
+ * gpm_watchdog_check:
+ *
+ * Called with the mutex held, samples each stall once.
+ **/
+static void
+gpm_watchdog_check (GpmWatchdog *watchdog, gint64 now)
+{
+	GpmWatchdogPrivate *priv = watchdog->priv;
+	const gchar *name;
+
+	if (priv->last_beat == priv->sampled_beat)
+		return;
+	if (now - priv->last_beat < (priv->interval + priv->threshold) * G_TIME_SPAN_MILLISECOND)
+		return;
+	priv->sampled_beat = priv->last_beat;
+
+	/* a timer is run from inside the GpmTimer source, so is the more exact */
+	name = gpm_timer_get_dispatching ();
+	if (name == NULL)
+		name = g_atomic_pointer_get (&gpm_watchdog_dispatching);
+	priv->stalled_in = name;
+}
+
+/**
+ * gpm_watchdog_thread:
+ **/
+static gpointer
+gpm_watchdog_thread (gpointer user_data)
+{
+	GpmWatchdog *watchdog = GPM_WATCHDOG (user_data);
+	GpmWatchdogPrivate *priv = watchdog->priv;
+
+	g_mutex_lock (&priv->mutex);
+	while (priv->running) {
+		g_cond_wait_until (&priv->cond, &priv->mutex,
+				   g_get_monotonic_time () + priv->interval * G_TIME_SPAN_MILLISECOND);
+		if (!priv->running)
+			break;
+		gpm_watchdog_check (watchdog, g_get_monotonic_time ());
+	}
+	g_mutex_unlock (&priv->mutex);
+	return NULL;
+}
+
+/**
+ * gpm_watchdog_beat:
+ **/
+static void
+gpm_watchdog_beat (GpmWatchdog *watchdog, gint64 now)
+{
+	GpmWatchdogPrivate *priv = watchdog->priv;
+	const gchar *stalled_in;
+	const gchar *name;
+	gint64 previous;
+	gint64 stall;
+	guint i;
+
+	g_mutex_lock (&priv->mutex);
+	previous = priv->last_beat;
+	priv->last_beat = now;
+	stalled_in = priv->stalled_in;
+	priv->stalled_in = NULL;
+	g_mutex_unlock (&priv->mutex);
+
+	/* how much later than asked for we got here */
+	stall = (now - previous) / G_TIME_SPAN_MILLISECOND - priv->interval;
+	if (stall < 0)
+		stall = 0;
+	for (i = 0; i < GPM_WATCHDOG_BUCKETS - 1; i++) {
+		if (stall < gpm_watchdog_limits[i])
+			break;
+	}
+	priv->histogram[i]++;
+
+	if (stall >= priv->threshold) {
+		name = stalled_in != NULL ? stalled_in : "unknown source";
+		g_warning ("main loop stalled for %" G_GINT64_FORMAT "ms in %s", stall, name);
+		g_queue_push_tail (priv->stalls,
+				   g_strdup_printf ("%" G_GINT64_FORMAT "ms in %s", stall, name));
+		if (g_queue_get_length (priv->stalls) > GPM_WATCHDOG_STALLS_MAX)
+			g_free (g_queue_pop_head (priv->stalls));
+	}
+}
+
+/**
+ * gpm_watchdog_heartbeat_cb:
+ **/
+static gboolean
+gpm_watchdog_heartbeat_cb (GpmWatchdog *watchdog)
+{
+	gpm_watchdog_beat (watchdog, g_get_monotonic_time ());
+	return TRUE;
+}
+
+/**
+ * gpm_watchdog_start:
+ * @watchdog: This class instance
+ * @interval: How often the heartbeat runs, in ms
+ * @threshold: How late the heartbeat has to be before it is a stall, in ms
+ *
+ * Must be called from the thread running the default main context.
+ *
+ * Return value: %TRUE if the watchdog was started
+ **/
+gboolean
+gpm_watchdog_start (GpmWatchdog *watchdog, guint interval, guint threshold)
+{
+	GpmWatchdogPrivate *priv;
+	guint i;
+
+	g_return_val_if_fail (GPM_IS_WATCHDOG (watchdog), FALSE);
+	g_return_val_if_fail (interval > 0, FALSE);
+
+	priv = watchdog->priv;
+	if (priv->running)
+		return FALSE;
+
+	priv->interval = interval;
+	priv->threshold = threshold;
+	priv->last_beat = g_get_monotonic_time ();
+	priv->sampled_beat = 0;
+	priv->stalled_in = NULL;
+	priv->running = TRUE;
+
+	/* name what the main thread dispatches */
+	gpm_watchdog_main_thread = g_thread_self ();
+	gpm_watchdog_idle_dispatch = g_idle_funcs.dispatch;
+	g_idle_funcs.dispatch = gpm_watchdog_idle_dispatch_cb;
+	gpm_watchdog_timeout_dispatch = g_timeout_funcs.dispatch;
+	g_timeout_funcs.dispatch = gpm_watchdog_timeout_dispatch_cb;
+	gpm_watchdog_hook_type (watchdog, G_TYPE_DBUS_PROXY);
+	for (i = 0; i < priv->types->len; i++)
+		gpm_watchdog_hook_type (watchdog, g_array_index (priv->types, GType, i));
+
+	priv->heartbeat_id = g_timeout_add_full (G_PRIORITY_HIGH, interval,
+						 (GSourceFunc) gpm_watchdog_heartbeat_cb,
+						 watchdog, NULL);
+	g_source_set_name_by_id (priv->heartbeat_id, "[GpmWatchdog] heartbeat");
+	priv->thread = g_thread_new ("gpm-watchdog", gpm_watchdog_thread, watchdog);
+	g_debug ("watching the main loop every %ums for stalls over %ums", interval, threshold);
+	return TRUE;
+}
+
+/**
+ * gpm_watchdog_stop:
+ **/
+void
+gpm_watchdog_stop (GpmWatchdog *watchdog)
+{
+	GpmWatchdogPrivate *priv;
+	GpmWatchdogHook *hook;
+	guint i;
+
+	g_return_if_fail (GPM_IS_WATCHDOG (watchdog));
+
+	priv = watchdog->priv;
+	if (!priv->running)
+		return;
+
+	g_mutex_lock (&priv->mutex);
+	priv->running = FALSE;
+	g_cond_signal (&priv->cond);
+	g_mutex_unlock (&priv->mutex);
+	g_thread_join (priv->thread);
+	priv->thread = NULL;
+
+	g_source_remove (priv->heartbeat_id);
+	priv->heartbeat_id = 0;
+
+	/* only the main thread ever looks at these */
+	for (i = 0; i < priv->hooks->len; i++) {
+		hook = &g_array_index (priv->hooks, GpmWatchdogHook, i);
+		g_signal_remove_emission_hook (hook->signal_id, hook->hook_id);
+	}
+	g_array_set_size (priv->hooks, 0);
+	g_idle_funcs.dispatch = gpm_watchdog_idle_dispatch;
+	g_timeout_funcs.dispatch = gpm_watchdog_timeout_dispatch;
+	g_atomic_pointer_set (&gpm_watchdog_dispatching, NULL);
+
+	for (i = 0; i < GPM_WATCHDOG_BUCKETS; i++) {
+		if (priv->histogram[i] == 0)
+			continue;
+		g_debug ("stalls under %ums: %u", gpm_watchdog_limits[i], priv->histogram[i]);
+	}
+}
+
+/**
+ * gpm_watchdog_is_running:
+ **/
+gboolean
+gpm_watchdog_is_running (GpmWatchdog *watchdog)
+{
+	g_return_val_if_fail (GPM_IS_WATCHDOG (watchdog), FALSE);
+	return watchdog->priv->running;
+}
+
+/**
+ * gpm_watchdog_get_histogram:
+ * @watchdog: This class instance
+ * @limits: (out): the upper limit of each bucket in ms, the last being G_MAXUINT
+ * @counts: (out): the number of heartbeats that were late by less than each limit
+ **/
+void
+gpm_watchdog_get_histogram (GpmWatchdog *watchdog, GArray **limits, GArray **counts)
+{
+	g_return_if_fail (GPM_IS_WATCHDOG (watchdog));
+
+	*limits = g_array_sized_new (FALSE, FALSE, sizeof (guint), GPM_WATCHDOG_BUCKETS);
+	g_array_append_vals (*limits, gpm_watchdog_limits, GPM_WATCHDOG_BUCKETS);
+	*counts = g_array_sized_new (FALSE, FALSE, sizeof (guint), GPM_WATCHDOG_BUCKETS);
+	g_array_append_vals (*counts, watchdog->priv->histogram, GPM_WATCHDOG_BUCKETS);
+}
+
+/**
+ * gpm_watchdog_get_stalls:
+ *
+ * Return value: the most recent stalls over the threshold, oldest first
+ **/
+gchar **
+gpm_watchdog_get_stalls (GpmWatchdog *watchdog)
+{
+	gchar **stalls;
+	GList *l;
+	guint i = 0;
+
+	g_return_val_if_fail (GPM_IS_WATCHDOG (watchdog), NULL);
+
+	stalls = g_new0 (gchar *, g_queue_get_length (watchdog->priv->stalls) + 1);
+	for (l = watchdog->priv->stalls->head; l != NULL; l = l->next)
+		stalls[i++] = g_strdup (l->data);
+	return stalls;
+}
+
+/**
+ * gpm_watchdog_class_init:
+ * @klass: This class instance
+ **/
+static void
+gpm_watchdog_class_init (GpmWatchdogClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = gpm_watchdog_finalize;
+}
+
+/**
+ * gpm_watchdog_init:
+ * @watchdog: This class instance
+ **/
+static void
+gpm_watchdog_init (GpmWatchdog *watchdog)
+{
+	watchdog->priv = gpm_watchdog_get_instance_private (watchdog);
+	g_mutex_init (&watchdog->priv->mutex);
+	g_cond_init (&watchdog->priv->cond);
+	watchdog->priv->stalls = g_queue_new ();
+	watchdog->priv->types = g_array_new (FALSE, FALSE, sizeof (GType));
+	watchdog->priv->hooks = g_array_new (FALSE, FALSE, sizeof (GpmWatchdogHook));
+}
+
+/**
+ * gpm_watchdog_finalize:
+ * @object: This class instance
+ **/
+static void
+gpm_watchdog_finalize (GObject *object)
+{
+	GpmWatchdog *watchdog;
+	g_return_if_fail (object != NULL);
+	g_return_if_fail (GPM_IS_WATCHDOG (object));
+
+	watchdog = GPM_WATCHDOG (object);
+	gpm_watchdog_stop (watchdog);
+	g_queue_free_full (watchdog->priv->stalls, g_free);
+	g_array_unref (watchdog->priv->types);
+	g_array_unref (watchdog->priv->hooks);
+	g_cond_clear (&watchdog->priv->cond);
+	g_mutex_clear (&watchdog->priv->mutex);
+
+	G_OBJECT_CLASS (gpm_watchdog_parent_class)->finalize (object);
+}
+
+/**
+ * gpm_watchdog_new:
+ * Return value: new GpmWatchdog instance.
+ **/
+GpmWatchdog *
+gpm_watchdog_new (void)
+{
+	if (gpm_watchdog_object != NULL) {
+		g_object_ref (gpm_watchdog_object);
+	} else {
+		gpm_watchdog_object = g_object_new (GPM_TYPE_WATCHDOG, NULL);
+		g_object_add_weak_pointer (gpm_watchdog_object, &gpm_watchdog_object);
+	}
+	return GPM_WATCHDOG (gpm_watchdog_object);
+}
+
+/***************************************************************************
+ ***                          MAKE CHECK TESTS                           ***
+ ***************************************************************************/
+#ifdef EGG_TEST
+#include "egg-test.h"
+
+#define GPM_WATCHDOG_TEST_INTERVAL	60000 /* ms, so the real heartbeat never runs */
+#define GPM_WATCHDOG_TEST_THRESHOLD	100 /* ms */
+
+static GMainLoop *gpm_watchdog_test_loop = NULL;
+
+/* pretend the thread has looked while the main loop was held up */
+static gboolean
+gpm_watchdog_test_stall_cb (GpmWatchdog *watchdog)
+{
+	GpmWatchdogPrivate *priv = watchdog->priv;
+
+	g_mutex_lock (&priv->mutex);
+	gpm_watchdog_check (watchdog, priv->last_beat +
+			    (GPM_WATCHDOG_TEST_INTERVAL + GPM_WATCHDOG_TEST_THRESHOLD + 1) * G_TIME_SPAN_MILLISECOND);
+	g_mutex_unlock (&priv->mutex);
+	g_main_loop_quit (gpm_watchdog_test_loop);
+	return FALSE;
+}
+
+/* pretend the heartbeat came 300ms late */
+static void
+gpm_watchdog_test_late_beat (GpmWatchdog *watchdog)
+{
+	gpm_watchdog_beat (watchdog, watchdog->priv->last_beat +
+			   (GPM_WATCHDOG_TEST_INTERVAL + 300) * G_TIME_SPAN_MILLISECOND);
+}
+
+void
+gpm_watchdog_test (gpointer data)
+{
+	GpmWatchdog *watchdog;
+	GpmTimer *timer;
+	GArray *limits;
+	GArray *counts;
+	gchar **stalls;
+	gboolean ret;
+	guint id;
+	guint i;
+	guint total = 0;
+	guint stalled = 0;
+	EggTest *test = (EggTest *) data;
+
+	if (egg_test_start (test, "GpmWatchdog") == FALSE)
+		return;
+
+	/************************************************************/
+	egg_test_title (test, "start the watchdog");
+	watchdog = gpm_watchdog_new ();
+	ret = gpm_watchdog_start (watchdog, GPM_WATCHDOG_TEST_INTERVAL, GPM_WATCHDOG_TEST_THRESHOLD);
+	egg_test_assert (test, ret);
+
+	/************************************************************/
+	egg_test_title (test, "stall in an idle names the idle");
+	gpm_watchdog_test_loop = g_main_loop_new (NULL, FALSE);
+	id = g_idle_add ((GSourceFunc) gpm_watchdog_test_stall_cb, watchdog);
+	g_source_set_name_by_id (id, "[GpmWatchdog] test-idle");
+	g_main_loop_run (gpm_watchdog_test_loop);
+	gpm_watchdog_test_late_beat (watchdog);
+	stalls = gpm_watchdog_get_stalls (watchdog);
+	i = g_strv_length (stalls);
+	if (i > 0 && g_strcmp0 (stalls[i - 1], "300ms in [GpmWatchdog] test-idle") == 0)
+		egg_test_success (test, NULL);
+	else
+		egg_test_failed (test, "stall not found: %s",
+				 i > 0 ? stalls[i - 1] : "no stalls");
+	g_strfreev (stalls);
+
+	/************************************************************/
+	egg_test_title (test, "stall in a timer names the timer");
+	timer = gpm_timer_new ();
+	gpm_timer_add (timer, 0, 0, "[GpmWatchdog] test-timer",
+		       (GSourceFunc) gpm_watchdog_test_stall_cb, watchdog);
+	g_main_loop_run (gpm_watchdog_test_loop);
+	gpm_watchdog_test_late_beat (watchdog);
+	g_object_unref (timer);
+	stalls = gpm_watchdog_get_stalls (watchdog);
+	i = g_strv_length (stalls);
+	if (i > 0 && g_strcmp0 (stalls[i - 1], "300ms in [GpmWatchdog] test-timer") == 0)
+		egg_test_success (test, NULL);
+	else
+		egg_test_failed (test, "stall not found: %s",
+				 i > 0 ? stalls[i - 1] : "no stalls");
+	g_strfreev (stalls);
+	g_main_loop_unref (gpm_watchdog_test_loop);
+
+	/************************************************************/
+	egg_test_title (test, "nothing is published once the source has returned");
+	if (g_atomic_pointer_get (&gpm_watchdog_dispatching) == NULL)
+		egg_test_success (test, NULL);
+	else
+		egg_test_failed (test, "still publishing %s",
+				 (const gchar *) g_atomic_pointer_get (&gpm_watchdog_dispatching));
+
+	/************************************************************/
+	egg_test_title (test, "histogram has the stalls");
+	gpm_watchdog_stop (watchdog);
+	gpm_watchdog_get_histogram (watchdog, &limits, &counts);
+	for (i = 0; i < counts->len; i++) {
+		total += g_array_index (counts, guint, i);
+		/* the bucket only holds stalls over the threshold */
+		if (i > 0 && g_array_index (limits, guint, i - 1) >= GPM_WATCHDOG_TEST_THRESHOLD)
+			stalled += g_array_index (counts, guint, i);
+	}
+	if (limits->len == counts->len && stalled >= 2 && total >= stalled)
+		egg_test_success (test, NULL);
+	else
+		egg_test_failed (test, "histogram wrong, %u beats, %u stalls", total, stalled);
+	g_array_unref (limits);
+	g_array_unref (counts);
+
+	g_object_unref (watchdog);
+
+	egg_test_end (test);
+}
+
+#endif
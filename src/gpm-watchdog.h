@@ -0,0 +1,70 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2012-2021 MATE Developers
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __GPM_WATCHDOG_H
+#define __GPM_WATCHDOG_H
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define GPM_TYPE_WATCHDOG		(gpm_watchdog_get_type ())
+#define GPM_WATCHDOG(o)			(G_TYPE_CHECK_INSTANCE_CAST ((o), GPM_TYPE_WATCHDOG, GpmWatchdog))
+#define GPM_WATCHDOG_CLASS(k)		(G_TYPE_CHECK_CLASS_CAST((k), GPM_TYPE_WATCHDOG, GpmWatchdogClass))
+#define GPM_IS_WATCHDOG(o)		(G_TYPE_CHECK_INSTANCE_TYPE ((o), GPM_TYPE_WATCHDOG))
+#define GPM_IS_WATCHDOG_CLASS(k)	(G_TYPE_CHECK_CLASS_TYPE ((k), GPM_TYPE_WATCHDOG))
+#define GPM_WATCHDOG_GET_CLASS(o)	(G_TYPE_INSTANCE_GET_CLASS ((o), GPM_TYPE_WATCHDOG, GpmWatchdogClass))
+
+#define GPM_WATCHDOG_INTERVAL		100 /* ms */
+#define GPM_WATCHDOG_THRESHOLD		250 /* ms */
+
+typedef struct GpmWatchdogPrivate GpmWatchdogPrivate;
+
+typedef struct
+{
+	GObject			 parent;
+	GpmWatchdogPrivate	*priv;
+} GpmWatchdog;
+
+typedef struct
+{
+	GObjectClass	parent_class;
+} GpmWatchdogClass;
+
+GType		 gpm_watchdog_get_type			(void);
+GpmWatchdog	*gpm_watchdog_new			(void);
+void		 gpm_watchdog_test			(gpointer	 data);
+
+gboolean	 gpm_watchdog_start			(GpmWatchdog	*watchdog,
+							 guint		 interval,
+							 guint		 threshold);
+void		 gpm_watchdog_stop			(GpmWatchdog	*watchdog);
+gboolean	 gpm_watchdog_is_running		(GpmWatchdog	*watchdog);
+void		 gpm_watchdog_get_histogram		(GpmWatchdog	*watchdog,
+							 GArray		**limits,
+							 GArray		**counts);
+gchar		**gpm_watchdog_get_stalls		(GpmWatchdog	*watchdog);
+void		 gpm_watchdog_watch_type		(GpmWatchdog	*watchdog,
+							 GType		 type);
+
+G_END_DECLS
+
+#endif /* __GPM_WATCHDOG_H */
@@ -39,9 +39,11 @@
 #include <gdk/gdkx.h>
 
 #include "msd-osd-window.h"
+#include "gpm-timer.h"
 
 #define DIALOG_TIMEOUT 2000     /* dialog timeout in ms */
 #define DIALOG_FADE_TIMEOUT 1500 /* timeout before fade starts */
+#define DIALOG_TIMEOUT_SLACK 200 /* how late the hide can be, in ms */
 #define FADE_TIMEOUT 10        /* timeout in ms between each frame of the fade */
 
 #define BG_ALPHA 0.75
@@ -49,6 +51,7 @@
 struct MsdOsdWindowPrivate
 {
         guint                    is_composited : 1;
+        GpmTimer                *timer;
         guint                    hide_timeout_id;
         guint                    fade_timeout_id;
         double                   fade_out_alpha;
@@ -98,8 +101,8 @@ fade_timeout (MsdOsdWindow *window)
 static gboolean
 hide_timeout (MsdOsdWindow *window)
 {
+        window->priv->hide_timeout_id = 0;
         if (window->priv->is_composited) {
-                window->priv->hide_timeout_id = 0;
                 window->priv->fade_timeout_id = g_timeout_add (FADE_TIMEOUT,
                                                                (GSourceFunc) fade_timeout,
                                                                window);
@@ -114,7 +117,7 @@ static void
 remove_hide_timeout (MsdOsdWindow *window)
 {
         if (window->priv->hide_timeout_id != 0) {
-                g_source_remove (window->priv->hide_timeout_id);
+                gpm_timer_remove (window->priv->timer, window->priv->hide_timeout_id);
                 window->priv->hide_timeout_id = 0;
         }
 
@@ -135,7 +138,10 @@ add_hide_timeout (MsdOsdWindow *window)
         } else {
                 timeout = DIALOG_TIMEOUT;
         }
-        window->priv->hide_timeout_id = g_timeout_add (timeout,
+        window->priv->hide_timeout_id = gpm_timer_add (window->priv->timer,
+                                                       timeout,
+                                                       DIALOG_TIMEOUT_SLACK,
+                                                       "[MsdOsdWindow] hide",
                                                        (GSourceFunc) hide_timeout,
                                                        window);
 }
@@ -377,6 +383,17 @@ msd_osd_window_constructor (GType                  type,
         return object;
 }
 
+static void
+msd_osd_window_finalize (GObject *object)
+{
+        MsdOsdWindow *window = MSD_OSD_WINDOW (object);
+
+        remove_hide_timeout (window);
+        g_object_unref (window->priv->timer);
+
+        G_OBJECT_CLASS (msd_osd_window_parent_class)->finalize (object);
+}
+
 static void
 msd_osd_window_class_init (MsdOsdWindowClass *klass)
 {
@@ -384,6 +401,7 @@ msd_osd_window_class_init (MsdOsdWindowClass *klass)
         GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
 
         gobject_class->constructor = msd_osd_window_constructor;
+        gobject_class->finalize = msd_osd_window_finalize;
 
         widget_class->show = msd_osd_window_real_show;
         widget_class->hide = msd_osd_window_real_hide;
@@ -441,6 +459,7 @@ msd_osd_window_init (MsdOsdWindow *window)
         GtkStyleContext *style;
 
         window->priv = msd_osd_window_get_instance_private (window);
+        window->priv->timer = gpm_timer_new ();
 
         screen = gtk_widget_get_screen (GTK_WIDGET (window));
 